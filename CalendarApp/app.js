@@ -2,6 +2,7 @@
 
 // C library API
 const ffi = require('ffi');
+const ref = require('ref');
 
 // Express App (Routes)
 // https://expressjs.com/en/4x/api.html
@@ -28,6 +29,8 @@ const mysql = require('mysql');
 // The user must login before using any of the other query endpoints.
 var connection;
 var database;
+// Connections with the same login, for the requests that need one to themselves (such as a transaction)
+var pool;
 
 
 // Async
@@ -36,6 +39,13 @@ const async = require('async');
 
 // Minimization
 const fs = require('fs');
+
+// Reading the results of libcalendar's worker pool
+const net = require('net');
+const os = require('os');
+
+// Builds calendar objects straight from the parser (see parser/addon/CalendarAddon.c and binding.gyp)
+const calendarAddon = require('./build/Release/calendar.node');
 const JavaScriptObfuscator = require('javascript-obfuscator');
 
 // Important, pass in port as in `npm run dev 32432`, do not change
@@ -75,9 +85,22 @@ app.post('/upload', function(req, res) {
       return res.status(500).send(err);
     }
 
-    // XXX I added this next res.send() thing, and commented out the res.redirect part
-    res.send(uploadFile);
-    //res.redirect('/');
+    // Tell the uploader which of its events are already in other uploaded calendars. The other calendars come from
+    // the catalog, which lists the directory on libcalendar's worker pool and already knows which files are valid
+    // calendars. A file that isn't a valid calendar is reported when it is loaded, so an error here is left alone.
+    getCatalog(function(catalog) {
+      const others = (catalog.error !== undefined) ? []
+                   : catalog.filter(entry => entry.error === 'OK' && entry.filename.endsWith('.ics') && entry.filename !== uploadFile.name)
+                            .map(entry => entry.filename);
+
+      findDuplicateEvents(others, uploadFile.name, false, function(result) {
+        uploadFile.duplicates = (result.error === undefined) ? result.duplicates : [];
+
+        // XXX I added this next res.send() thing, and commented out the res.redirect part
+        res.send(uploadFile);
+        //res.redirect('/');
+      });
+    });
   });
 });
 
@@ -95,50 +118,383 @@ app.get('/uploads/:name', function(req , res){
 
 //******************** Your code goes here ******************** 
 
-// Get an array of the absolute path of every file in the /uploads directory
+// Get an array of the name of every file in the /uploads directory, from its catalog
 app.get('/uploadsContents', function(req, res) {
-    res.send(fs.readdirSync(__dirname + '/uploads/'));
+    getCatalog(function(catalog) {
+        if (catalog.error !== undefined) {
+            res.status(500).send(catalog.message);
+            return;
+        }
+
+        res.send(catalog.map(entry => entry.filename));
+    });
+});
+
+// Get the catalog entry of every file in the /uploads directory: its size, modification time, and a summary
+// of the calendar in it (or the error it has). The listing can be filtered with the query parameters
+// 'minEvents' (the least number of events a calendar has) and 'valid' ("true" to leave out invalid files).
+app.get('/catalog', function(req, res) {
+    const minEvents = (req.query.minEvents === undefined) ? undefined : Number(req.query.minEvents);
+    if (isNaN(minEvents) && minEvents !== undefined) {
+        res.status(400).send('"minEvents" must be a number');
+        return;
+    }
+
+    getCatalog(function(catalog) {
+        if (catalog.error !== undefined) {
+            res.status(500).send(catalog.message);
+            return;
+        }
+
+        if (minEvents !== undefined) {
+            catalog = catalog.filter(entry => entry.numEvents >= minEvents);
+        }
+        if (req.query.valid === 'true') {
+            catalog = catalog.filter(entry => entry.error === 'OK');
+        }
+
+        res.status(200).send(catalog);
+    });
 });
 
 
 // FFI library to use the backend written in C. All functions return JSON strings of the new Calendar.
-let lib = ffi.Library('./libcalendar', {
-    'createCalendarJSON'    : ['string', ['string']],   // filename
-    'addEventJSON'          : ['string', ['string', 'string']], // filename, Event JSON string
-    'writeCalFromJSON'      : ['string', ['string', 'string', 'string']],   // filename, Calendar JSON string, Event JSON string
+// Each string is allocated by libcalendar and owned by the caller, so it is declared as a 'pointer' (a
+// 'string' return would be copied and the original never freed) and handed back with freeResult().
+const calendarFunctions = {
+    'createCalendarJSON'    : ['pointer', ['string']],   // filename
+    'addEventJSON'          : ['pointer', ['string', 'string']], // filename, Event JSON string
+    'addEventsJSON'         : ['pointer', ['string', 'string']], // filename, JSON array of Event JSON objects
+    'writeCalFromJSON'      : ['pointer', ['string', 'string', 'string']],   // filename, Calendar JSON string, Event JSON string
+    'createCalendarJSONAsync': ['int', ['string']],     // filename
+    'addEventJSONAsync'     : ['int', ['string', 'string']],    // filename, Event JSON string
+    'addEventsJSONAsync'    : ['int', ['string', 'string']],    // filename, JSON array of Event JSON objects
+    'writeCalFromJSONAsync' : ['int', ['string', 'string', 'string']],  // filename, Calendar JSON string, Event JSON string
+    'sortedEventsJSONAsync' : ['int', ['string', 'string']], // filename, key to sort by ("start", "stamp" or "uid")
+    'createCalendarCBORAsync': ['int', ['string']],     // filename
+    'queryEventsInRangeJSONAsync': ['int', ['string', 'string', 'string']],  // filename, range start, range end
+    'eventOccurrencesJSONAsync': ['int', ['string', 'string', 'string', 'string']],  // filename, Event UID, range start, range end
+    'findConflictsJSONAsync': ['int', ['string']],      // newline-separated filenames
+    'searchEventsJSONAsync' : ['int', ['string', 'string']],    // newline-separated filenames, search query
+    'freeBusyJSONAsync'     : ['int', ['string', 'string', 'string', 'int', 'string']],  // newline-separated filenames, range start, range end, slot minutes, mode
+    'catalogJSONAsync'      : ['int', ['string']],      // directory
+    'calendarJobsFd'        : ['int', []],
+    'calendarJobResult'     : ['pointer', ['int']],      // job id
+    'loadDirectoryJSONAsync': ['int', ['string', 'int']],   // directory, most threads (0 for one per processor)
+    'duplicateEventsJSONAsync': ['int', ['string', 'bool']],    // newline-separated filenames, compare by content
+    'checkDuplicatesJSONAsync': ['int', ['string', 'string', 'bool']],  // newline-separated filenames, filename to check, compare by content
+    'nextAlarmsJSONAsync'   : ['int', ['string', 'string', 'int']],  // newline-separated filenames, time, number of alarms
+    'exportTablesTSVAsync'  : ['int', ['string', 'string', 'string', 'string']],  // filename, EVENT rows file, ALARM rows file, comma-separated positions to leave out
+    'freeResult'            : ['void', ['pointer']],
+};
+let lib = ffi.Library('./libcalendar', calendarFunctions);
+
+// The result of a createCalendarCBORAsync() job is a buffer rather than a string, so it is taken with this unwrapped call
+const takeJobResultPointer = lib.calendarJobResult;
+
+// Every function that returns a string is wrapped, so that it still returns a JS string (or null), and the
+// C string is freed as soon as it has been copied.
+for (const name of Object.keys(calendarFunctions)) {
+    if (calendarFunctions[name][0] === 'pointer') {
+        const call = lib[name];
+
+        lib[name] = function(...args) {
+            const result = call(...args);
+            if (result.isNull()) {
+                return null;
+            }
+
+            const str = ref.readCString(result, 0);
+            lib.freeResult(result);
+            return str;
+        };
+    }
+}
+
+// Calls handed to libcalendar's pool of worker threads (see JobQueue.h) that are waiting for their results, by job id
+const pendingJobs = new Map();
+
+// The id of every finished job comes out of this pipe as a native int. It is read like any other socket, so the
+// event loop never waits on a job, and a large calendar being parsed doesn't hold up anyone else's requests.
+const jobFd = lib.calendarJobsFd();
+if (jobFd < 0) {
+    throw new Error('Could not start the libcalendar worker pool');
+}
+const jobPipe = new net.Socket({fd: jobFd, readable: true, writable: false});
+const readJobId = 'readInt32' + os.endianness();
+let jobBytes = Buffer.alloc(0);
+
+jobPipe.on('data', function(chunk) {
+    // An id may be split between two chunks
+    jobBytes = Buffer.concat([jobBytes, chunk]);
+    for (; jobBytes.length >= 4; jobBytes = jobBytes.slice(4)) {
+        const id = jobBytes[readJobId](0);
+        const job = pendingJobs.get(id);
+
+        pendingJobs.delete(id);
+        if (job !== undefined) {
+            job.callback(job.takeResult(id));
+        }
+    }
+});
+jobPipe.unref();
+
+// Calls 'callback' with the result of the job 'id' once a worker has run it, or with an error code JSON if the
+// job could not be queued. The result is taken with 'takeResult' (calendarJobResult() if it is left out).
+// The job can't finish before this is called, since ids are only read from the pipe once the current callback returns.
+function whenJobDone(id, callback, takeResult) {
+    if (id < 0) {
+        callback(JSON.stringify({'error': 'Other error', 'filename': 'N/A', 'message': 'Could not queue the job in libcalendar'}));
+        return;
+    }
+
+    pendingJobs.set(id, {'callback': callback, 'takeResult': (takeResult === undefined) ? lib.calendarJobResult : takeResult});
+}
+
+// Takes the result of a createCalendarCBORAsync() job: a native int holding the number of bytes of CBOR that follow
+// it, or -1 if an error code JSON follows instead. Returns the CBOR copied into a Buffer, or the error code JSON.
+function takeCBORResult(id) {
+    const result = takeJobResultPointer(id);
+    if (result.isNull()) {
+        return JSON.stringify({'error': 'Other error', 'filename': 'N/A', 'message': 'Could not allocate memory for the encoded calendar'});
+    }
+
+    const length = result.reinterpret(4)[readJobId](0);
+    const toReturn = (length < 0) ? ref.readCString(result, 4) : Buffer.from(result.reinterpret(4 + length).slice(4));
+    lib.freeResult(result);
+    return toReturn;
+}
+
+// Calls 'callback' with the catalog of the /uploads directory (see Catalog.h), which only parses the files that
+// changed since it was last asked for, or with an error code object
+function getCatalog(callback) {
+    whenJobDone(lib.catalogJSONAsync(__dirname + '/uploads'), function(retStr) {
+        try {
+            callback(JSON.parse(retStr));
+        } catch (e) {
+            console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+            callback({'error': 'Other error', 'message': e.message});
+        }
+    });
+}
+
+// Calls 'callback' with the Events of the uploaded calendar 'filename' that one of the uploaded calendars in 'names'
+// already has (see Dedup.h), comparing them by UID alone or, if 'byContent' is true, also by their content, or with
+// an error code object
+function findDuplicateEvents(names, filename, byContent, callback) {
+    const paths = names.map(name => __dirname + '/uploads/' + name).join('\n');
+
+    whenJobDone(lib.checkDuplicatesJSONAsync(paths, __dirname + '/uploads/' + filename, byContent), function(retStr) {
+        try {
+            callback(JSON.parse(retStr));
+        } catch (e) {
+            console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+            callback({'error': 'Other error', 'message': e.message});
+        }
+    });
+}
+
+// The directory that the files of table rows are written to. mkdtemp() gives it a name that can't be guessed and makes
+// it usable by this user only, so no one else can put a file or a link where one of them is about to be written.
+const tableDir = fs.mkdtempSync(path.join(os.tmpdir(), 'calendar-'));
+process.on('exit', function() {
+    try {
+        fs.rmdirSync(tableDir);
+    } catch (e) {
+        // Only an upload that was still going leaves a file behind
+    }
 });
 
+// The number of files of table rows made so far, so that two uploads never write to the same one
+let numTableFiles = 0;
+
+// Returns the path of a new temporary file to write the rows of 'table' to
+function tableFilePath(table) {
+    return path.join(tableDir, (numTableFiles++) + '-' + table + '.tsv');
+}
+
+// The most rows put into one INSERT when a table can't be bulk loaded, to stay under max_allowed_packet
+const MAX_INSERT_ROWS = 1000;
+
+// Reads the tab-separated rows that exportTablesTSV() writes (see TableExport.h) back into arrays of strings,
+// with \N as null
+function readTableRows(file) {
+    const escapes = {'\\\\': '\\', '\\t': '\t', '\\n': '\n', '\\r': '\r', '\\0': '\0'};
+
+    return fs.readFileSync(file, 'utf8').split('\n').slice(0, -1).map(line => line.split('\t').map(field =>
+        (field === '\\N') ? null : field.replace(/\\[\\tnr0]/g, escape => escapes[escape])));
+}
+
+// Loads the rows in 'file' into a table with the LOAD DATA LOCAL INFILE statement 'loadQuery', run on 'conn'. If the
+// server doesn't allow that (or 'loadQuery' is null), the rows are read in, turned into the values of a row of the table
+// by 'toValues', and inserted MAX_INSERT_ROWS at a time with 'insertQuery' (an "INSERT ... VALUES ?"). Calls 'callback'
+// with the error.
+function loadTable(conn, file, loadQuery, insertQuery, toValues, callback) {
+    const insertRows = function() {
+        const values = readTableRows(file).map(toValues);
+        const chunks = [];
+        for (let i = 0; i < values.length; i += MAX_INSERT_ROWS) {
+            chunks.push(values.slice(i, i + MAX_INSERT_ROWS));
+        }
+
+        async.eachSeries(chunks, (chunk, done) => conn.query(insertQuery, [chunk], err => done(err)), callback);
+    };
+
+    if (loadQuery === null) {
+        insertRows();
+        return;
+    }
+
+    conn.query(loadQuery, function(err) {
+        // ER_NOT_ALLOWED_COMMAND, or ER_CLIENT_LOCAL_FILES_DISABLED from MySQL 8 (where local_infile is off by default)
+        if (!err || (err.errno !== 1148 && err.errno !== 3948)) {
+            callback(err);
+            return;
+        }
+
+        insertRows();
+    });
+}
+
 
 // Given a file name (which will be appended to the path to the /uploads/ dir),
 // returns the Calendar JSON created from that file, or an error code JSON on a failure.
 app.get('/getCal/:name', function(req, res) {
     var path = __dirname + '/uploads/' + req.params.name;
     console.log('\nCreating calendar from "' + path + '"');
-    var retStr = lib.createCalendarJSON(path);
+    // The calendar is parsed off the main thread, and comes back as an object with no JSON in between
+    calendarAddon.createCalendarAsync(path, function(obj) {
+        var toReturn;
+
+        if (obj.error != undefined) {
+            // An error occurred
+            toReturn = obj;
+            console.log('Error occurred when creating calendar from "' + path + '": ' + toReturn.error + '; ' + toReturn.message);
+        } else {
+            // Calendar was created successfully
+            console.log('Successfully created calendar from "' + path + '"');
+            toReturn = {
+                'filename': req.params.name,
+                'obj': obj
+            };
+        }
 
-    try {
-        var obj = JSON.parse(retStr);
-    } catch (e) {
-        console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
-        res.status(500).send(e.message);
+        res.status(200).send(toReturn);
+    });
+});
+
+// Reads in every file in the /uploads directory at once, on as many threads as there are processors (or the
+// 'threads' query parameter, if it is given), and sends {numFiles, numErrors, calendars}, where each of the
+// calendars is what /getCal would send for the file. The JSON from libcalendar is sent as it is.
+app.get('/getAllCals', function(req, res) {
+    const threads = (req.query.threads === undefined) ? 0 : Number(req.query.threads);
+    if (!Number.isInteger(threads) || threads < 0) {
+        res.status(400).send('threads must be a whole number');
         return;
     }
-    var toReturn;
 
-    if (obj.error != undefined) {
-        // An error occurred
-        toReturn = obj;
-        console.log('Error occurred when creating calendar from "' + path + '": ' + toReturn.error + '; ' + toReturn.message);
-    } else {
-        // Calendar was created successfully
-        console.log('Successfully created calendar from "' + path + '"');
-        toReturn = {
-            'filename': req.params.name,
-            'obj': obj
-        };
+    whenJobDone(lib.loadDirectoryJSONAsync(__dirname + '/uploads', threads), function(retStr) {
+        console.log('\n/getAllCals: loaded the uploaded calendars');
+        res.status(200).type('json').send(retStr);
+    });
+});
+
+// Sends every Event of the given calendar file sorted by 'key' ("start", the default, "stamp" or "uid"),
+// without going through the database
+app.get('/getEventsSorted/:name', function(req, res) {
+    const key = (req.query.key === undefined) ? 'start' : String(req.query.key);
+    whenJobDone(lib.sortedEventsJSONAsync(__dirname + '/uploads/' + req.params.name, key), function(retStr) {
+        let events;
+        try {
+            events = JSON.parse(retStr);
+        } catch (e) {
+            console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+            res.status(500).send(e.message);
+            return;
+        }
+
+        if (events.error !== undefined) {
+            console.log('Error occurred when sorting the events of "' + req.params.name + '": ' + events.error + '; ' + events.message);
+        }
+
+        res.status(200).send(events);
+    });
+});
+
+// Same as /getCal/:name, except the Calendar is sent as CBOR (application/cbor) instead of JSON.
+// Errors are still sent as JSON error objects.
+app.get('/getCalCBOR/:name', function(req, res) {
+    var path = __dirname + '/uploads/' + req.params.name;
+
+    // The encoded calendar comes back copied out of C memory, or as an error JSON string if an error occurred
+    whenJobDone(lib.createCalendarCBORAsync(path), function(encoded) {
+        if (!Buffer.isBuffer(encoded)) {
+            var err = JSON.parse(encoded);
+            console.log('Error occurred when encoding calendar from "' + path + '": ' + err.error + '; ' + err.message);
+            res.status(200).send(err);
+            return;
+        }
+
+        res.status(200).type('application/cbor').send(encoded);
+    }, takeCBORResult);
+});
+
+// Sends every Event in the calendar file that overlaps the range of time [from, to), sorted by start time,
+// straight from the parsed calendar (no database needed). 'from' and 'to' are dates or date-times, either as
+// iCalendar values (20190305, 20190305T120000) or with separators (2019-03-05, 2019-03-05T12:00:00).
+// Without 'to', the range is the whole day of 'from'.
+app.get('/getEventsInRange/:filename', function(req, res) {
+    if (req.query.from === undefined) {
+        res.status(400).send('Missing "from" (start of the range) query parameter');
+        return;
     }
 
-    res.status(200).send(toReturn);
+    const from = String(req.query.from).replace(/[-:]/g, '');
+    const to = (req.query.to === undefined) ? '' : String(req.query.to).replace(/[-:]/g, '');
+    whenJobDone(lib.queryEventsInRangeJSONAsync(__dirname + '/uploads/' + req.params.filename, from, to), function(retStr) {
+        let events;
+        try {
+            events = JSON.parse(retStr);
+        } catch (e) {
+            console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+            res.status(500).send(e.message);
+            return;
+        }
+
+        if (events.error !== undefined) {
+            console.log('Error occurred when querying events of "' + req.params.filename + '": ' + events.error + '; ' + events.message);
+        }
+
+        res.status(200).send(events);
+    });
+});
+
+// Sends the times that the Event with the given UID occurs at within [from, to), following its RRULE,
+// RDATEs and EXDATEs. 'from' and 'to' are given the same way as for /getEventsInRange.
+app.get('/getOccurrences/:filename/:uid', function(req, res) {
+    if (req.query.from === undefined || req.query.to === undefined) {
+        res.status(400).send('Missing "from" or "to" (range of time) query parameter');
+        return;
+    }
+
+    const from = String(req.query.from).replace(/[-:]/g, '');
+    const to = String(req.query.to).replace(/[-:]/g, '');
+    whenJobDone(lib.eventOccurrencesJSONAsync(__dirname + '/uploads/' + req.params.filename, req.params.uid, from, to), function(retStr) {
+        let occurrences;
+        try {
+            occurrences = JSON.parse(retStr);
+        } catch (e) {
+            console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+            res.status(500).send(e.message);
+            return;
+        }
+
+        if (occurrences.error !== undefined) {
+            console.log('Error occurred when expanding event "' + req.params.uid + '" of "' + req.params.filename + '": ' + occurrences.error + '; ' + occurrences.message);
+        }
+
+        res.status(200).send(occurrences);
+    });
 });
 
 //Given a file name, and an Event JSON, adds the Event provided by the JSON
@@ -155,11 +511,33 @@ app.post('/addEvent', function(req, res) {
         return;
     }
 
-    var newCalJSON = lib.addEventJSON(__dirname + '/uploads/' + req.body.filename, req.body.evt);
+    // Only the new event is sent back; the rest of the calendar is unchanged
+    whenJobDone(lib.addEventJSONAsync(__dirname + '/uploads/' + req.body.filename, req.body.evt), function(newEvtJSON) {
+        console.log('\n/addEvent: Received the JSON of the new event: "' + newEvtJSON + '"');
+
+        res.status(200).send(newEvtJSON);
+    });
+});
+
+// Adds every Event in the JSON array 'evts' to the calendar file 'filename' with a single write.
+// Responds with the Events that were added, and the reason each of the others was rejected.
+app.post('/addEvents', function(req, res) {
+    if (req.body.filename == undefined && req.body.evts == undefined) {
+        res.status(400).send('No parameters given');
+        return;
+    } else if (req.body.filename == undefined) {
+        res.status(400).send('Missing filename parameter');
+        return;
+    } else if (req.body.evts == undefined) {
+        res.status(400).send('Missing evts (array of Event objects) parameter');
+        return;
+    }
 
-    console.log('\n/addEvent: Received calendar JSON (with a new event): "' + newCalJSON + '"');
+    whenJobDone(lib.addEventsJSONAsync(__dirname + '/uploads/' + req.body.filename, req.body.evts), function(resultJSON) {
+        console.log('\n/addEvents: Received the result of adding a batch of events: "' + resultJSON + '"');
 
-    res.status(200).send(newCalJSON);
+        res.status(200).send(resultJSON);
+    });
 });
 
 // Writes the given Calendar JSON object to the provided file path
@@ -179,11 +557,11 @@ app.post('/writeCalendarJSON', function(req, res) {
     }
 
     //var newCalJSON = lib.writeCalFromJSON(__dirname + '/uploads/' + req.query.filename, JSON.stringify(req.query.cal), JSON.stringify(req.query.evt));
-    var newCalJSON = lib.writeCalFromJSON(__dirname + '/uploads/' + req.body.filename, req.body.cal, req.body.evt);
+    whenJobDone(lib.writeCalFromJSONAsync(__dirname + '/uploads/' + req.body.filename, req.body.cal, req.body.evt), function(newCalJSON) {
+        console.log('\n/writeCalendarJSON: returned ' + newCalJSON);
 
-    console.log('\n/writeCalendarJSON: returned ' + newCalJSON);
-
-    res.status(200).send(newCalJSON);
+        res.status(200).send(newCalJSON);
+    });
 });
 
 
@@ -200,6 +578,11 @@ app.post('/databaseLogin', function(req, res) {
     });
     database = req.body.databaseName;
 
+    if (pool !== undefined) {
+        pool.end(() => {});
+        pool = undefined;
+    }
+
     connection.connect(function(err) {
         if (err) {
             console.log('Encountered error when logging into database with credentials (yes, I know this isnt "secure", but whatever): "' + JSON.stringify(req.body) + '"');
@@ -207,6 +590,13 @@ app.post('/databaseLogin', function(req, res) {
             return;
         }
 
+        pool = mysql.createPool({
+            host     : 'dursley.socs.uoguelph.ca',
+            user     : req.body.username,
+            password : req.body.password,
+            database : req.body.databaseName
+        });
+
         res.status(200).send('Connected to database with the following credentials: "' + JSON.stringify(req.body) + '"');
     });
 });
@@ -291,7 +681,7 @@ app.get('/createTables', function(req, res) {
 
 // Load a single calendar file into the MySQL database
 app.get('/insertIntoDB/:filename', function(req, res) {
-    if (connection === undefined) {
+    if (connection === undefined || pool === undefined) {
         res.status(401).send('Not logged in to database: connection failed');
         return;
     }
@@ -301,104 +691,135 @@ app.get('/insertIntoDB/:filename', function(req, res) {
         return;
     }
 
-    let calJSON = lib.createCalendarJSON(__dirname + '/uploads/' + req.params.filename);
-    //console.log("\nIn /insertIntoDB/" + req.params.filename + ", received Calendar JSON: \n\"" + calJSON + "\"\n");
-
-    if (calJSON === undefined) {
-        res.status(500).send('calJSON was undefined');
-        return;
-    }
-
-    // Parse the calendar received from the backend
-    let cal;
-    try {
-        cal = JSON.parse(calJSON);
-    } catch (e) {
-        console.log('\nFatal error in JSON.parse(): the JSON that broke it: ' + retStr);
-        res.status(500).send('Fatal error when parsing JSON created from "' + req.params.filename + '"');
-        return;
-    }
-
-
-    // A regex to match every single quote
-    var sQuote = RegExp("'", "g");
-
-
-    // First, see if the calendar file is already in the table. If it is, then replace it
-    connection.query("SELECT cal_id FROM FILE WHERE file_Name='" + req.params.filename.replace(sQuote, "''") + "'", function(err, rows, fields) {
+    // The calendar is inserted in a transaction, which needs a connection of its own: on the shared one, the queries
+    // of every other request would run inside it, and be committed or rolled back along with it
+    pool.getConnection(function(err, conn) {
         if (err) {
-            console.log('Encountered error when trying to see if FILE row with file_Name="' + req.params.filename + '" exists: ' + err);
-            res.status(500).send(err.sqlMessage);
-            return;
-        }
-
-        if (rows.length !== 0) {
-            // The calendar file is already in the database
-            console.log('The calendar "' + req.params.filename + '" is already in the database');
-            res.status(200).send({'alreadyContained':true, 'message':'The Calendar "' + req.params.filename + '" is already in the databse. It was not reuploaded'});
+            console.log('Encountered error when getting a connection to insert "' + req.params.filename + '" with: ' + err);
+            res.status(500).send(err.sqlMessage || err.message);
             return;
         }
 
-        // Insert the calendar into the FILE table
-        connection.query("INSERT INTO FILE (file_Name,version,prod_id) VALUES ('" + req.params.filename.replace(sQuote, "''") + "'," + cal.version + ",'" + cal.prodID.replace(sQuote, "''") + "')", function(err, rows, fields) {
+        // By default every Event of the file is stored, even if another file in the database has one with the same UID:
+        // the rows belong to their own file, so leaving them out would lose them as soon as the other file is deleted, and
+        // a UID alone doesn't tell a recurrence override or a newer version of an Event from a copy of it. The uploader
+        // is only told how many of them the other files already have. With 'skipDuplicates=true', those Events are left
+        // out of the EVENT and ALARM tables instead.
+        conn.query("SELECT file_Name FROM FILE", function(err, rows, fields) {
             if (err) {
-                console.log('error when inserting calendar into FILE table: ' + err);
+                console.log('Encountered error when getting the files in the database: ' + err);
+                conn.release();
                 res.status(500).send(err.sqlMessage);
                 return;
             }
-            //console.log("Successfully added calendar \"" + req.params.filename + "\" to FILE table in database\n");
-
-            // Add all the events from the current calendar into the EVENT table
-            for (let calEvent of cal.events) {
-                //console.log('Current working event (from ' + req.params.filename + '): ' + JSON.stringify(calEvent) + '\n');
-
-                // Find the location and organizer properties, if they exist
-                let evtLocation = calEvent.properties.find(prop => prop.propName.toLowerCase() === 'location');
-                let evtOrganizer = calEvent.properties.find(prop => prop.propName.toLowerCase() === 'organizer');
-
-                // This query is quite long, so I'm building the string from scratch in an attempt to improve readability
-                let evtQuery = "INSERT INTO EVENT (summary,start_time,location,organizer,cal_file) VALUES ";
-                evtQuery += "(" + (calEvent.summary === undefined || calEvent.summary === "" ? 'NULL' : "'" + calEvent.summary.replace(sQuote, "''") + "'");
-                evtQuery += ',';
-                evtQuery += "'" + calEvent.startDT.date.slice(0, 4) + '-' + calEvent.startDT.date.slice(4, 6) + '-' + calEvent.startDT.date.slice(6);
-                evtQuery += ' ' + calEvent.startDT.time.slice(0, 2) + ':' + calEvent.startDT.time.slice(2, 4) + ':' + calEvent.startDT.time.slice(4) + "'";
-                evtQuery += ',';
-                evtQuery += (evtLocation === undefined ? 'NULL' : "'" + evtLocation.propDescr.replace(sQuote, "''") + "'");
-                evtQuery += ',';
-                evtQuery += (evtOrganizer === undefined ? 'NULL' : "'" + evtOrganizer.propDescr.replace(sQuote, "''") + "'");
-                evtQuery += ',';
-                evtQuery += rows.insertId;
-                evtQuery += ")";
-
-                //console.log("\nquery to add event: " + evtQuery);
-
-                connection.query(evtQuery, function(err, rows, fields) {
-                    if (err) {
-                        console.log('error when inserting event into EVENT table: ' + err);
-                        res.status(500).send(err.sqlMessage);
+
+            findDuplicateEvents(rows.map(row => row.file_Name), req.params.filename, false, function(result) {
+                if (result.error !== undefined) {
+                    conn.release();
+                    res.status(500).send(result.message);
+                    return;
+                }
+                const positions = Array.from(new Set(result.duplicates.map(dup => dup.position)));
+                const numDuplicates = positions.length;
+                const skipDuplicates = (req.query.skipDuplicates === 'true');
+
+                // libcalendar writes the EVENT and ALARM rows straight from the parsed calendar (see TableExport.h),
+                // so every row goes in with one statement per table, rather than one INSERT per Event and Alarm
+                const eventsFile = tableFilePath('events');
+                const alarmsFile = tableFilePath('alarms');
+                const finish = function() {
+                    fs.unlink(eventsFile, () => {});
+                    fs.unlink(alarmsFile, () => {});
+                    conn.release();
+                };
+
+                whenJobDone(lib.exportTablesTSVAsync(__dirname + '/uploads/' + req.params.filename, eventsFile, alarmsFile, skipDuplicates ? positions.join(',') : ''), function(retStr) {
+                    let cal;
+                    try {
+                        cal = JSON.parse(retStr);
+                    } catch (e) {
+                        console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+                        finish();
+                        res.status(500).send(e.message);
                         return;
                     }
-                    //console.log("Successfully added event from file \"" + req.params.filename + "\" to EVENT table in database\n");
-
-                    // Add all the alarms from the current event into the ALARM table.
-                    for (let alarm of calEvent.alarms) {
-                        connection.query("INSERT INTO ALARM (action,`trigger`,event) VALUES ('" + alarm.action.replace(sQuote, "''") + "','" + alarm.trigger.replace(sQuote, "''") + "'," + rows.insertId + ")", function(err, rows, fields) {
-                            if (err) {
-                                console.log('error when inserting into ALARM table: ' + err);
-                                res.status(500).send(err.sqlMessage);
-                                return;
-                            }
-                            //console.log('Successfully added alarm from file "' + req.params.filename + '" to ALARM table in database\n');
 
-                        }); // End of insert Alarm into ALARM table
-                    } // End of for..of loop iterating over Alarms in the current Event
-                }); // End of insert Event into EVENT table
-            } // End of for..of loop iterating over Events in Calendar
-        }); // End of insert Calendar into FILE table
+                    if (cal.error !== undefined) {
+                        console.log('Could not export the rows of "' + req.params.filename + '": ' + retStr);
+                        finish();
+                        res.status(500).send(cal.message);
+                        return;
+                    }
 
-        // If the function gets to this point, then everything went ok!
-        res.status(200).send(req.params.filename);
-    }); // End of select query to determine if the Calendar was already in the FILE table
+                    // Passed down the waterfall when the calendar turns out to be in the database already
+                    const alreadyContained = new Error('The calendar is already in the database');
+
+                    // Every row of the calendar goes in, or none of them do
+                    async.waterfall([
+                        done => conn.beginTransaction(err => done(err)),
+                        // The calendar is looked for inside the transaction, so that two uploads of the same file can't
+                        // both find that it isn't there yet. FOR UPDATE makes the second one wait for the first to commit.
+                        done => conn.query('SELECT cal_id FROM FILE WHERE file_Name = ? FOR UPDATE', [req.params.filename], (err, rows) => done(err || ((rows.length !== 0) ? alreadyContained : null))),
+                        done => conn.query('INSERT INTO FILE (file_Name,version,prod_id) VALUES (?,?,?)', [req.params.filename, cal.version, cal.prodID], (err, rows) => done(err, rows && rows.insertId)),
+                        // AUTO_INCREMENT gives each Event its id, so no other connection's inserts can collide with them
+                        (calId, done) => loadTable(conn, eventsFile,
+                            mysql.format('LOAD DATA LOCAL INFILE ? INTO TABLE EVENT CHARACTER SET utf8mb4 (@row,summary,start_time,location,organizer) SET cal_file = ?', [eventsFile, calId]),
+                            'INSERT INTO EVENT (summary,start_time,location,organizer,cal_file) VALUES ?',
+                            row => [row[1], row[2], row[3], row[4], calId],
+                            err => done(err, calId)),
+                        // The ids go up in the order the rows were loaded in, so the nth smallest id of the calendar is row n's
+                        (calId, done) => conn.query('SELECT event_id FROM EVENT WHERE cal_file = ? ORDER BY event_id', [calId], function(err, rows) {
+                            if (!err && rows.length !== cal.numEvents) {
+                                err = new Error('Loaded ' + rows.length + ' of the ' + cal.numEvents + ' event(s)');
+                            }
+                            done(err, rows && rows.map(row => row.event_id));
+                        }),
+                        // The ids are usually one run of numbers, so a row number is turned into an id by adding the first one.
+                        // If other inserts took ids in between (or auto_increment_increment isn't 1), each row is looked up.
+                        function(eventIds, done) {
+                            const firstId = (eventIds.length === 0) ? 0 : eventIds[0];
+                            const consecutive = (eventIds.length === 0 || eventIds[eventIds.length - 1] - firstId === eventIds.length - 1);
+
+                            loadTable(conn, alarmsFile,
+                                consecutive ? mysql.format('LOAD DATA LOCAL INFILE ? INTO TABLE ALARM CHARACTER SET utf8mb4 (@row,action,`trigger`) SET event = @row + ?', [alarmsFile, firstId]) : null,
+                                'INSERT INTO ALARM (action,`trigger`,event) VALUES ?',
+                                row => [row[1], row[2], eventIds[Number(row[0])]],
+                                err => done(err));
+                        },
+                        done => conn.commit(err => done(err)),
+                    ], function(err) {
+                        if (err === alreadyContained) {
+                            console.log('The calendar "' + req.params.filename + '" is already in the database');
+                            conn.rollback(() => {
+                                finish();
+                                res.status(200).send({'alreadyContained':true, 'message':'The Calendar "' + req.params.filename + '" is already in the databse. It was not reuploaded'});
+                            });
+                            return;
+                        }
+
+                        if (err) {
+                            console.log('error when inserting "' + req.params.filename + '" into the database: ' + err);
+                            conn.rollback(() => {
+                                finish();
+                                res.status(500).send(err.sqlMessage || err.message);
+                            });
+                            return;
+                        }
+
+                        finish();
+                        console.log('Added ' + req.params.filename + ' to the database: ' + cal.numEvents + ' event(s) and ' + cal.numAlarms + ' alarm(s)');
+                        if (numDuplicates === 0) {
+                            res.status(200).send(req.params.filename);
+                        } else if (skipDuplicates) {
+                            res.status(200).send({'duplicates':numDuplicates, 'skipped':true, 'message':'Added ' + req.params.filename + ' to the database, leaving out ' + numDuplicates + ' of its event(s) that other files in it already have'});
+                        } else {
+                            res.status(200).send({'duplicates':numDuplicates, 'message':'Added ' + req.params.filename + ' to the database; ' + numDuplicates + ' of its event(s) are also in other files in it'});
+                        }
+                    });
+                }); // End of writing the calendar's rows
+            }); // End of finding the Events that other files in the database already have
+        }); // End of select query to find the files already in the database
+    }); // End of getting a connection of its own
 });
 
 
@@ -512,25 +933,192 @@ app.get('/getEventsFromFile/:filename', function(req, res) {
 });
 
 
-// Returns every Event from the database that start at the same time
+// Returns every Event from the uploaded calendar files that overlaps another Event
 app.get('/getEventConflicts', function(req, res) {
-    if (connection === undefined) {
-        res.status(401).send('Not logged in to database: connection failed');
+    // Every pair of events (across all of the uploaded calendars) whose times overlap, using DTEND/DURATION
+    const paths = fs.readdirSync(__dirname + '/uploads/').filter(name => name.endsWith('.ics')).map(name => __dirname + '/uploads/' + name);
+    whenJobDone(lib.findConflictsJSONAsync(paths.join('\n')), function(retStr) {
+        let result;
+        try {
+            result = JSON.parse(retStr);
+        } catch (e) {
+            console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+            res.status(500).send(e.message);
+            return;
+        }
+
+        if (result.error !== undefined) {
+            res.status(500).send(result.message);
+            return;
+        }
+        for (let err of result.errors) {
+            console.log('Skipped "' + err.filename + '" when finding conflicting events: ' + err.error);
+        }
+
+        // Send the overlapping events (already sorted by start time) in the same form as the other event queries
+        res.status(200).send(result.events.map(evt => ({
+            'start_time': evt.startDT.date.slice(0, 4) + '-' + evt.startDT.date.slice(4, 6) + '-' + evt.startDT.date.slice(6) + 'T'
+                          + evt.startDT.time.slice(0, 2) + ':' + evt.startDT.time.slice(2, 4) + ':' + evt.startDT.time.slice(4)
+                          + (evt.startDT.isUTC ? 'Z' : ''),
+            'summary': evt.summary,
+            'organizer': evt.organizer,
+            'filename': evt.filename
+        })));
+    });
+});
+
+
+// Returns the Events from the uploaded calendar files whose summary, description and location contain every word
+// in the query 'q' (a word ending in '*' matches any word starting with it), using an index kept on the server
+app.get('/searchEvents', function(req, res) {
+    if (req.query.q === undefined) {
+        res.status(400).send('Missing "q" (search query) query parameter');
         return;
     }
 
-    // Use an inner self-join with the EVENT table to find all events with the same start time (without duplicating itself)
-    connection.query("SELECT DISTINCT a.start_time,a.summary,a.organizer FROM EVENT AS a, EVENT AS b WHERE a.start_time=b.start_time AND a.event_id<>b.event_id ORDER BY start_time", function(err, rows, fields) {
-        if (err) {
-            console.log('Encountered error when performing self-join to find duplicate start_time properties in the EVENT table');
-            res.status(500).send(err.sqlMessage);
+    const paths = fs.readdirSync(__dirname + '/uploads/').filter(name => name.endsWith('.ics')).map(name => __dirname + '/uploads/' + name);
+    whenJobDone(lib.searchEventsJSONAsync(paths.join('\n'), String(req.query.q)), function(retStr) {
+        let result;
+        try {
+            result = JSON.parse(retStr);
+        } catch (e) {
+            console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+            res.status(500).send(e.message);
             return;
         }
 
-        res.status(200).send(rows);
+        if (result.error !== undefined) {
+            res.status(500).send(result.message);
+            return;
+        }
+        for (let err of result.errors) {
+            console.log('Skipped "' + err.filename + '" when searching events: ' + err.error);
+        }
+
+        res.status(200).send({'total': result.total, 'events': result.events});
     });
 });
 
+// Sends a report of the events that are in the uploaded calendars more than once: how many events there are, how
+// many are left once every copy is dropped, and where each copy of a duplicated event is. Events are compared by
+// UID, or also by their start, properties and alarms with 'by=content'.
+app.get('/duplicates', function(req, res) {
+    const paths = fs.readdirSync(__dirname + '/uploads/').filter(name => name.endsWith('.ics')).map(name => __dirname + '/uploads/' + name);
+    whenJobDone(lib.duplicateEventsJSONAsync(paths.join('\n'), req.query.by === 'content'), function(retStr) {
+        let result;
+        try {
+            result = JSON.parse(retStr);
+        } catch (e) {
+            console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+            res.status(500).send(e.message);
+            return;
+        }
+
+        if (result.error !== undefined) {
+            res.status(500).send(result.message);
+            return;
+        }
+        for (let err of result.errors) {
+            console.log('Skipped "' + err.filename + '" when finding duplicate events: ' + err.error);
+        }
+        delete result.errors;
+
+        res.status(200).send(result);
+    });
+});
+
+// Sends the free/busy time of a group of uploaded calendars between 'from' and 'to' (given the same way as for
+// /getEventsInRange). 'files' is a comma-separated list of filenames (every uploaded calendar if it is left out),
+// 'slot' is the length of a time slot in minutes (5 by default), and 'mode' is "free" (the time everyone is free,
+// the default), "busy" (the time anyone is busy) or "allbusy" (the time everyone is busy). With 'format=ics' a
+// VFREEBUSY calendar is sent instead of JSON.
+app.get('/getFreeBusy', function(req, res) {
+    if (req.query.from === undefined || req.query.to === undefined) {
+        res.status(400).send('Missing "from" or "to" (range of time) query parameter');
+        return;
+    }
+
+    const from = String(req.query.from).replace(/[-:]/g, '');
+    const to = String(req.query.to).replace(/[-:]/g, '');
+    const slot = (req.query.slot === undefined) ? 5 : parseInt(req.query.slot, 10);
+    const mode = (req.query.mode === undefined) ? 'free' : String(req.query.mode);
+
+    const names = (req.query.files === undefined) ? fs.readdirSync(__dirname + '/uploads/').filter(name => name.endsWith('.ics'))
+                                                  : String(req.query.files).split(',').map(name => path.basename(name));
+    whenJobDone(lib.freeBusyJSONAsync(names.map(name => __dirname + '/uploads/' + name).join('\n'), from, to, isNaN(slot) ? 0 : slot, mode), function(retStr) {
+        let result;
+        try {
+            result = JSON.parse(retStr);
+        } catch (e) {
+            console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+            res.status(500).send(e.message);
+            return;
+        }
+
+        if (result.error !== undefined) {
+            res.status(400).send(result.message);
+            return;
+        }
+        for (let err of result.errors) {
+            console.log('Skipped "' + err.filename + '" when finding free/busy time: ' + err.error);
+        }
+
+        if (req.query.format !== 'ics') {
+            res.status(200).send(result);
+            return;
+        }
+
+        // Content lines longer than 75 octets are folded onto lines that start with a space
+        const fold = line => line.match(/.{1,74}/g).join('\r\n ');
+        const utc = value => (value.length === 8 ? value + 'T000000' : value.slice(0, 15)) + 'Z';
+        const stamp = new Date().toISOString().replace(/[-:]/g, '').slice(0, 15) + 'Z';
+
+        let lines = ['BEGIN:VCALENDAR', 'VERSION:2.0', 'PRODID:-//CalendarApp//Free Busy//EN', 'BEGIN:VFREEBUSY',
+                     'DTSTAMP:' + stamp, 'DTSTART:' + utc(from), 'DTEND:' + utc(to)];
+        if (result.freebusy !== '') {
+            lines.push(fold('FREEBUSY;FBTYPE=' + (mode === 'free' ? 'FREE' : 'BUSY') + ':' + result.freebusy));
+        }
+        lines.push('END:VFREEBUSY', 'END:VCALENDAR');
+
+        res.status(200).type('text/calendar').send(lines.join('\r\n') + '\r\n');
+    });
+});
+
+// Sends the next 'k' (10 by default) times an alarm of the uploaded calendars goes off at or after 'now' (given the
+// same way as for /getEventsInRange, and the current local time if it is left out). 'files' is a comma-separated
+// list of filenames (every uploaded calendar if it is left out). The schedule is kept between requests, so a
+// notification worker can poll this with the current time as often as it likes.
+app.get('/nextAlarms', function(req, res) {
+    const pad = number => String(number).padStart(2, '0');
+    const date = new Date();
+    const now = (req.query.now !== undefined) ? String(req.query.now).replace(/[-:]/g, '')
+              : '' + date.getFullYear() + pad(date.getMonth() + 1) + pad(date.getDate()) + 'T' + pad(date.getHours()) + pad(date.getMinutes()) + pad(date.getSeconds());
+    const k = (req.query.k === undefined) ? 10 : parseInt(req.query.k, 10);
+
+    const names = (req.query.files === undefined) ? fs.readdirSync(__dirname + '/uploads/').filter(name => name.endsWith('.ics'))
+                                                  : String(req.query.files).split(',').map(name => path.basename(name));
+    whenJobDone(lib.nextAlarmsJSONAsync(names.map(name => __dirname + '/uploads/' + name).join('\n'), now, isNaN(k) ? 0 : k), function(retStr) {
+        let result;
+        try {
+            result = JSON.parse(retStr);
+        } catch (e) {
+            console.log('Fatal error in JSON.parse(): the JSON that broke it: ' + retStr);
+            res.status(500).send(e.message);
+            return;
+        }
+
+        if (result.error !== undefined) {
+            res.status(400).send(result.message);
+            return;
+        }
+        for (let err of result.errors) {
+            console.log('Skipped "' + err.filename + '" when scheduling alarms: ' + err.error);
+        }
+        delete result.errors;
+
+        res.status(200).send(result);
+    });
+});
 
 // Returns every Alarm from the database from the specified file
 app.get('/getAlarms/:filename', function(req, res) {
@@ -595,39 +1183,15 @@ app.get('/getCalsWithNumEvents/:number', function(req, res) {
         return;
     }
 
-    var toReturn = [];
-
-    //connection.query("SELECT * FROM FILE WHERE (SELECT COUNT() FROM ?) >= " + numEv, function(err, rows, fields) {
-    connection.query("SELECT * FROM FILE", function(err, rows, fields) {
+    // One query counts the events of every calendar at once, instead of one query per calendar
+    connection.query("SELECT FILE.* FROM FILE LEFT JOIN EVENT ON EVENT.cal_file=FILE.cal_id GROUP BY FILE.cal_id HAVING COUNT(EVENT.event_id) >= ?", [Number(numEv)], function(err, rows, fields) {
         if (err) {
-            console.log('Encountered error when getting the cal_id of all calendars in FILE table: ' + err);
+            console.log('Encountered error when getting the calendars with at least ' + numEv + ' events: ' + err);
             res.status(500).send(err.sqlMessage);
             return;
         }
 
-        async.forEachOf(rows, function(row, key, callback) {
-            connection.query("SELECT COUNT(*) from EVENT WHERE cal_file=" + row.cal_id, function(err, rows, fields) {
-                if (err) {
-                    console.log('Encountered error when getting the count of event rows from EVENT table with cal_file=' + row.cal_id + ': ' + err);
-                    //res.status(500).send(err.sqlMessage);
-                    callback(err.sqlMessage);
-                    //return;
-                }
-
-                console.log('The file with cal_id of ' + row.cal_id + ' has ' + rows[0]['COUNT(*)'] + ' events in it');
-                if (rows[0]['COUNT(*)'] >= numEv) {
-                    console.log('The file with cal_id ' + row.cal_id + ' had at least ' + numEv + ' events, and was pushed onto the array');
-                    toReturn.push(row);
-                }
-                callback();
-            });
-        }, function(err) {
-            if (err) {
-                res.status(500).send(err);
-            } else {
-                res.status(200).send(toReturn);
-            }
-        });
+        res.status(200).send(rows);
     });
 });
 
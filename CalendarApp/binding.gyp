@@ -0,0 +1,11 @@
+{
+    "targets": [
+        {
+            "target_name": "calendar",
+            "sources": ["parser/addon/CalendarAddon.c"],
+            "include_dirs": ["parser/include"],
+            "cflags": ["-std=c11", "-Wall", "-Wpedantic"],
+            "libraries": ["-L<(module_root_dir)", "-lcalendar", "-Wl,-rpath,<(module_root_dir)"]
+        }
+    ]
+}
@@ -0,0 +1,429 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  CalendarAddon.c                 *
+ ************************************/
+
+/* A Node addon (built by ../../binding.gyp against libcalendar.so) that parses a calendar and builds the
+ * JS object for it straight from the Calendar struct, with no JSON text in between.
+ *
+ * The object has the same shape as JSON.parse(createCalendarJSON(...)), and a calendar that can't be read
+ * gives the same {error, filename, message} object. The source is either the path of a file, or a Buffer
+ * of its contents, which is parsed where it is without being copied.
+ *
+ *     createCalendar(source)              returns the object
+ *     createCalendarAsync(source, done)   parses on libuv's thread pool, and calls done(object)
+ */
+
+#define NAPI_VERSION 8
+
+#include <node_api.h>
+
+#include "CalendarParser.h"
+#include "LinkedListAPI.h"
+
+#define ERROR_MESSAGE "Could not read in a valid calendar from the file"
+
+// Return from the calling function if a N-API call fails (which leaves an exception pending), or if one of
+// the functions below that build a value returns NULL
+#define CHECK(call) do { if ((call) != napi_ok) { return NULL; } } while (0)
+#define CHECK_VALUE(expr) do { if ((expr) == NULL) { return NULL; } } while (0)
+
+// Property names, made once per object built so they aren't turned into JS strings for every Event
+enum keyName {
+	KEY_VERSION, KEY_PRODID, KEY_NUMPROPS, KEY_NUMEVENTS, KEY_PROPERTIES, KEY_EVENTS, KEY_PROPNAME,
+	KEY_PROPDESCR, KEY_STARTDT, KEY_CREATEDT, KEY_UID, KEY_NUMALARMS, KEY_SUMMARY, KEY_ALARMS, KEY_ACTION,
+	KEY_TRIGGER, KEY_DATE, KEY_TIME, KEY_ISUTC, NUM_KEYS
+};
+
+static const char *keyNames[NUM_KEYS] = {
+	"version", "prodID", "numProps", "numEvents", "properties", "events", "propName",
+	"propDescr", "startDT", "createDT", "UID", "numAlarms", "summary", "alarms", "action",
+	"trigger", "date", "time", "isUTC"
+};
+
+typedef struct keys {
+	napi_value names[NUM_KEYS];
+} Keys;
+
+// Where a calendar is parsed from
+typedef struct source {
+	// The path of the file, or NULL if the calendar is in 'data'
+	char *path;
+	const char *data;
+	size_t length;
+} Source;
+
+// A call of createCalendarAsync()
+typedef struct parsejob {
+	Source source;
+	// Keeps the Buffer (if there is one) alive while it is parsed
+	napi_ref buffer;
+	napi_ref callback;
+	napi_async_work work;
+	Calendar *cal;
+	ICalErrorCode error;
+} ParseJob;
+
+static bool makeKeys(napi_env env, Keys *keys) {
+	for (int i = 0; i < NUM_KEYS; i++) {
+		if (napi_create_string_utf8(env, keyNames[i], NAPI_AUTO_LENGTH, &keys->names[i]) != napi_ok) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static napi_value setString(napi_env env, const Keys *keys, napi_value obj, enum keyName key, const char *str) {
+	napi_value value;
+
+	CHECK(napi_create_string_utf8(env, str, NAPI_AUTO_LENGTH, &value));
+	CHECK(napi_set_property(env, obj, keys->names[key], value));
+
+	return obj;
+}
+
+static napi_value setInt(napi_env env, const Keys *keys, napi_value obj, enum keyName key, int num) {
+	napi_value value;
+
+	CHECK(napi_create_int32(env, num, &value));
+	CHECK(napi_set_property(env, obj, keys->names[key], value));
+
+	return obj;
+}
+
+// As dtToJSON() writes it
+static napi_value dtToObject(napi_env env, const Keys *keys, DateTime dt) {
+	napi_value obj, isUTC;
+
+	CHECK(napi_create_object(env, &obj));
+	CHECK_VALUE(setString(env, keys, obj, KEY_DATE, dt.date));
+	CHECK_VALUE(setString(env, keys, obj, KEY_TIME, dt.time));
+	CHECK(napi_get_boolean(env, dt.UTC, &isUTC));
+	CHECK(napi_set_property(env, obj, keys->names[KEY_ISUTC], isUTC));
+
+	return obj;
+}
+
+// As propertyListToJSON() writes it
+static napi_value propertiesToArray(napi_env env, const Keys *keys, List *props) {
+	napi_value array;
+	ListIterator iter = createIterator(props);
+	Property *prop;
+
+	CHECK(napi_create_array_with_length(env, getLength(props), &array));
+	for (uint32_t i = 0; (prop = (Property *)nextElement(&iter)) != NULL; i++) {
+		napi_value obj;
+
+		CHECK(napi_create_object(env, &obj));
+		CHECK_VALUE(setString(env, keys, obj, KEY_PROPNAME, prop->propName));
+		CHECK_VALUE(setString(env, keys, obj, KEY_PROPDESCR, prop->propDescr));
+		CHECK(napi_set_element(env, array, i, obj));
+	}
+
+	return array;
+}
+
+// As alarmListToJSON() writes it
+static napi_value alarmsToArray(napi_env env, const Keys *keys, List *alarms) {
+	napi_value array;
+	ListIterator iter = createIterator(alarms);
+	Alarm *alarm;
+
+	CHECK(napi_create_array_with_length(env, getLength(alarms), &array));
+	for (uint32_t i = 0; (alarm = (Alarm *)nextElement(&iter)) != NULL; i++) {
+		napi_value obj, props;
+
+		CHECK(napi_create_object(env, &obj));
+		CHECK_VALUE(setString(env, keys, obj, KEY_ACTION, alarm->action));
+		CHECK_VALUE(setString(env, keys, obj, KEY_TRIGGER, alarm->trigger));
+		// The ACTION and TRIGGER count as properties
+		CHECK_VALUE(setInt(env, keys, obj, KEY_NUMPROPS, getLength(alarm->properties) + 2));
+		CHECK_VALUE(props = propertiesToArray(env, keys, alarm->properties));
+		CHECK(napi_set_property(env, obj, keys->names[KEY_PROPERTIES], props));
+		CHECK(napi_set_element(env, array, i, obj));
+	}
+
+	return array;
+}
+
+// As eventToJSON() writes it
+static napi_value eventToObject(napi_env env, const Keys *keys, const Event *ev) {
+	napi_value obj, value;
+	const char *summary = "";
+	ListIterator iter = createIterator(ev->properties);
+	Property *prop;
+
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		if (strcmp(prop->propName, "SUMMARY") == 0) {
+			summary = prop->propDescr;
+			break;
+		}
+	}
+
+	CHECK(napi_create_object(env, &obj));
+	CHECK_VALUE(value = dtToObject(env, keys, ev->startDateTime));
+	CHECK(napi_set_property(env, obj, keys->names[KEY_STARTDT], value));
+	CHECK_VALUE(value = dtToObject(env, keys, ev->creationDateTime));
+	CHECK(napi_set_property(env, obj, keys->names[KEY_CREATEDT], value));
+	CHECK_VALUE(setString(env, keys, obj, KEY_UID, ev->UID));
+	// The UID and the 2 DateTimes count as properties
+	CHECK_VALUE(setInt(env, keys, obj, KEY_NUMPROPS, getLength(ev->properties) + 3));
+	CHECK_VALUE(setInt(env, keys, obj, KEY_NUMALARMS, getLength(ev->alarms)));
+	CHECK_VALUE(setString(env, keys, obj, KEY_SUMMARY, summary));
+	CHECK_VALUE(value = propertiesToArray(env, keys, ev->properties));
+	CHECK(napi_set_property(env, obj, keys->names[KEY_PROPERTIES], value));
+	CHECK_VALUE(value = alarmsToArray(env, keys, ev->alarms));
+	CHECK(napi_set_property(env, obj, keys->names[KEY_ALARMS], value));
+
+	return obj;
+}
+
+// As calendarToJSON() writes it
+static napi_value calendarToObject(napi_env env, const Calendar *cal) {
+	Keys keys;
+	napi_value obj, value, events;
+	ListIterator iter = createIterator(cal->events);
+	Event *ev;
+
+	if (!makeKeys(env, &keys)) {
+		return NULL;
+	}
+	CHECK(napi_create_object(env, &obj));
+	CHECK_VALUE(setInt(env, &keys, obj, KEY_VERSION, (int)cal->version));
+	CHECK_VALUE(setString(env, &keys, obj, KEY_PRODID, cal->prodID));
+	// The VERSION and PRODID count as properties
+	CHECK_VALUE(setInt(env, &keys, obj, KEY_NUMPROPS, getLength(cal->properties) + 2));
+	CHECK_VALUE(setInt(env, &keys, obj, KEY_NUMEVENTS, getLength(cal->events)));
+	CHECK_VALUE(value = propertiesToArray(env, &keys, cal->properties));
+	CHECK(napi_set_property(env, obj, keys.names[KEY_PROPERTIES], value));
+
+	CHECK(napi_create_array_with_length(env, getLength(cal->events), &events));
+	for (uint32_t i = 0; (ev = (Event *)nextElement(&iter)) != NULL; i++) {
+		// Each Event's values are let go of once it is in the array, so a large calendar doesn't pile them up
+		napi_handle_scope scope;
+		CHECK(napi_open_handle_scope(env, &scope));
+		napi_value evObj = eventToObject(env, &keys, ev);
+		if (evObj == NULL || napi_set_element(env, events, i, evObj) != napi_ok) {
+			napi_close_handle_scope(env, scope);
+			return NULL;
+		}
+		CHECK(napi_close_handle_scope(env, scope));
+	}
+	CHECK(napi_set_property(env, obj, keys.names[KEY_EVENTS], events));
+
+	return obj;
+}
+
+// As ferrorCodeToJSON() writes it, with a filename of "N/A" if 'path' is NULL
+static napi_value errorToObject(napi_env env, ICalErrorCode error, const char *path, const char *message) {
+	napi_value obj, value;
+	char *errorStr = printError(error);
+	const char *fileName = "N/A";
+
+	if (path != NULL) {
+		fileName = strrchr(path, '/');
+		fileName = (fileName == NULL) ? path : fileName + 1;
+	}
+
+	napi_status status = napi_create_object(env, &obj);
+	if (status == napi_ok && (status = napi_create_string_utf8(env, errorStr, NAPI_AUTO_LENGTH, &value)) == napi_ok) {
+		status = napi_set_named_property(env, obj, "error", value);
+	}
+	free(errorStr);
+	CHECK(status);
+
+	CHECK(napi_create_string_utf8(env, fileName, NAPI_AUTO_LENGTH, &value));
+	CHECK(napi_set_named_property(env, obj, "filename", value));
+	CHECK(napi_create_string_utf8(env, message, NAPI_AUTO_LENGTH, &value));
+	CHECK(napi_set_named_property(env, obj, "message", value));
+
+	return obj;
+}
+
+static ICalErrorCode parseSource(const Source *source, Calendar **cal) {
+	if (source->path != NULL) {
+		return createCalendarValidated(source->path, cal);
+	}
+
+	return createCalendarFromBuffer(source->data, source->length, true, cal);
+}
+
+// Builds the object for the result of parsing 'source', and frees 'cal'
+static napi_value resultToObject(napi_env env, const Source *source, Calendar *cal, ICalErrorCode error) {
+	if (error != OK) {
+		return errorToObject(env, error, source->path, ERROR_MESSAGE);
+	}
+
+	napi_value obj = calendarToObject(env, cal);
+	deleteCalendar(cal);
+
+	return obj;
+}
+
+// Reads a path (copied into 'source') or a Buffer (pointed to by 'source') out of 'value'.
+// Throws a TypeError and returns false if it is neither.
+static bool getSource(napi_env env, napi_value value, Source *source) {
+	napi_valuetype type;
+	bool isBuffer;
+	size_t length;
+
+	source->path = NULL;
+	source->data = NULL;
+	source->length = 0;
+
+	if (napi_is_buffer(env, value, &isBuffer) == napi_ok && isBuffer) {
+		void *data;
+		if (napi_get_buffer_info(env, value, &data, &source->length) != napi_ok) {
+			return false;
+		}
+		source->data = data;
+		return true;
+	}
+
+	if (napi_typeof(env, value, &type) != napi_ok || type != napi_string) {
+		napi_throw_type_error(env, NULL, "The calendar must be a file path or a Buffer");
+		return false;
+	}
+
+	if (napi_get_value_string_utf8(env, value, NULL, 0, &length) != napi_ok || (source->path = malloc(length + 1)) == NULL) {
+		return false;
+	}
+	napi_get_value_string_utf8(env, value, source->path, length + 1, &length);
+
+	return true;
+}
+
+// createCalendar(source)
+static napi_value createCalendarSync(napi_env env, napi_callback_info info) {
+	size_t argc = 1;
+	napi_value argv[1], obj;
+	Source source;
+	Calendar *cal;
+
+	CHECK(napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+	if (argc < 1) {
+		napi_throw_type_error(env, NULL, "createCalendar() takes a file path or a Buffer");
+		return NULL;
+	}
+	if (!getSource(env, argv[0], &source)) {
+		return NULL;
+	}
+
+	ICalErrorCode error = parseSource(&source, &cal);
+	obj = resultToObject(env, &source, cal, error);
+	free(source.path);
+
+	return obj;
+}
+
+// Runs on a thread of libuv's pool, so it mustn't touch JS values
+static void executeParse(napi_env env, void *data) {
+	ParseJob *job = data;
+
+	(void)env;
+	job->error = parseSource(&job->source, &job->cal);
+}
+
+// Runs on the main thread once executeParse() is done
+static void completeParse(napi_env env, napi_status status, void *data) {
+	ParseJob *job = data;
+	napi_value callback, global, obj;
+
+	if (status == napi_ok) {
+		obj = resultToObject(env, &job->source, job->cal, job->error);
+	} else {
+		if (job->error == OK) {
+			deleteCalendar(job->cal);
+		}
+		obj = NULL;
+	}
+
+	// The callback is always called, with an error object if the work didn't run or the object couldn't be built
+	if (obj == NULL) {
+		napi_value exception;
+		bool pending;
+
+		if (napi_is_exception_pending(env, &pending) == napi_ok && pending) {
+			napi_get_and_clear_last_exception(env, &exception);
+		}
+		obj = errorToObject(env, OTHER_ERROR, job->source.path, (status == napi_cancelled) ? "The parse was cancelled" \
+		                    : "Could not build the object for the calendar");
+		if (obj == NULL && napi_get_undefined(env, &obj) != napi_ok) {
+			obj = NULL;
+		}
+	}
+
+	if (obj != NULL && napi_get_reference_value(env, job->callback, &callback) == napi_ok && napi_get_global(env, &global) == napi_ok) {
+		napi_call_function(env, global, callback, 1, &obj, NULL);
+	}
+
+	if (job->buffer != NULL) {
+		napi_delete_reference(env, job->buffer);
+	}
+	napi_delete_reference(env, job->callback);
+	napi_delete_async_work(env, job->work);
+	free(job->source.path);
+	free(job);
+}
+
+// createCalendarAsync(source, done)
+static napi_value createCalendarAsync(napi_env env, napi_callback_info info) {
+	size_t argc = 2;
+	napi_value argv[2], name;
+	napi_valuetype type;
+	ParseJob *job;
+
+	CHECK(napi_get_cb_info(env, info, &argc, argv, NULL, NULL));
+	if (argc < 2 || napi_typeof(env, argv[1], &type) != napi_ok || type != napi_function) {
+		napi_throw_type_error(env, NULL, "createCalendarAsync() takes a file path or a Buffer, and a callback");
+		return NULL;
+	}
+
+	if ((job = calloc(1, sizeof(ParseJob))) == NULL) {
+		napi_throw_error(env, NULL, "Could not allocate memory");
+		return NULL;
+	}
+	if (!getSource(env, argv[0], &job->source)) {
+		free(job);
+		return NULL;
+	}
+
+	if ((job->source.path == NULL && napi_create_reference(env, argv[0], 1, &job->buffer) != napi_ok)
+	    || napi_create_reference(env, argv[1], 1, &job->callback) != napi_ok
+	    || napi_create_string_utf8(env, "createCalendarAsync", NAPI_AUTO_LENGTH, &name) != napi_ok
+	    || napi_create_async_work(env, NULL, name, executeParse, completeParse, job, &job->work) != napi_ok
+	    || napi_queue_async_work(env, job->work) != napi_ok) {
+		if (job->work != NULL) {
+			napi_delete_async_work(env, job->work);
+		}
+		if (job->callback != NULL) {
+			napi_delete_reference(env, job->callback);
+		}
+		if (job->buffer != NULL) {
+			napi_delete_reference(env, job->buffer);
+		}
+		free(job->source.path);
+		free(job);
+		return NULL;
+	}
+
+	return NULL;
+}
+
+static napi_value init(napi_env env, napi_value exports) {
+	napi_property_descriptor functions[] = {
+		{"createCalendar", NULL, createCalendarSync, NULL, NULL, NULL, napi_enumerable, NULL},
+		{"createCalendarAsync", NULL, createCalendarAsync, NULL, NULL, NULL, napi_enumerable, NULL},
+	};
+
+	CHECK(napi_define_properties(env, exports, sizeof(functions) / sizeof(functions[0]), functions));
+
+	return exports;
+}
+
+NAPI_MODULE(NODE_GYP_MODULE_NAME, init)
@@ -0,0 +1,122 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  AlarmSchedule.h                 *
+ ************************************/
+
+/* Works out when Alarms go off. Refer to section 3.8.6 of the RFC5545 iCal specification.
+ *
+ * compileTrigger() turns an Alarm's TRIGGER into either an absolute time, or a signed number of seconds
+ * from the start (or, with RELATED=END, the end) of its Event. Along with REPEAT and DURATION, which make
+ * the Alarm go off again a number of times after that, this is enough to work out every time the Alarm
+ * goes off for every occurrence of the Event (see Recurrence.h).
+ *
+ * An AlarmSchedule holds every Alarm of a group of Calendars, and a binary min-heap of the next time each
+ * one goes off. Taking the earliest firing off the heap puts the Alarm's next firing in its place (the
+ * next REPEAT, or the next occurrence of the Event), so the heap only ever holds a few entries per Alarm,
+ * however many times they go off in total, and finding the next k firings takes O(k log n) time.
+ *
+ * The schedule is meant to be polled with a time that only moves forward: firings before it are thrown
+ * away, and the ones handed out are kept aside until they're in the past, so asking for the next k
+ * again is cheap. Asking with an earlier time than before starts the schedule over.
+ *
+ * Times are compared at face value, as in TimeSpan.h.
+ */
+
+#ifndef ALARMSCHEDULE_H
+#define ALARMSCHEDULE_H
+
+#include <stdint.h>
+
+#include "CalendarParser.h"
+#include "Recurrence.h"
+#include "TimeSpan.h"
+
+// The most times an Alarm goes off again through REPEAT
+#define MAX_ALARM_REPEAT 1000
+
+// A compiled TRIGGER, along with the Alarm's REPEAT and DURATION
+typedef struct alarmtrigger {
+	// An absolute trigger goes off at 'time'. A relative one goes off 'time' seconds (which may be negative)
+	// after the start of every occurrence of its Event, or after the end of it if 'relatedEnd' is true.
+	bool absolute;
+	bool relatedEnd;
+	int64_t time;
+	// Whether an absolute time was given in UTC
+	bool UTC;
+	// How many more times it goes off, and how many seconds apart
+	int repeat;
+	int64_t interval;
+} AlarmTrigger;
+
+// One time an Alarm goes off
+typedef struct alarmfiring {
+	int64_t time;
+	// The start of the occurrence of the Event it goes off for
+	int64_t occurrence;
+	// 0 the first time it goes off for the occurrence, and 1 to REPEAT for the times after that
+	int repeat;
+	// The index of the Alarm in the schedule's sources
+	int source;
+} AlarmFiring;
+
+// An Alarm in a schedule, and the Event and Calendar it came from
+typedef struct alarmsource {
+	const Alarm *alarm;
+	const Event *event;
+	int calendar;
+	AlarmTrigger trigger;
+	Recurrence *rec;
+	// Produces the occurrences of a recurring Event. NULL for an Event that only occurs once.
+	OccurrenceIterator *iter;
+} AlarmSource;
+
+typedef struct alarmschedule {
+	AlarmSource *sources;
+	int numSources;
+	// The number of Alarms that were left out because their TRIGGER, REPEAT or DURATION is malformed, or
+	// their Event's times are
+	int numSkipped;
+	// The next firing of every Alarm (and some of the ones after), as a binary min-heap
+	AlarmFiring *heap;
+	int heapSize;
+	int heapCapacity;
+	// Firings already taken off the heap by nextAlarms(), in order, from ready[firstReady] to ready[numReady - 1]
+	AlarmFiring *ready;
+	int firstReady;
+	int numReady;
+	int readyCapacity;
+	// The time the schedule was last polled with
+	int64_t now;
+	bool started;
+} AlarmSchedule;
+
+/*
+ * Compiles the TRIGGER of 'alarm', along with its REPEAT and DURATION properties (which are ignored unless
+ * both are there), and stores it in 'trigger'.
+ * Returns OK, or INV_ALARM if the TRIGGER, REPEAT or DURATION is malformed.
+ */
+ICalErrorCode compileTrigger(const Alarm *alarm, AlarmTrigger *trigger);
+
+/*
+ * Builds a schedule of every Alarm in the 'numCals' Calendars in 'cals'. Alarms that can't be compiled
+ * are counted in the schedule's numSkipped and left out.
+ * Returns NULL if memory could not be allocated.
+ */
+AlarmSchedule *createAlarmSchedule(Calendar **cals, int numCals);
+
+/*
+ * Frees the schedule (but not the Calendars it points to).
+ */
+void deleteAlarmSchedule(AlarmSchedule *schedule);
+
+/*
+ * Stores the next (up to) 'k' times an Alarm goes off at or after 'now' in 'firings', in order.
+ * Returns the number stored, or -1 if memory could not be allocated.
+ */
+int nextAlarms(AlarmSchedule *schedule, int64_t now, int k, AlarmFiring *firings);
+
+#endif
@@ -0,0 +1,59 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  AtomicFile.h                    *
+ ************************************/
+
+/* Crash-safe replacement of a file's contents.
+ *
+ * Instead of truncating the target and writing into it (which leaves a half-written calendar
+ * behind if anything fails partway through, and lets readers see one while it is being written),
+ * the new contents are written to a temporary file in the same directory. commitAtomic() then
+ * fsync()s it and rename()s it over the target, so the target always holds either the complete
+ * old contents or the complete new ones. The directory is fsync()ed last so the rename itself
+ * survives a crash.
+ *
+ * Where the kernel and filesystem support it, the temporary file is created with O_TMPFILE. It has
+ * no name until it is committed, so nothing is left behind in the directory if the process dies
+ * before then. Otherwise a hidden ".<name>.<pid>.<n>.tmp" file is used, and removed on abort.
+ */
+
+#ifndef ATOMICFILE_H
+#define ATOMICFILE_H
+
+#include <stdbool.h>
+
+#include "CalendarParser.h"
+
+typedef struct atomicfile {
+	// The file descriptor to write the new contents to
+	int fd;
+	// The file that will be replaced
+	char *path;
+	// The name of the temporary file, or NULL if it was created with O_TMPFILE and has no name yet
+	char *tempPath;
+} AtomicFile;
+
+/*
+ * Creates a temporary file in the same directory as 'path' to write its new contents to.
+ * If 'path' already exists, its permissions are copied over to the temporary file.
+ * Returns OK, or WRITE_ERROR if the temporary file could not be created.
+ */
+ICalErrorCode openAtomic(AtomicFile *file, const char *path);
+
+/*
+ * Flushes the temporary file to disk and renames it over the original path.
+ * The AtomicFile is closed afterwards, whether or not it succeeded.
+ * Returns OK, or WRITE_ERROR if the file could not be committed (the original is left untouched).
+ */
+ICalErrorCode commitAtomic(AtomicFile *file);
+
+/*
+ * Discards the temporary file, leaving the original path untouched.
+ */
+void abortAtomic(AtomicFile *file);
+
+#endif
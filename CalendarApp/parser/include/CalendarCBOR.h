@@ -0,0 +1,63 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  CalendarCBOR.h                  *
+ ************************************/
+
+/* A compact binary (CBOR, RFC 7049) encoding of a Calendar, written directly from the
+ * Calendar structure instead of going through calendarToJSON().
+ *
+ * The layout mirrors the JSON objects, except that every map key is a small unsigned
+ * integer instead of a string:
+ *
+ *   Calendar: {0: version (float), 1: prodID, 2: [properties], 3: [events]}
+ *   Event:    {0: UID, 1: creation DateTime, 2: start DateTime, 3: [properties], 4: [alarms]}
+ *   Alarm:    {0: action, 1: trigger, 2: [properties]}
+ *   Property: [name, description]
+ *   DateTime: [YYYYMMDDhhmmss (unsigned int), isUTC (bool)]
+ *
+ * A property name that exactly matches an entry of cborPropNames is written as its index
+ * into that table; any other name is written as a text string. The table is kept sorted so
+ * that names can be looked up with a binary search, and since each name's index is part of
+ * the wire format, the table is frozen: a name can't be added anywhere (even at the end)
+ * without changing the format. Names that aren't in it are still encoded, just as text.
+ */
+
+#ifndef CALENDARCBOR_H
+#define CALENDARCBOR_H
+
+#include <stdint.h>
+
+#include "CalendarParser.h"
+
+/*************
+ * Constants *
+ *************/
+
+// Map keys of an encoded Calendar
+enum cborCalKeys {CBOR_CAL_VERSION, CBOR_CAL_PRODID, CBOR_CAL_PROPS, CBOR_CAL_EVENTS};
+
+// Map keys of an encoded Event
+enum cborEventKeys {CBOR_EV_UID, CBOR_EV_CREATE, CBOR_EV_START, CBOR_EV_PROPS, CBOR_EV_ALARMS};
+
+// Map keys of an encoded Alarm
+enum cborAlarmKeys {CBOR_AL_ACTION, CBOR_AL_TRIGGER, CBOR_AL_PROPS};
+
+#define NUM_CBORPROPNAMES 36
+extern const char *cborPropNames[NUM_CBORPROPNAMES];
+
+/***********************
+ * Function Signatures *
+ ***********************/
+
+/* Encodes the Calendar 'cal' as CBOR.
+ * Returns a newly allocated buffer that must be freed by the caller, and stores the number of
+ * bytes in it in 'length'. Returns NULL (and sets 'length' to 0) if 'cal' is NULL or memory
+ * could not be allocated.
+ */
+unsigned char *calendarToCBOR(const Calendar *cal, size_t *length);
+
+#endif
@@ -16,33 +16,86 @@
 
 #include <ctype.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "CalendarParser.h"
 #include "Debug.h"
+#include "IOBatch.h"
 
 /**********************
  * Property constants *
  **********************/
 
+// Each list of property names is sorted, and its enum gives every name's index in the list.
+// The property validators use those indexes as bit positions in a uint64_t.
+
 #define NUM_CALPROPNAMES 4
 extern const char *calPropNames[NUM_CALPROPNAMES];
+enum calPropIndex {CAL_CALSCALE, CAL_METHOD, CAL_PRODID, CAL_VERSION};
 
 #define NUM_EVENTPROPNAMES 29
 extern const char *eventPropNames[NUM_EVENTPROPNAMES];
+enum eventPropIndex {EV_ATTACH, EV_ATTENDEE, EV_CATEGORIES, EV_CLASS, EV_COMMENT, EV_CONTACT, EV_CREATED, \
+	EV_DESCRIPTION, EV_DTEND, EV_DTSTAMP, EV_DTSTART, EV_DURATION, EV_EXDATE, EV_GEO, EV_LAST_MODIFIED, \
+	EV_LOCATION, EV_ORGANIZER, EV_PRIORITY, EV_RDATE, EV_RECURRENCE_ID, EV_RELATED_TO, EV_RESOURCES, \
+	EV_RRULE, EV_SEQUENCE, EV_STATUS, EV_SUMMARY, EV_TRANSP, EV_UID, EV_URL};
 
 #define NUM_ALARMPROPNAMES 5
 extern const char *alarmPropNames[NUM_ALARMPROPNAMES];
+enum alarmPropIndex {AL_ACTION, AL_ATTACH, AL_DURATION, AL_REPEAT, AL_TRIGGER};
+
+/************************
+ * Validation threading *
+ ************************/
+
+// Calendars with at least this many events have their events validated by several threads at once
+#define PARALLEL_VALIDATE_MIN 4096
+
+// The most threads that validateEvents() will use
+#define MAX_VALIDATE_THREADS 8
+
+/*****************************
+ * Property validation rules *
+ *****************************/
+
+// Maximum number of exclusive/together groups a component can have
+#define MAX_PROPGROUPS 4
+
+// The rules a component's property list must follow. Every mask has one bit per property name,
+// at the name's index in 'names' (so a component can have at most 64 property names).
+typedef struct componentrules {
+	const char **names;
+	int numNames;
+	// Properties that must appear at least once (min = 1)
+	uint64_t required;
+	// Properties that can appear at most once (max = 1)
+	uint64_t once;
+	// Properties that must not be in the list at all (max = 0), since they have their own member in the struct
+	uint64_t forbidden;
+	// At most one of the properties in each of these masks may appear (e.g. DTEND and DURATION)
+	uint64_t exclusive[MAX_PROPGROUPS];
+	// Either all or none of the properties in each of these masks must appear (e.g. an alarm's DURATION and REPEAT)
+	uint64_t together[MAX_PROPGROUPS];
+	// The error returned when the list breaks any of the rules
+	ICalErrorCode error;
+} ComponentRules;
+
+extern const ComponentRules calRules, eventRules, alarmRules;
 
 /***********************
  * Function Signatures *
  ***********************/
 
-ICalErrorCode writeProperties(FILE *fout, List *props);
+ICalErrorCode writeProperties(IOBatch *batch, List *props);
+
+ICalErrorCode writeEvents(IOBatch *batch, List *events);
+
+ICalErrorCode writeAlarms(IOBatch *batch, List *alarms);
 
-ICalErrorCode writeEvents(FILE *fout, List *events);
+ICalErrorCode scanCalendarFile(FILE *fp, const char **uids, int numUIDs, bool *taken, long *endOffset);
 
-ICalErrorCode writeAlarms(FILE *fout, List *alarms);
+ICalErrorCode spliceEvents(char *fileName, int srcFd, long endOffset, List *events);
 
 ICalErrorCode getDateTimeAsWritable(char *result, DateTime dt);
 
@@ -52,10 +105,14 @@ int equalsOneOfStr(const char *toCompare, int numArgs, const char **strings);
 
 int vequalsOneOfStr(const char *toCompare, int numArgs, ...);
 
+ICalErrorCode validateEvent(const Event *ev);
+
 ICalErrorCode validateEvents(List *events);
 
 ICalErrorCode validateAlarms(List *alarms);
 
+ICalErrorCode validateProperties(List *properties, const ComponentRules *rules);
+
 ICalErrorCode validatePropertiesCal(List *properties);
 
 ICalErrorCode validatePropertiesEv(List *properties);
@@ -66,4 +123,6 @@ ICalErrorCode validateDateTime(DateTime dt);
 
 bool propNamesEqual(const void *first, const void *second);
 
+char *escapeJSON(const char *str);
+
 #endif
@@ -96,6 +96,35 @@ typedef struct ical {
 ICalErrorCode createCalendar(char* fileName, Calendar** obj);
 
 
+/** Function to create a Calendar object based on the contents of an iCalendar file, and validate it
+    in the same pass. Gives the same result as createCalendar() followed by validateCalendar(), but
+    each Event is validated as soon as it is parsed instead of in a second pass over the Calendar.
+ *@pre Same as createCalendar()
+ *@post Either:
+        A valid calendar has been created, its address was stored in the variable obj, and OK was returned
+		or 
+		The file could not be parsed, or the calendar is not valid. It was not created, all temporary memory
+		was freed, obj was set to NULL, and the appropriate error code was returned
+ *@return the error code indicating success or the error encountered when parsing or validating the calendar
+ *@param fileName - a string containing the name of the iCalendar file
+ *@param a double pointer to a Calendar struct that needs to be allocated
+**/
+ICalErrorCode createCalendarValidated(char* fileName, Calendar** obj);
+
+
+/** Function to create a Calendar object from the contents of an iCalendar file that are already in memory.
+    The data is read where it is, without being copied.
+ *@pre 'data' points to 'length' bytes, which are not changed while the function runs
+ *@post Same as createCalendarValidated() if 'validate' is true, or createCalendar() if it is false
+ *@return the error code indicating success or the error encountered when parsing (or validating) the calendar
+ *@param data - the contents of an iCalendar file
+ *@param length - the number of bytes in 'data'
+ *@param validate - whether to validate the calendar as it is parsed
+ *@param a double pointer to a Calendar struct that needs to be allocated
+**/
+ICalErrorCode createCalendarFromBuffer(const char *data, size_t length, bool validate, Calendar** obj);
+
+
 /** Function to delete all calendar content and free all the memory.
  *@pre Calendar object exists, is not NULL, and has not been freed
  *@post Calendar object had been freed
@@ -200,7 +229,8 @@ char *errorCodeToJSON(ICalErrorCode err, char message[]);
 
 // Identical to errorCodeToJSON(), except the additional field "filename":...
 // is contained in the JSON string as well. Only the part of the string after the
-// last '/' character is included in the "filename":... property.
+// last '/' character is included in the "filename":... property, which is "N/A"
+// if 'filepath' is NULL.
 char *ferrorCodeToJSON(ICalErrorCode err, const char filepath[], char message[]);
 
 
@@ -222,6 +252,10 @@ Property *JSONtoProperty(const char *str);
  **/
 Event* JSONtoEvent(const char* str);
 
+// The same as JSONtoEvent(), but if 'generatedUID' isn't NULL, it is set to whether the JSON
+// left out the UID (by giving it as "NULL"), so that the Event was given a random one instead
+Event *JSONtoEventGenerated(const char *str, bool *generatedUID);
+
 // Converts a JSON string into an Alarm struct
 Alarm *JSONtoAlarm(const char *str);
 
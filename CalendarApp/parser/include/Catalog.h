@@ -0,0 +1,101 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  Catalog.h                       *
+ ************************************/
+
+/* A catalog of every calendar file in a directory: its size and modification time, and a summary of
+ * the Calendar in it (version, product ID, how many Events and properties it has, and the range of
+ * its Events' DTSTARTs), or the error that reading it in gave.
+ *
+ * The catalog is kept in a file called CATALOG_FILENAME in the same directory, so listing the
+ * calendars never needs them to be parsed. updateCatalog() only parses the files whose inode, size
+ * or modification time no longer match their entries, and drops the entries of files that are gone.
+ *
+ * The catalog file is a small binary table, written atomically (see AtomicFile.h). All numbers are
+ * little-endian:
+ *   header: "ICALCAT\0", format version (u32), number of entries (u32)
+ *   entry:  name length (u16), name, size (u64), mtime seconds (i64), mtime nanoseconds (i64),
+ *           inode (u64), error code (u32), version (IEEE 754 f32), product ID length (u16), product ID,
+ *           number of Events (u32), number of properties (u32), earliest DTSTART (i64), latest DTSTART (i64)
+ * A catalog file that can't be read (missing, corrupt, or of another format version) is rebuilt from scratch.
+ */
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "CalendarParser.h"
+
+// The name of the catalog file in the directory it describes. Files whose names start with '.' are never catalogued.
+#define CATALOG_FILENAME ".catalog"
+
+// Bumped whenever the layout of the catalog file changes
+#define CATALOG_FORMAT_VERSION 1
+
+typedef struct catalogentry {
+	// The file's name, without the directory
+	char *name;
+	// The status of the file when it was catalogued
+	int64_t size;
+	int64_t mtimeSec;
+	int64_t mtimeNsec;
+	uint64_t inode;
+	// OK, or the error that reading in and validating the file gave. The fields below are only filled in if it is OK.
+	ICalErrorCode error;
+	float version;
+	char *prodID;
+	int numEvents;
+	int numProps;
+	// The earliest and latest DTSTART of the Calendar's Events, in seconds (see TimeSpan.h).
+	// Both are 0 if the Calendar has no Events with a readable DTSTART.
+	int64_t minStart;
+	int64_t maxStart;
+} CatalogEntry;
+
+typedef struct catalog {
+	// Sorted by name
+	CatalogEntry *entries;
+	int numEntries;
+	int size;
+} Catalog;
+
+/*
+ * Reads the catalog file of the directory 'dirPath', and stores it in 'catalog'. If there is no catalog file
+ * yet, or it can't be read, an empty Catalog is stored instead.
+ * Returns OK, or OTHER_ERROR if memory could not be allocated.
+ */
+ICalErrorCode loadCatalog(const char *dirPath, Catalog **catalog);
+
+/*
+ * Brings 'catalog' up to date with the files in the directory 'dirPath', only parsing the files that are
+ * new or have changed. 'changed' is set to true if any entry was added, replaced or removed.
+ * Returns OK, INV_FILE if the directory can't be read, or OTHER_ERROR if memory could not be allocated.
+ */
+ICalErrorCode updateCatalog(Catalog *catalog, const char *dirPath, bool *changed);
+
+/*
+ * Writes 'catalog' to the catalog file of the directory 'dirPath'.
+ * Returns OK, or WRITE_ERROR if the file could not be written.
+ */
+ICalErrorCode saveCatalog(const Catalog *catalog, const char *dirPath);
+
+/*
+ * Returns a newly allocated JSON array of every entry in 'catalog', sorted by name, as
+ * [{"filename":...,"size":...,"mtime":...,"error":...,"version":...,"prodID":...,"numEvents":...,
+ * "numProps":...,"minStartDT":...,"maxStartDT":...},...], where "mtime" is in milliseconds (like a
+ * JavaScript Date), and "minStartDT" and "maxStartDT" are DateTime JSONs, or null if the Calendar has no Events.
+ */
+char *catalogToJSON(const Catalog *catalog);
+
+/*
+ * Frees a Catalog.
+ */
+void deleteCatalog(Catalog *catalog);
+
+#endif
@@ -0,0 +1,54 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  Conflicts.h                     *
+ ************************************/
+
+/* Finds every pair of Events that overlap in time, across any number of Calendars.
+ *
+ * The spans of all the Events (see getEventSpan()) are put in order of their start times and swept
+ * from earliest to latest. The Events that are still going on at the current point of the sweep are
+ * kept in a min-heap ordered by their end times: before each Event is added, every Event that has
+ * ended by its start is removed, and everything left in the heap overlaps it. That takes
+ * O(n log n + k) time for n Events and k overlapping pairs, instead of comparing every pair.
+ *
+ * Two Events overlap when their spans share some time. An Event with no duration happens at the
+ * instant it starts, so it overlaps the Events that are going on at that instant (including any
+ * other Event that has no duration and starts at the same time).
+ */
+
+#ifndef CONFLICTS_H
+#define CONFLICTS_H
+
+#include "CalendarParser.h"
+#include "EventIndex.h"
+#include "TimeSpan.h"
+
+// An Event taking part in a sweep, along with its span and which Calendar it came from
+typedef struct sweepentry {
+	TimeSpan span;
+	const Event *event;
+	// The position of the Event's EventIndex in the array passed to createSweep()
+	int calendar;
+} SweepEntry;
+
+/*
+ * Collects the Events of every EventIndex in 'indexes' into one array sorted by start time, and stores
+ * it in 'entries'. The array must be freed by the caller, and points at the Events in the Calendars,
+ * which must outlive it.
+ * Returns the number of entries, or -1 if memory could not be allocated.
+ */
+int createSweep(EventIndex **indexes, int numIndexes, SweepEntry **entries);
+
+/*
+ * Calls 'found' once for every pair of overlapping Events in 'entries' (as built by createSweep()),
+ * with the positions of the two Events in 'entries'. The first position is always the smaller one.
+ * 'data' is passed to every call of 'found' untouched.
+ * Returns the number of overlapping pairs, or -1 if memory could not be allocated.
+ */
+long findConflicts(const SweepEntry *entries, int numEntries, void (*found)(int, int, void *), void *data);
+
+#endif
@@ -0,0 +1,83 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  Dedup.h                         *
+ ************************************/
+
+/* Finds copies of the same Event across Calendars.
+ *
+ * Every Event gets a 64-bit fingerprint: a hash of its UID or, when comparing by content, a hash of its
+ * UID, DTSTART, properties and alarms (but not DTSTAMP, which changes every time a calendar is exported).
+ * The properties and alarms are combined so that their order doesn't matter.
+ *
+ * An EventSet holds the fingerprints of every Event in a group of Calendars twice over: in a Bloom filter,
+ * which answers "definitely not in the set" for most new Events by testing a few bits, and in an open
+ * addressing hash table, which finds the Events that actually share the fingerprint. Two Events are only
+ * taken to be copies if their UIDs are also equal, so a collision of fingerprints can't join unrelated Events.
+ *
+ * The set points at the Calendars' Events, so it must be deleted before they are.
+ */
+
+#ifndef DEDUP_H
+#define DEDUP_H
+
+#include <stdint.h>
+
+#include "CalendarParser.h"
+
+// The Bloom filter gets this many bits per Event, and sets this many of them for each one,
+// which makes about 1% of the Events that aren't in the set look like they might be
+#define BLOOM_BITS_PER_EVENT 10
+#define BLOOM_NUM_HASHES 7
+
+typedef struct bloomfilter {
+	uint64_t *words;
+	uint64_t numBits;
+} BloomFilter;
+
+// An Event in an EventSet, and where it came from
+typedef struct fingerprintentry {
+	uint64_t fingerprint;
+	const Event *event;
+	// The position of its Calendar in the set, and its position in the Calendar
+	int calendar;
+	int position;
+} FingerprintEntry;
+
+typedef struct eventset {
+	bool byContent;
+	BloomFilter bloom;
+	// A hash table with linear probing. Its size is a power of 2, and an entry with a NULL event is empty.
+	FingerprintEntry *slots;
+	size_t numSlots;
+	size_t numEvents;
+} EventSet;
+
+/*
+ * Returns the fingerprint of 'ev': a hash of its UID, or also of its content if 'byContent' is true.
+ */
+uint64_t fingerprintEvent(const Event *ev, bool byContent);
+
+/*
+ * Builds a set of every Event in the 'numCals' Calendars in 'cals', fingerprinted by UID, or also by
+ * content if 'byContent' is true.
+ * Returns NULL if memory could not be allocated.
+ */
+EventSet *createEventSet(Calendar **cals, int numCals, bool byContent);
+
+/*
+ * Frees the set (but not the Calendars it points to).
+ */
+void deleteEventSet(EventSet *set);
+
+/*
+ * Calls 'found' on every Event in 'set' that is a copy of 'ev' (other than 'ev' itself), in no particular
+ * order. 'data' is passed to every call of 'found' untouched.
+ * Returns the number of copies.
+ */
+int findCopies(const EventSet *set, const Event *ev, void (*found)(const FingerprintEntry *, void *), void *data);
+
+#endif
@@ -0,0 +1,66 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  EventIndex.h                    *
+ ************************************/
+
+/* An interval tree over the time spans of a Calendar's Events (see getEventSpan()), used to find
+ * every Event that overlaps a range of time without looking at all of them.
+ *
+ * The spans are sorted by their start, and the sorted array is used as an implicit balanced binary
+ * search tree: the root of any range of the array is its middle element. Each element also stores
+ * the latest end of any span in its subtree, so whole subtrees that finish before the query range
+ * starts are skipped, as is everything that starts after it ends. A query takes O(log n + k) time
+ * for k results, and the whole index is three flat arrays.
+ *
+ * The index points at the Calendar's Events, so it must be deleted before the Calendar is, and
+ * rebuilt whenever Events are added or changed.
+ */
+
+#ifndef EVENTINDEX_H
+#define EVENTINDEX_H
+
+#include "CalendarParser.h"
+#include "TimeSpan.h"
+
+typedef struct eventindex {
+	int numEvents;
+	// The span of every Event, sorted by start time (and by position in the Calendar for equal spans)
+	TimeSpan *spans;
+	// events[i] is the Event that spans[i] belongs to
+	const Event **events;
+	// maxEnd[i] is the latest end of any span in the subtree rooted at i
+	int64_t *maxEnd;
+} EventIndex;
+
+/*
+ * Builds an index over every Event in 'cal'. An Event whose DTEND or DURATION can't be read is
+ * indexed as if it had neither, so it can still be found by its start time.
+ * Returns NULL if 'cal' is NULL or memory could not be allocated.
+ */
+EventIndex *createEventIndex(const Calendar *cal);
+
+/*
+ * Frees the index (but not the Events it points to).
+ */
+void deleteEventIndex(EventIndex *index);
+
+/*
+ * Calls 'found' on every Event whose span overlaps 'range', in order of their start times.
+ * An Event with no duration overlaps 'range' if it starts inside of it.
+ * 'data' is passed to every call of 'found' untouched. If 'found' returns false, the search stops.
+ * Returns the number of Events found, or -1 if the search was stopped.
+ */
+int queryEventIndex(const EventIndex *index, TimeSpan range, bool (*found)(const Event *, void *), void *data);
+
+/*
+ * Returns a newly allocated JSON array of every Event (as eventToJSON() writes them) whose span
+ * overlaps 'range', in order of their start times. Returns "[]" if there are none, or NULL if
+ * memory could not be allocated.
+ */
+char *queryEventsInRange(const EventIndex *index, TimeSpan range);
+
+#endif
@@ -0,0 +1,38 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  EventSort.h                     *
+ ************************************/
+
+/* Sorts a List of Events in O(n) time, instead of inserting them one at a time with insertSorted().
+ *
+ * The key of every Event is read once into a 64-bit number: a DateTime is packed as the decimal
+ * number YYYYMMDDhhmmss (the same as in CalendarCBOR.h), and a UID as its first 8 bytes, most
+ * significant first. The keys are sorted with an LSD radix sort, one byte per pass, skipping the
+ * passes in which every key has the same byte. Radix sorting is stable, so Events with equal keys
+ * stay in the order they were in. UIDs that share their first 8 bytes are then put in order with
+ * strcmp(). Finally the List's nodes are relinked in the new order, so no Event is copied or moved.
+ *
+ * DateTimes are compared at face value (a UTC time and a local time with the same digits are equal),
+ * and Events whose DateTime isn't made of digits come after all of the others.
+ */
+
+#ifndef EVENTSORT_H
+#define EVENTSORT_H
+
+#include "CalendarParser.h"
+
+enum eventSortKey {SORT_BY_START, SORT_BY_STAMP, SORT_BY_UID};
+
+/*
+ * Sorts the Events in 'events' by their DTSTART, DTSTAMP or UID, keeping Events with equal keys in the
+ * order they were in.
+ * Returns OK, INV_CAL if 'events' is NULL, or OTHER_ERROR if memory could not be allocated (in which case
+ * the List is left untouched).
+ */
+ICalErrorCode sortEvents(List *events, enum eventSortKey key);
+
+#endif
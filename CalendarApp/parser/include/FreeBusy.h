@@ -0,0 +1,106 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  FreeBusy.h                      *
+ ************************************/
+
+/* Free/busy time of Calendars, as bitmaps over a range of time cut into fixed-length slots (e.g. 5
+ * minutes). Refer to section 3.6.4 and 3.2.9 of the RFC5545 iCal specification.
+ *
+ * A bit is set for every slot that an Event of the Calendar overlaps, even partly. Recurring Events
+ * are expanded with an OccurrenceIterator (see Recurrence.h), and Events that are TRANSPARENT or
+ * CANCELLED don't take up any time. An Event with no duration takes up the slot it starts in.
+ *
+ * The bits are packed into 64-bit words, so combining the bitmaps of several Calendars works on 64
+ * slots at a time: a year of 5-minute slots is 1643 words, and ORing 200 of them together is a few
+ * hundred thousand word operations. Runs of set or clear bits are found a word at a time with
+ * __builtin_ctzll().
+ */
+
+#ifndef FREEBUSY_H
+#define FREEBUSY_H
+
+#include <stdint.h>
+
+#include "CalendarParser.h"
+#include "TimeSpan.h"
+
+// The most slots a bitmap can have (a little under 40 years of 5-minute slots)
+#define MAX_BUSY_SLOTS (1 << 22)
+
+// The most occurrences of a single recurring Event that are marked in a bitmap
+#define MAX_BUSY_OCCURRENCES 1000000
+
+typedef struct busybitmap {
+	// The start of the first slot, and how long every slot is, in seconds (see TimeSpan.h)
+	int64_t start;
+	int64_t slotSeconds;
+	int numSlots;
+	// Bit i % 64 of words[i / 64] is set if slot i is busy. Bits past the last slot are always clear.
+	int numWords;
+	uint64_t *words;
+} BusyBitmap;
+
+/*
+ * Creates a bitmap of 'numSlots' free slots of 'slotSeconds' seconds each, the first of which starts at 'start'.
+ * Returns NULL if the size of the bitmap is out of range, or memory could not be allocated.
+ */
+BusyBitmap *createBusyBitmap(int64_t start, int64_t slotSeconds, int numSlots);
+
+/*
+ * Frees a bitmap.
+ */
+void deleteBusyBitmap(BusyBitmap *bitmap);
+
+/*
+ * Marks every slot that 'span' overlaps as busy. A span with no duration marks the slot it starts in.
+ * Returns true if any slot was marked.
+ */
+bool markBusy(BusyBitmap *bitmap, TimeSpan span);
+
+/*
+ * Marks every slot taken up by an Event of 'cal' (or one of its occurrences) as busy.
+ * Returns the number of Events that took up any time in the bitmap's range.
+ */
+int markCalendarBusy(BusyBitmap *bitmap, const Calendar *cal);
+
+/*
+ * Makes every slot of 'dest' busy if it is busy in 'dest' or 'src' (the time at least one of them is busy).
+ * Both bitmaps must cover the same slots.
+ */
+void unionBusy(BusyBitmap *dest, const BusyBitmap *src);
+
+/*
+ * Makes every slot of 'dest' busy only if it is busy in both 'dest' and 'src' (the time both are busy).
+ * Both bitmaps must cover the same slots.
+ */
+void intersectBusy(BusyBitmap *dest, const BusyBitmap *src);
+
+/*
+ * Swaps the free and busy slots of 'bitmap'.
+ */
+void invertBusy(BusyBitmap *bitmap);
+
+/*
+ * Calls 'found' on every run of busy slots (or free slots, if 'busy' is false), in order, with the span of
+ * time the run covers. 'data' is passed to every call of 'found' untouched.
+ * Returns the number of runs.
+ */
+int findPeriods(const BusyBitmap *bitmap, bool busy, void (*found)(TimeSpan, void *), void *data);
+
+/*
+ * Returns a newly allocated JSON array of the runs of busy slots (or free slots, if 'busy' is false), as
+ * [{"startDT":...,"endDT":...},...].
+ */
+char *periodsToJSON(const BusyBitmap *bitmap, bool busy);
+
+/*
+ * Returns a newly allocated FREEBUSY property value (e.g. "20190101T090000Z/20190101T100000Z,...") of the
+ * runs of busy slots (or free slots, if 'busy' is false). Times are taken to be UTC, as in TimeSpan.h.
+ */
+char *periodsToFreeBusy(const BusyBitmap *bitmap, bool busy);
+
+#endif
@@ -0,0 +1,98 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  IOBatch.h                       *
+ ************************************/
+
+/* A gather-write batch used to serialize Calendars.
+ *
+ * Instead of formatting every line with fprintf, the writers append iovec entries that point
+ * straight at the strings already stored in the Calendar (UIDs, property descriptions, triggers...),
+ * interleaved with static separators and CRLFs. The batch is flushed to the file descriptor with a
+ * single writev() whenever it fills up, and once more at the very end.
+ *
+ * Because most entries are not copied, everything appended with batchAppend() must stay alive and
+ * unmodified until the next flush. Short generated strings (e.g. the VERSION number) are copied into
+ * the batch's scratch space with batchAppendCopy() or batchPrintf() instead.
+ */
+
+#ifndef IOBATCH_H
+#define IOBATCH_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <sys/uio.h>
+
+#include "CalendarParser.h"
+
+// Number of iovec entries gathered before the batch is flushed. Must not exceed IOV_MAX (1024 on Linux).
+#define IOBATCH_MAX_VECS 512
+
+// Bytes of scratch space for strings that have to be copied into the batch
+#define IOBATCH_SCRATCH_SIZE 4096
+
+// Maximum number of octets in a content line (not including the CRLF) before it must be folded.
+// Refer to section 3.1 of the RFC5545 iCal specification.
+#define FOLD_LENGTH 75
+
+typedef struct iobatch {
+	int fd;
+	struct iovec vecs[IOBATCH_MAX_VECS];
+	int numVecs;
+	char scratch[IOBATCH_SCRATCH_SIZE];
+	size_t scratchUsed;
+	// Total number of bytes that have been flushed to 'fd' so far
+	size_t written;
+	// The first error encountered. Once set, every other call is ignored and returns it.
+	ICalErrorCode error;
+} IOBatch;
+
+// Appends a string literal to the batch without needing to call strlen() on it
+#define batchAppendLit(batch, literal) batchAppend((batch), (literal), sizeof(literal) - 1)
+
+/*
+ * Prepares 'batch' to write to the file descriptor 'fd'.
+ */
+void initializeBatch(IOBatch *batch, int fd);
+
+/*
+ * Appends 'length' bytes starting at 'data' to the batch without copying them.
+ * 'data' must not be freed or modified until the batch has been flushed.
+ * Returns OK, or WRITE_ERROR if a flush was needed and it failed.
+ */
+ICalErrorCode batchAppend(IOBatch *batch, const char *data, size_t length);
+
+/*
+ * Copies 'length' bytes starting at 'data' into the batch's scratch space and appends them,
+ * so 'data' may be modified or freed immediately afterwards.
+ * Returns OK, or WRITE_ERROR if a flush was needed and it failed.
+ */
+ICalErrorCode batchAppendCopy(IOBatch *batch, const char *data, size_t length);
+
+/*
+ * Formats a string into the batch's scratch space using printf format specifiers, and appends it.
+ * The formatted string must be shorter than IOBATCH_SCRATCH_SIZE.
+ * Returns OK, or WRITE_ERROR if a flush was needed and it failed.
+ */
+ICalErrorCode batchPrintf(IOBatch *batch, const char *format, ...);
+
+/*
+ * Appends the content line "<name><separator><value>\r\n" to the batch without copying any of
+ * its parts, folding it every FOLD_LENGTH octets with a (CRLF)(single space) sequence.
+ * Folds are never placed inside a multi-byte UTF-8 sequence.
+ * Returns OK, or WRITE_ERROR if a flush was needed and it failed.
+ */
+ICalErrorCode batchAppendLine(IOBatch *batch, const char *name, size_t nameLen, const char *separator, \
+                              const char *value, size_t valueLen);
+
+/*
+ * Writes everything in the batch to its file descriptor with writev(), retrying partial writes.
+ * The batch is empty afterwards, and may be reused.
+ * Returns OK, or WRITE_ERROR if the write failed.
+ */
+ICalErrorCode flushBatch(IOBatch *batch);
+
+#endif
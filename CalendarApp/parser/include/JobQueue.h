@@ -0,0 +1,62 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  JobQueue.h                      *
+ ************************************/
+
+/* A pool of worker threads owned by the library, for running calls that take a long time (like parsing
+ * a large calendar) without blocking whoever asked for them.
+ *
+ * submitJob() queues a call and returns an id for it straight away. Once a worker has run it, the result
+ * is kept and the job's id is written (as a native int) to a pipe, whose read end is jobQueueFd(). A
+ * caller with an event loop (like Node) can watch that pipe, and collect each result with takeJobResult()
+ * once its id comes out, so it never waits on a job.
+ *
+ * So that small jobs don't queue up behind large ones, jobs on LARGE_JOB_BYTES or more of data are kept in
+ * a queue of their own, which only ever gets all but one of the workers. A job that writes to a file is
+ * never run at the same time as another job that writes to the same file, and the jobs that write to a
+ * file are run in the order they were submitted.
+ */
+
+#ifndef JOBQUEUE_H
+#define JOBQUEUE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// The most worker threads in the pool (there is one per processor, but never fewer than 2)
+#define MAX_JOB_THREADS 16
+
+// A job on at least this many bytes of data is a large one
+#define LARGE_JOB_BYTES (1 << 20)
+
+// The most arguments a job can have
+#define MAX_JOB_ARGS 5
+
+// The call a job makes, with its arguments. It returns a newly allocated string.
+typedef char *(*JobFunction)(char **args);
+
+/*
+ * Queues a call of 'run' with copies of the 'numArgs' strings in 'args', on 'size' bytes of data. If 'writes'
+ * is true, the job writes to the file at args[0]. The pool is started the first time a job is submitted.
+ * Returns the id of the job (which is positive), or -1 if the pool could not be started or memory could not
+ * be allocated.
+ */
+int submitJob(JobFunction run, const char **args, int numArgs, size_t size, bool writes);
+
+/*
+ * Returns the read end of the pipe that the id of every finished job is written to, starting the pool if it
+ * hasn't been. Returns -1 if the pool could not be started.
+ */
+int jobQueueFd(void);
+
+/*
+ * Returns the result of the finished job 'id', and forgets the job, so the result can only be taken once.
+ * Returns NULL if there is no such job, or it hasn't finished.
+ */
+char *takeJobResult(int id);
+
+#endif
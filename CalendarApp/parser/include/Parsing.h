@@ -20,6 +20,8 @@
 #include "Debug.h"
 #include "Initialize.h"
 
+// The size readFold() first gives its line buffer. It is doubled whenever a line doesn't fit.
+#define READ_FOLD_SIZE 1024
 
 /*
  * To be used during createCalendar when something goes wrong or if the calendar
@@ -66,17 +68,18 @@ char *strUpperCopy(const char *string);
 
 
 /*
- * Reads in at most 'size' bytes from 'fp' and stores it in the buffer pointed to by 'unfolded'.
+ * Reads the next content line from 'fp' into *unfolded, a buffer of *size bytes that is grown with
+ * realloc() whenever the line doesn't fit (like getline(), *unfolded may start out NULL with a *size
+ * of 0, and the caller frees it once it is done reading).
  * Continually reads lines as long as folded lines are encountered. Stops when a line
  * without a fold is read, or if the end of the file is reached.
  * Folded lines are concatenated together, and then unfolded to make one single line with no
- * CRLF(whitesapce) sequences.
- * 'unfold' must be large enough to hold the entire string.
+ * CRLF(whitesapce) sequences. Trailing whitespace is trimmed, and leading whitespace is kept.
  *
- * Returns OK on a success, INV_FILE if imvalid line endings are found, and any other
- * relevant error if an error is found (for example, INV_CAL if an empty line is found)
+ * Returns OK on a success, INV_FILE if imvalid line endings are found, OTHER_ERROR if the buffer could
+ * not be grown, and any other relevant error if an error is found (for example, INV_CAL if an empty line is found)
  */
-ICalErrorCode readFold(char *unfolded, int size, FILE *fp);
+ICalErrorCode readFold(char **unfolded, size_t *size, FILE *fp);
 
 
 ICalErrorCode getEvent(FILE *fp, Event **event);
@@ -0,0 +1,29 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  Random.h                        *
+ ************************************/
+
+/* A pseudo-random number generator that is safe to call from any number of threads at once, to
+ * use instead of rand() (whose single hidden state every thread shares).
+ *
+ * Every thread gets its own xorshift64* state in thread-local storage, so no locking is needed. A
+ * thread seeds its state the first time it asks for a number, from the time, the address of the
+ * state and a counter shared by every thread, so threads started at the same moment still get
+ * different numbers. The numbers are not suitable for anything that needs to be unguessable.
+ */
+
+#ifndef RANDOM_H
+#define RANDOM_H
+
+#include <stdint.h>
+
+/*
+ * Returns the next pseudo-random number of the calling thread.
+ */
+uint32_t randomNumber(void);
+
+#endif
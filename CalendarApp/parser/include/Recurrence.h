@@ -0,0 +1,145 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  Recurrence.h                    *
+ ************************************/
+
+/* Expands the RRULE, RDATE and EXDATE properties of an Event into the times it occurs at.
+ * Refer to section 3.3.10 and 3.8.5 of the RFC5545 iCal specification.
+ *
+ * compileRecurrence() parses an Event's recurrence properties once into a Recurrence: the RRULE
+ * becomes a handful of bitmasks (BYMONTH, BYMONTHDAY, BYDAY), and the RDATEs and EXDATEs become
+ * sorted arrays of times. An OccurrenceIterator then produces the occurrences in order, one
+ * "period" of the rule (a day, week, month or year, depending on FREQ) at a time, so it never holds
+ * more than one period's worth (at most 366) of them, however long the rule runs for.
+ *
+ * startOccurrences() can start the iterator anywhere. Without a COUNT, the period containing the
+ * starting time is calculated directly instead of stepping through every period from DTSTART. With a
+ * COUNT, the earlier occurrences have to be counted, but that only takes O(1) time for rules without
+ * BYxxx parts (every period of those has exactly one occurrence), and O(1) memory either way.
+ *
+ * Supported rule parts are FREQ, INTERVAL, COUNT, UNTIL, BYMONTH, BYMONTHDAY, BYDAY (with ordinals
+ * like 2MO or -1FR for MONTHLY and YEARLY rules) and WKST. Time zones are not looked up (see
+ * TimeSpan.h), and every occurrence starts at the same time of day as DTSTART.
+ */
+
+#ifndef RECURRENCE_H
+#define RECURRENCE_H
+
+#include <stdint.h>
+
+#include "CalendarParser.h"
+#include "TimeSpan.h"
+
+// The most BYDAY entries with ordinals (e.g. "1MO,-1FR") that a rule can have
+#define MAX_ORDINAL_DAYS 32
+
+// The most occurrences a rule can have in a single period (the number of days in a leap year)
+#define MAX_PERIOD_OCCURRENCES 366
+
+// A rule that goes this many periods in a row without an occurrence (e.g. "every February 30th") is over
+#define MAX_EMPTY_PERIODS 10000
+
+enum recurFreq {FREQ_SECONDLY, FREQ_MINUTELY, FREQ_HOURLY, FREQ_DAILY, FREQ_WEEKLY, FREQ_MONTHLY, FREQ_YEARLY};
+
+// A BYDAY entry with an ordinal, e.g. -1FR for "the last Friday"
+typedef struct ordinalday {
+	int ordinal;
+	// 0 is Sunday
+	int weekday;
+} OrdinalDay;
+
+// A compiled RRULE
+typedef struct recurrencerule {
+	enum recurFreq freq;
+	int interval;
+	// 0 if the rule has no COUNT
+	int count;
+	// INT64_MAX if the rule has no UNTIL
+	int64_t until;
+	// Bit m is set for every month m (1-12) in BYMONTH. 0 if there is no BYMONTH.
+	uint16_t byMonth;
+	// Bit d-1 is set for every day d in BYMONTHDAY, and bit d-1 of byNegMonthDay for every day -d
+	uint32_t byMonthDay;
+	uint32_t byNegMonthDay;
+	// Bit w is set for every weekday w (0 is Sunday) in BYDAY that doesn't have an ordinal
+	uint8_t byDay;
+	// The BYDAY entries that have ordinals
+	OrdinalDay ordinalDays[MAX_ORDINAL_DAYS];
+	int numOrdinalDays;
+	// The weekday that weeks start on (WKST), 0 is Sunday
+	int weekStart;
+} RecurrenceRule;
+
+// Every time an Event occurs at, as compiled by compileRecurrence()
+typedef struct recurrence {
+	// DTSTART, and how long every occurrence lasts
+	int64_t start;
+	int64_t duration;
+	bool UTC;
+	bool hasRule;
+	RecurrenceRule rule;
+	// Whether the rule itself produces DTSTART. If it doesn't, DTSTART is still the first occurrence.
+	bool ruleHasStart;
+	// Every RDATE and EXDATE, sorted
+	int64_t *rdates;
+	int numRDates;
+	int64_t *exdates;
+	int numExDates;
+} Recurrence;
+
+// Produces the occurrences of a Recurrence in order. The Recurrence must outlive it.
+typedef struct occurrenceiterator {
+	const Recurrence *rec;
+	// The period of the rule that the buffered occurrences belong to (0 is the one with DTSTART in it)
+	int64_t period;
+	int64_t buffer[MAX_PERIOD_OCCURRENCES];
+	int numBuffered;
+	int nextBuffered;
+	// Whether the buffered period is the last one the rule has an occurrence in (because of UNTIL)
+	bool lastPeriod;
+	// The number of occurrences the rule has produced so far, for COUNT
+	int produced;
+	bool ruleDone;
+	// Whether DTSTART still has to be produced (only used if the rule doesn't produce it itself)
+	bool startPending;
+	int nextRDate;
+	// The last occurrence that was returned, so that one produced twice (e.g. by the rule and an RDATE) is only returned once
+	int64_t last;
+	bool returnedAny;
+} OccurrenceIterator;
+
+/*
+ * Compiles the DTSTART, DTEND/DURATION, RRULE, RDATE and EXDATE properties of 'ev' into a Recurrence,
+ * and stores it in 'rec'. An Event without an RRULE or any RDATEs just occurs once, at DTSTART.
+ * Returns OK, INV_EVENT if one of the properties is malformed, or OTHER_ERROR if the RRULE uses a rule part
+ * that isn't supported (BYSECOND, BYMINUTE, BYHOUR, BYYEARDAY, BYWEEKNO or BYSETPOS).
+ */
+ICalErrorCode compileRecurrence(const Event *ev, Recurrence **rec);
+
+/*
+ * Frees a Recurrence.
+ */
+void deleteRecurrence(Recurrence *rec);
+
+/*
+ * Sets up 'iter' to produce every occurrence of 'rec' that starts at or after 'from', in order.
+ */
+void startOccurrences(const Recurrence *rec, int64_t from, OccurrenceIterator *iter);
+
+/*
+ * Stores the start of the next occurrence in 'start'. Returns false (and leaves 'start' alone) once there
+ * are no more occurrences.
+ */
+bool nextOccurrence(OccurrenceIterator *iter, int64_t *start);
+
+/*
+ * Returns a newly allocated JSON array of the occurrences of 'rec' that overlap 'range', as
+ * [{"startDT":...,"endDT":...},...], in order. At most 'maxOccurrences' are included.
+ */
+char *occurrencesToJSON(const Recurrence *rec, TimeSpan range, int maxOccurrences);
+
+#endif
@@ -0,0 +1,84 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  SearchIndex.h                   *
+ ************************************/
+
+/* An inverted index over the words in the SUMMARY, DESCRIPTION and LOCATION properties of the Events
+ * in any number of Calendars, used to search for Events by their text without reading all of them.
+ *
+ * Words are runs of letters and digits (any byte that isn't ASCII counts as a letter, so UTF-8 words
+ * stay whole), lower-cased. Every distinct word is kept in one sorted array of terms, and each term
+ * has a postings list of the Events it appears in, as (calendar, event) pairs in order. The lists are
+ * stored back to back in one block of bytes, delta coded and written as varints: each posting is the
+ * difference from the previous calendar, then the event's position in its Calendar (or, if the
+ * calendar didn't change, the difference from the previous event's position). Most postings take
+ * two bytes.
+ *
+ * A query is a list of words, all of which an Event must contain. A word ending in '*' matches any
+ * term that starts with it. Each word is found with a binary search of the terms, and the matching
+ * lists are intersected smallest first, so a search only reads the postings of the words in it.
+ *
+ * The index points at the Calendars' Events, so it must be deleted before they are, and rebuilt
+ * whenever Events are added or changed.
+ */
+
+#ifndef SEARCHINDEX_H
+#define SEARCHINDEX_H
+
+#include <stdint.h>
+
+#include "CalendarParser.h"
+
+// Longer words are cut down to this many bytes, both when indexing and when searching
+#define MAX_TOKEN_LENGTH 64
+
+// An Event found by a search: the position of its Calendar in the index, and its position in the Calendar
+typedef struct searchhit {
+	int calendar;
+	int event;
+} SearchHit;
+
+typedef struct searchindex {
+	int numCalendars;
+	// Calendar c's Events are events[firstEvent[c]] to events[firstEvent[c + 1] - 1], in the order of its list
+	int *firstEvent;
+	const Event **events;
+	// Every distinct word, sorted with strcmp(). They all point into termText.
+	int numTerms;
+	char **terms;
+	char *termText;
+	// The postings of terms[i] are the bytes postings[postingStart[i]] to postings[postingStart[i + 1] - 1],
+	// and name postingCount[i] Events
+	size_t *postingStart;
+	int *postingCount;
+	uint8_t *postings;
+} SearchIndex;
+
+/*
+ * Builds an index over the Events of the 'numCals' Calendars in 'cals'.
+ * Returns NULL if memory could not be allocated.
+ */
+SearchIndex *createSearchIndex(Calendar **cals, int numCals);
+
+/*
+ * Frees the index (but not the Calendars it points to).
+ */
+void deleteSearchIndex(SearchIndex *index);
+
+/*
+ * Finds every Event that contains all of the words in 'query', and stores them in a newly allocated
+ * array in 'hits', sorted by calendar and then by position. A query without any words finds nothing.
+ * Returns the number of Events found, or -1 if memory could not be allocated.
+ */
+int searchEvents(const SearchIndex *index, const char *query, SearchHit **hits);
+
+/*
+ * Returns the Event that 'hit' names.
+ */
+const Event *searchHitEvent(const SearchIndex *index, SearchHit hit);
+
+#endif
@@ -0,0 +1,47 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  TableExport.h                   *
+ ************************************/
+
+/* Writes the rows a Calendar is stored as in the database's EVENT and ALARM tables (see /insertIntoDB in
+ * app.js) as tab-separated values, in the format that LOAD DATA INFILE reads by default: fields end with a
+ * tab, rows end with a newline, a backslash escapes a tab, newline, carriage return, NUL or backslash in a
+ * value, and \N is NULL. Thousands of rows can then be loaded with a single statement, instead of one
+ * INSERT each.
+ *
+ * An Event doesn't have an event_id until it is loaded, so each EVENT row starts with its row number instead
+ * (0 for the first row, counting only the Events that are written), and each ALARM row refers to its Event by
+ * that number. AUTO_INCREMENT gives the EVENT rows ascending ids in the order they are loaded, so the loader
+ * reads the ids back and turns row numbers into ids with them:
+ *
+ *   EVENT: row number, summary, start_time, location, organizer
+ *   ALARM: row number of its Event, action, trigger
+ *
+ * The summary is NULL if the Event has no SUMMARY (or an empty one), and the location and organizer are
+ * NULL if it has no LOCATION or ORGANIZER property. start_time is written as "YYYY-MM-DD hh:mm:ss".
+ *
+ * The rows point straight at the Calendar's strings, so it must not be deleted until the batches are flushed.
+ */
+
+#ifndef TABLEEXPORT_H
+#define TABLEEXPORT_H
+
+#include <stdbool.h>
+
+#include "CalendarParser.h"
+#include "IOBatch.h"
+
+/*
+ * Appends a row to 'events' for every Event of 'cal' (other than the ones whose entry in 'skip' is true,
+ * if 'skip' isn't NULL), and a row to 'alarms' for every Alarm of those Events. The number of rows of
+ * each is stored in 'numEvents' and 'numAlarms'.
+ * Returns OK, INV_CAL if 'cal' is NULL, or WRITE_ERROR if a flush was needed and it failed.
+ */
+ICalErrorCode appendTableRows(const Calendar *cal, const bool *skip, IOBatch *events, IOBatch *alarms, \
+                              int *numEvents, int *numAlarms);
+
+#endif
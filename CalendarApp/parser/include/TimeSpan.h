@@ -0,0 +1,87 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  TimeSpan.h                      *
+ ************************************/
+
+/* Conversions between iCalendar date/time values and plain numbers of seconds.
+ *
+ * Every time is turned into the number of seconds since 19700101T000000, counting days with the
+ * proleptic Gregorian calendar. Time zones are not looked up: UTC times and floating (local) times
+ * are both taken at face value, which keeps the ordering of the Events in a single calendar intact.
+ */
+
+#ifndef TIMESPAN_H
+#define TIMESPAN_H
+
+#include <stdint.h>
+
+#include "CalendarParser.h"
+
+#define SECONDS_PER_DAY 86400
+
+// The half-open range of time [start, end), in seconds since 19700101T000000
+typedef struct timespan {
+	int64_t start;
+	int64_t end;
+} TimeSpan;
+
+/*
+ * Returns the number of days from 19700101 to the given date in the proleptic Gregorian calendar.
+ */
+int64_t daysFromDate(int year, int month, int day);
+
+/*
+ * The inverse of daysFromDate(): stores the date that is 'days' days after 19700101.
+ */
+void dateFromDays(int64_t days, int *year, int *month, int *day);
+
+/*
+ * Returns the day of the week of the date 'days' days after 19700101, where 0 is Sunday.
+ */
+int weekdayFromDays(int64_t days);
+
+/*
+ * Returns the number of days in the given month.
+ */
+int daysInMonth(int year, int month);
+
+/*
+ * Converts a number of seconds back into a DateTime, and stores it in 'dt'.
+ */
+void secondsToDateTime(int64_t seconds, bool UTC, DateTime *dt);
+
+/*
+ * Converts the DateTime 'dt' into seconds, and stores them in 'seconds'.
+ * Returns OK, or INV_DT if the DateTime does not hold a real date and time.
+ */
+ICalErrorCode dateTimeToSeconds(const DateTime *dt, int64_t *seconds);
+
+/*
+ * Converts an iCalendar DATE ("YYYYMMDD") or DATE-TIME ("YYYYMMDDThhmmss", optionally followed
+ * by a 'Z') value into seconds, and stores them in 'seconds'. 'isDate' is set to true if the
+ * value was a DATE (it may be NULL).
+ * Returns OK, or INV_DT if the value is malformed.
+ */
+ICalErrorCode parseTimeValue(const char *value, int64_t *seconds, bool *isDate);
+
+/*
+ * Converts an iCalendar DURATION value (e.g. "PT1H30M", "P1W", "-P2DT12H") into a number of
+ * seconds, which is negative for a negative duration, and stores it in 'seconds'.
+ * Refer to section 3.3.6 of the RFC5545 iCal specification.
+ * Returns OK, or INV_DT if the value is malformed.
+ */
+ICalErrorCode parseDuration(const char *value, int64_t *seconds);
+
+/*
+ * Finds the span of time taken up by the Event 'ev': it starts at DTSTART, and ends at DTEND if the
+ * Event has one, or DTSTART + DURATION if it has that instead. An Event without either (or with an end
+ * before its start) ends at its DTSTART.
+ * Returns OK, or INV_DT if DTSTART, DTEND or DURATION is malformed.
+ */
+ICalErrorCode getEventSpan(const Event *ev, TimeSpan *span);
+
+#endif
@@ -25,10 +25,49 @@
 #ifndef FFICALENDAR_H
 #define FFICALENDAR_H
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <strings.h>
+#include <sys/stat.h>
 #include <time.h>
+#include <unistd.h>
 
 #include "CalendarParser.h"
 #include "CalendarHelper.h"
+#include "AlarmSchedule.h"
+#include "CalendarCBOR.h"
+#include "Catalog.h"
+#include "Conflicts.h"
+#include "Dedup.h"
+#include "EventIndex.h"
+#include "EventSort.h"
+#include "FreeBusy.h"
+#include "JobQueue.h"
+#include "Parsing.h"
+#include "Random.h"
+#include "Recurrence.h"
+#include "SearchIndex.h"
+#include "TableExport.h"
+
+// The most occurrences of a single Event that eventOccurrencesJSON() returns
+#define MAX_OCCURRENCES_JSON 10000
+
+// The most overlapping pairs of Events that findConflictsJSON() lists
+#define MAX_CONFLICTS_JSON 1000
+
+// The most Events that searchEventsJSON() returns
+#define MAX_SEARCH_RESULTS 500
+
+// The most duplicated Events that duplicateEventsJSON() lists
+#define MAX_DUPLICATES_JSON 500
+
+// The most alarms that nextAlarmsJSON() returns
+#define MAX_ALARMS_JSON 1000
+
+// The most threads that loadDirectoryJSON() reads files in with
+#define MAX_LOAD_THREADS 16
 
 /****************************
  * Stub AJAX Call Functions *
@@ -56,15 +95,129 @@ char *fakeCal();
  * Actual AJAX Callback Functions *
  **********************************/
 
+// Every function below that returns a char * gives the caller a newly allocated string (or, for
+// createCalendarCBOR(), buffer), which it owns. Callers that can't call free() themselves (like
+// JavaScript through ffi) hand it back to freeResult() once they have copied it out.
+void freeResult(char *result);
+
 // Takes a filename and returns a JSON string of a Calendar object, or an error code on a fail.
 char *createCalendarJSON(const char filepath[]);
 
-// Takes a filename and an Event JSON. Adds the Event to the Calendar created from the filename,
-// then overwrites the file with the new Calendar containing its shiny new event.
-// Returns the JSON of the new calendar.
+// Takes a filename, and the key to sort its Events by ("start", "stamp" or "uid"). Returns a JSON array of
+// every Event in the Calendar, sorted by that key (see EventSort.h).
+char *sortedEventsJSON(const char filepath[], const char *key);
+
+// Takes a filename and an Event JSON. Appends the Event to the end of the Calendar in the file,
+// without reading in or re-writing any of the Calendar's other Events.
+// Returns the JSON of the new Event.
 char *addEventJSON(const char filepath[], const char *eventJSON);
 
+// Takes a filename and a JSON array of Events. Every valid Event is appended to the end of the Calendar
+// in the file with a single write. Returns the JSON of every added Event, along with the reason each
+// of the other Events was rejected.
+char *addEventsJSON(const char filepath[], const char *eventsJSON);
+
 // Writes the Calendar JSON to the file path
 char *writeCalFromJSON(const char filepath[], const char *calJSON, const char *evtJSON);
 
+// The same as createCalendarJSON(), addEventJSON(), addEventsJSON(), writeCalFromJSON() and sortedEventsJSON(), but run on the
+// library's pool of worker threads (see JobQueue.h). Each returns the id of its job straight away, or -1 on a fail.
+// Every other *Async() function below is the same as the function it is named after, run the same way.
+int createCalendarJSONAsync(const char filepath[]);
+int addEventJSONAsync(const char filepath[], const char *eventJSON);
+int addEventsJSONAsync(const char filepath[], const char *eventsJSON);
+int writeCalFromJSONAsync(const char filepath[], const char *calJSON, const char *evtJSON);
+int sortedEventsJSONAsync(const char filepath[], const char *key);
+
+// Returns the read end of the pipe that the id of each finished job is written to (as a native int), or -1 on a fail
+int calendarJobsFd();
+
+// Returns the result of the finished job 'id', which can only be taken once, or NULL if it hasn't finished
+char *calendarJobResult(int id);
+
+// Takes a filename and returns the Calendar encoded as CBOR (see CalendarCBOR.h), storing the
+// number of bytes in 'length'. On a fail, an error code JSON is returned instead and 'length' is set to -1.
+char *createCalendarCBOR(const char filepath[], int *length);
+
+// The result of its job is a native int holding the number of bytes of CBOR that follow it, or -1 if the error
+// code JSON follows it instead
+int createCalendarCBORAsync(const char filepath[]);
+
+// Takes a filename and a range of time [from, to), given as iCalendar DATE or DATE-TIME values. If 'to' is
+// empty, the range is the day (or second) that 'from' names. Returns a JSON array of every Event in the
+// Calendar that overlaps the range, sorted by start time, or an error code JSON on a fail.
+// The Calendar's EventIndex is kept until the file changes, so repeated queries don't re-parse it.
+char *queryEventsInRangeJSON(const char filepath[], const char *from, const char *to);
+int queryEventsInRangeJSONAsync(const char filepath[], const char *from, const char *to);
+
+// Takes a filename, the UID of one of its Events, and a range of time [from, to) given as iCalendar DATE or
+// DATE-TIME values. Returns a JSON array of the times the Event occurs at in that range, following its
+// RRULE, RDATEs and EXDATEs, as [{"startDT":...,"endDT":...},...]. At most MAX_OCCURRENCES_JSON are returned.
+char *eventOccurrencesJSON(const char filepath[], const char *uid, const char *from, const char *to);
+int eventOccurrencesJSONAsync(const char filepath[], const char *uid, const char *from, const char *to);
+
+// Takes the paths of any number of calendar files, separated by newlines, and finds every pair of Events
+// (in the same file or in different ones) whose times overlap. Returns the overlapping Events, the number of
+// pairs of them that overlap and the first MAX_CONFLICTS_JSON of those pairs, and an error for each file
+// that could not be read in.
+char *findConflictsJSON(const char *filepaths);
+int findConflictsJSONAsync(const char *filepaths);
+
+// Takes the paths of any number of calendar files, separated by newlines, and a query made of words (a word
+// ending in '*' matches any word that starts with it). Returns the number of Events whose SUMMARY, DESCRIPTION
+// and LOCATION contain every word, the first MAX_SEARCH_RESULTS of them, and an error for each file that
+// could not be read in.
+char *searchEventsJSON(const char *filepaths, const char *query);
+int searchEventsJSONAsync(const char *filepaths, const char *query);
+
+// Takes the paths of any number of calendar files, separated by newlines, a range of time [from, to), the
+// length of a time slot in minutes, and a mode ("free", "busy" or "allbusy"). Returns the runs of slots in
+// which every calendar is free, at least one is busy, or every one is busy, and an error for each file
+// that could not be read in.
+char *freeBusyJSON(const char *filepaths, const char *from, const char *to, int slotMinutes, const char *mode);
+int freeBusyJSONAsync(const char *filepaths, const char *from, const char *to, int slotMinutes, const char *mode);
+
+// Takes the paths of any number of calendar files, separated by newlines, and finds every Event that is in
+// them more than once, by UID or (if 'byContent' is true) by UID and content. Returns how many Events there
+// are, how many are left once copies are dropped, the first MAX_DUPLICATES_JSON duplicated Events along with
+// the file and position of every copy, and an error for each file that could not be read in.
+char *duplicateEventsJSON(const char *filepaths, bool byContent);
+int duplicateEventsJSONAsync(const char *filepaths, bool byContent);
+
+// Takes the paths of any number of calendar files, separated by newlines, and the path of another calendar
+// file, and finds every Event of the other file that one of the files already has, compared the same way as
+// in duplicateEventsJSON(). Returns the position of each of those Events in the other file and the files
+// that have a copy of it, and an error for each file in the list that could not be read in.
+char *checkDuplicatesJSON(const char *filepaths, const char filepath[], bool byContent);
+int checkDuplicatesJSONAsync(const char *filepaths, const char filepath[], bool byContent);
+
+// Takes the paths of any number of calendar files, separated by newlines, a time, and a number k (at most
+// MAX_ALARMS_JSON). Returns the next k times an Alarm of one of the files goes off at or after the time, the
+// number of Alarms that were left out because they are malformed, and an error for each file that could not
+// be read in.
+char *nextAlarmsJSON(const char *filepaths, const char *now, int k);
+int nextAlarmsJSONAsync(const char *filepaths, const char *now, int k);
+
+// Takes the path of a directory of calendar files, and brings its catalog (see Catalog.h) up to date, only
+// parsing the files that are new or have changed. Returns a JSON array with the catalog entry of every file.
+char *catalogJSON(const char dirPath[]);
+int catalogJSONAsync(const char dirPath[]);
+
+// Takes the path of a directory, and reads in and validates every .ics file in it (other than ones whose names
+// start with '.') on up to 'maxThreads' threads at once, or one per processor if 'maxThreads' is 0 or less.
+// Returns {"numFiles","numErrors","calendars":[...]}, where each calendar is {"filename","obj":Calendar JSON}
+// or the error code JSON of the file, sorted by filename. Returns an error code JSON if the directory can't be read.
+char *loadDirectoryJSON(const char dirPath[], int maxThreads);
+
+// The same as loadDirectoryJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int loadDirectoryJSONAsync(const char dirPath[], int maxThreads);
+
+// Takes a filename, the paths of the new files to write its EVENT and ALARM rows to, and the positions of the Events to
+// leave out, separated by commas. Writes the rows as tab-separated values for LOAD DATA INFILE (see TableExport.h),
+// and returns {"version","prodID","numEvents","numAlarms"}, or an error code JSON on a fail.
+char *exportTablesTSV(const char filepath[], const char eventsPath[], const char alarmsPath[], const char *skip);
+
+// The same as exportTablesTSV(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int exportTablesTSVAsync(const char filepath[], const char eventsPath[], const char alarmsPath[], const char *skip);
+
 #endif
@@ -0,0 +1,355 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  AlarmSchedule.c                 *
+ ************************************/
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <strings.h>
+
+#include "AlarmSchedule.h"
+#include "Debug.h"
+
+// Returns the value of the Property, without any parameters that come before it
+static const char *alarmPropValue(const Alarm *alarm, const char *name) {
+	ListIterator iter = createIterator(alarm->properties);
+	Property *prop;
+
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		if (strcasecmp(prop->propName, name) == 0) {
+			const char *colon = strrchr(prop->propDescr, ':');
+			return (colon == NULL) ? prop->propDescr : colon + 1;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Compiles the TRIGGER of 'alarm', along with its REPEAT and DURATION properties (which are ignored unless
+ * both are there), and stores it in 'trigger'.
+ * Returns OK, or INV_ALARM if the TRIGGER, REPEAT or DURATION is malformed.
+ */
+ICalErrorCode compileTrigger(const Alarm *alarm, AlarmTrigger *trigger) {
+	if (alarm == NULL || alarm->trigger == NULL) {
+		return INV_ALARM;
+	}
+
+	memset(trigger, 0, sizeof(AlarmTrigger));
+
+	// The trigger is stored with its parameters, e.g. "RELATED=END:-PT5M" or "VALUE=DATE-TIME:19980101T050000Z"
+	const char *colon = strrchr(alarm->trigger, ':');
+	const char *value = (colon == NULL) ? alarm->trigger : colon + 1;
+	bool dateTime = false;
+
+	if (colon != NULL) {
+		char *params = strndup(alarm->trigger, colon - alarm->trigger);
+		char *param, *savePtr;
+
+		for (param = strtok_r(params, ";", &savePtr); param != NULL; param = strtok_r(NULL, ";", &savePtr)) {
+			if (strcasecmp(param, "RELATED=END") == 0) {
+				trigger->relatedEnd = true;
+			} else if (strcasecmp(param, "VALUE=DATE-TIME") == 0) {
+				dateTime = true;
+			}
+		}
+		free(params);
+	}
+
+	// Without a VALUE parameter, a duration is told apart by its sign or 'P'
+	if (dateTime || (isdigit((unsigned char)value[0]) && strlen(value) >= 15)) {
+		bool isDate;
+
+		if (parseTimeValue(value, &(trigger->time), &isDate) != OK || isDate) {
+			errorMsg("\tTRIGGER \"%s\" is not a DATE-TIME\n", alarm->trigger);
+			return INV_ALARM;
+		}
+		trigger->absolute = true;
+		trigger->relatedEnd = false;
+		trigger->UTC = (toupper((unsigned char)value[strlen(value) - 1]) == 'Z');
+	} else if (parseDuration(value, &(trigger->time)) != OK) {
+		errorMsg("\tTRIGGER \"%s\" is not a duration\n", alarm->trigger);
+		return INV_ALARM;
+	}
+
+	const char *repeat = alarmPropValue(alarm, "REPEAT");
+	const char *duration = alarmPropValue(alarm, "DURATION");
+
+	if (repeat != NULL && duration != NULL) {
+		char *end;
+		long numRepeats = strtol(repeat, &end, 10);
+
+		if (end == repeat || *end != '\0' || numRepeats < 0) {
+			errorMsg("\tREPEAT \"%s\" is not a count\n", repeat);
+			return INV_ALARM;
+		}
+		if (parseDuration(duration, &(trigger->interval)) != OK || trigger->interval <= 0) {
+			errorMsg("\tDURATION \"%s\" is not a positive duration\n", duration);
+			return INV_ALARM;
+		}
+		trigger->repeat = (numRepeats > MAX_ALARM_REPEAT) ? MAX_ALARM_REPEAT : (int)numRepeats;
+	}
+
+	return OK;
+}
+
+// Returns true if 'a' goes off before 'b'. Ties are broken by Alarm and REPEAT, so the order is always the same.
+static bool firesBefore(const AlarmFiring *a, const AlarmFiring *b) {
+	if (a->time != b->time) {
+		return a->time < b->time;
+	}
+	if (a->source != b->source) {
+		return a->source < b->source;
+	}
+
+	return a->repeat < b->repeat;
+}
+
+// Returns the time the firing of 'source' for 'occurrence' goes off at, for the given REPEAT
+static int64_t firingTime(const AlarmSource *source, int64_t occurrence, int repeat) {
+	const AlarmTrigger *trigger = &(source->trigger);
+	int64_t base = trigger->absolute ? trigger->time \
+	               : occurrence + trigger->time + (trigger->relatedEnd ? source->rec->duration : 0);
+
+	return base + repeat * trigger->interval;
+}
+
+static bool heapPush(AlarmSchedule *schedule, int sourceIndex, int64_t occurrence, int repeat) {
+	if (schedule->heapSize == schedule->heapCapacity) {
+		int capacity = (schedule->heapCapacity == 0) ? 64 : schedule->heapCapacity * 2;
+		AlarmFiring *heap = realloc(schedule->heap, sizeof(AlarmFiring) * capacity);
+
+		if (heap == NULL) {
+			return false;
+		}
+		schedule->heap = heap;
+		schedule->heapCapacity = capacity;
+	}
+
+	AlarmFiring firing = {firingTime(&(schedule->sources[sourceIndex]), occurrence, repeat), occurrence, repeat, sourceIndex};
+	int i = schedule->heapSize++;
+
+	// Sift up
+	while (i > 0 && firesBefore(&firing, &(schedule->heap[(i - 1) / 2]))) {
+		schedule->heap[i] = schedule->heap[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	schedule->heap[i] = firing;
+
+	return true;
+}
+
+// Takes the earliest firing off the heap, and puts the next firings of the same Alarm on it. Every firing of
+// an Alarm is pushed by the one before it for the same occurrence, or by the first one for the occurrence
+// before, which goes off no later, so the heap always holds the earliest firing that hasn't been taken.
+static bool heapPop(AlarmSchedule *schedule, AlarmFiring *top) {
+	*top = schedule->heap[0];
+
+	AlarmFiring last = schedule->heap[--schedule->heapSize];
+	int i = 0;
+
+	// Sift down
+	while (2 * i + 1 < schedule->heapSize) {
+		int child = 2 * i + 1;
+		if (child + 1 < schedule->heapSize && firesBefore(&(schedule->heap[child + 1]), &(schedule->heap[child]))) {
+			child++;
+		}
+		if (!firesBefore(&(schedule->heap[child]), &last)) {
+			break;
+		}
+		schedule->heap[i] = schedule->heap[child];
+		i = child;
+	}
+	if (schedule->heapSize > 0) {
+		schedule->heap[i] = last;
+	}
+
+	AlarmSource *source = &(schedule->sources[top->source]);
+	int64_t next;
+
+	if (top->repeat < source->trigger.repeat && !heapPush(schedule, top->source, top->occurrence, top->repeat + 1)) {
+		return false;
+	}
+	// An absolute trigger only goes off once, however many times its Event occurs
+	if (top->repeat == 0 && !source->trigger.absolute && source->iter != NULL && nextOccurrence(source->iter, &next)) {
+		return heapPush(schedule, top->source, next, 0);
+	}
+
+	return true;
+}
+
+// Empties the heap and puts the first firing of every Alarm that could go off at or after 'now' on it
+static bool startSchedule(AlarmSchedule *schedule, int64_t now) {
+	schedule->heapSize = 0;
+	schedule->firstReady = schedule->numReady = 0;
+	schedule->now = now;
+	schedule->started = true;
+
+	for (int i = 0; i < schedule->numSources; i++) {
+		AlarmSource *source = &(schedule->sources[i]);
+		int64_t occurrence = source->rec->start;
+
+		if (source->iter != NULL && !source->trigger.absolute) {
+			// The first occurrence that could have a firing at or after 'now' is the one whose last REPEAT does
+			int64_t latest = source->trigger.time + source->trigger.repeat * source->trigger.interval \
+			                 + (source->trigger.relatedEnd ? source->rec->duration : 0);
+
+			startOccurrences(source->rec, now - latest, source->iter);
+			if (!nextOccurrence(source->iter, &occurrence)) {
+				continue;
+			}
+		}
+
+		if (!heapPush(schedule, i, occurrence, 0)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Builds a schedule of every Alarm in the 'numCals' Calendars in 'cals'. Alarms that can't be compiled
+ * are counted in the schedule's numSkipped and left out.
+ * Returns NULL if memory could not be allocated.
+ */
+AlarmSchedule *createAlarmSchedule(Calendar **cals, int numCals) {
+	debugMsg("-----START createAlarmSchedule()-----\n");
+	AlarmSchedule *schedule = calloc(1, sizeof(AlarmSchedule));
+	int maxSources = 0;
+
+	if (schedule == NULL) {
+		return NULL;
+	}
+
+	for (int c = 0; c < numCals; c++) {
+		ListIterator iter = createIterator(cals[c]->events);
+		Event *ev;
+
+		while ((ev = (Event *)nextElement(&iter)) != NULL) {
+			maxSources += getLength(ev->alarms);
+		}
+	}
+
+	if ((schedule->sources = calloc(maxSources + 1, sizeof(AlarmSource))) == NULL) {
+		free(schedule);
+		return NULL;
+	}
+
+	for (int c = 0; c < numCals; c++) {
+		ListIterator evIter = createIterator(cals[c]->events);
+		Event *ev;
+
+		while ((ev = (Event *)nextElement(&evIter)) != NULL) {
+			ListIterator alIter = createIterator(ev->alarms);
+			Alarm *alarm;
+
+			while ((alarm = (Alarm *)nextElement(&alIter)) != NULL) {
+				AlarmSource *source = &(schedule->sources[schedule->numSources]);
+
+				if (compileTrigger(alarm, &(source->trigger)) != OK || compileRecurrence(ev, &(source->rec)) != OK) {
+					schedule->numSkipped++;
+					continue;
+				}
+
+				// Only a recurring Event needs an iterator, which is a few kilobytes
+				if (source->rec->hasRule || source->rec->numRDates > 0) {
+					if ((source->iter = malloc(sizeof(OccurrenceIterator))) == NULL) {
+						deleteRecurrence(source->rec);
+						deleteAlarmSchedule(schedule);
+						return NULL;
+					}
+				}
+
+				source->alarm = alarm;
+				source->event = ev;
+				source->calendar = c;
+				schedule->numSources++;
+			}
+		}
+	}
+
+	notifyMsg("\t-----END createAlarmSchedule(): %d alarms, %d skipped-----\n", schedule->numSources, schedule->numSkipped);
+	return schedule;
+}
+
+/*
+ * Frees the schedule (but not the Calendars it points to).
+ */
+void deleteAlarmSchedule(AlarmSchedule *schedule) {
+	if (schedule == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < schedule->numSources; i++) {
+		deleteRecurrence(schedule->sources[i].rec);
+		free(schedule->sources[i].iter);
+	}
+	free(schedule->sources);
+	free(schedule->heap);
+	free(schedule->ready);
+	free(schedule);
+}
+
+/*
+ * Stores the next (up to) 'k' times an Alarm goes off at or after 'now' in 'firings', in order.
+ * Returns the number stored, or -1 if memory could not be allocated.
+ */
+int nextAlarms(AlarmSchedule *schedule, int64_t now, int k, AlarmFiring *firings) {
+	AlarmFiring top;
+
+	if (!schedule->started || now < schedule->now) {
+		if (!startSchedule(schedule, now)) {
+			return -1;
+		}
+	}
+	schedule->now = now;
+
+	// Firings that have gone by are thrown away, whether they were handed out already or not
+	while (schedule->firstReady < schedule->numReady && schedule->ready[schedule->firstReady].time < now) {
+		schedule->firstReady++;
+	}
+	while (schedule->heapSize > 0 && schedule->heap[0].time < now) {
+		if (!heapPop(schedule, &top)) {
+			return -1;
+		}
+	}
+
+	// Move the firings that are still ahead to the front, and take more off the heap until there are k
+	int numReady = schedule->numReady - schedule->firstReady;
+	if (numReady > 0) {
+		memmove(schedule->ready, schedule->ready + schedule->firstReady, sizeof(AlarmFiring) * numReady);
+	}
+	schedule->firstReady = 0;
+	schedule->numReady = numReady;
+
+	while (schedule->numReady < k && schedule->heapSize > 0) {
+		if (schedule->numReady == schedule->readyCapacity) {
+			int capacity = (schedule->readyCapacity == 0) ? 64 : schedule->readyCapacity * 2;
+			AlarmFiring *ready = realloc(schedule->ready, sizeof(AlarmFiring) * capacity);
+
+			if (ready == NULL) {
+				return -1;
+			}
+			schedule->ready = ready;
+			schedule->readyCapacity = capacity;
+		}
+
+		if (!heapPop(schedule, &top)) {
+			return -1;
+		}
+		schedule->ready[schedule->numReady++] = top;
+	}
+
+	int numFirings = (schedule->numReady < k) ? schedule->numReady : k;
+	if (numFirings > 0) {
+		memcpy(firings, schedule->ready, sizeof(AlarmFiring) * numFirings);
+	}
+
+	return numFirings;
+}
@@ -0,0 +1,199 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  AtomicFile.c                    *
+ ************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "AtomicFile.h"
+#include "Debug.h"
+
+// Returns a newly allocated copy of the directory part of 'path' ("." if it doesn't have one)
+static char *directoryOf(const char *path) {
+	const char *slash = strrchr(path, '/');
+
+	if (slash == NULL) {
+		return strdup(".");
+	} else if (slash == path) {
+		return strdup("/");
+	}
+
+	return strndup(path, slash - path);
+}
+
+// Writes a new hidden temporary file name for 'path' into 'name'. Every call gives a different name.
+static void tempName(char *name, size_t size, const char *path) {
+	static unsigned int counter = 0;
+	char *dir = directoryOf(path);
+	const char *base = strrchr(path, '/');
+
+	base = (base == NULL) ? path : base + 1;
+	snprintf(name, size, "%s/.%s.%d.%u.tmp", dir, base, (int)getpid(), \
+	         __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED));
+	free(dir);
+}
+
+// fsync()s the directory containing 'path', so that a rename() into it is on disk
+static ICalErrorCode syncDirectory(const char *path) {
+	char *dir = directoryOf(path);
+	int dirfd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	free(dir);
+
+	if (dirfd < 0) {
+		errorMsg("\tCould not open the directory of \"%s\": %s\n", path, strerror(errno));
+		return WRITE_ERROR;
+	}
+
+	if (fsync(dirfd) != 0) {
+		errorMsg("\tfsync() of the directory of \"%s\" failed: %s\n", path, strerror(errno));
+		close(dirfd);
+		return WRITE_ERROR;
+	}
+
+	close(dirfd);
+	return OK;
+}
+
+/*
+ * Creates a temporary file in the same directory as 'path' to write its new contents to.
+ * If 'path' already exists, its permissions are copied over to the temporary file.
+ * Returns OK, or WRITE_ERROR if the temporary file could not be created.
+ */
+ICalErrorCode openAtomic(AtomicFile *file, const char *path) {
+	debugMsg("-----START openAtomic()-----\n");
+	struct stat original;
+	size_t nameSize = strlen(path) + 64;
+
+	file->fd = -1;
+	file->path = strdup(path);
+	file->tempPath = NULL;
+
+#ifdef O_TMPFILE
+	// Fast path: an unnamed file that only gets linked into the directory when it is committed
+	char *dir = directoryOf(path);
+	file->fd = open(dir, O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666);
+	free(dir);
+
+	if (file->fd < 0) {
+		debugMsg("\tO_TMPFILE is not supported here (%s), using a named temporary file\n", strerror(errno));
+	}
+#endif
+
+	// Fall back to a named temporary file; O_EXCL makes sure it is a new one
+	for (int attempts = 0; file->fd < 0 && attempts < 100; attempts++) {
+		if (file->tempPath == NULL) {
+			file->tempPath = malloc(nameSize);
+		}
+		tempName(file->tempPath, nameSize, path);
+
+		file->fd = open(file->tempPath, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+		if (file->fd < 0 && errno != EEXIST) {
+			break;
+		}
+	}
+
+	if (file->fd < 0) {
+		errorMsg("\tCould not create a temporary file for \"%s\": %s\n", path, strerror(errno));
+		free(file->tempPath);
+		free(file->path);
+		file->tempPath = file->path = NULL;
+		return WRITE_ERROR;
+	}
+
+	// Replacing a file shouldn't change who can read it
+	if (stat(path, &original) == 0) {
+		fchmod(file->fd, original.st_mode & 07777);
+	}
+
+	return OK;
+}
+
+/*
+ * Flushes the temporary file to disk and renames it over the original path.
+ * The AtomicFile is closed afterwards, whether or not it succeeded.
+ * Returns OK, or WRITE_ERROR if the file could not be committed (the original is left untouched).
+ */
+ICalErrorCode commitAtomic(AtomicFile *file) {
+	debugMsg("-----START commitAtomic()-----\n");
+
+	if (fsync(file->fd) != 0) {
+		errorMsg("\tfsync() failed: %s\n", strerror(errno));
+		abortAtomic(file);
+		return WRITE_ERROR;
+	}
+
+	if (file->tempPath == NULL) {
+		// An O_TMPFILE file has to be given a name before it can be renamed over the original
+		// (linkat() can't replace an existing file). It is linked through /proc, since linking
+		// the descriptor itself with AT_EMPTY_PATH needs extra privileges.
+		size_t nameSize = strlen(file->path) + 64;
+		char procPath[64];
+		snprintf(procPath, 64, "/proc/self/fd/%d", file->fd);
+
+		file->tempPath = malloc(nameSize);
+		for (int attempts = 0; attempts < 100; attempts++) {
+			tempName(file->tempPath, nameSize, file->path);
+
+			if (linkat(AT_FDCWD, procPath, AT_FDCWD, file->tempPath, AT_SYMLINK_FOLLOW) == 0) {
+				break;
+			} else if (errno != EEXIST || attempts == 99) {
+				errorMsg("\tCould not link the temporary file into place: %s\n", strerror(errno));
+				free(file->tempPath);
+				file->tempPath = NULL;
+				abortAtomic(file);
+				return WRITE_ERROR;
+			}
+		}
+	}
+
+	if (close(file->fd) != 0) {
+		file->fd = -1;
+		errorMsg("\tclose() failed: %s\n", strerror(errno));
+		abortAtomic(file);
+		return WRITE_ERROR;
+	}
+	file->fd = -1;
+
+	if (rename(file->tempPath, file->path) != 0) {
+		errorMsg("\tCould not rename \"%s\" to \"%s\": %s\n", file->tempPath, file->path, strerror(errno));
+		abortAtomic(file);
+		return WRITE_ERROR;
+	}
+
+	// The new contents are in place; all that's left is making sure the rename is on disk too
+	ICalErrorCode error = syncDirectory(file->path);
+
+	free(file->tempPath);
+	free(file->path);
+	file->tempPath = file->path = NULL;
+
+	return error;
+}
+
+/*
+ * Discards the temporary file, leaving the original path untouched.
+ */
+void abortAtomic(AtomicFile *file) {
+	if (file->fd >= 0) {
+		close(file->fd);
+		file->fd = -1;
+	}
+
+	if (file->tempPath != NULL) {
+		unlink(file->tempPath);
+		free(file->tempPath);
+		file->tempPath = NULL;
+	}
+
+	free(file->path);
+	file->path = NULL;
+}
@@ -0,0 +1,287 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  CalendarCBOR.c                  *
+ ************************************/
+
+#include <ctype.h>
+
+#include "CalendarCBOR.h"
+#include "Debug.h"
+
+// Every property name that can legally appear in a Calendar, Event, or Alarm, in sorted order
+// (propNameTag() binary-searches it). The table is frozen: adding, removing or reordering
+// entries changes the wire format.
+const char *cborPropNames[NUM_CBORPROPNAMES] = {"ACTION", "ATTACH", "ATTENDEE", "CALSCALE", "CATEGORIES", \
+	"CLASS", "COMMENT", "CONTACT", "CREATED", "DESCRIPTION", "DTEND", "DTSTAMP", "DTSTART", "DURATION", \
+	"EXDATE", "GEO", "LAST-MODIFIED", "LOCATION", "METHOD", "ORGANIZER", "PRIORITY", "PRODID", "RDATE", \
+	"RECURRENCE-ID", "RELATED-TO", "REPEAT", "RESOURCES", "RRULE", "SEQUENCE", "STATUS", "SUMMARY", \
+	"TRANSP", "TRIGGER", "UID", "URL", "VERSION"};
+
+// CBOR major types (RFC 7049, section 2.1), already shifted into the top 3 bits
+#define CBOR_UINT	0x00
+#define CBOR_TEXT	0x60
+#define CBOR_ARRAY	0x80
+#define CBOR_MAP	0xa0
+
+// Single byte values
+#define CBOR_FALSE		0xf4
+#define CBOR_TRUE		0xf5
+#define CBOR_FLOAT32	0xfa
+
+// A growable output buffer. 'failed' is set as soon as an allocation fails, after which
+// every write is ignored so that the encoders don't need to check each call.
+typedef struct cborbuf {
+	unsigned char *data;
+	size_t length;
+	size_t capacity;
+	bool failed;
+} CBORBuffer;
+
+static bool reserve(CBORBuffer *buf, size_t needed) {
+	if (buf->failed) {
+		return false;
+	}
+
+	if (buf->length + needed <= buf->capacity) {
+		return true;
+	}
+
+	size_t newCapacity = buf->capacity * 2;
+	while (newCapacity < buf->length + needed) {
+		newCapacity *= 2;
+	}
+
+	unsigned char *temp = realloc(buf->data, newCapacity);
+	if (temp == NULL) {
+		errorMsg("\tCould not grow CBOR buffer to %zu bytes\n", newCapacity);
+		buf->failed = true;
+		return false;
+	}
+
+	buf->data = temp;
+	buf->capacity = newCapacity;
+	return true;
+}
+
+// Writes the initial byte of a data item, along with its argument in the fewest bytes possible
+static void writeHead(CBORBuffer *buf, unsigned char major, uint64_t value) {
+	if (!reserve(buf, 9)) {
+		return;
+	}
+
+	unsigned char *out = buf->data + buf->length;
+	int numBytes;
+
+	if (value < 24) {
+		out[0] = major | (unsigned char)value;
+		buf->length += 1;
+		return;
+	} else if (value <= 0xff) {
+		out[0] = major | 24;
+		numBytes = 1;
+	} else if (value <= 0xffff) {
+		out[0] = major | 25;
+		numBytes = 2;
+	} else if (value <= 0xffffffff) {
+		out[0] = major | 26;
+		numBytes = 4;
+	} else {
+		out[0] = major | 27;
+		numBytes = 8;
+	}
+
+	// Arguments are big-endian
+	for (int i = numBytes; i > 0; i--) {
+		out[i] = (unsigned char)(value & 0xff);
+		value >>= 8;
+	}
+
+	buf->length += numBytes + 1;
+}
+
+static void writeText(CBORBuffer *buf, const char *str) {
+	size_t len = strlen(str);
+
+	writeHead(buf, CBOR_TEXT, len);
+	if (!reserve(buf, len)) {
+		return;
+	}
+
+	memcpy(buf->data + buf->length, str, len);
+	buf->length += len;
+}
+
+static void writeByte(CBORBuffer *buf, unsigned char byte) {
+	if (!reserve(buf, 1)) {
+		return;
+	}
+
+	buf->data[buf->length++] = byte;
+}
+
+static void writeFloat(CBORBuffer *buf, float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	writeByte(buf, CBOR_FLOAT32);
+	for (int shift = 24; shift >= 0; shift -= 8) {
+		writeByte(buf, (unsigned char)((bits >> shift) & 0xff));
+	}
+}
+
+// Returns the index of 'name' in cborPropNames, or -1 if it is not in the table.
+// The table is sorted, so a binary search is used.
+static int propNameTag(const char *name) {
+	int low = 0, high = NUM_CBORPROPNAMES - 1;
+
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		int cmp = strcmp(name, cborPropNames[mid]);
+
+		if (cmp == 0) {
+			return mid;
+		} else if (cmp < 0) {
+			high = mid - 1;
+		} else {
+			low = mid + 1;
+		}
+	}
+
+	return -1;
+}
+
+// DateTimes are packed into the single integer YYYYMMDDhhmmss. A DateTime that is not made of
+// exactly 8 + 6 digits can't be packed, so it is written as its text form instead.
+static void writeDateTime(CBORBuffer *buf, DateTime dt) {
+	uint64_t packed = 0;
+	bool digits = (strlen(dt.date) == 8 && strlen(dt.time) == 6);
+
+	for (int i = 0; digits && i < 8; i++) {
+		digits = isdigit((unsigned char)dt.date[i]);
+		packed = packed * 10 + (dt.date[i] - '0');
+	}
+	for (int i = 0; digits && i < 6; i++) {
+		digits = isdigit((unsigned char)dt.time[i]);
+		packed = packed * 10 + (dt.time[i] - '0');
+	}
+
+	writeHead(buf, CBOR_ARRAY, 2);
+	if (digits) {
+		writeHead(buf, CBOR_UINT, packed);
+	} else {
+		char text[20];
+		snprintf(text, 20, "%sT%s", dt.date, dt.time);
+		writeText(buf, text);
+	}
+	writeByte(buf, (dt.UTC) ? CBOR_TRUE : CBOR_FALSE);
+}
+
+static void writePropertyList(CBORBuffer *buf, List *props) {
+	writeHead(buf, CBOR_ARRAY, getLength(props));
+
+	ListIterator iter = createIterator(props);
+	Property *prop;
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		int tag = propNameTag(prop->propName);
+
+		writeHead(buf, CBOR_ARRAY, 2);
+		if (tag == -1) {
+			writeText(buf, prop->propName);
+		} else {
+			writeHead(buf, CBOR_UINT, tag);
+		}
+		writeText(buf, prop->propDescr);
+	}
+}
+
+static void writeAlarmList(CBORBuffer *buf, List *alarms) {
+	writeHead(buf, CBOR_ARRAY, getLength(alarms));
+
+	ListIterator iter = createIterator(alarms);
+	Alarm *alarm;
+	while ((alarm = (Alarm *)nextElement(&iter)) != NULL) {
+		writeHead(buf, CBOR_MAP, 3);
+
+		writeHead(buf, CBOR_UINT, CBOR_AL_ACTION);
+		writeText(buf, alarm->action);
+
+		writeHead(buf, CBOR_UINT, CBOR_AL_TRIGGER);
+		writeText(buf, (alarm->trigger == NULL) ? "" : alarm->trigger);
+
+		writeHead(buf, CBOR_UINT, CBOR_AL_PROPS);
+		writePropertyList(buf, alarm->properties);
+	}
+}
+
+static void writeEventList(CBORBuffer *buf, List *events) {
+	writeHead(buf, CBOR_ARRAY, getLength(events));
+
+	ListIterator iter = createIterator(events);
+	Event *event;
+	while ((event = (Event *)nextElement(&iter)) != NULL) {
+		writeHead(buf, CBOR_MAP, 5);
+
+		writeHead(buf, CBOR_UINT, CBOR_EV_UID);
+		writeText(buf, event->UID);
+
+		writeHead(buf, CBOR_UINT, CBOR_EV_CREATE);
+		writeDateTime(buf, event->creationDateTime);
+
+		writeHead(buf, CBOR_UINT, CBOR_EV_START);
+		writeDateTime(buf, event->startDateTime);
+
+		writeHead(buf, CBOR_UINT, CBOR_EV_PROPS);
+		writePropertyList(buf, event->properties);
+
+		writeHead(buf, CBOR_UINT, CBOR_EV_ALARMS);
+		writeAlarmList(buf, event->alarms);
+	}
+}
+
+/* Encodes the Calendar 'cal' as CBOR.
+ * Returns a newly allocated buffer that must be freed by the caller, and stores the number of
+ * bytes in it in 'length'. Returns NULL (and sets 'length' to 0) if 'cal' is NULL or memory
+ * could not be allocated.
+ */
+unsigned char *calendarToCBOR(const Calendar *cal, size_t *length) {
+	debugMsg("-----START calendarToCBOR()-----\n");
+	*length = 0;
+
+	if (cal == NULL) {
+		errorMsg("\tCalendar passed is NULL\n");
+		return NULL;
+	}
+
+	CBORBuffer buf = {.data = malloc(1024), .length = 0, .capacity = 1024, .failed = false};
+	if (buf.data == NULL) {
+		errorMsg("\tCould not allocate the CBOR buffer\n");
+		return NULL;
+	}
+
+	writeHead(&buf, CBOR_MAP, 4);
+
+	writeHead(&buf, CBOR_UINT, CBOR_CAL_VERSION);
+	writeFloat(&buf, cal->version);
+
+	writeHead(&buf, CBOR_UINT, CBOR_CAL_PRODID);
+	writeText(&buf, cal->prodID);
+
+	writeHead(&buf, CBOR_UINT, CBOR_CAL_PROPS);
+	writePropertyList(&buf, cal->properties);
+
+	writeHead(&buf, CBOR_UINT, CBOR_CAL_EVENTS);
+	writeEventList(&buf, cal->events);
+
+	if (buf.failed) {
+		free(buf.data);
+		return NULL;
+	}
+
+	*length = buf.length;
+	notifyMsg("\tEncoded calendar into %zu bytes of CBOR\n", buf.length);
+	return realloc(buf.data, buf.length);
+}
@@ -7,6 +7,15 @@
  *  CalendarHelper.c                *
  ************************************/
 
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "AtomicFile.h"
 #include "CalendarHelper.h"
 #include "Debug.h"
 #include "Parsing.h"
@@ -20,11 +29,46 @@ const char *eventPropNames[NUM_EVENTPROPNAMES] = {"ATTACH", "ATTENDEE", "CATEGOR
 
 const char *alarmPropNames[NUM_ALARMPROPNAMES] = {"ACTION", "ATTACH", "DURATION", "REPEAT", "TRIGGER"};
 
-/* Writes the property list 'props' to the file pointed to by 'fout' in the proper
- * iCalendar syntax.
+_Static_assert(NUM_CALPROPNAMES <= 64 && NUM_EVENTPROPNAMES <= 64 && NUM_ALARMPROPNAMES <= 64, \
+               "property names are tracked with the bits of a uint64_t");
+
+#define PROPBIT(index) (UINT64_C(1) << (index))
+
+const ComponentRules calRules = {
+	.names = calPropNames, .numNames = NUM_CALPROPNAMES,
+	.once = PROPBIT(CAL_CALSCALE) | PROPBIT(CAL_METHOD),
+	// PRODID and VERSION have their own members in the Calendar struct
+	.forbidden = PROPBIT(CAL_PRODID) | PROPBIT(CAL_VERSION),
+	.error = INV_CAL
+};
+
+const ComponentRules eventRules = {
+	.names = eventPropNames, .numNames = NUM_EVENTPROPNAMES,
+	.once = PROPBIT(EV_CLASS) | PROPBIT(EV_CREATED) | PROPBIT(EV_DESCRIPTION) | PROPBIT(EV_DTEND) | \
+	        PROPBIT(EV_DURATION) | PROPBIT(EV_GEO) | PROPBIT(EV_LAST_MODIFIED) | PROPBIT(EV_LOCATION) | \
+	        PROPBIT(EV_ORGANIZER) | PROPBIT(EV_PRIORITY) | PROPBIT(EV_RECURRENCE_ID) | PROPBIT(EV_SEQUENCE) | \
+	        PROPBIT(EV_STATUS) | PROPBIT(EV_SUMMARY) | PROPBIT(EV_TRANSP) | PROPBIT(EV_URL),
+	// DTSTAMP, DTSTART, and UID have their own members in the Event struct
+	.forbidden = PROPBIT(EV_DTSTAMP) | PROPBIT(EV_DTSTART) | PROPBIT(EV_UID),
+	.exclusive = {PROPBIT(EV_DTEND) | PROPBIT(EV_DURATION)},
+	.error = INV_EVENT
+};
+
+const ComponentRules alarmRules = {
+	.names = alarmPropNames, .numNames = NUM_ALARMPROPNAMES,
+	.once = PROPBIT(AL_ATTACH) | PROPBIT(AL_DURATION) | PROPBIT(AL_REPEAT),
+	// ACTION and TRIGGER have their own members in the Alarm struct
+	.forbidden = PROPBIT(AL_ACTION) | PROPBIT(AL_TRIGGER),
+	.together = {PROPBIT(AL_DURATION) | PROPBIT(AL_REPEAT)},
+	.error = INV_ALARM
+};
+
+/* Appends the property list 'props' to the write batch 'batch' in the proper
+ * iCalendar syntax. Nothing is copied: the batch points directly at each property's
+ * name and description.
  */
-ICalErrorCode writeProperties(FILE *fout, List *props) {
-    if (fout == NULL || props == NULL) {
+ICalErrorCode writeProperties(IOBatch *batch, List *props) {
+    if (batch == NULL || props == NULL) {
         return WRITE_ERROR;
     }
 
@@ -35,25 +79,41 @@ ICalErrorCode writeProperties(FILE *fout, List *props) {
     Property *toWrite;
     ListIterator iter = createIterator(props);
     while ((toWrite = (Property *)nextElement(&iter)) != NULL) {
-        fprintf(fout, "%s%c%s\r\n", \
-                toWrite->propName, \
-                // The comparison below is essentially "does toWrite->propDescr contain a ':' character?"
-                // If it does, then it contains parameters, and therefore the name and description
-                // must be delimited by a semicolon (;) instead of a colon (:)
-                (strcspn(toWrite->propDescr, ":") != strlen(toWrite->propDescr)) ? ';' : ':', \
-                toWrite->propDescr);
+        size_t descrLen = strlen(toWrite->propDescr);
+
+        // If the description contains a ':' character, then it contains parameters, and therefore
+        // the name and description must be delimited by a semicolon (;) instead of a colon (:)
+        batchAppendLine(batch, toWrite->propName, strlen(toWrite->propName), \
+                        (memchr(toWrite->propDescr, ':', descrLen) != NULL) ? ";" : ":", \
+                        toWrite->propDescr, descrLen);
     }
 
-    return OK;
+    return batch->error;
 }
 
-/* Writes the event list 'events' to the file pointed to by 'fout' in the proper
+/* Appends the DateTime 'dt' to the write batch 'batch' in the proper iCalendar syntax
+ * (i.e. YYYYMMDDTHHMMSS, followed by a 'Z' for UTC times).
+ * 'dt' must be the DateTime stored in the Event itself, not a copy of it, since the
+ * batch points directly at its date and time strings.
+ */
+static ICalErrorCode writeDateTime(IOBatch *batch, const DateTime *dt) {
+    batchAppend(batch, dt->date, strlen(dt->date));
+    batchAppendLit(batch, "T");
+    batchAppend(batch, dt->time, strlen(dt->time));
+    if (dt->UTC) {
+        batchAppendLit(batch, "Z");
+    }
+
+    return batchAppendLit(batch, "\r\n");
+}
+
+/* Appends the event list 'events' to the write batch 'batch' in the proper
  * iCalendar syntax, including opening and closing VEVENT tags.
  */
-ICalErrorCode writeEvents(FILE *fout, List *events) {
+ICalErrorCode writeEvents(IOBatch *batch, List *events) {
 	debugMsg("\t-----START writeEvents()-----\n");
-    if (fout == NULL || events == NULL) {
-		errorMsg("\t\tEither the file pointer or the event List is NULL\n");
+    if (batch == NULL || events == NULL) {
+		errorMsg("\t\tEither the write batch or the event List is NULL\n");
         return WRITE_ERROR;
     }
 
@@ -65,38 +125,28 @@ ICalErrorCode writeEvents(FILE *fout, List *events) {
     ICalErrorCode err;
     Event *toWrite;
     ListIterator iter = createIterator(events);
-    char dateTimeData[100];
     while ((toWrite = (Event *)nextElement(&iter)) != NULL) {
-        fprintf(fout, "BEGIN:VEVENT\r\n");
-        fprintf(fout, "UID:%s\r\n", toWrite->UID);
-
-		debugMsg("\t\tWrote BEGIN:VEVENT and UID\n");
-
-        if ((err = getDateTimeAsWritable(dateTimeData, toWrite->creationDateTime)) != OK) {
-			errorMsg("\t\tEncountered error when getting the creationDateTime as a writable string\n");
-            return err;
-        }
-        fprintf(fout, "DTSTAMP:%s\r\n", dateTimeData);
-
-		debugMsg("\t\tWrote DTSTAMP\n");
-
-        if ((err = getDateTimeAsWritable(dateTimeData, toWrite->startDateTime)) != OK) {
-			errorMsg("\t\tEncountered error when getting the startDateTime as a writable string\n");
-            return err;
-        }
-        fprintf(fout, "DTSTART:%s\r\n", dateTimeData);
+        batchAppendLit(batch, "BEGIN:VEVENT\r\n");
+        batchAppendLine(batch, "UID", 3, ":", toWrite->UID, strlen(toWrite->UID));
+        batchAppendLit(batch, "DTSTAMP:");
+        writeDateTime(batch, &(toWrite->creationDateTime));
+        batchAppendLit(batch, "DTSTART:");
+        writeDateTime(batch, &(toWrite->startDateTime));
 
-		debugMsg("\t\tWrote DTSTART\n");
+		debugMsg("\t\tWrote BEGIN:VEVENT, UID, DTSTAMP, and DTSTART\n");
 
-        if ((err = writeProperties(fout, toWrite->properties)) != OK) {
+        if ((err = writeProperties(batch, toWrite->properties)) != OK) {
 			errorMsg("\t\tEncountered error when writing the properties\n");
             return err;
         }
-        if ((err = writeAlarms(fout, toWrite->alarms)) != OK) {
+        if ((err = writeAlarms(batch, toWrite->alarms)) != OK) {
 			errorMsg("\t\tEncountered error when writing the alarms\n");
             return err;
         }
-        fprintf(fout, "END:VEVENT\r\n");
+        if ((err = batchAppendLit(batch, "END:VEVENT\r\n")) != OK) {
+			errorMsg("\t\tEncountered error when flushing the write batch\n");
+            return err;
+        }
 		debugMsg("\t\tWrote END:VEVENT\n");
     }
 	successMsg("\t\t-----END writeEvents()-----\n");
@@ -104,13 +154,13 @@ ICalErrorCode writeEvents(FILE *fout, List *events) {
     return OK;
 }
 
-/* Writes the alarm list 'alarms' to the file pointed to by 'fout' in the proper
+/* Appends the alarm list 'alarms' to the write batch 'batch' in the proper
  * iCalendar syntax, including opening and closing VALARM tags.
  */
-ICalErrorCode writeAlarms(FILE *fout, List *alarms) {
+ICalErrorCode writeAlarms(IOBatch *batch, List *alarms) {
 	debugMsg("\t\t-----START writeAlarms()-----\n");
-    if (fout == NULL || alarms == NULL) {
-		errorMsg("\t\t\tEither the file pointer or alarms List is NULL\n");
+    if (batch == NULL || alarms == NULL) {
+		errorMsg("\t\t\tEither the write batch or alarms List is NULL\n");
         return WRITE_ERROR;
     }
 
@@ -123,17 +173,20 @@ ICalErrorCode writeAlarms(FILE *fout, List *alarms) {
     Alarm *toWrite;
     ListIterator iter = createIterator(alarms);
     while ((toWrite = (Alarm *)nextElement(&iter)) != NULL) {
-        fprintf(fout, "BEGIN:VALARM\r\n");
-        fprintf(fout, "ACTION:%s\r\n", toWrite->action);
-        fprintf(fout, "TRIGGER:%s\r\n", toWrite->trigger);
+        batchAppendLit(batch, "BEGIN:VALARM\r\n");
+        batchAppendLine(batch, "ACTION", 6, ":", toWrite->action, strlen(toWrite->action));
+        batchAppendLine(batch, "TRIGGER", 7, ":", toWrite->trigger, (toWrite->trigger == NULL) ? 0 : strlen(toWrite->trigger));
 
 		debugMsg("\t\t\tWrote BEGIN:VALARM, ACTION, and TRIGGER\n");
 
-        if ((err = writeProperties(fout, toWrite->properties)) != OK) {
+        if ((err = writeProperties(batch, toWrite->properties)) != OK) {
 			errorMsg("\t\t\tEncountered error when writing properties\n");
             return err;
         }
-        fprintf(fout, "END:VALARM\r\n");
+        if ((err = batchAppendLit(batch, "END:VALARM\r\n")) != OK) {
+			errorMsg("\t\t\tEncountered error when flushing the write batch\n");
+            return err;
+        }
 		debugMsg("\t\t\tWrote END:VALARM\n");
     }
 	successMsg("\t\t\t-----END writeAlarms()-----\n");
@@ -141,6 +194,166 @@ ICalErrorCode writeAlarms(FILE *fout, List *alarms) {
     return OK;
 }
 
+static int compareUIDs(const void *first, const void *second) {
+	return strcmp(*(const char **)first, *(const char **)second);
+}
+
+/* Reads through an iCalendar file without building a Calendar out of it, to find what is needed to
+ * append events to it: the offset of its END:VCALENDAR line is stored in 'endOffset', and 'taken[i]'
+ * is set if an event in the file already uses the UID 'uids[i]'. 'uids' must be sorted with strcmp().
+ * Returns OK, INV_CAL if the file doesn't begin with BEGIN:VCALENDAR and end with END:VCALENDAR,
+ * or whatever error readFold() encounters.
+ */
+ICalErrorCode scanCalendarFile(FILE *fp, const char **uids, int numUIDs, bool *taken, long *endOffset) {
+	debugMsg("\t-----START scanCalendarFile()-----\n");
+	char *line = NULL;
+	size_t lineSize = 0;
+	const char *uid, **found;
+	bool beginCal = false;
+	long lineStart;
+	ICalErrorCode error = OK;
+
+	*endOffset = -1;
+	for (int i = 0; i < numUIDs; i++) {
+		taken[i] = false;
+	}
+
+	while (!feof(fp)) {
+		lineStart = ftell(fp);
+		if ((error = readFold(&line, &lineSize, fp)) != OK) {
+			errorMsg("\t\treadFold() failed at offset %ld\n", lineStart);
+			break;
+		}
+
+		if (line[0] == '\0' || line[0] == ';') {
+			// nothing but comments were left in the file
+			continue;
+		}
+
+		if (*endOffset != -1) {
+			errorMsg("\t\tMore lines after hitting END:VCALENDAR\n");
+			error = INV_CAL;
+			break;
+		}
+
+		if (!beginCal) {
+			if (strcasecmp(line, "BEGIN:VCALENDAR") != 0) {
+				errorMsg("\t\tFirst non-comment line was not BEGIN:VCALENDAR\n");
+				error = INV_CAL;
+				break;
+			}
+			beginCal = true;
+		} else if (strcasecmp(line, "END:VCALENDAR") == 0) {
+			*endOffset = lineStart;
+		} else if (numUIDs > 0 && strncasecmp(line, "UID:", 4) == 0) {
+			uid = line + 4;
+			if ((found = bsearch(&uid, uids, numUIDs, sizeof(char *), compareUIDs)) != NULL) {
+				debugMsg("\t\tUID \"%s\" is already taken\n", uid);
+				taken[found - uids] = true;
+			}
+		}
+	}
+	free(line);
+
+	if (error != OK) {
+		return error;
+	}
+
+	if (*endOffset == -1) {
+		errorMsg("\t\tFile ended before END:VCALENDAR\n");
+		return INV_CAL;
+	}
+
+	successMsg("\t\t-----END scanCalendarFile()-----\n");
+	return OK;
+}
+
+// Copies the first 'length' bytes of 'srcFd' to 'destFd'. The kernel does the copying with
+// copy_file_range() (which can share the blocks instead of duplicating them on filesystems that
+// support it); if it can't copy between the two files, they are read and written the ordinary way.
+static ICalErrorCode copyPrefix(int srcFd, int destFd, long length) {
+	loff_t inOffset = 0;
+	ssize_t copied, wrote;
+	char buf[65536];
+	bool useKernel = true;
+
+	while (inOffset < length) {
+		if (useKernel) {
+			copied = copy_file_range(srcFd, &inOffset, destFd, NULL, length - inOffset, 0);
+			if (copied < 0 && (errno == ENOSYS || errno == EXDEV || errno == EINVAL || errno == EOPNOTSUPP)) {
+				useKernel = false;
+				continue;
+			}
+		} else {
+			size_t toRead = (length - inOffset < (long)sizeof(buf)) ? length - inOffset : sizeof(buf);
+			if ((copied = pread(srcFd, buf, toRead, inOffset)) > 0) {
+				for (ssize_t done = 0; done < copied; done += wrote) {
+					if ((wrote = write(destFd, buf + done, copied - done)) < 0 && errno != EINTR) {
+						errorMsg("\t\twrite() failed: %s\n", strerror(errno));
+						return WRITE_ERROR;
+					}
+					wrote = (wrote < 0) ? 0 : wrote;
+				}
+				inOffset += copied;
+			}
+		}
+
+		if (copied < 0 && errno == EINTR) {
+			continue;
+		} else if (copied <= 0) {
+			// A return of 0 means the file ended early, i.e. it was truncated after it was scanned
+			errorMsg("\t\tcould not copy past offset %ld: %s\n", (long)inOffset, (copied < 0) ? strerror(errno) : "end of file");
+			return WRITE_ERROR;
+		}
+	}
+
+	return OK;
+}
+
+/* Appends the event list 'events' to the iCalendar file 'fileName', whose END:VCALENDAR line is at
+ * 'endOffset' (found with scanCalendarFile()). The file is replaced atomically (see AtomicFile.h): the
+ * untouched part before END:VCALENDAR is copied from 'srcFd' by the kernel with copy_file_range(),
+ * without being read in or parsed, and the events and a new END:VCALENDAR are written after it.
+ */
+ICalErrorCode spliceEvents(char *fileName, int srcFd, long endOffset, List *events) {
+	debugMsg("\t-----START spliceEvents()-----\n");
+	AtomicFile file;
+	IOBatch batch;
+
+	if (openAtomic(&file, fileName) != OK) {
+		errorMsg("\t\tCould not open a temporary file for \"%s\"\n", fileName);
+		return WRITE_ERROR;
+	}
+
+	if (copyPrefix(srcFd, file.fd, endOffset) != OK) {
+		errorMsg("\t\tCould not copy the existing calendar\n");
+		abortAtomic(&file);
+		return WRITE_ERROR;
+	}
+
+	initializeBatch(&batch, file.fd);
+	if (writeEvents(&batch, events) != OK) {
+		errorMsg("\t\twriteEvents() failed somehow\n");
+		abortAtomic(&file);
+		return WRITE_ERROR;
+	}
+	batchAppendLit(&batch, "END:VCALENDAR\r\n");
+
+	if (flushBatch(&batch) != OK) {
+		errorMsg("\t\tCould not flush the write batch\n");
+		abortAtomic(&file);
+		return WRITE_ERROR;
+	}
+
+	if (commitAtomic(&file) != OK) {
+		errorMsg("\t\tCould not replace \"%s\" with the new calendar\n", fileName);
+		return WRITE_ERROR;
+	}
+
+	successMsg("\t\t-----END spliceEvents()-----\n");
+	return OK;
+}
+
 /* Puts the relevent information from the Datetime structure 'dt' into the
  * string 'result' using the proper iCalendar syntax so that it may be written
  * to a file (after it is prepended by the proper DT___ tag).
@@ -265,10 +478,161 @@ int vequalsOneOfStr(const char *toCompare, int numArgs, ...) {
 	return -1;
 }
 
+/* Validates a single event to determine whether it conforms to the iCalendar
+ * specification. Returns the highest priority error, or OK if the event conforms
+ * to the specification.
+ *
+ * Highest priority error for this function: INV_EVENT (Priority lvl 4/5)
+ */
+ICalErrorCode validateEvent(const Event *ev) {
+	ICalErrorCode err, highestPriority;
+	highestPriority = OK;
+
+	// check for NULL event members
+	if (ev == NULL || ev->properties == NULL || ev->alarms == NULL || ev->UID == NULL) {
+		errorMsg("\t\tfound NULL event or event member\n");
+		return INV_EVENT;
+	}
+
+	// UID can't be empty
+	if ((ev->UID)[0] == '\0') {
+		errorMsg("\t\tUID empty string\n");
+		return INV_EVENT;
+	}
+
+	// UID can't be longer than 1000 characters (including '\0')
+	bool terminator = false;
+	for (int i = 0; i <= 999; i++) {
+		if ((ev->UID)[i] == '\0') {
+			terminator = true;
+			break;
+		}
+	}
+	if (!terminator) {
+		errorMsg("\t\tUID had no '\\0' within the first 1000 characters\n");
+		return INV_EVENT;
+	}
+
+	// validate creation and start DateTimes
+	if ((err = validateDateTime(ev->creationDateTime)) != OK) {
+		errorMsg("\t\tCreation DateTime invalid\n");
+		if (err == INV_DT) {
+			return INV_EVENT;
+		}
+		highestPriority = higherPriority(highestPriority, err);
+	}
+	if ((err = validateDateTime(ev->startDateTime)) != OK) {
+		errorMsg("\t\tStart DateTime invalid\n");
+		if (err == INV_DT) {
+			return INV_EVENT;
+		}
+		highestPriority = higherPriority(highestPriority, err);
+	}
+
+	// validate event properties
+	if ((err = validatePropertiesEv(ev->properties)) != OK) {
+		errorMsg("\t\tProperties List encountered error\n");
+		highestPriority = higherPriority(highestPriority, err);
+	}
+
+	// validate event alarms
+	if ((err = validateAlarms(ev->alarms)) != OK) {
+		errorMsg("\t\tAlarms List encountered error\n");
+		highestPriority = higherPriority(highestPriority, err);
+	}
+
+	return highestPriority;
+}
+
+// A range of events to be validated by one thread
+typedef struct validatejob {
+	Event **events;
+	int start;
+	int end;
+	// Set by whichever thread finds an INV_EVENT first, since nothing can outrank it
+	atomic_bool *stop;
+	// The highest priority error found in the range
+	ICalErrorCode result;
+} ValidateJob;
+
+static void *validateEventRange(void *arg) {
+	ValidateJob *job = (ValidateJob *)arg;
+	ICalErrorCode err;
+
+	job->result = OK;
+	for (int i = job->start; i < job->end; i++) {
+		if ((err = validateEvent(job->events[i])) != OK) {
+			job->result = higherPriority(job->result, err);
+		}
+
+		if (job->result == INV_EVENT) {
+			atomic_store(job->stop, true);
+			break;
+		}
+
+		// check every so often whether another thread already found an INV_EVENT
+		if ((i & 63) == 0 && atomic_load_explicit(job->stop, memory_order_relaxed)) {
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+// Validates every event in 'events' (which has 'numEvents' events) by splitting them into contiguous
+// ranges, one per thread. The highest priority error of the ranges is returned.
+static ICalErrorCode validateEventsParallel(List *events, int numEvents, int numThreads) {
+	Event **array = malloc(numEvents * sizeof(Event *));
+	ValidateJob jobs[MAX_VALIDATE_THREADS];
+	pthread_t threads[MAX_VALIDATE_THREADS];
+	bool started[MAX_VALIDATE_THREADS];
+	atomic_bool stop = false;
+	ICalErrorCode highestPriority = OK;
+	ListIterator iter = createIterator(events);
+
+	if (array == NULL) {
+		return OTHER_ERROR;
+	}
+	for (int i = 0; i < numEvents; i++) {
+		array[i] = (Event *)nextElement(&iter);
+	}
+
+	for (int t = 0; t < numThreads; t++) {
+		jobs[t] = (ValidateJob){.events = array, .start = (long)numEvents * t / numThreads, \
+		                        .end = (long)numEvents * (t + 1) / numThreads, .stop = &stop, .result = OK};
+	}
+
+	// The calling thread takes the first range itself. If a thread can't be started, its range
+	// is validated here as well.
+	for (int t = 1; t < numThreads; t++) {
+		started[t] = (pthread_create(&threads[t], NULL, validateEventRange, &jobs[t]) == 0);
+	}
+	validateEventRange(&jobs[0]);
+	for (int t = 1; t < numThreads; t++) {
+		if (started[t]) {
+			pthread_join(threads[t], NULL);
+		} else {
+			validateEventRange(&jobs[t]);
+		}
+	}
+
+	for (int t = 0; t < numThreads; t++) {
+		if (jobs[t].result != OK) {
+			highestPriority = higherPriority(highestPriority, jobs[t].result);
+		}
+	}
+
+	free(array);
+	return highestPriority;
+}
+
 /* Validates a list of events to determine whether each event conforms to the iCalendar
  * specification. Returns the highest priority error, or OK if every event in the list
  * conforms to the specification.
  *
+ * Every event is validated independently, so calendars with at least PARALLEL_VALIDATE_MIN events
+ * are split up between several threads; the result is the same either way.
+ *
  * Highest priority error for this function: INV_EVENT (Priority lvl 4/5)
  */
 ICalErrorCode validateEvents(List *events) {
@@ -278,68 +642,28 @@ ICalErrorCode validateEvents(List *events) {
 	}
 
 	// Calendars must have at least 1 event
-	if (getLength(events) < 1) {
+	int numEvents = getLength(events);
+	if (numEvents < 1) {
 		errorMsg("\t\tEvent List is empty\n");
 		return INV_CAL;
 	}
 
+	if (numEvents >= PARALLEL_VALIDATE_MIN) {
+		long numThreads = sysconf(_SC_NPROCESSORS_ONLN);
+		numThreads = (numThreads > MAX_VALIDATE_THREADS) ? MAX_VALIDATE_THREADS : numThreads;
+
+		if (numThreads > 1) {
+			return validateEventsParallel(events, numEvents, (int)numThreads);
+		}
+	}
+
 	Event *ev;
 	ICalErrorCode err, highestPriority;
 	highestPriority = OK;
 	ListIterator iter = createIterator(events);
 
 	while ((ev = (Event *)nextElement(&iter)) != NULL) {
-		// check for NULL event members
-		if (ev->properties == NULL || ev->alarms == NULL || ev->UID == NULL) {
-			errorMsg("\t\tfound NULL event member: properties:%p, alarms:%p, UID:%p\n", \
-			         (void *)(ev->properties), (void *)(ev->alarms), (void *)(ev->UID));
-			return INV_EVENT;
-		}
-
-		// UID can't be empty
-		if ((ev->UID)[0] == '\0') {
-			errorMsg("\t\tUID empty string\n");
-			return INV_EVENT;
-		}
-
-		// UID can't be longer than 1000 characters (including '\0')
-		bool terminator = false;
-		for (int i = 0; i <= 999; i++) {
-			if ((ev->UID)[i] == '\0') {
-				terminator = true;
-				break;
-			}
-		}
-		if (!terminator) {
-			errorMsg("\t\tUID had no '\\0' within the first 1000 characters\n");
-			return INV_EVENT;
-		}
-
-		// validate creation and start DateTimes
-		if ((err = validateDateTime(ev->creationDateTime)) != OK) {
-			errorMsg("\t\tCreation DateTime invalid\n");
-			if (err == INV_DT) {
-				return INV_EVENT;
-			}
-			highestPriority = higherPriority(highestPriority, err);
-		}
-		if ((err = validateDateTime(ev->startDateTime)) != OK) {
-			errorMsg("\t\tStart DateTime invalid\n");
-			if (err == INV_DT) {
-				return INV_EVENT;
-			}
-			highestPriority = higherPriority(highestPriority, err);
-		}
-
-		// validate event properties
-		if ((err = validatePropertiesEv(ev->properties)) != OK) {
-			errorMsg("\t\tProperties List encountered error\n");
-			highestPriority = higherPriority(highestPriority, err);
-		}
-
-		// validate event alarms
-		if ((err = validateAlarms(ev->alarms)) != OK) {
-			errorMsg("\t\tAlarms List encountered error\n");
+		if ((err = validateEvent(ev)) != OK) {
 			highestPriority = higherPriority(highestPriority, err);
 		}
 
@@ -434,79 +758,93 @@ ICalErrorCode validateAlarms(List *alarms) {
 	return highestPriority;
 }
 
-/* Validates a list of properties to determine whether each property conforms to the iCalendar
- * specification with respect to the valid properties of the Calendar itself.
- * Returns the highest priority error, or OK if every property in the list conforms to the specification.
- *
- * For the purposes of this assignment, propDescr is valid as long as it is not NULL or empty.
- * Therefore, the only things that must be validated are whether the propName is valid for the
- * current scope, and occurs a valid number of times (i.e. VERSION occurs exactly once, etc.)
- *
- * Highest priority error for this function: INV_CAL (Priority lvl 5/5)
+// Returns the index of 'name' in the sorted list 'names', ignoring case, or -1 if it isn't in the list
+static int findPropName(const char *name, const char **names, int numNames) {
+	int low = 0, high = numNames - 1;
+
+	while (low <= high) {
+		int mid = (low + high) / 2;
+		int cmp = strcasecmp(name, names[mid]);
+
+		if (cmp == 0) {
+			return mid;
+		} else if (cmp < 0) {
+			high = mid - 1;
+		} else {
+			low = mid + 1;
+		}
+	}
+
+	return -1;
+}
+
+/* Validates a list of properties against the rules of the component it belongs to, in one pass.
+ * Each property's name is looked up in the component's list of names, and its bit is set in a
+ * 'seen' mask (or in a 'repeated' mask if it was already seen). All the occurrence rules are then
+ * checked at once with bitwise operations on those two masks.
+ * Returns OK, OTHER_ERROR if 'properties' is NULL, or the component's error if any rule is broken.
  */
-ICalErrorCode validatePropertiesCal(List *properties) {
+ICalErrorCode validateProperties(List *properties, const ComponentRules *rules) {
 	if (properties == NULL) {
 		return OTHER_ERROR;
 	}
 
-	bool calscale, method;
-	calscale = method = false;
+	uint64_t seen = 0, repeated = 0, broken, group;
 	Property *prop;
+	int index;
 	ListIterator iter = createIterator(properties);
 
-	debugMsg("\t-----START validatePropertiesCal()-----\n");
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		// validate that property description is not empty
+		if ((prop->propDescr)[0] == '\0') {
+			errorMsg("\t\tProperty description is empty: \"%s\"\n", prop->propName);
+			return rules->error;
+		}
 
-	// TODO maybe make an array of bool's, and just check if the index is true or false instead
-	// of using big switch statements with if/else's
+		if ((index = findPropName(prop->propName, rules->names, rules->numNames)) == -1) {
+			errorMsg("\t\tfound non-valid propName: \"%s\"\n", prop->propName);
+			return rules->error;
+		}
 
-	while ((prop = (Property *)nextElement(&iter)) != NULL) {
-		char *printProp = printProperty(prop);
-		notifyMsg("\t\t\"%s\"\n", printProp);
-		free(printProp);
+		repeated |= seen & PROPBIT(index);
+		seen |= PROPBIT(index);
+	}
 
-		// validate that property description is not empty
-		if (prop->propDescr == NULL || (prop->propDescr)[0] == '\0') {
-			errorMsg("\t\tProperty description is NULL or empty\n");
-			return INV_CAL;
-		}
-
-		switch (equalsOneOfStr(prop->propName, NUM_CALPROPNAMES, calPropNames)) {
-			case -1:
-				// the property name did not match any valid Calendar property names
-				errorMsg("\t\tfound non-valid propName: \"%s\"\n", prop->propName);
-				return INV_CAL;
-
-			case 0:
-				debugMsg("\t\tValidate CALSCALE\n");
-				if (calscale) {
-					errorMsg("\t\tDuplicate CALSCALE\n");
-					return INV_CAL;
-				}
-				calscale = true;
-				break;
+	broken = (repeated & rules->once) | (seen & rules->forbidden) | (rules->required & ~seen);
 
-			case 1:
-				debugMsg("\t\tValidate METHOD\n");
-				if (method) {
-					errorMsg("\t\tDuplicate METHOD\n");
-					return INV_CAL;
-				}
-				method = true;
-				break;
+	for (int i = 0; i < MAX_PROPGROUPS; i++) {
+		// more than one bit of an exclusive group is set if clearing the lowest one leaves any behind
+		group = seen & rules->exclusive[i];
+		broken |= group & (group - 1);
 
-			case 2:
-			case 3:
-				// This should never happen for a valid calendar: Calendar structs have a unique
-				// variable to store the PRODID and it should never be in the property list.
-				errorMsg("\t\tFound a PRODID or VERSION property inside the Property List\n");
-				return INV_CAL;
-		}
+		// a together group is broken if some, but not all, of its bits are set
+		group = seen & rules->together[i];
+		broken |= (group != 0) ? group ^ rules->together[i] : 0;
+	}
+
+	if (broken != 0) {
+		errorMsg("\t\tproperty \"%s\" is missing, repeated, or not allowed with the others\n", \
+		         rules->names[__builtin_ctzll(broken)]);
+		return rules->error;
 	}
 
-	successMsg("\t\t-----END validatePropertiesCal()-----\n");
 	return OK;
 }
 
+/* Validates a list of properties to determine whether each property conforms to the iCalendar
+ * specification with respect to the valid properties of the Calendar itself.
+ * Returns the highest priority error, or OK if every property in the list conforms to the specification.
+ *
+ * For the purposes of this assignment, propDescr is valid as long as it is not NULL or empty.
+ * Therefore, the only things that must be validated are whether the propName is valid for the
+ * current scope, and occurs a valid number of times (i.e. VERSION occurs exactly once, etc.)
+ *
+ * Highest priority error for this function: INV_CAL (Priority lvl 5/5)
+ */
+ICalErrorCode validatePropertiesCal(List *properties) {
+	return validateProperties(properties, &calRules);
+}
+
 /* Validates a list of properties to determine whether each property conforms to the iCalendar
  * specification with respect to the valid properties of an Event.
  * Returns the highest priority error, or OK if every property in the list conforms to the specification.
@@ -518,253 +856,7 @@ ICalErrorCode validatePropertiesCal(List *properties) {
  * Highest priority error for this function: INV_EVENT (Priority lvl 4/5)
  */
 ICalErrorCode validatePropertiesEv(List *properties) {
-	if (properties == NULL) {
-		return OTHER_ERROR;
-	}
-
-	// TODO maybe make an array of bool's, and just check if the index is true or false instead
-	// of using big switch statements with if/else's
-
-	debugMsg("\t\t----START validatePropertiesEv()-----\n");
-	// The following properties MUST NOT occur more than once:
-	bool class, created, description, geo, last_mod, location, organizer, \
-	     priority, seq, status, summary, transp, url, recurid;
-	class = created = description = geo = last_mod = location = organizer = priority = seq = status = \
-		summary = transp = url = recurid = false;
-
-	// The 'duration' property and 'dtend' property can't show up together in the same event
-	bool dtend, duration;
-	dtend = duration = false;
-
-	Property *prop;
-	ListIterator iter = createIterator(properties);
-	while ((prop = (Property *)nextElement(&iter)) != NULL) {
-		char *printProp = printProperty(prop);
-		notifyMsg("\t\t\t\"%s\"\n", printProp);
-		free(printProp);
-
-		// validate that property description is not empty
-		if (prop->propDescr == NULL || (prop->propDescr)[0] == '\0') {
-			errorMsg("\t\t\tProperty description is NULL or empty\n");
-			return INV_EVENT;
-		}
-
-		switch (equalsOneOfStr(prop->propName, NUM_EVENTPROPNAMES, eventPropNames)) {
-			case -1:
-				// the property name did not match any valid Event property names
-				errorMsg("\t\t\tfound non-valid propName: \"%s\"\n", prop->propName);
-				return INV_EVENT;
-
-			case 0:
-				debugMsg("\t\t\tATTACH\n");
-				break;
-
-			case 1:
-				debugMsg("\t\t\tATTENDEE\n");
-				break;
-
-			case 2:
-				debugMsg("\t\t\tCATEGORIES\n");
-				break;
-
-			case 3:
-				debugMsg("\t\t\tCLASS\n");
-				if (class) {
-					errorMsg("\t\t\tDuplicate CLASS\n");
-					return INV_EVENT;
-				}
-				class = true;
-				break;
-
-			case 4:
-				debugMsg("\t\t\tCOMMENT\n");
-				break;
-
-			case 5:
-				debugMsg("\t\t\tCONTACT\n");
-				break;
-
-			case 6:
-				debugMsg("\t\t\tCREATED\n");
-				if (created) {
-					errorMsg("\t\t\tDuplicate CREATED\n");
-					return INV_EVENT;
-				}
-				created = true;
-				break;
-
-			case 7:
-				debugMsg("\t\t\tDESCRIPTION\n");
-				if (description) {
-					errorMsg("\t\t\tDuplicate DESCRIPTION\n");
-					return INV_EVENT;
-				}
-				description = true;
-				break;
-
-			case 8:
-				debugMsg("\t\t\tDTEND\n");
-				if (dtend || duration) {
-					errorMsg("\t\t\tDuplicate DTEND, or DURATION is present\n");
-					return INV_EVENT;
-				}
-				dtend = true;
-				break;
-
-			case 9:
-				// This property is already accounted for in the Event structure definition.
-				// If it showss up in the property List, then something has gone wrong
-				// in createCalendar() as this error should have been caught there.
-				errorMsg("\t\t\tDTSTAMP found in property List\n");
-				return INV_EVENT;
-
-			case 10:
-				// This property is already accounted for in the Event structure definition.
-				// If it shows up in the property List, then something has gone wrong
-				// in createCalendar() as this error should have been caught there.
-				errorMsg("\t\t\tDTSTART found in property List\n");
-				return INV_EVENT;
-
-			case 11:
-				debugMsg("\t\t\tDURATION\n");
-				if (dtend || duration) {
-					errorMsg("\t\t\tDuplicate DURATION, or DTEND is present\n");
-					return INV_EVENT;
-				}
-				duration = true;
-				break;
-
-			case 12:
-				debugMsg("\t\t\tEXDATE\n");
-				break;
-
-			case 13:
-				debugMsg("\t\t\tGEO\n");
-				if (geo) {
-					errorMsg("\t\t\tDuplicate GEO\n");
-					return INV_EVENT;
-				}
-				geo = true;
-				break;
-
-			case 14:
-				debugMsg("\t\t\tLAST-MODIFIED\n");
-				if (last_mod) {
-					errorMsg("\t\t\tDuplicate LAST-MODIFIED\n");
-					return INV_EVENT;
-				}
-				last_mod = true;
-				break;
-
-			case 15:
-				debugMsg("\t\t\tLOCATION\n");
-				if (location){
-					errorMsg("\t\t\tDuplicate LOCATION\n");
-					return INV_EVENT;
-				}
-				location = true;
-				break;
-
-			case 16:
-				debugMsg("\t\t\tORGANIZER\n");
-				if (organizer) {
-					errorMsg("\t\t\tDuplicate ORGANIZER\n");
-					return INV_EVENT;
-				}
-				organizer = true;
-				break;
-
-			case 17:
-				debugMsg("\t\t\tPRIORITY\n");
-				if (priority) {
-					errorMsg("\t\t\tDuplicate PRIORITY\n");
-					return INV_EVENT;
-				}
-				priority = true;
-				break;
-
-			case 18:
-				debugMsg("\t\t\tRDATE\n");
-				break;
-
-			case 19:
-				debugMsg("\t\t\tRECURRENCE-ID\n");
-				if (recurid) {
-					errorMsg("\t\t\tDuplicate RECURRENCE-ID\n");
-					return INV_EVENT;
-				}
-				recurid = true;
-				break;
-
-			case 20:
-				debugMsg("\t\t\tRELATED-TO\n");
-				break;
-
-			case 21:
-				debugMsg("\t\t\tRESOURCES\n");
-				break;
-
-			case 22:
-				debugMsg("\t\t\tRRULE\n");
-				break;
-
-			case 23:
-				debugMsg("\t\t\tSEQUENCE\n");
-				if (seq) {
-					errorMsg("\t\t\tDuplicate SEQUENCE\n");
-					return INV_EVENT;
-				}
-				seq = true;
-				break;
-
-			case 24:
-				debugMsg("\t\t\tSTATUS\n");
-				if (status) {
-					errorMsg("\t\t\tDuplicate STATUS\n");
-					return INV_EVENT;
-				}
-				status = true;
-				break;
-
-			case 25:
-				debugMsg("\t\t\tSUMMARY\n");
-				if (summary) {
-					errorMsg("\t\t\tDuplicate SUMMARY\n");
-					return INV_EVENT;
-				}
-				summary = true;
-				break;
-
-			case 26:
-				debugMsg("\t\t\tTRANSP\n");
-				if (transp) {
-					errorMsg("\t\t\tDuplicate TRANSP\n");
-					return INV_EVENT;
-				}
-				transp = true;
-				break;
-
-			case 27:
-				debugMsg("\t\t\tUID\n");
-				// This property is already accounted for in the Event structure definition.
-				// If it showss up in the property List, then something has gone wrong
-				// in createCalendar() as this error should have been caught there.
-				errorMsg("\t\t\tUID found in property List\n");
-				return INV_EVENT;
-
-			case 28:
-				debugMsg("\t\t\tURL\n");
-				if (url) {
-					errorMsg("\t\t\tDuplicate URL\n");
-					return INV_EVENT;
-				}
-				url = true;
-				break;
-		}
-	}
-
-	notifyMsg("\t\t\t-----END validatePropertiesEv()-----\n");
-	return OK;
+	return validateProperties(properties, &eventRules);
 }
 
 /* Validates a list of properties to determine whether each property conforms to the iCalendar
@@ -778,92 +870,7 @@ ICalErrorCode validatePropertiesEv(List *properties) {
  * Highest priority error for this function: INV_ALARM (Priority lvl 3/5)
  */
 ICalErrorCode validatePropertiesAl(List *properties) {
-	if (properties == NULL) {
-		return OTHER_ERROR;
-	}
-
-	// TODO maybe make an array of bool's, and just check if the index is true or false instead
-	// of using big switch statements with if/else's
-
-	debugMsg("\t\t\t-----START validtePropertiesAl()-----\n");
-	// The following are required as long as at least one of them is present
-	// (i.e. they are optional, but if one is present than the other must be present as well)
-	bool duration, repeat;
-	duration = repeat = false;
-
-	// Misc. that can't be declared more than once
-	bool attach = false;
-
-	Property *prop;
-	ListIterator iter = createIterator(properties);
-	while ((prop = (Property *)nextElement(&iter)) != NULL) {
-		char *printProp = printProperty(prop);
-		notifyMsg("\t\t\t\t\"%s\"\n", printProp);
-		free(printProp);
-
-		// validate that property description is not empty
-		if (prop->propDescr == NULL || (prop->propDescr)[0] == '\0') {
-			errorMsg("\t\t\t\tProperty description is NULL or empty\n");
-			return INV_ALARM;
-		}
-
-		switch (equalsOneOfStr(prop->propName, NUM_ALARMPROPNAMES, alarmPropNames)) {
-			case -1:
-				errorMsg("\t\t\t\tfound non-valid propName: \"%s\"\n", prop->propName);
-				return INV_ALARM;
-
-			case 0:
-				// This property is already accounted for in the Alarm structure definition.
-				// If it showss up in the property List, then something has gone wrong
-				// in createCalendar() as this error should have been caught there.
-				errorMsg("\t\t\t\tan extra ACTION wiggled through createCalendar()\n");
-				return INV_ALARM;
-
-			case 1:
-				debugMsg("\t\t\t\tValidate ATTACH\n");
-				if (attach) {
-					errorMsg("\t\t\t\tduplicate ATTACH\n");
-					return INV_ALARM;
-				}
-				attach = true;
-				break;
-
-			case 2:
-				debugMsg("\t\t\t\tValidate DURATION\n");
-				if (duration) {
-					errorMsg("\t\t\t\tduplicate DURATION property found\n");
-					return INV_ALARM;
-				}
-				duration = true;
-				break;
-
-			case 3:
-				debugMsg("\t\t\t\tValidate REPEAT\n");
-				if (repeat) {
-					errorMsg("\t\t\t\tduplicate REPEAT property found\n");
-					return INV_ALARM;
-				}
-				repeat = true;
-				break;
-
-			case 4:
-				// This property is already accounted for in the Alarm structure definition.
-				// If it showss up in the property List, then something has gone wrong
-				// in createCalendar() as this error should have been caught there.
-				debugMsg("\t\t\t\tValidate TRIGGER\n");
-				return INV_ALARM;
-		}
-	}
-
-	// duration and repeat properties must either be both present, or neither are present
-	if (duration != repeat) {
-		errorMsg("\t\t\t\tduration != repeat (%d and %d respectively)\n", \
-			   duration, repeat);
-		return INV_ALARM;
-	}
-
-	notifyMsg("\t\t\t\t-----END validatePropertiesAl()-----\n");
-	return OK;
+	return validateProperties(properties, &alarmRules);
 }
 
 /* Validates a single DateTime to determine whether it conforms to the iCalendar
@@ -929,3 +936,56 @@ bool propNamesEqual(const void *first, const void *second) {
 	return strcmp(p1->propName, p2->propName) == 0;
 }
 
+
+// Returns a newly allocated copy of 'str' that can be written between the quotes of a JSON string:
+// quotes and backslashes are escaped, and control characters are written as \n, \r, \t or \u00XX.
+// Returns NULL if memory could not be allocated.
+char *escapeJSON(const char *str) {
+	size_t length = 0;
+
+	for (const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++) {
+		if (*c == '"' || *c == '\\' || *c == '\n' || *c == '\r' || *c == '\t') {
+			length += 2;
+		} else if (*c < 0x20) {
+			length += 6;
+		} else {
+			length++;
+		}
+	}
+
+	char *toReturn = malloc(length + 1), *dest = toReturn;
+	if (toReturn == NULL) {
+		return NULL;
+	}
+
+	for (const unsigned char *c = (const unsigned char *)str; *c != '\0'; c++) {
+		switch (*c) {
+			case '"':
+			case '\\':
+				*dest++ = '\\';
+				*dest++ = *c;
+				break;
+			case '\n':
+				*dest++ = '\\';
+				*dest++ = 'n';
+				break;
+			case '\r':
+				*dest++ = '\\';
+				*dest++ = 'r';
+				break;
+			case '\t':
+				*dest++ = '\\';
+				*dest++ = 't';
+				break;
+			default:
+				if (*c < 0x20) {
+					dest += sprintf(dest, "\\u%04x", *c);
+				} else {
+					*dest++ = *c;
+				}
+		}
+	}
+	*dest = '\0';
+
+	return toReturn;
+}
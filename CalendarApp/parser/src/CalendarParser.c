@@ -7,76 +7,48 @@
  *  CalendarParser.c                *
  ************************************/
 
+#define _GNU_SOURCE
+
+#include "AtomicFile.h"
 #include "CalendarParser.h"
 #include "CalendarHelper.h"
 #include "LinkedListAPI.h"
 #include "Parsing.h"
 #include "Initialize.h"
+#include "Random.h"
 
-/** Function to create a Calendar object based on the contents of an iCalendar file.
- *@pre File name cannot be an empty string or NULL.  File name must have the .ics extension.
-       File represented by this name must exist and must be readable.
- *@post Either:
-        A valid calendar has been created, its address was stored in the variable obj, and OK was returned
-		or
-		An error occurred, the calendar was not created, all temporary memory was freed, obj was set to NULL, and the
-		appropriate error code was returned
- *@return the error code indicating success or the error encountered when parsing the calendar
- *@param fileName - a string containing the name of the iCalendar file
- *@param a double pointer to a Calendar struct that needs to be allocated
-**/
-ICalErrorCode createCalendar(char* fileName, Calendar** obj) {
-    FILE *fin;
+static ICalErrorCode validateCalendarFields(const Calendar* obj, ICalErrorCode eventsError);
+
+/* Does the work of createCalendar(), createCalendarValidated() and createCalendarFromBuffer() on an open
+ * stream, which is closed before it returns. If 'validation' isn't NULL, each Event is validated as soon as
+ * it has been parsed, and the highest priority error is stored in it. Lines are read into *buffer (see readFold()).
+ */
+static ICalErrorCode parseCalendarLines(FILE *fin, Calendar** obj, ICalErrorCode *validation, char **buffer, size_t *bufferSize) {
     ICalErrorCode error;
     bool version, prodID, method, beginCal, endCal, foundEvent;
-    char *parse, *name, *descr;
+    char *parse, *name, *descr, *savePtr;
 	char delim[] = ";:";
     version = prodID = method = beginCal = endCal = foundEvent = false;
 
 	debugMsg("-----START createCalendar()-----\n");
 
-    // Prof said not to check for obj being NULL, but you can't dereference a NULL pointer,
-    // so I think he meant "don't worry if *obj = NULL, since it is being overwritten", and in
-    // order to dereference it then the double pointer passed into the function can't be NULL.
-    if (obj == NULL) {
-		errorMsg("\tprovided obj is NULL\n");
-        return OTHER_ERROR;
-    }
-
-    // filename can't be null or an empty string, and must end with the '.ics' extension
-    if (fileName == NULL || strcmp(fileName, "") == 0 || !endsWith(fileName, ".ics")) {
-		errorMsg("\tInvalid fileName. fileName = \"%s\"\n", fileName);
-        *obj = NULL;
-		notifyMsg("\tRETURNING INV_FILE\n");
-        return INV_FILE;
-    }
-
-    fin = fopen(fileName, "r");
-
-    // Check that file was found/opened correctly
-    if (fin == NULL) {
-		errorMsg("\tFile could not be found/opened properly\n");
-        // On a failure, the obj argument is set to NULL and an error code is returned
-        *obj = NULL;
-		notifyMsg("\tRETURNING INV_FILE\n");
-        return INV_FILE;
-    }
-
     // allocate memory for the Calendar and all its components
     if ((error = initializeCalendar(obj)) != OK) {
 		errorMsg("\tCould not initializeCalendar() for some reason\n");
+        fclose(fin);
         return error;
     }
 
-    char line[10000];
+    char *line;
     while (!feof(fin)) {
-        // readFold returns NULL when the raw line does not end with a \r\n sequence
+        // readFold returns INV_FILE when the raw line does not end with a \r\n sequence
         // (i.e. the file has invalid line endings)
-        if ((error = readFold(line, 10000, fin)) != OK) {
+        if ((error = readFold(buffer, bufferSize, fin)) != OK) {
 			errorMsg("\treadFold() failed for some reason\n");
             cleanup(obj, NULL, fin);
             return error;
         }
+        line = *buffer;
 
 		debugMsg("\tLine read : \"%s\"\n", line);
 
@@ -110,13 +82,13 @@ ICalErrorCode createCalendar(char* fileName, Calendar** obj) {
         }
 
 		// split the string into the property name and property description
-		if ((name = strtok(parse, delim)) == NULL) {
+		if ((name = strtok_r(parse, delim, &savePtr)) == NULL) {
 			// The line is only delimiters, which obviously is not allowed
 			debugMsg("\tLine contained only delimiters\n");
 			cleanup(obj, parse, fin);
 			return INV_CAL;
 		}
-		if ((descr = strtok(NULL, delim)) == NULL) {
+		if ((descr = strtok_r(NULL, delim, &savePtr)) == NULL) {
 			// The line has no property description, or doesn't contain any delimiters
 			debugMsg("\tLine contains no property description\n");
 			cleanup(obj, parse, fin);
@@ -174,6 +146,11 @@ ICalErrorCode createCalendar(char* fileName, Calendar** obj) {
 
             // +7 to only copy characters past 'PRODID:' part of the string
             //debugMsg("found PRODID line: \"%s\"\n", line);
+            if (strlen(line + 7) >= sizeof((*obj)->prodID)) {
+				errorMsg("\tPRODID too long\n");
+                cleanup(obj, parse, fin);
+                return INV_PRODID;
+            }
             strcpy((*obj)->prodID, line + 7);
             //debugMsg("set product ID to\"%s\"\n", (*obj)->prodID);
             prodID = true;
@@ -219,6 +196,13 @@ ICalErrorCode createCalendar(char* fileName, Calendar** obj) {
             }
             foundEvent = true;
 
+            // Validating the Event now, while it is still in the cache, saves validateCalendar()
+            // from walking over every Event again (INV_EVENT is as bad as an Event can get, so
+            // once it has been found the rest don't need to be checked)
+            if (validation != NULL && *validation != INV_EVENT && (error = validateEvent(event)) != OK) {
+                *validation = higherPriority(*validation, error);
+            }
+
             insertBack((*obj)->events, (void *)event);
         } else if (strcmp(name, "BEGIN") == 0 && strcmp(descr, "VALARM") == 0) {
             // there can't be an alarm for an entire calendar
@@ -272,6 +256,144 @@ ICalErrorCode createCalendar(char* fileName, Calendar** obj) {
     return OK;
 }
 
+/* Parses the Calendar in 'fin' with parseCalendarLines(), giving it a line buffer that grows to fit the
+ * longest (unfolded) line in the file. */
+static ICalErrorCode parseCalendarStream(FILE *fin, Calendar** obj, ICalErrorCode *validation) {
+    char *buffer = NULL;
+    size_t bufferSize = 0;
+
+    ICalErrorCode error = parseCalendarLines(fin, obj, validation, &buffer, &bufferSize);
+    free(buffer);
+
+    return error;
+}
+
+/* Opens the file for parseCalendarStream(), after checking its name. */
+static ICalErrorCode parseCalendar(char* fileName, Calendar** obj, ICalErrorCode *validation) {
+    FILE *fin;
+
+    // Prof said not to check for obj being NULL, but you can't dereference a NULL pointer,
+    // so I think he meant "don't worry if *obj = NULL, since it is being overwritten", and in
+    // order to dereference it then the double pointer passed into the function can't be NULL.
+    if (obj == NULL) {
+		errorMsg("\tprovided obj is NULL\n");
+        return OTHER_ERROR;
+    }
+
+    // filename can't be null or an empty string, and must end with the '.ics' extension
+    if (fileName == NULL || strcmp(fileName, "") == 0 || !endsWith(fileName, ".ics")) {
+		errorMsg("\tInvalid fileName. fileName = \"%s\"\n", fileName);
+        *obj = NULL;
+		notifyMsg("\tRETURNING INV_FILE\n");
+        return INV_FILE;
+    }
+
+    fin = fopen(fileName, "r");
+
+    // Check that file was found/opened correctly
+    if (fin == NULL) {
+		errorMsg("\tFile could not be found/opened properly\n");
+        // On a failure, the obj argument is set to NULL and an error code is returned
+        *obj = NULL;
+		notifyMsg("\tRETURNING INV_FILE\n");
+        return INV_FILE;
+    }
+
+    return parseCalendarStream(fin, obj, validation);
+}
+
+
+/** Function to create a Calendar object based on the contents of an iCalendar file.
+ *@pre File name cannot be an empty string or NULL.  File name must have the .ics extension.
+       File represented by this name must exist and must be readable.
+ *@post Either:
+        A valid calendar has been created, its address was stored in the variable obj, and OK was returned
+		or
+		An error occurred, the calendar was not created, all temporary memory was freed, obj was set to NULL, and the
+		appropriate error code was returned
+ *@return the error code indicating success or the error encountered when parsing the calendar
+ *@param fileName - a string containing the name of the iCalendar file
+ *@param a double pointer to a Calendar struct that needs to be allocated
+**/
+ICalErrorCode createCalendar(char* fileName, Calendar** obj) {
+    return parseCalendar(fileName, obj, NULL);
+}
+
+
+/** Function to create a Calendar object based on the contents of an iCalendar file, and validate it
+    in the same pass. Gives the same result as createCalendar() followed by validateCalendar(), but
+    each Event is validated as soon as it is parsed instead of in a second pass over the Calendar.
+ *@pre Same as createCalendar()
+ *@post Either:
+        A valid calendar has been created, its address was stored in the variable obj, and OK was returned
+		or 
+		The file could not be parsed, or the calendar is not valid. It was not created, all temporary memory
+		was freed, obj was set to NULL, and the appropriate error code was returned
+ *@return the error code indicating success or the error encountered when parsing or validating the calendar
+ *@param fileName - a string containing the name of the iCalendar file
+ *@param a double pointer to a Calendar struct that needs to be allocated
+**/
+ICalErrorCode createCalendarValidated(char* fileName, Calendar** obj) {
+    ICalErrorCode error, eventsError;
+    eventsError = OK;
+
+    if ((error = parseCalendar(fileName, obj, &eventsError)) != OK) {
+        return error;
+    }
+
+    if ((error = validateCalendarFields(*obj, eventsError)) != OK) {
+        deleteCalendar(*obj);
+        *obj = NULL;
+    }
+
+    return error;
+}
+
+
+/** Function to create a Calendar object from the contents of an iCalendar file that are already in memory.
+    The data is read where it is, without being copied.
+ *@pre 'data' points to 'length' bytes, which are not changed while the function runs
+ *@post Same as createCalendarValidated() if 'validate' is true, or createCalendar() if it is false
+ *@return the error code indicating success or the error encountered when parsing (or validating) the calendar
+ *@param data - the contents of an iCalendar file
+ *@param length - the number of bytes in 'data'
+ *@param validate - whether to validate the calendar as it is parsed
+ *@param a double pointer to a Calendar struct that needs to be allocated
+**/
+ICalErrorCode createCalendarFromBuffer(const char *data, size_t length, bool validate, Calendar** obj) {
+    ICalErrorCode error, eventsError;
+    FILE *fin;
+    eventsError = OK;
+
+    if (obj == NULL) {
+		errorMsg("\tprovided obj is NULL\n");
+        return OTHER_ERROR;
+    }
+    *obj = NULL;
+
+    // An empty file isn't a calendar (and fmemopen() won't open an empty buffer)
+    if (data == NULL || length == 0) {
+        return INV_CAL;
+    }
+
+    // The stream reads 'data' in place. It is only ever read from, so casting away the const is safe.
+    if ((fin = fmemopen((void *)data, length, "r")) == NULL) {
+		errorMsg("\tCould not open a stream on the buffer\n");
+        return OTHER_ERROR;
+    }
+
+    if ((error = parseCalendarStream(fin, obj, validate ? &eventsError : NULL)) != OK) {
+        return error;
+    }
+
+    if (validate && (error = validateCalendarFields(*obj, eventsError)) != OK) {
+        deleteCalendar(*obj);
+        *obj = NULL;
+    }
+
+    return error;
+}
+
 
 /** Function to delete all calendar content and free all the memory.
  *@pre Calendar object exists, is not null, and has not been freed
@@ -404,7 +526,7 @@ char* printError(ICalErrorCode err) {
  *@param obj - a pointer to a Calendar struct
  **/
 ICalErrorCode writeCalendar(char* fileName, const Calendar* obj) {
-    FILE *fout;
+    AtomicFile file;
 
 	debugMsg("-----START writeCalendar()-----\n");
 
@@ -420,32 +542,47 @@ ICalErrorCode writeCalendar(char* fileName, const Calendar* obj) {
     }
 
 	debugMsg("\tfileName = \"%s\"\n", fileName);
-    
-    if ((fout = fopen(fileName, "w")) == NULL) {
+
+    // The calendar is written to a temporary file which then replaces 'fileName' in one step,
+    // so a failure partway through never leaves a half-written calendar behind
+    if (openAtomic(&file, fileName) != OK) {
 		errorMsg("\tfile \"%s\" could not be opened for writing for some reason.\n", fileName);
         return WRITE_ERROR;
     }
 
-    ICalErrorCode err;
-    fprintf(fout, "BEGIN:VCALENDAR\r\n");
-    fprintf(fout, "PRODID:%s\r\n", obj->prodID);
-    fprintf(fout, "VERSION:%.1f\r\n", obj->version);
+    // Every line of the calendar is gathered into the batch, which is written out with
+    // a handful of writev() calls instead of one fprintf() per line
+    IOBatch batch;
+    initializeBatch(&batch, file.fd);
+
+    batchAppendLit(&batch, "BEGIN:VCALENDAR\r\n");
+    batchAppendLine(&batch, "PRODID", 6, ":", obj->prodID, strlen(obj->prodID));
+    batchPrintf(&batch, "VERSION:%.1f\r\n", obj->version);
 
 	debugMsg("\tWrote BEGIN:VCALENDAR, prodID, and version\n");
     
-	if ((err = writeProperties(fout, obj->properties)) != OK) {
+	if (writeProperties(&batch, obj->properties) != OK) {
 		errorMsg("\twriteProperties() failed somehow\n");
-		fclose(fout);
+		abortAtomic(&file);
         return WRITE_ERROR;
     }
-    if ((err = writeEvents(fout, obj->events)) != OK) {
+    if (writeEvents(&batch, obj->events) != OK) {
 		errorMsg("\twriteEvents() failed somehow\n");
-		fclose(fout);
+		abortAtomic(&file);
         return WRITE_ERROR;
     }
-    fprintf(fout, "END:VCALENDAR\r\n");
+    batchAppendLit(&batch, "END:VCALENDAR\r\n");
 
-	fclose(fout);
+    if (flushBatch(&batch) != OK) {
+		errorMsg("\tCould not flush the write batch\n");
+		abortAtomic(&file);
+        return WRITE_ERROR;
+    }
+
+	if (commitAtomic(&file) != OK) {
+		errorMsg("\tCould not replace \"%s\" with the new calendar\n", fileName);
+		return WRITE_ERROR;
+	}
 
 	debugMsg("\tWrote END:VCALENDAR\n");
 	debugMsg("\t-----END writeCalendar()-----\n");
@@ -474,6 +611,15 @@ ICalErrorCode validateCalendar(const Calendar* obj) {
 		return INV_CAL;
 	}
 
+	return validateCalendarFields(obj, validateEvents(obj->events));
+}
+
+
+/* Validates everything in a Calendar except for its Events, whose highest priority error has
+ * already been found and is passed in as 'eventsError'. Returns the same error code as
+ * validateCalendar().
+ */
+static ICalErrorCode validateCalendarFields(const Calendar* obj, ICalErrorCode eventsError) {
 	// verify the version
 	if (obj->version <= 0.0) {
 		errorMsg("\tInvalid version: %f\n", obj->version);
@@ -512,7 +658,7 @@ ICalErrorCode validateCalendar(const Calendar* obj) {
 	highestPriority = OK;
 
 	// verify events
-	if ((err = validateEvents(obj->events)) != OK) {
+	if ((err = eventsError) != OK) {
 		printErr = printError(err);
 		debugMsg("\tvalidateEvents() returned an error: %s\n", printErr);
 		free(printErr);
@@ -577,10 +723,14 @@ char *propertyToJSON(const Property *prop) {
 	debugMsg("\tPassed Property: \"%s\"\n", temp);
 	free(temp);
 
-	int size = 300 + strlen(prop->propDescr);
+	char *name = escapeJSON(prop->propName);
+	char *descr = escapeJSON(prop->propDescr);
+
+	int size = 40 + strlen(name) + strlen(descr);
 	toReturn = malloc(size);
-	written = snprintf(toReturn, size, "{\"propName\":\"%s\",\"propDescr\":\"%s\"}", \
-	                   prop->propName, prop->propDescr);
+	written = snprintf(toReturn, size, "{\"propName\":\"%s\",\"propDescr\":\"%s\"}", name, descr);
+	free(name);
+	free(descr);
 
 	notifyMsg("\tJSON created: \"%s\"\n", toReturn);
 
@@ -651,10 +801,16 @@ char *alarmToJSON(const Alarm *alarm) {
 	}
 
 	propListJ = propertyListToJSON(alarm->properties);
-	toReturn = malloc(20000);
-	written = snprintf(toReturn, 20000, "{\"action\":\"%s\",\"trigger\":\"%s\",\"numProps\":%d,\"properties\":%s}",\
-	                   alarm->action, alarm->trigger, getLength(alarm->properties)+2, propListJ);
+	char *action = escapeJSON(alarm->action);
+	char *trigger = escapeJSON(alarm->trigger);
+
+	int size = 100 + strlen(action) + strlen(trigger) + strlen(propListJ);
+	toReturn = malloc(size);
+	written = snprintf(toReturn, size, "{\"action\":\"%s\",\"trigger\":\"%s\",\"numProps\":%d,\"properties\":%s}",\
+	                   action, trigger, getLength(alarm->properties)+2, propListJ);
 	free(propListJ);
+	free(action);
+	free(trigger);
 
 	notifyMsg("\tJSON created: \"%s\"\n", toReturn);
 
@@ -745,24 +901,28 @@ char* eventToJSON(const Event* event) {
 		char *propListJ = propertyListToJSON(event->properties);
 		char *alarmListJ = alarmListToJSON(event->alarms);
 
-		// Allocate memory depending on whether a SUMMARY property needs to be written
+		// findElement returns NULL if the property could not be found in 'event',
+		// in which case an empty string is written instead of the summary properties description
+		char *uid = escapeJSON(event->UID);
+		char *summaryJ = escapeJSON((summary == NULL) ? "" : summary->propDescr);
+
 		int lenProps = strlen(propListJ);
 		int lenAlarms = strlen(alarmListJ);
-		int size = (summary == NULL) ? 600+lenProps+lenAlarms : strlen(summary->propDescr) + 600+lenProps+lenAlarms;
+		int size = 600 + strlen(uid) + strlen(summaryJ) + lenProps + lenAlarms;
 		toReturn = malloc(size);
 
 		// Write the JSON in toReturn
 		written = snprintf(toReturn, size, "{\"startDT\":%s,\"createDT\":%s,\"UID\":\"%s\",\"numProps\":%d,\"numAlarms\":%d,\"summary\":\"%s\",\"properties\":%s,\"alarms\":%s}", \
-		                   startDT, createDT, event->UID, getLength(event->properties)+3, getLength(event->alarms), \
-		                   // findElement returns NULL if the property could not be found in 'event',
-		                   // in which case an empty string is written instead of the summary properties description
-		                   (summary == NULL) ? "" : summary->propDescr, \
+		                   startDT, createDT, uid, getLength(event->properties)+3, getLength(event->alarms), summaryJ, \
 		                   propListJ, alarmListJ);
 
 		// NOTE: +3 is added to the length of the Event's proeprty list because
 		// the required UID and the 2 required DateTimes count as properties
 
 		free(startDT);
+		free(createDT);
+		free(uid);
+		free(summaryJ);
 		free(propListJ);
 		free(alarmListJ);
 	}
@@ -850,12 +1010,16 @@ char* calendarToJSON(const Calendar* cal) {
 	// Get Property and Event List JSONs
 	propListJ = propertyListToJSON(cal->properties);
 	eventListJ = eventListToJSON(cal->events);
-	int size = 2000 + strlen(propListJ) + strlen(eventListJ);
+	char *prodID = escapeJSON(cal->prodID);
+	int size = 200 + strlen(prodID) + strlen(propListJ) + strlen(eventListJ);
 
 	toReturn = malloc(size);
 	written = snprintf(toReturn, size, "{\"version\":%d,\"prodID\":\"%s\",\"numProps\":%d,\"numEvents\":%d,\"properties\":%s,\"events\":%s}", \
-	                   (int)cal->version, cal->prodID, getLength(cal->properties) + 2, getLength(cal->events), \
+	                   (int)cal->version, prodID, getLength(cal->properties) + 2, getLength(cal->events), \
 	                   propListJ, eventListJ);
+	free(prodID);
+	free(propListJ);
+	free(eventListJ);
 
 	notifyMsg("\tJSON created: \"%s\"\n", toReturn);
 	return realloc(toReturn, written + 1);
@@ -867,26 +1031,38 @@ char *errorCodeToJSON(ICalErrorCode err, char message[]) {
 	char *errorStr = printError(err);
 
 	int written = snprintf(toReturn, 500, "{\"error\":\"%s\",\"message\":\"%s\"}", errorStr, (message == NULL) ? "" : message);
+	free(errorStr);
 
 	return realloc(toReturn, written + 1);
 }
 
 // Identical to errorCodeToJSON(), except the additional field "filename":...
 // is contained in the JSON string as well. Only the part of the string after the
-// last '/' character is included in the "filename":... property.
+// last '/' character is included in the "filename":... property, which is "N/A"
+// if 'filepath' is NULL.
 char *ferrorCodeToJSON(ICalErrorCode err, const char filepath[], char message[]) {
-	char *toReturn = malloc(1000);
 	char *errorStr = printError(err);
 
-	char *justFileName = strrchr(filepath, '/');
-	if (justFileName == NULL) {
+	char *justFileName = (filepath == NULL) ? NULL : strrchr(filepath, '/');
+	if (filepath == NULL) {
+		justFileName = "N/A";
+	} else if (justFileName == NULL) {
 		// The filepath is literally just the filename
 		justFileName = (char *)filepath;
 	} else {
 		justFileName += 1;
 	}
 
-	int written = snprintf(toReturn, 1000, "{\"error\":\"%s\",\"filename\":\"%s\",\"message\":\"%s\"}", errorStr, justFileName, (message == NULL) ? errorStr : message);
+	char *fileName = escapeJSON(justFileName);
+	if (message == NULL) {
+		message = errorStr;
+	}
+
+	int size = 50 + strlen(errorStr) + strlen(fileName) + strlen(message);
+	char *toReturn = malloc(size);
+	int written = snprintf(toReturn, size, "{\"error\":\"%s\",\"filename\":\"%s\",\"message\":\"%s\"}", errorStr, fileName, message);
+	free(errorStr);
+	free(fileName);
 
 	return realloc(toReturn, written + 1);
 }
@@ -950,25 +1126,33 @@ Property *JSONtoProperty(const char *str) {
 
 	Property *toReturn;
 	char tempName[200];
-	char tempDescr[10000];
+	int descrStart = 0;
+
+	// Descriptions can be any length, so only the name is scanned, and the description is copied
+	// straight out of 'str' once its length is known
+	if (sscanf(str, "{\"propName\":\"%199[^\"]\",\"propDescr\":\"%n", tempName, &descrStart) < 1 || descrStart == 0) {
+		errorMsg("\tCould not correctly parse the JSON string, returning NULL\n");
+		return NULL;
+	}
 
-	// Since there could potentially be d-quotes (") in the propDescr, the string must end at
-	// the } that terminates the object string, and the last d-quote must be chopped off the
-	// description that is copied over.
-	if (sscanf(str, "{\"propName\":\"%199[^\"]\",\"propDescr\":\"%9999[^}]\"}", tempName, tempDescr) < 2) {
+	// Since there could potentially be d-quotes (") in the propDescr, the description must end at
+	// the } that terminates the object string, and the last d-quote must be chopped off of it
+	const char *descr = str + descrStart;
+	size_t descrLen = strcspn(descr, "}");
+	if (descrLen == 0) {
 		errorMsg("\tCould not correctly parse the JSON string, returning NULL\n");
 		return NULL;
 	}
-	int descrLen = strlen(tempDescr);
-	tempDescr[descrLen-1] = '\0'; // Chop the d-quote that carried through
+	descrLen--;
 
-	toReturn = malloc(sizeof(Property) + strlen(tempDescr) + 1);
+	toReturn = malloc(sizeof(Property) + descrLen + 1);
 	if (toReturn == NULL) {
 		errorMsg("\tSomething went wrong while allocating memory; returning NULL\n");
 		return NULL;
 	}
 	strcpy(toReturn->propName, tempName);
-	strcpy(toReturn->propDescr, tempDescr);
+	memcpy(toReturn->propDescr, descr, descrLen);
+	toReturn->propDescr[descrLen] = '\0';
 
 	char *temp = printProperty(toReturn);
 	notifyMsg("\tSuccessfully parsed the JSON into a Property object: \"%s\"\n", temp);
@@ -1015,6 +1199,12 @@ Alarm *JSONtoAlarm(const char *str) {
  *@param str - a pointer to a string
  **/
 Event* JSONtoEvent(const char* str) {
+	return JSONtoEventGenerated(str, NULL);
+}
+
+// The same as JSONtoEvent(), but if 'generatedUID' isn't NULL, it is set to whether the JSON
+// left out the UID (by giving it as "NULL"), so that the Event was given a random one instead
+Event *JSONtoEventGenerated(const char *str, bool *generatedUID) {
 	debugMsg("-----START JSONtoEvent()-----\n");
 	if (str == NULL) {
 		errorMsg("\tPassed string is NULL, returning NULL\n");
@@ -1037,7 +1227,7 @@ Event* JSONtoEvent(const char* str) {
 
 	// The JSON string 'str' contains only a "UID" field
 	//if (sscanf(str, "{\"UID\":\"%999[^\"]\"}", toReturn->UID) < 1) {
-	if (sscanf(str, "{\"startDT\":%100[^}]},\"createDT\":%100[^}]},\"UID\":\"%999[^\"]\",\"numProps\":%d,\"numAlarms\":%d,\"summary\":\"%1999[^\"]\",\"properties\":[],\"alarms\":[]}", \
+	if (sscanf(str, "{\"startDT\":%98[^}]},\"createDT\":%98[^}]},\"UID\":\"%999[^\"]\",\"numProps\":%d,\"numAlarms\":%d,\"summary\":\"%1999[^\"]\",\"properties\":[],\"alarms\":[]}", \
 	           startDT, createDT, uid, &dummy1, &dummy2, summary) < 5) {
 		errorMsg("\tCould not correctly parse the JSON string, returning NULL\n");
 		deleteEvent(toReturn);
@@ -1055,9 +1245,12 @@ Event* JSONtoEvent(const char* str) {
 
 	// A flag that indicates a UID was not provided
 	// (sscanf doesn't play nice with matching empty strings)
+	if (generatedUID != NULL) {
+		*generatedUID = (strcmp(uid, "NULL") == 0);
+	}
 	if (strcmp(uid, "NULL") == 0) {
 		char randUID[50];
-		snprintf(randUID, 50, "%d", rand());
+		snprintf(randUID, 50, "%u", randomNumber());
 		strcpy(uid, randUID);
 	}
 
@@ -1111,6 +1304,7 @@ Calendar* JSONtoCalendar(const char* str) {
 	if (sscanf(str, "{\"version\":%f,\"prodID\":\"%999[^\"]\",\"numProps\":%d,\"numEvents\":%d,\"properties\":[],\"events\":[]}", \
 	    &(toReturn->version), toReturn->prodID, &dummy1, &dummy2) < 4) {
 		errorMsg("\tUnable to parse the JSON for some reason. Returning NULL\n");
+		deleteCalendar(toReturn);
 		return NULL;
 	}
 
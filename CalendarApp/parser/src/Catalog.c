@@ -0,0 +1,482 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  Catalog.c                       *
+ ************************************/
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <unistd.h>
+
+#include "Catalog.h"
+#include "AtomicFile.h"
+#include "IOBatch.h"
+#include "TimeSpan.h"
+#include "Debug.h"
+
+static const char catalogMagic[8] = "ICALCAT";
+
+// Reads numbers and strings out of the bytes of a catalog file. Once anything runs past the end, 'ok' is
+// false and every read after it gives 0.
+typedef struct catalogreader {
+	const unsigned char *data;
+	size_t length;
+	size_t pos;
+	bool ok;
+} CatalogReader;
+
+// Writes the lowest 'bytes' bytes of 'value' to 'out', lowest first
+static void writeLE(FILE *out, uint64_t value, int bytes) {
+	for (int i = 0; i < bytes; i++) {
+		fputc((int)((value >> (8 * i)) & 0xFF), out);
+	}
+}
+
+// Writes the length of 'str' as a u16, followed by 'str' itself (cut down to 65535 bytes)
+static void writeString(FILE *out, const char *str) {
+	size_t length = strlen(str);
+
+	length = (length > UINT16_MAX) ? UINT16_MAX : length;
+	writeLE(out, length, 2);
+	fwrite(str, 1, length, out);
+}
+
+static uint64_t readLE(CatalogReader *reader, int bytes) {
+	uint64_t value = 0;
+
+	if (!reader->ok || reader->length - reader->pos < (size_t)bytes) {
+		reader->ok = false;
+		return 0;
+	}
+
+	for (int i = 0; i < bytes; i++) {
+		value |= (uint64_t)reader->data[reader->pos++] << (8 * i);
+	}
+
+	return value;
+}
+
+// Returns a newly allocated copy of the string written by writeString(), or NULL if it runs past the end
+static char *readString(CatalogReader *reader) {
+	size_t length = readLE(reader, 2);
+	char *str;
+
+	if (!reader->ok || reader->length - reader->pos < length || (str = malloc(length + 1)) == NULL) {
+		reader->ok = false;
+		return NULL;
+	}
+
+	memcpy(str, reader->data + reader->pos, length);
+	str[length] = '\0';
+	reader->pos += length;
+
+	return str;
+}
+
+static uint32_t floatBits(float value) {
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+static float bitsFloat(uint32_t bits) {
+	float value;
+	memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+static void freeEntry(CatalogEntry *entry) {
+	free(entry->name);
+	free(entry->prodID);
+}
+
+// Returns a newly allocated "<dirPath>/<name>"
+static char *joinPath(const char *dirPath, const char *name) {
+	char *path = malloc(strlen(dirPath) + strlen(name) + 2);
+
+	if (path != NULL) {
+		sprintf(path, "%s/%s", dirPath, name);
+	}
+
+	return path;
+}
+
+// Makes room for one more entry at the end of 'catalog'. Returns false if memory could not be allocated.
+static bool reserveEntry(Catalog *catalog) {
+	if (catalog->numEntries < catalog->size) {
+		return true;
+	}
+
+	int newSize = (catalog->size == 0) ? 64 : catalog->size * 2;
+	CatalogEntry *grown = realloc(catalog->entries, sizeof(CatalogEntry) * newSize);
+	if (grown == NULL) {
+		return false;
+	}
+
+	catalog->entries = grown;
+	catalog->size = newSize;
+	return true;
+}
+
+static int compareEntries(const void *first, const void *second) {
+	return strcmp(((const CatalogEntry *)first)->name, ((const CatalogEntry *)second)->name);
+}
+
+// Fills in the entry of the file at 'path', whose status is 'info', by reading the Calendar in it
+static void catalogFile(CatalogEntry *entry, const char *path, const struct stat *info) {
+	Calendar *cal;
+
+	entry->size = info->st_size;
+	entry->mtimeSec = info->st_mtim.tv_sec;
+	entry->mtimeNsec = info->st_mtim.tv_nsec;
+	entry->inode = info->st_ino;
+	entry->version = 0;
+	entry->prodID = NULL;
+	entry->numEvents = entry->numProps = 0;
+	entry->minStart = entry->maxStart = 0;
+
+	if ((entry->error = createCalendarValidated((char *)path, &cal)) != OK) {
+		return;
+	}
+
+	entry->version = cal->version;
+	entry->prodID = strdup(cal->prodID);
+	entry->numEvents = getLength(cal->events);
+	entry->numProps = getLength(cal->properties);
+
+	Event *ev;
+	int64_t start, minStart = INT64_MAX, maxStart = INT64_MIN;
+	ListIterator iter = createIterator(cal->events);
+	while ((ev = (Event *)nextElement(&iter)) != NULL) {
+		if (dateTimeToSeconds(&(ev->startDateTime), &start) == OK) {
+			minStart = (start < minStart) ? start : minStart;
+			maxStart = (start > maxStart) ? start : maxStart;
+		}
+	}
+	if (minStart <= maxStart) {
+		entry->minStart = minStart;
+		entry->maxStart = maxStart;
+	}
+
+	deleteCalendar(cal);
+}
+
+// Reads the entries in the bytes of a catalog file into 'catalog'. Returns false if the bytes aren't a
+// catalog file of this format version (the entries read so far are left in 'catalog').
+static bool parseCatalog(Catalog *catalog, const unsigned char *data, size_t length) {
+	CatalogReader reader = {data, length, 0, true};
+
+	if (length < sizeof(catalogMagic) || memcmp(data, catalogMagic, sizeof(catalogMagic)) != 0) {
+		return false;
+	}
+	reader.pos = sizeof(catalogMagic);
+
+	if (readLE(&reader, 4) != CATALOG_FORMAT_VERSION) {
+		return false;
+	}
+
+	uint32_t numEntries = readLE(&reader, 4);
+	for (uint32_t i = 0; i < numEntries && reader.ok; i++) {
+		CatalogEntry entry;
+
+		entry.name = readString(&reader);
+		entry.size = readLE(&reader, 8);
+		entry.mtimeSec = readLE(&reader, 8);
+		entry.mtimeNsec = readLE(&reader, 8);
+		entry.inode = readLE(&reader, 8);
+		entry.error = readLE(&reader, 4);
+		entry.version = bitsFloat(readLE(&reader, 4));
+		entry.prodID = readString(&reader);
+		entry.numEvents = readLE(&reader, 4);
+		entry.numProps = readLE(&reader, 4);
+		entry.minStart = readLE(&reader, 8);
+		entry.maxStart = readLE(&reader, 8);
+
+		if (!reader.ok || !reserveEntry(catalog)) {
+			freeEntry(&entry);
+			return false;
+		}
+
+		// Only valid Calendars have a product ID
+		if (entry.error != OK) {
+			free(entry.prodID);
+			entry.prodID = NULL;
+		}
+		catalog->entries[catalog->numEntries++] = entry;
+	}
+
+	return reader.ok && reader.pos == length;
+}
+
+/*
+ * Reads the catalog file of the directory 'dirPath', and stores it in 'catalog'. If there is no catalog file
+ * yet, or it can't be read, an empty Catalog is stored instead.
+ * Returns OK, or OTHER_ERROR if memory could not be allocated.
+ */
+ICalErrorCode loadCatalog(const char *dirPath, Catalog **catalog) {
+	debugMsg("-----START loadCatalog()-----\n");
+	char *path = joinPath(dirPath, CATALOG_FILENAME);
+	struct stat info;
+	unsigned char *data = NULL;
+
+	if (path == NULL || (*catalog = calloc(1, sizeof(Catalog))) == NULL) {
+		free(path);
+		return OTHER_ERROR;
+	}
+
+	int fd = open(path, O_RDONLY);
+	free(path);
+	if (fd < 0) {
+		notifyMsg("\t-----END loadCatalog(): no catalog file yet-----\n");
+		return OK;
+	}
+
+	// The whole file is read in at once, since it is only a few dozen bytes per calendar
+	size_t length = 0;
+	bool readAll = false;
+	if (fstat(fd, &info) == 0 && (data = malloc(info.st_size + 1)) != NULL) {
+		ssize_t got;
+		while (length < (size_t)info.st_size && (got = read(fd, data + length, info.st_size - length)) > 0) {
+			length += got;
+		}
+		readAll = (length == (size_t)info.st_size);
+	}
+	close(fd);
+
+	if (!readAll || !parseCatalog(*catalog, data, length)) {
+		errorMsg("\tThe catalog file in \"%s\" could not be read, and will be rebuilt\n", dirPath);
+		for (int i = 0; i < (*catalog)->numEntries; i++) {
+			freeEntry(&(*catalog)->entries[i]);
+		}
+		(*catalog)->numEntries = 0;
+	}
+	free(data);
+
+	// Entries are always written sorted, but a file that was edited by hand might not be
+	qsort((*catalog)->entries, (*catalog)->numEntries, sizeof(CatalogEntry), compareEntries);
+
+	notifyMsg("\t-----END loadCatalog(): %d entries-----\n", (*catalog)->numEntries);
+	return OK;
+}
+
+/*
+ * Brings 'catalog' up to date with the files in the directory 'dirPath', only parsing the files that are
+ * new or have changed. 'changed' is set to true if any entry was added, replaced or removed.
+ * Returns OK, INV_FILE if the directory can't be read, or OTHER_ERROR if memory could not be allocated.
+ */
+ICalErrorCode updateCatalog(Catalog *catalog, const char *dirPath, bool *changed) {
+	debugMsg("-----START updateCatalog()-----\n");
+	DIR *dir = opendir(dirPath);
+	struct dirent *file;
+	struct stat info;
+	int numOld = catalog->numEntries, numParsed = 0;
+	// Marks the old entries whose files are still there
+	bool *seen = calloc(numOld + 1, sizeof(bool));
+
+	*changed = false;
+	if (dir == NULL || seen == NULL) {
+		if (dir != NULL) {
+			closedir(dir);
+		}
+		free(seen);
+		return (dir == NULL) ? INV_FILE : OTHER_ERROR;
+	}
+
+	// New entries are added after the old ones, and everything is sorted again at the end
+	while ((file = readdir(dir)) != NULL) {
+		char *path;
+
+		if (file->d_name[0] == '.' || (path = joinPath(dirPath, file->d_name)) == NULL) {
+			continue;
+		}
+		if (stat(path, &info) != 0 || !S_ISREG(info.st_mode)) {
+			free(path);
+			continue;
+		}
+
+		CatalogEntry key = {.name = file->d_name};
+		CatalogEntry *old = bsearch(&key, catalog->entries, numOld, sizeof(CatalogEntry), compareEntries);
+
+		if (old != NULL) {
+			seen[old - catalog->entries] = true;
+
+			if (old->size == info.st_size && old->mtimeSec == info.st_mtim.tv_sec \
+			    && old->mtimeNsec == info.st_mtim.tv_nsec && old->inode == info.st_ino) {
+				free(path);
+				continue;
+			}
+
+			// The file changed, so it is parsed again in place
+			free(old->prodID);
+			catalogFile(old, path, &info);
+		} else {
+			if (!reserveEntry(catalog)) {
+				free(path);
+				closedir(dir);
+				free(seen);
+				return OTHER_ERROR;
+			}
+
+			CatalogEntry *entry = &catalog->entries[catalog->numEntries];
+			entry->name = strdup(file->d_name);
+			catalogFile(entry, path, &info);
+			catalog->numEntries++;
+		}
+
+		numParsed++;
+		*changed = true;
+		free(path);
+	}
+	closedir(dir);
+
+	// Drop the entries of files that are gone, keeping the rest in place
+	int kept = 0;
+	for (int i = 0; i < catalog->numEntries; i++) {
+		if (i < numOld && !seen[i]) {
+			freeEntry(&catalog->entries[i]);
+			*changed = true;
+			continue;
+		}
+		catalog->entries[kept++] = catalog->entries[i];
+	}
+	catalog->numEntries = kept;
+	free(seen);
+
+	if (*changed) {
+		qsort(catalog->entries, catalog->numEntries, sizeof(CatalogEntry), compareEntries);
+	}
+
+	notifyMsg("\t-----END updateCatalog(): %d entries, %d parsed-----\n", catalog->numEntries, numParsed);
+	return OK;
+}
+
+/*
+ * Writes 'catalog' to the catalog file of the directory 'dirPath'.
+ * Returns OK, or WRITE_ERROR if the file could not be written.
+ */
+ICalErrorCode saveCatalog(const Catalog *catalog, const char *dirPath) {
+	debugMsg("-----START saveCatalog()-----\n");
+	char *path = joinPath(dirPath, CATALOG_FILENAME);
+	char *data;
+	size_t length;
+	AtomicFile file;
+	IOBatch batch;
+
+	FILE *out = open_memstream(&data, &length);
+	fwrite(catalogMagic, 1, sizeof(catalogMagic), out);
+	writeLE(out, CATALOG_FORMAT_VERSION, 4);
+	writeLE(out, catalog->numEntries, 4);
+
+	for (int i = 0; i < catalog->numEntries; i++) {
+		const CatalogEntry *entry = &catalog->entries[i];
+
+		writeString(out, entry->name);
+		writeLE(out, entry->size, 8);
+		writeLE(out, entry->mtimeSec, 8);
+		writeLE(out, entry->mtimeNsec, 8);
+		writeLE(out, entry->inode, 8);
+		writeLE(out, entry->error, 4);
+		writeLE(out, floatBits(entry->version), 4);
+		writeString(out, (entry->prodID == NULL) ? "" : entry->prodID);
+		writeLE(out, entry->numEvents, 4);
+		writeLE(out, entry->numProps, 4);
+		writeLE(out, entry->minStart, 8);
+		writeLE(out, entry->maxStart, 8);
+	}
+	fclose(out);
+
+	if (path == NULL || openAtomic(&file, path) != OK) {
+		errorMsg("\tCould not open a temporary file for the catalog of \"%s\"\n", dirPath);
+		free(path);
+		free(data);
+		return WRITE_ERROR;
+	}
+	free(path);
+
+	initializeBatch(&batch, file.fd);
+	if (batchAppend(&batch, data, length) != OK || flushBatch(&batch) != OK) {
+		errorMsg("\tCould not write the catalog of \"%s\"\n", dirPath);
+		abortAtomic(&file);
+		free(data);
+		return WRITE_ERROR;
+	}
+	free(data);
+
+	if (commitAtomic(&file) != OK) {
+		errorMsg("\tCould not replace the catalog of \"%s\"\n", dirPath);
+		return WRITE_ERROR;
+	}
+
+	notifyMsg("\t-----END saveCatalog(): %zu bytes-----\n", length);
+	return OK;
+}
+
+// Writes the DateTime JSON of 'seconds' to 'json'
+static void writeStartJSON(FILE *json, int64_t seconds) {
+	DateTime dt;
+
+	secondsToDateTime(seconds, false, &dt);
+	char *dtJSON = dtToJSON(dt);
+	fputs(dtJSON, json);
+	free(dtJSON);
+}
+
+/*
+ * Returns a newly allocated JSON array of every entry in 'catalog', sorted by name, as
+ * [{"filename":...,"size":...,"mtime":...,"error":...,"version":...,"prodID":...,"numEvents":...,
+ * "numProps":...,"minStartDT":...,"maxStartDT":...},...], where "mtime" is in milliseconds (like a
+ * JavaScript Date), and "minStartDT" and "maxStartDT" are DateTime JSONs, or null if the Calendar has no Events.
+ */
+char *catalogToJSON(const Catalog *catalog) {
+	char *toReturn;
+	size_t length;
+
+	FILE *json = open_memstream(&toReturn, &length);
+	fputc('[', json);
+
+	for (int i = 0; i < catalog->numEntries; i++) {
+		const CatalogEntry *entry = &catalog->entries[i];
+		char *errorStr = printError(entry->error);
+
+		fprintf(json, "%s{\"filename\":\"%s\",\"size\":%" PRId64 ",\"mtime\":%" PRId64 ",\"error\":\"%s\",\"version\":%.1f," \
+		        "\"prodID\":\"%s\",\"numEvents\":%d,\"numProps\":%d,\"minStartDT\":", (i == 0) ? "" : ",", entry->name, \
+		        entry->size, entry->mtimeSec * 1000 + entry->mtimeNsec / 1000000, errorStr, entry->version, \
+		        (entry->prodID == NULL) ? "" : entry->prodID, entry->numEvents, entry->numProps);
+		free(errorStr);
+
+		if (entry->numEvents == 0) {
+			fputs("null,\"maxStartDT\":null}", json);
+			continue;
+		}
+		writeStartJSON(json, entry->minStart);
+		fputs(",\"maxStartDT\":", json);
+		writeStartJSON(json, entry->maxStart);
+		fputc('}', json);
+	}
+
+	fputc(']', json);
+	fclose(json);
+
+	return toReturn;
+}
+
+/*
+ * Frees a Catalog.
+ */
+void deleteCatalog(Catalog *catalog) {
+	if (catalog == NULL) {
+		return;
+	}
+
+	for (int i = 0; i < catalog->numEntries; i++) {
+		freeEntry(&catalog->entries[i]);
+	}
+	free(catalog->entries);
+	free(catalog);
+}
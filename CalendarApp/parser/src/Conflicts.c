@@ -0,0 +1,137 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  Conflicts.c                     *
+ ************************************/
+
+#include "Conflicts.h"
+#include "Debug.h"
+
+// Sorts SweepEntries by start time. Ties are broken so that the order never depends on qsort().
+static int compareSweepEntries(const void *first, const void *second) {
+	const SweepEntry *a = first, *b = second;
+
+	if (a->span.start != b->span.start) {
+		return (a->span.start < b->span.start) ? -1 : 1;
+	}
+	if (a->span.end != b->span.end) {
+		return (a->span.end < b->span.end) ? -1 : 1;
+	}
+	if (a->calendar != b->calendar) {
+		return a->calendar - b->calendar;
+	}
+	return strcmp(a->event->UID, b->event->UID);
+}
+
+/*
+ * Collects the Events of every EventIndex in 'indexes' into one array sorted by start time, and stores
+ * it in 'entries'. The array must be freed by the caller, and points at the Events in the Calendars,
+ * which must outlive it.
+ * Returns the number of entries, or -1 if memory could not be allocated.
+ */
+int createSweep(EventIndex **indexes, int numIndexes, SweepEntry **entries) {
+	int numEntries = 0;
+
+	for (int i = 0; i < numIndexes; i++) {
+		numEntries += indexes[i]->numEvents;
+	}
+
+	if ((*entries = malloc(sizeof(SweepEntry) * (numEntries + 1))) == NULL) {
+		return -1;
+	}
+
+	int pos = 0;
+	for (int i = 0; i < numIndexes; i++) {
+		for (int j = 0; j < indexes[i]->numEvents; j++) {
+			(*entries)[pos].span = indexes[i]->spans[j];
+			(*entries)[pos].event = indexes[i]->events[j];
+			(*entries)[pos].calendar = i;
+			pos++;
+		}
+	}
+
+	qsort(*entries, numEntries, sizeof(SweepEntry), compareSweepEntries);
+
+	return numEntries;
+}
+
+// The heap is ordered by end time. An Event with no duration sorts just after everything else that
+// ends at the same time, since it is still going on at that instant.
+static int64_t endKey(const SweepEntry *entry) {
+	return entry->span.end * 2 + (entry->span.start == entry->span.end);
+}
+
+// Moves heap[pos] down to its place in the min-heap 'heap'
+static void siftDown(const SweepEntry *entries, int *heap, int heapSize, int pos) {
+	while (true) {
+		int smallest = pos, left = pos * 2 + 1, right = pos * 2 + 2;
+
+		if (left < heapSize && endKey(&entries[heap[left]]) < endKey(&entries[heap[smallest]])) {
+			smallest = left;
+		}
+		if (right < heapSize && endKey(&entries[heap[right]]) < endKey(&entries[heap[smallest]])) {
+			smallest = right;
+		}
+		if (smallest == pos) {
+			return;
+		}
+
+		int temp = heap[pos];
+		heap[pos] = heap[smallest];
+		heap[smallest] = temp;
+		pos = smallest;
+	}
+}
+
+// Moves heap[pos] up to its place in the min-heap 'heap'
+static void siftUp(const SweepEntry *entries, int *heap, int pos) {
+	while (pos > 0 && endKey(&entries[heap[pos]]) < endKey(&entries[heap[(pos - 1) / 2]])) {
+		int temp = heap[pos];
+		heap[pos] = heap[(pos - 1) / 2];
+		heap[(pos - 1) / 2] = temp;
+		pos = (pos - 1) / 2;
+	}
+}
+
+/*
+ * Calls 'found' once for every pair of overlapping Events in 'entries' (as built by createSweep()),
+ * with the positions of the two Events in 'entries'. The first position is always the smaller one.
+ * 'data' is passed to every call of 'found' untouched.
+ * Returns the number of overlapping pairs, or -1 if memory could not be allocated.
+ */
+long findConflicts(const SweepEntry *entries, int numEntries, void (*found)(int, int, void *), void *data) {
+	debugMsg("-----START findConflicts()-----\n");
+	int *active = malloc(sizeof(int) * (numEntries + 1));
+	int numActive = 0;
+	long numConflicts = 0;
+
+	if (active == NULL) {
+		return -1;
+	}
+
+	for (int i = 0; i < numEntries; i++) {
+		// Remove every Event that was over by the time this one starts
+		while (numActive > 0 && endKey(&entries[active[0]]) <= entries[i].span.start * 2) {
+			active[0] = active[--numActive];
+			siftDown(entries, active, numActive, 0);
+		}
+
+		// Everything still going on overlaps this Event, and started before it did
+		for (int j = 0; j < numActive; j++) {
+			found(active[j], i, data);
+		}
+		numConflicts += numActive;
+
+		active[numActive] = i;
+		siftUp(entries, active, numActive);
+		numActive++;
+	}
+
+	free(active);
+
+	notifyMsg("\t-----END findConflicts(): %ld conflicts-----\n", numConflicts);
+	return numConflicts;
+}
@@ -0,0 +1,194 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  Dedup.c                         *
+ ************************************/
+
+#include "Dedup.h"
+#include "Debug.h"
+
+#define FNV_OFFSET UINT64_C(0xcbf29ce484222325)
+#define FNV_PRIME UINT64_C(0x100000001b3)
+
+// Hashes 'str' into 'hash' with FNV-1a, followed by a 0 byte so that "ab"+"c" and "a"+"bc" differ
+static uint64_t hashString(uint64_t hash, const char *str) {
+	for (; *str != '\0'; str++) {
+		hash = (hash ^ (unsigned char)*str) * FNV_PRIME;
+	}
+
+	return hash * FNV_PRIME;
+}
+
+// Spreads the bits of 'x' over the whole word (the finalizer of splitmix64), since FNV-1a leaves the
+// low bits of similar strings alike
+static uint64_t mix(uint64_t x) {
+	x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+	x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+
+	return x ^ (x >> 31);
+}
+
+// Hashes every Property in 'props' on its own and adds the hashes up, so their order doesn't matter
+static uint64_t hashProperties(const List *props) {
+	ListIterator iter = createIterator((List *)props);
+	Property *prop;
+	uint64_t sum = 0;
+
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		sum += mix(hashString(hashString(FNV_OFFSET, prop->propName), prop->propDescr));
+	}
+
+	return sum;
+}
+
+/*
+ * Returns the fingerprint of 'ev': a hash of its UID, or also of its content if 'byContent' is true.
+ */
+uint64_t fingerprintEvent(const Event *ev, bool byContent) {
+	uint64_t hash = hashString(FNV_OFFSET, ev->UID);
+
+	if (byContent) {
+		hash = hashString(hash, ev->startDateTime.date);
+		hash = hashString(hash, ev->startDateTime.time);
+		hash = (hash ^ ev->startDateTime.UTC) * FNV_PRIME;
+		hash ^= mix(hashProperties(ev->properties));
+
+		ListIterator iter = createIterator(ev->alarms);
+		Alarm *alarm;
+		uint64_t alarmSum = 0;
+		while ((alarm = (Alarm *)nextElement(&iter)) != NULL) {
+			alarmSum += mix(hashString(hashString(FNV_OFFSET, alarm->action), alarm->trigger) + hashProperties(alarm->properties));
+		}
+		hash = (hash * FNV_PRIME) ^ mix(alarmSum + 1);
+	}
+
+	return mix(hash);
+}
+
+// The second hash of the Bloom filter's double hashing, which must be odd to reach every bit
+static uint64_t bloomStep(uint64_t fingerprint) {
+	return mix(fingerprint ^ UINT64_C(0x9e3779b97f4a7c15)) | 1;
+}
+
+static void bloomAdd(BloomFilter *bloom, uint64_t fingerprint) {
+	uint64_t step = bloomStep(fingerprint);
+
+	for (int i = 0; i < BLOOM_NUM_HASHES; i++) {
+		uint64_t bit = (fingerprint + i * step) % bloom->numBits;
+		bloom->words[bit / 64] |= UINT64_C(1) << (bit % 64);
+	}
+}
+
+// Returns false if no Event with the fingerprint was added to the filter, and true if one might have been
+static bool bloomMayContain(const BloomFilter *bloom, uint64_t fingerprint) {
+	uint64_t step = bloomStep(fingerprint);
+
+	for (int i = 0; i < BLOOM_NUM_HASHES; i++) {
+		uint64_t bit = (fingerprint + i * step) % bloom->numBits;
+		if ((bloom->words[bit / 64] & (UINT64_C(1) << (bit % 64))) == 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+ * Builds a set of every Event in the 'numCals' Calendars in 'cals', fingerprinted by UID, or also by
+ * content if 'byContent' is true.
+ * Returns NULL if memory could not be allocated.
+ */
+EventSet *createEventSet(Calendar **cals, int numCals, bool byContent) {
+	debugMsg("-----START createEventSet()-----\n");
+	EventSet *set = calloc(1, sizeof(EventSet));
+	size_t numEvents = 0;
+
+	if (set == NULL) {
+		return NULL;
+	}
+
+	for (int c = 0; c < numCals; c++) {
+		numEvents += getLength(cals[c]->events);
+	}
+
+	// The table is kept at most half full, so that probes stay short
+	set->byContent = byContent;
+	set->numSlots = 16;
+	while (set->numSlots < numEvents * 2) {
+		set->numSlots *= 2;
+	}
+	set->slots = calloc(set->numSlots, sizeof(FingerprintEntry));
+	set->bloom.numBits = (numEvents + 1) * BLOOM_BITS_PER_EVENT;
+	set->bloom.words = calloc((set->bloom.numBits + 63) / 64, sizeof(uint64_t));
+
+	if (set->slots == NULL || set->bloom.words == NULL) {
+		deleteEventSet(set);
+		return NULL;
+	}
+
+	for (int c = 0; c < numCals; c++) {
+		ListIterator iter = createIterator(cals[c]->events);
+		Event *ev;
+
+		for (int position = 0; (ev = (Event *)nextElement(&iter)) != NULL; position++) {
+			uint64_t fingerprint = fingerprintEvent(ev, byContent);
+			size_t slot = fingerprint & (set->numSlots - 1);
+
+			while (set->slots[slot].event != NULL) {
+				slot = (slot + 1) & (set->numSlots - 1);
+			}
+
+			set->slots[slot].fingerprint = fingerprint;
+			set->slots[slot].event = ev;
+			set->slots[slot].calendar = c;
+			set->slots[slot].position = position;
+			bloomAdd(&set->bloom, fingerprint);
+		}
+	}
+	set->numEvents = numEvents;
+
+	notifyMsg("\t-----END createEventSet(): %zu events-----\n", numEvents);
+	return set;
+}
+
+/*
+ * Frees the set (but not the Calendars it points to).
+ */
+void deleteEventSet(EventSet *set) {
+	if (set == NULL) {
+		return;
+	}
+
+	free(set->slots);
+	free(set->bloom.words);
+	free(set);
+}
+
+/*
+ * Calls 'found' on every Event in 'set' that is a copy of 'ev' (other than 'ev' itself), in no particular
+ * order. 'data' is passed to every call of 'found' untouched.
+ * Returns the number of copies.
+ */
+int findCopies(const EventSet *set, const Event *ev, void (*found)(const FingerprintEntry *, void *), void *data) {
+	uint64_t fingerprint = fingerprintEvent(ev, set->byContent);
+	int numCopies = 0;
+
+	if (!bloomMayContain(&set->bloom, fingerprint)) {
+		return 0;
+	}
+
+	// Every Event with this fingerprint is in the run of full slots that starts where it hashes to
+	for (size_t slot = fingerprint & (set->numSlots - 1); set->slots[slot].event != NULL; slot = (slot + 1) & (set->numSlots - 1)) {
+		const FingerprintEntry *entry = &set->slots[slot];
+
+		if (entry->fingerprint == fingerprint && entry->event != ev && strcmp(entry->event->UID, ev->UID) == 0) {
+			found(entry, data);
+			numCopies++;
+		}
+	}
+
+	return numCopies;
+}
@@ -0,0 +1,248 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  EventIndex.c                    *
+ ************************************/
+
+#define _GNU_SOURCE
+
+#include "EventIndex.h"
+#include "Debug.h"
+
+// A span, the Event it belongs to, and the Event's position in the Calendar, used while sorting
+typedef struct indexentry {
+	TimeSpan span;
+	const Event *event;
+	int position;
+} IndexEntry;
+
+static int compareIndexEntries(const void *first, const void *second) {
+	const IndexEntry *a = first, *b = second;
+
+	if (a->span.start != b->span.start) {
+		return (a->span.start < b->span.start) ? -1 : 1;
+	}
+	if (a->span.end != b->span.end) {
+		return (a->span.end < b->span.end) ? -1 : 1;
+	}
+	return a->position - b->position;
+}
+
+// Fills in maxEnd for the subtree made of the elements [lo, hi), and returns the subtree's maxEnd
+static int64_t buildMaxEnd(EventIndex *index, int lo, int hi) {
+	if (lo >= hi) {
+		return INT64_MIN;
+	}
+
+	int mid = lo + (hi - lo) / 2;
+	int64_t left = buildMaxEnd(index, lo, mid);
+	int64_t right = buildMaxEnd(index, mid + 1, hi);
+	int64_t max = index->spans[mid].end;
+
+	max = (left > max) ? left : max;
+	max = (right > max) ? right : max;
+	index->maxEnd[mid] = max;
+
+	return max;
+}
+
+/*
+ * Builds an index over every Event in 'cal'. An Event whose DTEND or DURATION can't be read is
+ * indexed as if it had neither, so it can still be found by its start time.
+ * Returns NULL if 'cal' is NULL or memory could not be allocated.
+ */
+EventIndex *createEventIndex(const Calendar *cal) {
+	debugMsg("-----START createEventIndex()-----\n");
+	if (cal == NULL || cal->events == NULL) {
+		return NULL;
+	}
+
+	int numEvents = getLength(cal->events);
+	EventIndex *index = malloc(sizeof(EventIndex));
+	IndexEntry *entries = malloc(sizeof(IndexEntry) * (numEvents + 1));
+
+	if (index == NULL || entries == NULL) {
+		free(index);
+		free(entries);
+		return NULL;
+	}
+
+	// Events with an unreadable DTSTART are left out, since there's nowhere to put them
+	Event *ev;
+	int count = 0;
+	ListIterator iter = createIterator(cal->events);
+	for (int position = 0; (ev = (Event *)nextElement(&iter)) != NULL; position++) {
+		if (getEventSpan(ev, &(entries[count].span)) != OK) {
+			if (dateTimeToSeconds(&(ev->startDateTime), &(entries[count].span.start)) != OK) {
+				errorMsg("\tEvent \"%s\" has an invalid DTSTART, and was not indexed\n", ev->UID);
+				continue;
+			}
+			entries[count].span.end = entries[count].span.start;
+		}
+		entries[count].event = ev;
+		entries[count].position = position;
+		count++;
+	}
+
+	qsort(entries, count, sizeof(IndexEntry), compareIndexEntries);
+
+	index->numEvents = count;
+	index->spans = malloc(sizeof(TimeSpan) * (count + 1));
+	index->events = malloc(sizeof(Event *) * (count + 1));
+	index->maxEnd = malloc(sizeof(int64_t) * (count + 1));
+
+	if (index->spans == NULL || index->events == NULL || index->maxEnd == NULL) {
+		free(entries);
+		deleteEventIndex(index);
+		return NULL;
+	}
+
+	for (int i = 0; i < count; i++) {
+		index->spans[i] = entries[i].span;
+		index->events[i] = entries[i].event;
+	}
+	free(entries);
+
+	buildMaxEnd(index, 0, count);
+
+	notifyMsg("\t-----END createEventIndex()-----\n");
+	return index;
+}
+
+/*
+ * Frees the index (but not the Events it points to).
+ */
+void deleteEventIndex(EventIndex *index) {
+	if (index == NULL) {
+		return;
+	}
+
+	free(index->spans);
+	free(index->events);
+	free(index->maxEnd);
+	free(index);
+}
+
+// Whether 'span' overlaps 'range'. A span with no duration is treated as the instant it starts at.
+static bool overlaps(TimeSpan span, TimeSpan range) {
+	if (span.start == span.end) {
+		return span.start >= range.start && span.start < range.end;
+	}
+
+	return span.start < range.end && span.end > range.start;
+}
+
+// Searches the subtree made of the elements [lo, hi) in order, recursing into the left subtrees and
+// looping over the right ones. Returns -1 as soon as 'found' asks for the search to stop.
+static int searchRange(const EventIndex *index, int lo, int hi, TimeSpan range, \
+                       bool (*found)(const Event *, void *), void *data) {
+	int numFound = 0, numLeft;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		// Nothing in this subtree ends after the range starts. The maxEnd of an instant is its start,
+		// which is why an instant at exactly range.start has to be let through.
+		if (index->maxEnd[mid] < range.start) {
+			break;
+		}
+
+		if ((numLeft = searchRange(index, lo, mid, range, found, data)) < 0) {
+			return -1;
+		}
+		numFound += numLeft;
+
+		// This span, and everything to the right of it, starts after the range ends
+		if (index->spans[mid].start >= range.end) {
+			break;
+		}
+
+		if (overlaps(index->spans[mid], range)) {
+			if (!found(index->events[mid], data)) {
+				return -1;
+			}
+			numFound++;
+		}
+
+		lo = mid + 1;
+	}
+
+	return numFound;
+}
+
+/*
+ * Calls 'found' on every Event whose span overlaps 'range', in order of their start times.
+ * An Event with no duration overlaps 'range' if it starts inside of it.
+ * 'data' is passed to every call of 'found' untouched. If 'found' returns false, the search stops.
+ * Returns the number of Events found, or -1 if the search was stopped.
+ */
+int queryEventIndex(const EventIndex *index, TimeSpan range, bool (*found)(const Event *, void *), void *data) {
+	if (index == NULL || found == NULL || range.end <= range.start) {
+		return 0;
+	}
+
+	return searchRange(index, 0, index->numEvents, range, found, data);
+}
+
+// The JSON array being built by queryEventsInRange()
+typedef struct jsonarray {
+	char *json;
+	size_t length;
+	size_t size;
+} JSONArray;
+
+// Appends the JSON of 'event' to the JSONArray 'data'. Returns false if memory could not be allocated.
+static bool appendEventJSON(const Event *event, void *data) {
+	JSONArray *array = data;
+	char *eventJSON = eventToJSON(event);
+	size_t eventLen;
+
+	if (eventJSON == NULL) {
+		return false;
+	}
+	eventLen = strlen(eventJSON);
+
+	// Room for the ',' (or the '['), the Event, and the closing "]\0"
+	if (array->length + eventLen + 3 > array->size) {
+		size_t size = (array->size * 2 > array->length + eventLen + 3) ? array->size * 2 : array->length + eventLen + 3;
+		char *grown = realloc(array->json, size);
+
+		if (grown == NULL) {
+			free(eventJSON);
+			return false;
+		}
+		array->json = grown;
+		array->size = size;
+	}
+
+	array->json[array->length] = (array->length == 0) ? '[' : ',';
+	array->length++;
+	memcpy(array->json + array->length, eventJSON, eventLen);
+	array->length += eventLen;
+
+	free(eventJSON);
+	return true;
+}
+
+/*
+ * Returns a newly allocated JSON array of every Event (as eventToJSON() writes them) whose span
+ * overlaps 'range', in order of their start times. Returns "[]" if there are none, or NULL if
+ * memory could not be allocated.
+ */
+char *queryEventsInRange(const EventIndex *index, TimeSpan range) {
+	JSONArray array = {NULL, 0, 0};
+	int numFound = queryEventIndex(index, range, appendEventJSON, &array);
+
+	if (numFound <= 0) {
+		free(array.json);
+		return (numFound == 0) ? strdup("[]") : NULL;
+	}
+
+	array.json[array.length++] = ']';
+	array.json[array.length] = '\0';
+
+	return array.json;
+}
@@ -0,0 +1,176 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  EventSort.c                     *
+ ************************************/
+
+#include <ctype.h>
+#include <stdint.h>
+
+#include "EventSort.h"
+#include "Debug.h"
+
+// A node of the List, its key, and where it was in the List (to keep UIDs with equal prefixes stable)
+typedef struct sortentry {
+	uint64_t key;
+	Node *node;
+	int position;
+} SortEntry;
+
+// Packs a DateTime into YYYYMMDDhhmmss, or UINT64_MAX if it isn't made of digits
+static uint64_t packDateTime(const DateTime *dt) {
+	uint64_t packed = 0;
+
+	if (strlen(dt->date) != 8 || strlen(dt->time) != 6) {
+		return UINT64_MAX;
+	}
+
+	for (int i = 0; i < 8; i++) {
+		if (!isdigit((unsigned char)dt->date[i])) {
+			return UINT64_MAX;
+		}
+		packed = packed * 10 + (dt->date[i] - '0');
+	}
+	for (int i = 0; i < 6; i++) {
+		if (!isdigit((unsigned char)dt->time[i])) {
+			return UINT64_MAX;
+		}
+		packed = packed * 10 + (dt->time[i] - '0');
+	}
+
+	return packed;
+}
+
+// Packs the first 8 bytes of a string, most significant first. A shorter string is padded with zeroes,
+// which keeps the same order as strcmp().
+static uint64_t packPrefix(const char *str) {
+	uint64_t packed = 0;
+	int i = 0;
+
+	for (; i < 8 && str[i] != '\0'; i++) {
+		packed = (packed << 8) | (unsigned char)str[i];
+	}
+
+	return packed << (8 * (8 - i));
+}
+
+static uint64_t eventKey(const Event *ev, enum eventSortKey key) {
+	switch (key) {
+		case SORT_BY_START:
+			return packDateTime(&(ev->startDateTime));
+		case SORT_BY_STAMP:
+			return packDateTime(&(ev->creationDateTime));
+		default:
+			return packPrefix(ev->UID);
+	}
+}
+
+static int compareUIDs(const void *first, const void *second) {
+	const SortEntry *a = first, *b = second;
+	int cmp = strcmp(((Event *)a->node->data)->UID, ((Event *)b->node->data)->UID);
+
+	return (cmp != 0) ? cmp : a->position - b->position;
+}
+
+// Sorts 'entries' by key, using 'temp' (which must be as long) as scratch space. Returns the array the
+// sorted entries ended up in.
+static SortEntry *radixSort(SortEntry *entries, SortEntry *temp, int numEntries) {
+	static const int numPasses = sizeof(uint64_t);
+	int counts[sizeof(uint64_t)][256] = {{0}};
+
+	// Every pass's histogram is counted in one go
+	for (int i = 0; i < numEntries; i++) {
+		for (int pass = 0; pass < numPasses; pass++) {
+			counts[pass][(entries[i].key >> (8 * pass)) & 0xFF]++;
+		}
+	}
+
+	for (int pass = 0; pass < numPasses; pass++) {
+		int *count = counts[pass];
+
+		// A pass where every key has the same byte wouldn't move anything
+		if (count[(entries[0].key >> (8 * pass)) & 0xFF] == numEntries) {
+			continue;
+		}
+
+		int offset = 0;
+		for (int digit = 0; digit < 256; digit++) {
+			int bucketSize = count[digit];
+			count[digit] = offset;
+			offset += bucketSize;
+		}
+
+		for (int i = 0; i < numEntries; i++) {
+			temp[count[(entries[i].key >> (8 * pass)) & 0xFF]++] = entries[i];
+		}
+
+		SortEntry *swap = entries;
+		entries = temp;
+		temp = swap;
+	}
+
+	return entries;
+}
+
+/*
+ * Sorts the Events in 'events' by their DTSTART, DTSTAMP or UID, keeping Events with equal keys in the
+ * order they were in.
+ * Returns OK, INV_CAL if 'events' is NULL, or OTHER_ERROR if memory could not be allocated (in which case
+ * the List is left untouched).
+ */
+ICalErrorCode sortEvents(List *events, enum eventSortKey key) {
+	debugMsg("-----START sortEvents()-----\n");
+	if (events == NULL) {
+		return INV_CAL;
+	}
+
+	int numEntries = getLength(events);
+	if (numEntries < 2) {
+		return OK;
+	}
+
+	SortEntry *entries = malloc(sizeof(SortEntry) * numEntries);
+	SortEntry *temp = malloc(sizeof(SortEntry) * numEntries);
+	if (entries == NULL || temp == NULL) {
+		free(entries);
+		free(temp);
+		return OTHER_ERROR;
+	}
+
+	int position = 0;
+	for (Node *node = events->head; node != NULL; node = node->next, position++) {
+		entries[position].key = eventKey((Event *)node->data, key);
+		entries[position].node = node;
+		entries[position].position = position;
+	}
+
+	SortEntry *sorted = radixSort(entries, temp, numEntries);
+
+	// UIDs are only sorted by their first 8 bytes so far
+	if (key == SORT_BY_UID) {
+		for (int start = 0, end; start < numEntries; start = end) {
+			for (end = start + 1; end < numEntries && sorted[end].key == sorted[start].key; end++);
+
+			if (end - start > 1) {
+				qsort(sorted + start, end - start, sizeof(SortEntry), compareUIDs);
+			}
+		}
+	}
+
+	// Relink the nodes in their new order
+	for (int i = 0; i < numEntries; i++) {
+		sorted[i].node->previous = (i == 0) ? NULL : sorted[i - 1].node;
+		sorted[i].node->next = (i == numEntries - 1) ? NULL : sorted[i + 1].node;
+	}
+	events->head = sorted[0].node;
+	events->tail = sorted[numEntries - 1].node;
+
+	free(entries);
+	free(temp);
+
+	notifyMsg("\t-----END sortEvents(): %d events-----\n", numEntries);
+	return OK;
+}
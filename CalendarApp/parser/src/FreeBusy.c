@@ -0,0 +1,292 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  FreeBusy.c                      *
+ ************************************/
+
+#define _GNU_SOURCE
+
+#include <strings.h>
+
+#include "FreeBusy.h"
+#include "Recurrence.h"
+#include "Debug.h"
+
+// Rounds a / b down, even when a is negative (b must be positive)
+static int64_t floorDiv(int64_t a, int64_t b) {
+	return a / b - (a % b < 0);
+}
+
+// Sets the bits of slots [lo, hi)
+static void setSlots(uint64_t *words, int lo, int hi) {
+	while (lo < hi) {
+		int bit = lo % 64;
+		int count = (hi - lo < 64 - bit) ? hi - lo : 64 - bit;
+
+		words[lo / 64] |= (count == 64) ? ~UINT64_C(0) : ((UINT64_C(1) << count) - 1) << bit;
+		lo += count;
+	}
+}
+
+// Clears the bits past the last slot, which the whole-word operations can set
+static void clearTail(BusyBitmap *bitmap) {
+	if (bitmap->numSlots % 64 != 0) {
+		bitmap->words[bitmap->numWords - 1] &= (UINT64_C(1) << (bitmap->numSlots % 64)) - 1;
+	}
+}
+
+// Returns the first slot at or after 'from' that is busy (or free, if 'busy' is false), or numSlots if there is none
+static int nextSlot(const BusyBitmap *bitmap, int from, bool busy) {
+	if (from >= bitmap->numSlots) {
+		return bitmap->numSlots;
+	}
+
+	int word = from / 64;
+	uint64_t bits = (busy ? bitmap->words[word] : ~bitmap->words[word]) & (~UINT64_C(0) << (from % 64));
+
+	while (bits == 0) {
+		if (++word == bitmap->numWords) {
+			return bitmap->numSlots;
+		}
+		bits = busy ? bitmap->words[word] : ~bitmap->words[word];
+	}
+
+	int slot = word * 64 + __builtin_ctzll(bits);
+	return (slot < bitmap->numSlots) ? slot : bitmap->numSlots;
+}
+
+// Whether the Event doesn't take up any time, because it is TRANSPARENT or CANCELLED
+static bool isTransparent(const Event *ev) {
+	ListIterator iter = createIterator(ev->properties);
+	Property *prop;
+
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		if ((strcasecmp(prop->propName, "TRANSP") == 0 && strcasecmp(prop->propDescr, "TRANSPARENT") == 0) \
+		    || (strcasecmp(prop->propName, "STATUS") == 0 && strcasecmp(prop->propDescr, "CANCELLED") == 0)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Whether the Event has an RRULE or RDATE, and so may occur more than once
+static bool isRecurring(const Event *ev) {
+	ListIterator iter = createIterator(ev->properties);
+	Property *prop;
+
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		if (strcasecmp(prop->propName, "RRULE") == 0 || strcasecmp(prop->propName, "RDATE") == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Creates a bitmap of 'numSlots' free slots of 'slotSeconds' seconds each, the first of which starts at 'start'.
+ * Returns NULL if the size of the bitmap is out of range, or memory could not be allocated.
+ */
+BusyBitmap *createBusyBitmap(int64_t start, int64_t slotSeconds, int numSlots) {
+	if (slotSeconds <= 0 || numSlots <= 0 || numSlots > MAX_BUSY_SLOTS) {
+		return NULL;
+	}
+
+	BusyBitmap *bitmap = malloc(sizeof(BusyBitmap));
+	if (bitmap == NULL) {
+		return NULL;
+	}
+
+	bitmap->start = start;
+	bitmap->slotSeconds = slotSeconds;
+	bitmap->numSlots = numSlots;
+	bitmap->numWords = (numSlots + 63) / 64;
+
+	if ((bitmap->words = calloc(bitmap->numWords, sizeof(uint64_t))) == NULL) {
+		free(bitmap);
+		return NULL;
+	}
+
+	return bitmap;
+}
+
+/*
+ * Frees a bitmap.
+ */
+void deleteBusyBitmap(BusyBitmap *bitmap) {
+	if (bitmap == NULL) {
+		return;
+	}
+
+	free(bitmap->words);
+	free(bitmap);
+}
+
+/*
+ * Marks every slot that 'span' overlaps as busy. A span with no duration marks the slot it starts in.
+ * Returns true if any slot was marked.
+ */
+bool markBusy(BusyBitmap *bitmap, TimeSpan span) {
+	int64_t first = floorDiv(span.start - bitmap->start, bitmap->slotSeconds);
+	int64_t last = (span.end > span.start) ? floorDiv(span.end - bitmap->start - 1, bitmap->slotSeconds) : first;
+
+	if (last < 0 || first >= bitmap->numSlots) {
+		return false;
+	}
+
+	setSlots(bitmap->words, (first < 0) ? 0 : (int)first, (last >= bitmap->numSlots) ? bitmap->numSlots : (int)last + 1);
+	return true;
+}
+
+/*
+ * Marks every slot taken up by an Event of 'cal' (or one of its occurrences) as busy.
+ * Returns the number of Events that took up any time in the bitmap's range.
+ */
+int markCalendarBusy(BusyBitmap *bitmap, const Calendar *cal) {
+	int64_t rangeEnd = bitmap->start + bitmap->slotSeconds * bitmap->numSlots;
+	Recurrence *rec;
+	TimeSpan span;
+	Event *ev;
+	int numBusy = 0;
+
+	ListIterator iter = createIterator(cal->events);
+	while ((ev = (Event *)nextElement(&iter)) != NULL) {
+		if (isTransparent(ev)) {
+			continue;
+		}
+
+		// A recurring Event whose rule can't be expanded is still busy at its DTSTART
+		if (isRecurring(ev) && compileRecurrence(ev, &rec) == OK) {
+			OccurrenceIterator occurrences;
+			bool marked = false;
+			int64_t start;
+
+			// An occurrence that starts before the range still overlaps it if it hasn't ended by the time it starts
+			startOccurrences(rec, (rec->duration > 0) ? bitmap->start - rec->duration + 1 : bitmap->start, &occurrences);
+			for (int i = 0; i < MAX_BUSY_OCCURRENCES && nextOccurrence(&occurrences, &start) && start < rangeEnd; i++) {
+				span.start = start;
+				span.end = start + rec->duration;
+				marked |= markBusy(bitmap, span);
+			}
+
+			numBusy += marked;
+			deleteRecurrence(rec);
+		} else if (getEventSpan(ev, &span) == OK) {
+			numBusy += markBusy(bitmap, span);
+		}
+	}
+
+	return numBusy;
+}
+
+/*
+ * Makes every slot of 'dest' busy if it is busy in 'dest' or 'src' (the time at least one of them is busy).
+ * Both bitmaps must cover the same slots.
+ */
+void unionBusy(BusyBitmap *dest, const BusyBitmap *src) {
+	for (int i = 0; i < dest->numWords; i++) {
+		dest->words[i] |= src->words[i];
+	}
+}
+
+/*
+ * Makes every slot of 'dest' busy only if it is busy in both 'dest' and 'src' (the time both are busy).
+ * Both bitmaps must cover the same slots.
+ */
+void intersectBusy(BusyBitmap *dest, const BusyBitmap *src) {
+	for (int i = 0; i < dest->numWords; i++) {
+		dest->words[i] &= src->words[i];
+	}
+}
+
+/*
+ * Swaps the free and busy slots of 'bitmap'.
+ */
+void invertBusy(BusyBitmap *bitmap) {
+	for (int i = 0; i < bitmap->numWords; i++) {
+		bitmap->words[i] = ~bitmap->words[i];
+	}
+	clearTail(bitmap);
+}
+
+/*
+ * Calls 'found' on every run of busy slots (or free slots, if 'busy' is false), in order, with the span of
+ * time the run covers. 'data' is passed to every call of 'found' untouched.
+ * Returns the number of runs.
+ */
+int findPeriods(const BusyBitmap *bitmap, bool busy, void (*found)(TimeSpan, void *), void *data) {
+	int numPeriods = 0;
+	int slot = nextSlot(bitmap, 0, busy);
+
+	while (slot < bitmap->numSlots) {
+		int end = nextSlot(bitmap, slot, !busy);
+		TimeSpan span = {bitmap->start + slot * bitmap->slotSeconds, bitmap->start + end * bitmap->slotSeconds};
+
+		found(span, data);
+		numPeriods++;
+		slot = nextSlot(bitmap, end, busy);
+	}
+
+	return numPeriods;
+}
+
+// Writes a period to the JSON array in 'data'
+static void writePeriodJSON(TimeSpan span, void *data) {
+	FILE *json = data;
+	DateTime startDT, endDT;
+
+	secondsToDateTime(span.start, false, &startDT);
+	secondsToDateTime(span.end, false, &endDT);
+
+	char *startJSON = dtToJSON(startDT);
+	char *endJSON = dtToJSON(endDT);
+	fprintf(json, "%s{\"startDT\":%s,\"endDT\":%s}", (ftell(json) == 1) ? "" : ",", startJSON, endJSON);
+	free(startJSON);
+	free(endJSON);
+}
+
+// Writes a period to the FREEBUSY value in 'data'
+static void writePeriodFreeBusy(TimeSpan span, void *data) {
+	FILE *value = data;
+	DateTime startDT, endDT;
+
+	secondsToDateTime(span.start, true, &startDT);
+	secondsToDateTime(span.end, true, &endDT);
+	fprintf(value, "%s%sT%sZ/%sT%sZ", (ftell(value) == 0) ? "" : ",", startDT.date, startDT.time, endDT.date, endDT.time);
+}
+
+/*
+ * Returns a newly allocated JSON array of the runs of busy slots (or free slots, if 'busy' is false), as
+ * [{"startDT":...,"endDT":...},...].
+ */
+char *periodsToJSON(const BusyBitmap *bitmap, bool busy) {
+	char *toReturn;
+	size_t length;
+	FILE *json = open_memstream(&toReturn, &length);
+
+	fputc('[', json);
+	findPeriods(bitmap, busy, writePeriodJSON, json);
+	fputc(']', json);
+	fclose(json);
+
+	return toReturn;
+}
+
+/*
+ * Returns a newly allocated FREEBUSY property value (e.g. "20190101T090000Z/20190101T100000Z,...") of the
+ * runs of busy slots (or free slots, if 'busy' is false). Times are taken to be UTC, as in TimeSpan.h.
+ */
+char *periodsToFreeBusy(const BusyBitmap *bitmap, bool busy) {
+	char *toReturn;
+	size_t length;
+	FILE *value = open_memstream(&toReturn, &length);
+
+	findPeriods(bitmap, busy, writePeriodFreeBusy, value);
+	fclose(value);
+
+	return toReturn;
+}
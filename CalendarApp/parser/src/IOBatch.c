@@ -0,0 +1,202 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  IOBatch.c                       *
+ ************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <unistd.h>
+
+#include "IOBatch.h"
+#include "Debug.h"
+
+/*
+ * Prepares 'batch' to write to the file descriptor 'fd'.
+ */
+void initializeBatch(IOBatch *batch, int fd) {
+	batch->fd = fd;
+	batch->numVecs = 0;
+	batch->scratchUsed = 0;
+	batch->written = 0;
+	batch->error = OK;
+}
+
+/*
+ * Writes everything in the batch to its file descriptor with writev(), retrying partial writes.
+ * The batch is empty afterwards, and may be reused.
+ * Returns OK, or WRITE_ERROR if the write failed.
+ */
+ICalErrorCode flushBatch(IOBatch *batch) {
+	if (batch->error != OK) {
+		return batch->error;
+	}
+
+	struct iovec *vec = batch->vecs;
+	int remaining = batch->numVecs;
+
+	while (remaining > 0) {
+		ssize_t wrote = writev(batch->fd, vec, remaining);
+
+		if (wrote < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			errorMsg("\twritev() failed: %s\n", strerror(errno));
+			batch->error = WRITE_ERROR;
+			return WRITE_ERROR;
+		}
+		batch->written += wrote;
+
+		// Skip over every entry that was written completely...
+		while (remaining > 0 && (size_t)wrote >= vec->iov_len) {
+			wrote -= vec->iov_len;
+			vec++;
+			remaining--;
+		}
+
+		// ...and move the start of a partially written entry forward
+		if (remaining > 0) {
+			vec->iov_base = (char *)vec->iov_base + wrote;
+			vec->iov_len -= wrote;
+		}
+	}
+
+	batch->numVecs = 0;
+	batch->scratchUsed = 0;
+	return OK;
+}
+
+/*
+ * Appends 'length' bytes starting at 'data' to the batch without copying them.
+ * 'data' must not be freed or modified until the batch has been flushed.
+ * Returns OK, or WRITE_ERROR if a flush was needed and it failed.
+ */
+ICalErrorCode batchAppend(IOBatch *batch, const char *data, size_t length) {
+	if (batch->error != OK) {
+		return batch->error;
+	}
+
+	if (length == 0) {
+		return OK;
+	}
+
+	if (batch->numVecs == IOBATCH_MAX_VECS && flushBatch(batch) != OK) {
+		return batch->error;
+	}
+
+	// writev() never modifies the buffers, so casting away the const is safe
+	batch->vecs[batch->numVecs].iov_base = (char *)data;
+	batch->vecs[batch->numVecs].iov_len = length;
+	batch->numVecs++;
+
+	return OK;
+}
+
+/*
+ * Copies 'length' bytes starting at 'data' into the batch's scratch space and appends them,
+ * so 'data' may be modified or freed immediately afterwards.
+ * Returns OK, or WRITE_ERROR if a flush was needed and it failed.
+ */
+ICalErrorCode batchAppendCopy(IOBatch *batch, const char *data, size_t length) {
+	if (batch->error != OK) {
+		return batch->error;
+	}
+
+	if (length > IOBATCH_SCRATCH_SIZE) {
+		// Too big to ever fit in the scratch space, so write it out right away instead
+		if (flushBatch(batch) != OK || batchAppend(batch, data, length) != OK) {
+			return batch->error;
+		}
+		return flushBatch(batch);
+	}
+
+	// Entries already in the batch may point into the scratch space, so it can only
+	// be reused once they have been written. A full batch is flushed first too, since
+	// flushing from batchAppend() would reset the scratch space under the new entry.
+	if ((batch->scratchUsed + length > IOBATCH_SCRATCH_SIZE || batch->numVecs == IOBATCH_MAX_VECS) \
+	    && flushBatch(batch) != OK) {
+		return batch->error;
+	}
+
+	char *dest = batch->scratch + batch->scratchUsed;
+	memcpy(dest, data, length);
+	batch->scratchUsed += length;
+
+	return batchAppend(batch, dest, length);
+}
+
+/*
+ * Appends 'length' bytes starting at 'data' to the current content line, inserting a fold
+ * whenever the line would grow past FOLD_LENGTH octets. 'column' holds the number of octets
+ * already on the current (physical) line, and is updated as the data is appended.
+ *
+ * UTF-8 is self-synchronizing, so a safe fold point is found by looking at the byte the fold
+ * would land on: if it is a continuation byte (10xxxxxx), the fold moves back to the start of
+ * that character. That is at most 3 bytes of work per fold, and the rest of the value is never
+ * scanned.
+ */
+static ICalErrorCode appendFolded(IOBatch *batch, const char *data, size_t length, size_t *column) {
+	while (*column + length > FOLD_LENGTH) {
+		size_t cut = FOLD_LENGTH - *column;
+
+		for (int i = 0; i < 3 && cut > 0 && ((unsigned char)data[cut] & 0xc0) == 0x80; i++) {
+			cut--;
+		}
+
+		batchAppend(batch, data, cut);
+		batchAppendLit(batch, "\r\n ");
+
+		data += cut;
+		length -= cut;
+		*column = 1;	// the space that starts the continuation line
+	}
+
+	batchAppend(batch, data, length);
+	*column += length;
+
+	return batch->error;
+}
+
+/*
+ * Appends the content line "<name><separator><value>\r\n" to the batch without copying any of
+ * its parts, folding it every FOLD_LENGTH octets with a (CRLF)(single space) sequence.
+ * Folds are never placed inside a multi-byte UTF-8 sequence.
+ * Returns OK, or WRITE_ERROR if a flush was needed and it failed.
+ */
+ICalErrorCode batchAppendLine(IOBatch *batch, const char *name, size_t nameLen, const char *separator, \
+                              const char *value, size_t valueLen) {
+	size_t column = 0;
+
+	appendFolded(batch, name, nameLen, &column);
+	appendFolded(batch, separator, strlen(separator), &column);
+	appendFolded(batch, value, valueLen, &column);
+
+	return batchAppendLit(batch, "\r\n");
+}
+
+/*
+ * Formats a string into the batch's scratch space using printf format specifiers, and appends it.
+ * The formatted string must be shorter than IOBATCH_SCRATCH_SIZE.
+ * Returns OK, or WRITE_ERROR if a flush was needed and it failed.
+ */
+ICalErrorCode batchPrintf(IOBatch *batch, const char *format, ...) {
+	char temp[IOBATCH_SCRATCH_SIZE];
+	va_list ap;
+
+	va_start(ap, format);
+	int length = vsnprintf(temp, IOBATCH_SCRATCH_SIZE, format, ap);
+	va_end(ap);
+
+	if (length < 0 || length >= IOBATCH_SCRATCH_SIZE) {
+		errorMsg("\tformatted string does not fit in the scratch space\n");
+		batch->error = WRITE_ERROR;
+		return WRITE_ERROR;
+	}
+
+	return batchAppendCopy(batch, temp, length);
+}
@@ -42,6 +42,12 @@ ICalErrorCode initializeDateTime(const char *line, DateTime *dt) {
         return INV_DT;
     }
 
+    // A valid DateTime is far shorter than 'data' (see below), so a longer one can be rejected before it is copied
+    if (len - colonIndex - 1 >= (int)sizeof(data)) {
+		errorMsg("DateTime is %d characters long\n", len - colonIndex - 1);
+        return INV_DT;
+    }
+
     // ignore everything before (and including) the property name and ':' or ';'
     strcpy(data, line + colonIndex + 1);
 
@@ -84,7 +90,8 @@ ICalErrorCode initializeDateTime(const char *line, DateTime *dt) {
  * and INV_CAL if either the name or description is blank.
  */
 ICalErrorCode initializeProperty(const char *line, Property **prop) {
-    char name[200], descr[2000];
+    char name[200];
+    const char *descr;
     const char delim[] = ";:";
     int firstDelim, length;
 
@@ -108,10 +115,18 @@ ICalErrorCode initializeProperty(const char *line, Property **prop) {
         return INV_CAL;
     }
 
+    if (firstDelim >= sizeof(name)) {
+        // Property names are stored in a fixed-size array
+        errorMsg("\tproperty name is %d characters long\n", firstDelim);
+        return INV_CAL;
+    }
+
     strncpy(name, line, firstDelim);
     name[firstDelim] = '\0';    // strncpy does not automatically null-terminate
 
-    strcpy(descr, line + firstDelim + 1);
+    // Descriptions can be any length (long ones are folded across several lines),
+    // so it is used straight from 'line' instead of being copied into a buffer
+    descr = line + firstDelim + 1;
 
     if (strlen(name) == 0 || strlen(descr) == 0) {
         // name or property value is missing
@@ -0,0 +1,303 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  JobQueue.c                      *
+ ************************************/
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "JobQueue.h"
+#include "Debug.h"
+
+typedef struct job {
+	int id;
+	JobFunction run;
+	char *args[MAX_JOB_ARGS];
+	int numArgs;
+	bool large;
+	// The file the job writes to, or NULL if it doesn't write to one
+	const char *writes;
+	char *result;
+	struct job *next;
+} Job;
+
+// A list of jobs, in the order they were added
+typedef struct joblist {
+	Job *head;
+	Job *tail;
+} JobList;
+
+// Everything below is guarded by 'lock'
+static struct {
+	pthread_mutex_t lock;
+	pthread_cond_t ready;
+	bool started;
+	int numThreads;
+	int nextId;
+	// Jobs waiting for a worker, small and large apart
+	JobList small;
+	JobList large;
+	// Jobs a worker is running, and finished jobs waiting for their results to be taken
+	JobList running;
+	JobList finished;
+	int numLargeRunning;
+	// The pipe finished jobs' ids are written to
+	int readFd;
+	int writeFd;
+} pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .ready = PTHREAD_COND_INITIALIZER, .readFd = -1, .writeFd = -1};
+
+static void append(JobList *list, Job *job) {
+	job->next = NULL;
+	if (list->tail == NULL) {
+		list->head = job;
+	} else {
+		list->tail->next = job;
+	}
+	list->tail = job;
+}
+
+// Takes 'job' out of 'list'. 'previous' is the job before it, or NULL if it is first.
+static void removeJob(JobList *list, Job *job, Job *previous) {
+	if (previous == NULL) {
+		list->head = job->next;
+	} else {
+		previous->next = job->next;
+	}
+	if (list->tail == job) {
+		list->tail = previous;
+	}
+	job->next = NULL;
+}
+
+// Returns true if a running job writes to 'path'
+static bool beingWritten(const char *path) {
+	for (Job *job = pool.running.head; job != NULL; job = job->next) {
+		if (job->writes != NULL && strcmp(job->writes, path) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Returns true if a job in 'list' that is waiting for a worker writes to 'path'
+static bool waitingToWrite(const JobList *list, const char *path) {
+	for (Job *job = list->head; job != NULL; job = job->next) {
+		if (job->writes != NULL && strcmp(job->writes, path) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Takes the first job of 'list' that can run now out of it, or returns NULL if none can
+static Job *takeRunnable(JobList *list) {
+	Job *previous = NULL;
+
+	for (Job *job = list->head; job != NULL; previous = job, job = job->next) {
+		if (job->writes == NULL || !beingWritten(job->writes)) {
+			removeJob(list, job, previous);
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+// Returns the next job a worker should run, or NULL if there isn't one it can run yet.
+// Small jobs go first, and large ones never take the last free worker (unless there is only one).
+static Job *nextJob(void) {
+	Job *job = takeRunnable(&pool.small);
+
+	if (job == NULL && (pool.numLargeRunning == 0 || pool.numLargeRunning < pool.numThreads - 1)) {
+		job = takeRunnable(&pool.large);
+	}
+
+	return job;
+}
+
+static void freeJob(Job *job) {
+	for (int i = 0; i < job->numArgs; i++) {
+		free(job->args[i]);
+	}
+	free(job->result);
+	free(job);
+}
+
+static void *worker(void *arg) {
+	(void)arg;
+
+	while (true) {
+		Job *job;
+
+		pthread_mutex_lock(&pool.lock);
+		while ((job = nextJob()) == NULL) {
+			pthread_cond_wait(&pool.ready, &pool.lock);
+		}
+		append(&pool.running, job);
+		pool.numLargeRunning += job->large;
+		pthread_mutex_unlock(&pool.lock);
+
+		char *result = job->run(job->args);
+
+		pthread_mutex_lock(&pool.lock);
+		Job *previous = NULL;
+		for (Job *other = pool.running.head; other != job; previous = other, other = other->next);
+		removeJob(&pool.running, job, previous);
+		pool.numLargeRunning -= job->large;
+		job->result = result;
+		append(&pool.finished, job);
+
+		// A job that was waiting for this one's file, or for a worker to take a large job, may be able to run now
+		pthread_cond_broadcast(&pool.ready);
+
+		// The job may be taken (and freed) as soon as the lock is let go
+		int id = job->id;
+		pthread_mutex_unlock(&pool.lock);
+
+		// The pipe is only written to without the lock held, so a reader that is slow to empty it can't hold up the pool
+		while (write(pool.writeFd, &id, sizeof(int)) < 0 && errno == EINTR);
+	}
+
+	return NULL;
+}
+
+// Starts the pool, if it hasn't been. Must be called with the lock held. Returns false if it could not be started.
+static bool startPool(void) {
+	int fds[2];
+
+	if (pool.started) {
+		return true;
+	}
+
+	// Each write of an id is smaller than PIPE_BUF, so it never gets mixed up with another
+	if (pipe2(fds, O_CLOEXEC) != 0) {
+		errorMsg("\tCould not create the job pipe\n");
+		return false;
+	}
+	pool.readFd = fds[0];
+	pool.writeFd = fds[1];
+
+	long numProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+	int numThreads = (numProcessors < 2) ? 2 : (numProcessors > MAX_JOB_THREADS) ? MAX_JOB_THREADS : (int)numProcessors;
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	for (int i = 0; i < numThreads; i++) {
+		pthread_t thread;
+		if (pthread_create(&thread, &attr, worker, NULL) == 0) {
+			pool.numThreads++;
+		}
+	}
+	pthread_attr_destroy(&attr);
+
+	if (pool.numThreads == 0) {
+		close(pool.readFd);
+		close(pool.writeFd);
+		pool.readFd = pool.writeFd = -1;
+		return false;
+	}
+
+	pool.nextId = 1;
+	pool.started = true;
+	notifyMsg("\tStarted the job queue with %d workers\n", pool.numThreads);
+
+	return true;
+}
+
+/*
+ * Queues a call of 'run' with copies of the 'numArgs' strings in 'args', on 'size' bytes of data. If 'writes'
+ * is true, the job writes to the file at args[0]. The pool is started the first time a job is submitted.
+ * Returns the id of the job (which is positive), or -1 if the pool could not be started or memory could not
+ * be allocated.
+ */
+int submitJob(JobFunction run, const char **args, int numArgs, size_t size, bool writes) {
+	Job *job = calloc(1, sizeof(Job));
+
+	if (job == NULL || numArgs > MAX_JOB_ARGS) {
+		free(job);
+		return -1;
+	}
+
+	job->run = run;
+	for (; job->numArgs < numArgs; job->numArgs++) {
+		if ((job->args[job->numArgs] = strdup(args[job->numArgs])) == NULL) {
+			freeJob(job);
+			return -1;
+		}
+	}
+	job->large = (size >= LARGE_JOB_BYTES);
+	job->writes = (writes && numArgs > 0) ? job->args[0] : NULL;
+
+	pthread_mutex_lock(&pool.lock);
+	if (!startPool()) {
+		pthread_mutex_unlock(&pool.lock);
+		freeJob(job);
+		return -1;
+	}
+
+	// Small jobs are taken before large ones, so a small write queued behind a large write to the same file
+	// would overtake it. It waits in the large queue instead, which keeps the writes to every file in the order
+	// they were submitted (each queue is taken in order, and a file is never written by two jobs at once).
+	if (job->writes != NULL && !job->large && waitingToWrite(&pool.large, job->writes)) {
+		job->large = true;
+	}
+
+	job->id = pool.nextId;
+	// Ids wrap around to 1, long after the job that had it is gone
+	pool.nextId = (pool.nextId == 0x7FFFFFFF) ? 1 : pool.nextId + 1;
+	append(job->large ? &pool.large : &pool.small, job);
+	pthread_cond_broadcast(&pool.ready);
+
+	int id = job->id;
+	pthread_mutex_unlock(&pool.lock);
+
+	return id;
+}
+
+/*
+ * Returns the read end of the pipe that the id of every finished job is written to, starting the pool if it
+ * hasn't been. Returns -1 if the pool could not be started.
+ */
+int jobQueueFd(void) {
+	pthread_mutex_lock(&pool.lock);
+	int fd = startPool() ? pool.readFd : -1;
+	pthread_mutex_unlock(&pool.lock);
+
+	return fd;
+}
+
+/*
+ * Returns the result of the finished job 'id', and forgets the job, so the result can only be taken once.
+ * Returns NULL if there is no such job, or it hasn't finished.
+ */
+char *takeJobResult(int id) {
+	char *result = NULL;
+	Job *previous = NULL;
+
+	pthread_mutex_lock(&pool.lock);
+	for (Job *job = pool.finished.head; job != NULL; previous = job, job = job->next) {
+		if (job->id == id) {
+			removeJob(&pool.finished, job, previous);
+			result = job->result;
+			job->result = NULL;
+			freeJob(job);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&pool.lock);
+
+	return result;
+}
@@ -31,6 +31,9 @@ List * initializeList(char* (*printFunction)(void* toBePrinted),void (*deleteFun
     assert(compareFunction != NULL);
 
     List * tmpList = malloc(sizeof(List));
+	if (tmpList == NULL) {
+		return NULL;
+	}
 	
 	tmpList->head = NULL;
 	tmpList->tail = NULL;
@@ -7,6 +7,8 @@
  *  Parsing.c                       *
  ************************************/
 
+#define _GNU_SOURCE
+
 #include "Parsing.h"
 
 
@@ -158,35 +160,78 @@ char *strUpperCopy(const char *string) {
     return toReturn;
 }
 
+// Reads the next physical line of 'fp' (up to and including its '\n', if it has one) into *buffer, starting
+// at offset 'start', and growing the buffer (whose size is *size) whenever the line doesn't fit.
+// Stores the number of bytes read in 'lineLength', which is 0 at the end of the file.
+// Returns OK, or OTHER_ERROR if the buffer could not be grown.
+static ICalErrorCode readLine(char **buffer, size_t *size, size_t start, size_t *lineLength, FILE *fp) {
+    size_t length = start;
+
+    while (true) {
+        // fgets() needs room for at least one character and the '\0'
+        if (*size - length < 2) {
+            size_t newSize = (*size < READ_FOLD_SIZE) ? READ_FOLD_SIZE : *size * 2;
+            char *grown = realloc(*buffer, newSize);
+
+            if (grown == NULL) {
+                errorMsg("\tcould not grow the line buffer to %zu bytes\n", newSize);
+                return OTHER_ERROR;
+            }
+            *buffer = grown;
+            *size = newSize;
+        }
+
+        if (fgets(*buffer + length, *size - length, fp) == NULL) {
+            break;
+        }
+
+        length += strlen(*buffer + length);
+        if ((*buffer)[length - 1] == '\n') {
+            break;
+        }
+    }
+
+    (*buffer)[length] = '\0';
+    *lineLength = length - start;
+
+    return OK;
+}
+
 /*
- * Reads in at most 'size' bytes from 'fp' and stores it in the buffer pointed to by 'unfolded'.
+ * Reads the next content line from 'fp' into *unfolded, a buffer of *size bytes that is grown with
+ * realloc() whenever the line doesn't fit (like getline(), *unfolded may start out NULL with a *size
+ * of 0, and the caller frees it once it is done reading).
  * Continually reads lines as long as folded lines are encountered. Stops when a line
  * without a fold is read, or if the end of the file is reached.
- * Folded lines are concatenated together, and then unfolded to make one single line with no
- * CRLF(whitesapce) sequences.
- * 'unfold' must be large enough to hold the entire string.
+ * Each physical line is read straight into its place at the end of *unfolded, and its CRLF is
+ * dropped right away. Whether the next line continues the fold is decided by peeking at its first
+ * character, so the file never needs to be rewound and nothing is copied twice.
+ * Trailing whitespace is trimmed, but leading whitespace is kept, as it always has been (trimWhitespace()
+ * returns a pointer past it, which the original reader never used). test/ReadFoldTest.c checks this.
  *
- * Returns OK on a success, INV_FILE if imvalid line endings are found, and any other
- * relevant error if an error is found (for example, INV_CAL if an empty line is found)
+ * Returns OK on a success, INV_FILE if imvalid line endings are found, OTHER_ERROR if the buffer could
+ * not be grown, and any other relevant error if an error is found (for example, INV_CAL if an empty line is found)
  */
-ICalErrorCode readFold(char *unfolded, int size, FILE *fp) {
-    char buf[size];
-    bool foundFold = false;
-    bool allWhitespace;
-    int sizeLeft = size;
-    int bufLength;
-
-    // clear 'unfolded' for more reliable concatenation
-    strcpy(unfolded, "");
+ICalErrorCode readFold(char **unfolded, size_t *size, FILE *fp) {
+    bool allWhitespace, continued = false;
+    size_t length = 0, lineLength;
+    int next;
+    char *line;
+    ICalErrorCode error;
 
-    while (fgets(buf, sizeLeft, fp)) {
-        //debugMsg("\traw buf = \"%s\"\n", buf);
+    while (true) {
+        if ((error = readLine(unfolded, size, length, &lineLength, fp)) != OK) {
+            return error;
+        }
+        if (lineLength == 0) {
+            break;
+        }
+        line = *unfolded + length;
 
         // check if the line is entirely blank lines
         allWhitespace = true;
-        for (int i = 0; i < strlen(buf); i++) {
-            if (!isspace(buf[i])) {
-                //debugMsg("\tfound non-whitespace character: %c - %d\n", buf[i], (unsigned int)buf[i]);
+        for (size_t i = 0; i < lineLength; i++) {
+            if (!isspace((unsigned char)line[i])) {
                 allWhitespace = false;
                 break;
             }
@@ -197,35 +242,45 @@ ICalErrorCode readFold(char *unfolded, int size, FILE *fp) {
             return INV_CAL;
         }
 
-        if (!endsWith(buf, "\r\n")) {
+        if (lineLength < 2 || line[lineLength - 2] != '\r' || line[lineLength - 1] != '\n') {
             // line endings are incorrect
 			errorMsg("Invalid line endings - line does not end with \\r\\n\n");
             return INV_FILE;
         }
 
-        if (buf[0] == ';') {
+        if (line[0] == ';' && !continued) {
             // lines that begin with a semicolon are comments and should be ignored
-            continue;
+            line[0] = '\0';
+        } else {
+            // keep the line, minus its CRLF
+            length += lineLength - 2;
+            (*unfolded)[length] = '\0';
         }
 
-        bufLength = strlen(buf);
-        sizeLeft -= bufLength;
+        if ((next = getc(fp)) == EOF) {
+            break;
+        }
+
+        // A line starting with whitespace continues the current one; the CRLF and that
+        // single whitespace character make up the fold, and are both removed
+        continued = (length > 0 && isspace(next) && next != '\r' && next != '\n');
+        if (continued) {
+            continue;
+        }
 
-        // there were folded lines, but then a non-folded line was found
-        // (i.e. end of fold was found)
-        if (foundFold && !isspace(buf[0])) {
-            // return to the previous line
-            fseek(fp, -bufLength, SEEK_CUR);
+        ungetc(next, fp);
+        if (length > 0 && next != ';') {
+            // the next line is a new content line
             break;
         }
+    }
 
-        // the line must have begun with a space, meaning there is a fold present
-        concat(unfolded, buf);
-        foundFold = true;
+    // trim trailing whitespace (leading whitespace is kept; see above)
+    while (length > 0 && isspace((unsigned char)(*unfolded)[length - 1])) {
+        length--;
     }
+    (*unfolded)[length] = '\0';
 
-    unfold(unfolded);
-    trimWhitespace(unfolded);
     return OK;
 }
 
@@ -242,12 +297,13 @@ ICalErrorCode readFold(char *unfolded, int size, FILE *fp) {
  * precisely like this one.)
  * XXX XXX XXX */
 ICalErrorCode getEvent(FILE *fp, Event **event) {
-    char line[10000], *parse, *name, *descr;
+    char *line = NULL, *parse, *name, *descr, *savePtr;
+    size_t lineSize = 0;
 	char delim[] = ":;";
     ICalErrorCode error;
     bool dtStamp, dtStart, UID, endEvent;
     parse = NULL;
-    dtStamp = dtStart = UID = false;
+    dtStamp = dtStart = UID = endEvent = false;
 
     debugMsg("\t=====START getEvent()=====\n");
 
@@ -262,7 +318,7 @@ ICalErrorCode getEvent(FILE *fp, Event **event) {
             parse = NULL;
         }
 
-        if ((error = readFold(line, 10000, fp)) != OK) {
+        if ((error = readFold(&line, &lineSize, fp)) != OK) {
 			errorMsg("\t\treadFold returned an error\n");
             goto CLEANEV;
         }
@@ -273,7 +329,7 @@ ICalErrorCode getEvent(FILE *fp, Event **event) {
 		}
 
         parse = strUpperCopy(line);
-		if ((name = strtok(parse, delim)) == NULL) {
+		if ((name = strtok_r(parse, delim, &savePtr)) == NULL) {
 			// The line is only delimiters, which obviously is not allowed
 			free(parse);
 			parse = NULL;
@@ -281,7 +337,7 @@ ICalErrorCode getEvent(FILE *fp, Event **event) {
 			goto CLEANEV;
 		}
 
-		if ((descr = strtok(NULL, delim)) == NULL) {
+		if ((descr = strtok_r(NULL, delim, &savePtr)) == NULL) {
 			// The line has no property description, or doesn't contain any delimiters
 			free(parse);
 			parse = NULL;
@@ -358,6 +414,12 @@ ICalErrorCode getEvent(FILE *fp, Event **event) {
                 goto CLEANEV;
             }
 
+            if (strlen(line + 4) >= sizeof((*event)->UID)) {
+				errorMsg("\t\tUID property is too long\n");
+                error = INV_EVENT;
+                goto CLEANEV;
+            }
+
             UID = true;
 
             strcpy((*event)->UID, line + 4);
@@ -399,6 +461,8 @@ ICalErrorCode getEvent(FILE *fp, Event **event) {
 
     free(parse);
     parse = NULL;
+    free(line);
+    line = NULL;
 
     // the file can't end without hitting END:VEVENT (and also END:VCALENDAR)
     // along with a few other mandatory propeprties
@@ -417,6 +481,7 @@ CLEANEV:    deleteEvent(*event);
             if (parse != NULL) {
                 free(parse);
             }
+            free(line);
             return error;
 }
 
@@ -433,12 +498,13 @@ CLEANEV:    deleteEvent(*event);
  * precisely like this one.)
  * XXX XXX XXX */
 ICalErrorCode getAlarm(FILE *fp, Alarm **alarm) {
-    char line[10000], *parse, *name, *descr;
+    char *line = NULL, *parse, *name, *descr, *savePtr;
+    size_t lineSize = 0;
 	char delim[] = ":;";
     bool trigger, action, endAlarm;
     ICalErrorCode error;
     parse = NULL;
-    trigger = action = false;
+    trigger = action = endAlarm = false;
 
     debugMsg("\t\t=====START getAlarm()=====\n");
     if ((error = initializeAlarm(alarm)) != OK) {
@@ -453,7 +519,7 @@ ICalErrorCode getAlarm(FILE *fp, Alarm **alarm) {
             parse = NULL;
         }
 
-        if ((error = readFold(line, 10000, fp)) != OK) {
+        if ((error = readFold(&line, &lineSize, fp)) != OK) {
 			errorMsg("readFold encountered an error\n");
             goto CLEANAL;
         }
@@ -464,7 +530,7 @@ ICalErrorCode getAlarm(FILE *fp, Alarm **alarm) {
 		}
 
         parse = strUpperCopy(line);
-		if ((name = strtok(parse, delim)) == NULL) {
+		if ((name = strtok_r(parse, delim, &savePtr)) == NULL) {
 			// The line is only delimiters, which obviously is not allowed
 			errorMsg("\t\t\tread line contains only delimiters, and could not be tokenized\n");
 			free(parse);
@@ -473,7 +539,7 @@ ICalErrorCode getAlarm(FILE *fp, Alarm **alarm) {
 			goto CLEANAL;
 		}
 
-		if ((descr = strtok(NULL, delim)) == NULL) {
+		if ((descr = strtok_r(NULL, delim, &savePtr)) == NULL) {
 			// The line has no property description, or doesn't contain any delimiters
 			errorMsg("\t\t\tline either contains no property description or contains no delimiters\n");
 			free(parse);
@@ -529,6 +595,12 @@ ICalErrorCode getAlarm(FILE *fp, Alarm **alarm) {
                 goto CLEANAL;
             }
 
+            if (strlen(line + 7) >= sizeof((*alarm)->action)) {
+                errorMsg("\t\t\tACTION property is too long\n");
+                error = INV_ALARM;
+                goto CLEANAL;
+            }
+
             strcpy((*alarm)->action, line + 7);
             debugMsg("\t\t\taction = \"%s\"\n", (*alarm)->action);
         } else if (strcmp(name, "BEGIN") == 0 && (strcmp(descr, "VEVENT") == 0 || strcmp(descr, "VALARM") == 0)) {
@@ -551,6 +623,8 @@ ICalErrorCode getAlarm(FILE *fp, Alarm **alarm) {
 
     free(parse);
     parse = NULL;
+    free(line);
+    line = NULL;
 
     // the file can't end without hitting END:VALARM (and also END:VCALENDAR)
     // and a few other mandatory properties
@@ -569,6 +643,7 @@ CLEANAL:    deleteAlarm(*alarm);
             if (parse != NULL) {
                 free(parse);
             }
+            free(line);
             return error;
 }
 
@@ -0,0 +1,52 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  Random.c                        *
+ ************************************/
+
+#define _GNU_SOURCE
+
+#include <time.h>
+
+#include "Random.h"
+
+// The state of the calling thread's generator, which is 0 until the thread seeds it
+static _Thread_local uint64_t state = 0;
+
+// Counts the threads that have seeded their generators
+static uint64_t numSeeded = 0;
+
+// Turns similar seeds into very different states (the finalizer of splitmix64)
+static uint64_t mix(uint64_t x) {
+	x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+	x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+
+	return x ^ (x >> 31);
+}
+
+/*
+ * Returns the next pseudo-random number of the calling thread.
+ */
+uint32_t randomNumber(void) {
+	if (state == 0) {
+		struct timespec now;
+		clock_gettime(CLOCK_REALTIME, &now);
+
+		state = mix((uint64_t)now.tv_sec * 1000000000 + now.tv_nsec) ^ mix((uintptr_t)&state) \
+		        ^ mix(__atomic_add_fetch(&numSeeded, 1, __ATOMIC_RELAXED) * UINT64_C(0x9e3779b97f4a7c15));
+
+		// xorshift can never leave a state of 0
+		if (state == 0) {
+			state = 1;
+		}
+	}
+
+	state ^= state >> 12;
+	state ^= state << 25;
+	state ^= state >> 27;
+
+	return (uint32_t)((state * UINT64_C(0x2545f4914f6cdd1d)) >> 32);
+}
@@ -0,0 +1,679 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  Recurrence.c                    *
+ ************************************/
+
+#define _GNU_SOURCE
+
+#include <ctype.h>
+#include <strings.h>
+
+#include "Recurrence.h"
+#include "Debug.h"
+
+static const char *weekdayNames[7] = {"SU", "MO", "TU", "WE", "TH", "FR", "SA"};
+
+// Division that rounds towards negative infinity, so that times before DTSTART land in negative periods
+static int64_t floorDiv(int64_t a, int64_t b) {
+	return a / b - ((a % b != 0) && ((a < 0) != (b < 0)));
+}
+
+/**********************
+ * Compiling an RRULE *
+ **********************/
+
+// Returns the weekday (0 is Sunday) named by the two letters at 'str', or -1 if they don't name one
+static int parseWeekday(const char *str) {
+	for (int i = 0; i < 7; i++) {
+		if (strcasecmp(str, weekdayNames[i]) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+// Parses a whole (possibly signed) number that makes up all of 'str'. Returns false if it isn't one.
+static bool parseNumber(const char *str, int *number) {
+	char *end;
+	long value = strtol(str, &end, 10);
+
+	if (end == str || *end != '\0' || value < -1000000 || value > 1000000) {
+		return false;
+	}
+
+	*number = (int)value;
+	return true;
+}
+
+// Compiles a comma-separated BYxxx list into 'rule'. 'part' is the name of the rule part.
+static ICalErrorCode parseByList(RecurrenceRule *rule, const char *part, char *list) {
+	char *savePtr, *item;
+
+	for (item = strtok_r(list, ",", &savePtr); item != NULL; item = strtok_r(NULL, ",", &savePtr)) {
+		int number;
+
+		if (strcasecmp(part, "BYMONTH") == 0) {
+			if (!parseNumber(item, &number) || number < 1 || number > 12) {
+				return INV_EVENT;
+			}
+			rule->byMonth |= (uint16_t)(1u << number);
+		} else if (strcasecmp(part, "BYMONTHDAY") == 0) {
+			if (!parseNumber(item, &number) || number == 0 || number < -31 || number > 31) {
+				return INV_EVENT;
+			}
+			if (number > 0) {
+				rule->byMonthDay |= 1u << (number - 1);
+			} else {
+				rule->byNegMonthDay |= 1u << (-number - 1);
+			}
+		} else {
+			// BYDAY: an optional ordinal, followed by the two letter weekday
+			size_t length = strlen(item);
+			int weekday = (length >= 2) ? parseWeekday(item + length - 2) : -1;
+
+			if (weekday < 0) {
+				return INV_EVENT;
+			}
+
+			if (length == 2) {
+				rule->byDay |= (uint8_t)(1u << weekday);
+				continue;
+			}
+
+			item[length - 2] = '\0';
+			if (!parseNumber(item, &number) || number == 0 || number < -53 || number > 53 \
+			    || rule->numOrdinalDays == MAX_ORDINAL_DAYS) {
+				return INV_EVENT;
+			}
+			rule->ordinalDays[rule->numOrdinalDays].ordinal = number;
+			rule->ordinalDays[rule->numOrdinalDays].weekday = weekday;
+			rule->numOrdinalDays++;
+		}
+	}
+
+	return OK;
+}
+
+// Compiles the value of an RRULE property (e.g. "FREQ=MONTHLY;BYDAY=-1FR;COUNT=10") into 'rule'
+static ICalErrorCode compileRule(const char *value, RecurrenceRule *rule) {
+	static const char *freqNames[] = {"SECONDLY", "MINUTELY", "HOURLY", "DAILY", "WEEKLY", "MONTHLY", "YEARLY"};
+	ICalErrorCode error = OK;
+	char *copy = strdup(value), *savePtr, *part;
+	bool foundFreq, foundUntil;
+	foundFreq = foundUntil = false;
+
+	memset(rule, 0, sizeof(RecurrenceRule));
+	rule->interval = 1;
+	rule->until = INT64_MAX;
+	rule->weekStart = 1;	// Monday
+
+	for (part = strtok_r(copy, ";", &savePtr); part != NULL && error == OK; part = strtok_r(NULL, ";", &savePtr)) {
+		char *partValue = strchr(part, '=');
+
+		if (partValue == NULL) {
+			errorMsg("\tRRULE part \"%s\" has no value\n", part);
+			error = INV_EVENT;
+			break;
+		}
+		*(partValue++) = '\0';
+
+		if (strcasecmp(part, "FREQ") == 0) {
+			for (int i = 0; i < 7; i++) {
+				if (strcasecmp(partValue, freqNames[i]) == 0) {
+					rule->freq = (enum recurFreq)i;
+					foundFreq = true;
+				}
+			}
+			error = foundFreq ? OK : INV_EVENT;
+		} else if (strcasecmp(part, "INTERVAL") == 0) {
+			error = (parseNumber(partValue, &rule->interval) && rule->interval > 0) ? OK : INV_EVENT;
+		} else if (strcasecmp(part, "COUNT") == 0) {
+			error = (parseNumber(partValue, &rule->count) && rule->count > 0) ? OK : INV_EVENT;
+		} else if (strcasecmp(part, "UNTIL") == 0) {
+			bool isDate = false;
+			error = parseTimeValue(partValue, &rule->until, &isDate) == OK ? OK : INV_EVENT;
+			if (isDate) {
+				// A DATE means the whole day is included
+				rule->until += SECONDS_PER_DAY - 1;
+			}
+			foundUntil = true;
+		} else if (strcasecmp(part, "BYMONTH") == 0 || strcasecmp(part, "BYMONTHDAY") == 0 || strcasecmp(part, "BYDAY") == 0) {
+			error = parseByList(rule, part, partValue);
+		} else if (strcasecmp(part, "WKST") == 0) {
+			error = ((rule->weekStart = parseWeekday(partValue)) >= 0) ? OK : INV_EVENT;
+		} else if (strcasecmp(part, "BYSECOND") == 0 || strcasecmp(part, "BYMINUTE") == 0 || strcasecmp(part, "BYHOUR") == 0 \
+		           || strcasecmp(part, "BYYEARDAY") == 0 || strcasecmp(part, "BYWEEKNO") == 0 || strcasecmp(part, "BYSETPOS") == 0) {
+			errorMsg("\tRRULE part %s is not supported\n", part);
+			error = OTHER_ERROR;
+		}
+		// Any other (e.g. experimental X-) rule part is ignored
+	}
+	free(copy);
+
+	if (error == OK && (!foundFreq || (foundUntil && rule->count > 0))) {
+		errorMsg("\tRRULE \"%s\" has no FREQ, or has both COUNT and UNTIL\n", value);
+		error = INV_EVENT;
+	}
+
+	// Ordinals only mean something in a month or a year, so in any other rule "2MO" is just "MO"
+	if (rule->freq < FREQ_MONTHLY) {
+		for (int i = 0; i < rule->numOrdinalDays; i++) {
+			rule->byDay |= (uint8_t)(1u << rule->ordinalDays[i].weekday);
+		}
+		rule->numOrdinalDays = 0;
+	}
+
+	return error;
+}
+
+/*****************************
+ * Expanding a single period *
+ *****************************/
+
+// Number of seconds in one period of a SECONDLY, MINUTELY or HOURLY rule
+static int64_t periodLength(const RecurrenceRule *rule) {
+	static const int64_t unitLengths[] = {1, 60, 3600};
+
+	return unitLengths[rule->freq] * rule->interval;
+}
+
+// The first day of the week that 'day' is in
+static int64_t weekStartOf(int64_t day, int weekStart) {
+	return day - ((weekdayFromDays(day) - weekStart + 7) % 7);
+}
+
+// Whether the day 'day' (which is the date y-m-d) passes the rule's BYMONTHDAY and BYDAY parts. Ordinals
+// count weekdays in the year if 'ordinalsInYear' is set, and in the month otherwise.
+static bool matchesDay(const RecurrenceRule *rule, int64_t day, int year, int month, int dayOfMonth, bool ordinalsInYear) {
+	int monthLength = daysInMonth(year, month);
+
+	if ((rule->byMonthDay | rule->byNegMonthDay) != 0 && !(rule->byMonthDay & (1u << (dayOfMonth - 1))) \
+	    && !(rule->byNegMonthDay & (1u << (monthLength - dayOfMonth)))) {
+		return false;
+	}
+
+	if (rule->byDay == 0 && rule->numOrdinalDays == 0) {
+		return true;
+	}
+
+	int weekday = weekdayFromDays(day);
+	if (rule->byDay & (1u << weekday)) {
+		return true;
+	}
+
+	// This is the nth such weekday in the month or year, and the nthFromEnd-th from the end of it
+	int position, length;
+	if (ordinalsInYear) {
+		position = (int)(day - daysFromDate(year, 1, 1));
+		length = (int)(daysFromDate(year + 1, 1, 1) - daysFromDate(year, 1, 1));
+	} else {
+		position = dayOfMonth - 1;
+		length = monthLength;
+	}
+	int nth = position / 7 + 1;
+	int nthFromEnd = (length - 1 - position) / 7 + 1;
+
+	for (int i = 0; i < rule->numOrdinalDays; i++) {
+		const OrdinalDay *ord = &rule->ordinalDays[i];
+		if (ord->weekday == weekday && (ord->ordinal > 0 ? ord->ordinal == nth : -ord->ordinal == nthFromEnd)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Whether the day 'day' passes the rule's BYMONTH, BYMONTHDAY and BYDAY parts (as limits, not expansions)
+static bool dayPassesLimits(const RecurrenceRule *rule, int64_t day) {
+	int year, month, dayOfMonth;
+	dateFromDays(day, &year, &month, &dayOfMonth);
+
+	if (rule->byMonth != 0 && !(rule->byMonth & (1u << month))) {
+		return false;
+	}
+
+	return matchesDay(rule, day, year, month, dayOfMonth, false);
+}
+
+// Adds the occurrence at 'day' (at DTSTART's time of day) to the buffer, unless it is before DTSTART
+// or after UNTIL
+static void bufferDay(OccurrenceIterator *iter, int64_t day) {
+	const Recurrence *rec = iter->rec;
+	int64_t startDay = floorDiv(rec->start, SECONDS_PER_DAY);
+	int64_t time = day * SECONDS_PER_DAY + (rec->start - startDay * SECONDS_PER_DAY);
+
+	if (time < rec->start) {
+		return;
+	}
+	if (time > rec->rule.until) {
+		iter->lastPeriod = true;
+		return;
+	}
+
+	iter->buffer[iter->numBuffered++] = time;
+}
+
+// Adds every day of the month y-m that the rule picks to the buffer
+static void bufferMonth(OccurrenceIterator *iter, int year, int month, bool ordinalsInYear) {
+	const RecurrenceRule *rule = &iter->rec->rule;
+	int startYear, startMonth, startDayOfMonth;
+	int64_t firstDay = daysFromDate(year, month, 1);
+	int monthLength = daysInMonth(year, month);
+
+	dateFromDays(floorDiv(iter->rec->start, SECONDS_PER_DAY), &startYear, &startMonth, &startDayOfMonth);
+
+	// Without BYMONTHDAY or BYDAY, the rule repeats DTSTART's day of the month (and month, for a
+	// YEARLY rule without BYMONTH)
+	if ((rule->byMonthDay | rule->byNegMonthDay) == 0 && rule->byDay == 0 && rule->numOrdinalDays == 0) {
+		if (startDayOfMonth <= monthLength && (rule->freq != FREQ_YEARLY || rule->byMonth != 0 || month == startMonth)) {
+			bufferDay(iter, firstDay + startDayOfMonth - 1);
+		}
+		return;
+	}
+
+	for (int d = 1; d <= monthLength; d++) {
+		if (matchesDay(rule, firstDay + d - 1, year, month, d, ordinalsInYear)) {
+			bufferDay(iter, firstDay + d - 1);
+		}
+	}
+}
+
+// Fills the buffer with the occurrences of the rule in period iter->period, and moves on to the next period
+static void loadPeriod(OccurrenceIterator *iter) {
+	const Recurrence *rec = iter->rec;
+	const RecurrenceRule *rule = &rec->rule;
+	int64_t startDay = floorDiv(rec->start, SECONDS_PER_DAY);
+	int64_t firstDay;
+	int startYear, startMonth, startDayOfMonth;
+
+	iter->numBuffered = iter->nextBuffered = 0;
+	dateFromDays(startDay, &startYear, &startMonth, &startDayOfMonth);
+
+	switch (rule->freq) {
+		case FREQ_SECONDLY:
+		case FREQ_MINUTELY:
+		case FREQ_HOURLY: {
+			int64_t time = rec->start + iter->period * periodLength(rule);
+			int64_t day = floorDiv(time, SECONDS_PER_DAY);
+			firstDay = day;
+
+			if (time > rule->until) {
+				iter->lastPeriod = true;
+				break;
+			}
+			if (dayPassesLimits(rule, day)) {
+				iter->buffer[iter->numBuffered++] = time;
+				iter->period++;
+			} else {
+				// None of the rest of the day can pass either, so skip straight to the next day
+				int64_t nextDay = (day + 1) * SECONDS_PER_DAY - rec->start;
+				iter->period = floorDiv(nextDay + periodLength(rule) - 1, periodLength(rule));
+			}
+			break;
+		}
+		case FREQ_DAILY:
+			firstDay = startDay + iter->period * rule->interval;
+			if (dayPassesLimits(rule, firstDay)) {
+				bufferDay(iter, firstDay);
+			}
+			iter->period++;
+			break;
+		case FREQ_WEEKLY:
+			firstDay = weekStartOf(startDay, rule->weekStart) + iter->period * 7 * rule->interval;
+			for (int i = 0; i < 7; i++) {
+				int64_t day = firstDay + i;
+				// Without BYDAY (or BYMONTHDAY), the rule repeats DTSTART's day of the week
+				bool weekdayOk = (rule->byDay == 0 && (rule->byMonthDay | rule->byNegMonthDay) == 0) ? \
+				                 weekdayFromDays(day) == weekdayFromDays(startDay) : true;
+
+				if (weekdayOk && dayPassesLimits(rule, day)) {
+					bufferDay(iter, day);
+				}
+			}
+			iter->period++;
+			break;
+		case FREQ_MONTHLY: {
+			int64_t months = (int64_t)startYear * 12 + (startMonth - 1) + iter->period * rule->interval;
+			int year = (int)floorDiv(months, 12), month = (int)(months - (int64_t)year * 12) + 1;
+			firstDay = daysFromDate(year, month, 1);
+
+			if (rule->byMonth == 0 || (rule->byMonth & (1u << month))) {
+				bufferMonth(iter, year, month, false);
+			}
+			iter->period++;
+			break;
+		}
+		case FREQ_YEARLY: {
+			int year = startYear + (int)(iter->period * rule->interval);
+			firstDay = daysFromDate(year, 1, 1);
+
+			for (int month = 1; month <= 12; month++) {
+				if (rule->byMonth == 0 || (rule->byMonth & (1u << month))) {
+					bufferMonth(iter, year, month, rule->byMonth == 0);
+				}
+			}
+			iter->period++;
+			break;
+		}
+	}
+
+	// The rule is over once a whole period is past UNTIL, or past the end of the year 9999
+	if (firstDay * SECONDS_PER_DAY > rule->until || firstDay > daysFromDate(10000, 1, 1)) {
+		iter->lastPeriod = true;
+	}
+}
+
+// Makes sure the next occurrence of the rule is in the buffer. Returns false once the rule is over.
+static bool fillBuffer(OccurrenceIterator *iter) {
+	int emptyPeriods = 0;
+
+	while (!iter->ruleDone && iter->nextBuffered >= iter->numBuffered) {
+		if (iter->lastPeriod || emptyPeriods++ > MAX_EMPTY_PERIODS \
+		    || (iter->rec->rule.count > 0 && iter->produced >= iter->rec->rule.count)) {
+			iter->ruleDone = true;
+			break;
+		}
+		loadPeriod(iter);
+	}
+
+	return !iter->ruleDone;
+}
+
+// Takes the next occurrence of the rule out of the buffer (fillBuffer() must have returned true)
+static int64_t takeFromRule(OccurrenceIterator *iter) {
+	iter->produced++;
+	if (iter->rec->rule.count > 0 && iter->produced >= iter->rec->rule.count) {
+		iter->lastPeriod = true;
+		iter->numBuffered = iter->nextBuffered + 1;
+	}
+
+	return iter->buffer[iter->nextBuffered++];
+}
+
+// Whether each period of the rule has exactly one occurrence, so the number of occurrences before a
+// period is the number of the period
+static bool isSimpleRule(const Recurrence *rec) {
+	const RecurrenceRule *rule = &rec->rule;
+	int year, month, day;
+
+	if (rule->byMonth != 0 || (rule->byMonthDay | rule->byNegMonthDay) != 0 || rule->byDay != 0 || rule->numOrdinalDays != 0) {
+		return false;
+	}
+
+	dateFromDays(floorDiv(rec->start, SECONDS_PER_DAY), &year, &month, &day);
+
+	// Some months don't have a 29th-31st, and most years don't have a February 29th
+	return rule->freq < FREQ_MONTHLY || (rule->freq == FREQ_MONTHLY && day <= 28) \
+	       || (rule->freq == FREQ_YEARLY && !(month == 2 && day == 29));
+}
+
+// The period of the rule that 'time' is in (or 0, if it is before DTSTART's)
+static int64_t periodOf(const Recurrence *rec, int64_t time) {
+	const RecurrenceRule *rule = &rec->rule;
+	int64_t startDay = floorDiv(rec->start, SECONDS_PER_DAY), day = floorDiv(time, SECONDS_PER_DAY);
+	int startYear, startMonth, year, month, dayOfMonth;
+	int64_t period = 0;
+
+	dateFromDays(startDay, &startYear, &startMonth, &dayOfMonth);
+	dateFromDays(day, &year, &month, &dayOfMonth);
+
+	switch (rule->freq) {
+		case FREQ_SECONDLY:
+		case FREQ_MINUTELY:
+		case FREQ_HOURLY:
+			period = floorDiv(time - rec->start, periodLength(rule));
+			break;
+		case FREQ_DAILY:
+			period = floorDiv(day - startDay, rule->interval);
+			break;
+		case FREQ_WEEKLY:
+			period = floorDiv((weekStartOf(day, rule->weekStart) - weekStartOf(startDay, rule->weekStart)) / 7, rule->interval);
+			break;
+		case FREQ_MONTHLY:
+			period = floorDiv(((int64_t)year * 12 + month) - ((int64_t)startYear * 12 + startMonth), rule->interval);
+			break;
+		case FREQ_YEARLY:
+			period = floorDiv(year - startYear, rule->interval);
+			break;
+	}
+
+	return (period < 0) ? 0 : period;
+}
+
+/******************
+ * The public API *
+ ******************/
+
+static int compareTimes(const void *first, const void *second) {
+	int64_t a = *(const int64_t *)first, b = *(const int64_t *)second;
+
+	return (a > b) - (a < b);
+}
+
+// Adds every time in the value of an RDATE or EXDATE property to 'times'. A DATE is taken to be at the
+// same time of day as DTSTART, and a PERIOD (for RDATE) at the time it starts.
+static ICalErrorCode addTimeList(const Property *prop, int64_t start, int64_t **times, int *numTimes) {
+	const char *colon = strrchr(prop->propDescr, ':');
+	char *copy = strdup((colon == NULL) ? prop->propDescr : colon + 1), *savePtr, *item;
+	ICalErrorCode error = OK;
+
+	for (item = strtok_r(copy, ",", &savePtr); item != NULL; item = strtok_r(NULL, ",", &savePtr)) {
+		int64_t time;
+		bool isDate;
+
+		if (strchr(item, '/') != NULL) {
+			*strchr(item, '/') = '\0';
+		}
+		if (parseTimeValue(item, &time, &isDate) != OK) {
+			error = INV_EVENT;
+			break;
+		}
+		if (isDate) {
+			time += start - floorDiv(start, SECONDS_PER_DAY) * SECONDS_PER_DAY;
+		}
+
+		// Grow the array whenever its size reaches a power of 2
+		if ((*numTimes & (*numTimes - 1)) == 0) {
+			*times = realloc(*times, sizeof(int64_t) * (*numTimes == 0 ? 1 : *numTimes * 2));
+		}
+		(*times)[(*numTimes)++] = time;
+	}
+
+	free(copy);
+	return error;
+}
+
+/*
+ * Compiles the DTSTART, DTEND/DURATION, RRULE, RDATE and EXDATE properties of 'ev' into a Recurrence,
+ * and stores it in 'rec'. An Event without an RRULE or any RDATEs just occurs once, at DTSTART.
+ * Returns OK, INV_EVENT if one of the properties is malformed, or OTHER_ERROR if the RRULE uses a rule part
+ * that isn't supported (BYSECOND, BYMINUTE, BYHOUR, BYYEARDAY, BYWEEKNO or BYSETPOS).
+ */
+ICalErrorCode compileRecurrence(const Event *ev, Recurrence **rec) {
+	debugMsg("-----START compileRecurrence()-----\n");
+	ICalErrorCode error = OK;
+	TimeSpan span;
+	Property *prop;
+
+	*rec = NULL;
+	if (ev == NULL || getEventSpan(ev, &span) != OK) {
+		return INV_EVENT;
+	}
+
+	Recurrence *toReturn = calloc(1, sizeof(Recurrence));
+	toReturn->start = span.start;
+	toReturn->duration = span.end - span.start;
+	toReturn->UTC = ev->startDateTime.UTC;
+
+	ListIterator iter = createIterator(ev->properties);
+	while (error == OK && (prop = (Property *)nextElement(&iter)) != NULL) {
+		if (strcasecmp(prop->propName, "RRULE") == 0 && !toReturn->hasRule) {
+			// A second RRULE is ignored
+			error = compileRule(prop->propDescr, &toReturn->rule);
+			toReturn->hasRule = true;
+		} else if (strcasecmp(prop->propName, "RDATE") == 0) {
+			error = addTimeList(prop, span.start, &toReturn->rdates, &toReturn->numRDates);
+		} else if (strcasecmp(prop->propName, "EXDATE") == 0) {
+			error = addTimeList(prop, span.start, &toReturn->exdates, &toReturn->numExDates);
+		}
+	}
+
+	if (error != OK) {
+		deleteRecurrence(toReturn);
+		return error;
+	}
+
+	qsort(toReturn->rdates, toReturn->numRDates, sizeof(int64_t), compareTimes);
+	qsort(toReturn->exdates, toReturn->numExDates, sizeof(int64_t), compareTimes);
+
+	// See whether the rule produces DTSTART itself, or whether it has to be added on
+	if (toReturn->hasRule) {
+		OccurrenceIterator first = {.rec = toReturn};
+
+		loadPeriod(&first);
+		toReturn->ruleHasStart = (first.numBuffered > 0 && first.buffer[0] == toReturn->start);
+	}
+
+	*rec = toReturn;
+	return OK;
+}
+
+/*
+ * Frees a Recurrence.
+ */
+void deleteRecurrence(Recurrence *rec) {
+	if (rec == NULL) {
+		return;
+	}
+
+	free(rec->rdates);
+	free(rec->exdates);
+	free(rec);
+}
+
+/*
+ * Sets up 'iter' to produce every occurrence of 'rec' that starts at or after 'from', in order.
+ */
+void startOccurrences(const Recurrence *rec, int64_t from, OccurrenceIterator *iter) {
+	iter->rec = rec;
+	iter->period = 0;
+	iter->numBuffered = iter->nextBuffered = 0;
+	iter->lastPeriod = false;
+	iter->returnedAny = false;
+	iter->ruleDone = !rec->hasRule;
+	// DTSTART is always the first occurrence, and counts towards COUNT even if the rule doesn't produce it
+	iter->startPending = (!rec->hasRule || !rec->ruleHasStart) && rec->start >= from;
+	iter->produced = (rec->hasRule && !rec->ruleHasStart) ? 1 : 0;
+
+	// Skip the RDATEs before 'from'
+	int lo = 0, hi = rec->numRDates;
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+		if (rec->rdates[mid] < from) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	iter->nextRDate = lo;
+
+	if (!rec->hasRule) {
+		return;
+	}
+
+	// Jump straight to the period 'from' is in, unless the occurrences before it have to be counted one
+	// at a time. Only the first few occurrences of that period then have to be skipped.
+	if (rec->rule.count == 0 || isSimpleRule(rec)) {
+		iter->period = periodOf(rec, from);
+		iter->produced += (rec->rule.count > 0) ? (int)((iter->period < rec->rule.count) ? iter->period : rec->rule.count) : 0;
+	}
+
+	while (fillBuffer(iter) && iter->buffer[iter->nextBuffered] < from) {
+		takeFromRule(iter);
+	}
+}
+
+/*
+ * Stores the start of the next occurrence in 'start'. Returns false (and leaves 'start' alone) once there
+ * are no more occurrences.
+ */
+bool nextOccurrence(OccurrenceIterator *iter, int64_t *start) {
+	const Recurrence *rec = iter->rec;
+
+	while (true) {
+		// Take whichever of DTSTART, the rule and the RDATEs comes next
+		int64_t next = INT64_MAX;
+		int source = -1;
+
+		if (iter->startPending) {
+			next = rec->start;
+			source = 0;
+		}
+		if (fillBuffer(iter) && iter->buffer[iter->nextBuffered] < next) {
+			next = iter->buffer[iter->nextBuffered];
+			source = 1;
+		}
+		if (iter->nextRDate < rec->numRDates && rec->rdates[iter->nextRDate] < next) {
+			next = rec->rdates[iter->nextRDate];
+			source = 2;
+		}
+
+		if (source == 0) {
+			iter->startPending = false;
+		} else if (source == 1) {
+			takeFromRule(iter);
+		} else if (source == 2) {
+			iter->nextRDate++;
+		} else {
+			return false;
+		}
+
+		// Skip occurrences that were already returned, or that are excluded
+		if ((iter->returnedAny && next == iter->last) \
+		    || bsearch(&next, rec->exdates, rec->numExDates, sizeof(int64_t), compareTimes) != NULL) {
+			continue;
+		}
+
+		iter->last = next;
+		iter->returnedAny = true;
+		*start = next;
+		return true;
+	}
+}
+
+/*
+ * Returns a newly allocated JSON array of the occurrences of 'rec' that overlap 'range', as
+ * [{"startDT":...,"endDT":...},...], in order. At most 'maxOccurrences' are included.
+ */
+char *occurrencesToJSON(const Recurrence *rec, TimeSpan range, int maxOccurrences) {
+	OccurrenceIterator iter;
+	int64_t start;
+	char *toReturn;
+	size_t length;
+	FILE *json = open_memstream(&toReturn, &length);
+
+	// An occurrence that starts before the range still overlaps it if it hasn't ended by the time it starts
+	startOccurrences(rec, (rec->duration > 0) ? range.start - rec->duration + 1 : range.start, &iter);
+
+	fputc('[', json);
+	for (int i = 0; i < maxOccurrences && nextOccurrence(&iter, &start) && start < range.end; i++) {
+		DateTime startDT, endDT;
+		secondsToDateTime(start, rec->UTC, &startDT);
+		secondsToDateTime(start + rec->duration, rec->UTC, &endDT);
+
+		char *startJSON = dtToJSON(startDT);
+		char *endJSON = dtToJSON(endDT);
+		fprintf(json, "%s{\"startDT\":%s,\"endDT\":%s}", (i == 0) ? "" : ",", startJSON, endJSON);
+		free(startJSON);
+		free(endJSON);
+	}
+	fputc(']', json);
+	fclose(json);
+
+	return toReturn;
+}
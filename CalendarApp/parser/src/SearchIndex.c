@@ -0,0 +1,498 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  SearchIndex.c                   *
+ ************************************/
+
+#include <ctype.h>
+#include <strings.h>
+
+#include "SearchIndex.h"
+#include "Debug.h"
+
+// A posting is two varints of at most 5 bytes each
+#define MAX_POSTING_BYTES 10
+
+// The properties whose words are indexed
+static const char *indexedProps[] = {"SUMMARY", "DESCRIPTION", "LOCATION"};
+
+// One word of one Event, used while building the index
+typedef struct tokenentry {
+	// Where the word is in the block of every word found, until that block stops growing
+	size_t offset;
+	const char *token;
+	int calendar;
+	int event;
+} TokenEntry;
+
+// The terms that one word of a query matches, terms[lo] to terms[hi - 1], and how many postings they have
+typedef struct queryword {
+	int lo;
+	int hi;
+	long numPostings;
+} QueryWord;
+
+static int compareTokenEntries(const void *first, const void *second) {
+	const TokenEntry *a = first, *b = second;
+	int cmp = strcmp(a->token, b->token);
+
+	if (cmp != 0) {
+		return cmp;
+	}
+	if (a->calendar != b->calendar) {
+		return a->calendar - b->calendar;
+	}
+	return a->event - b->event;
+}
+
+static int compareQueryWords(const void *first, const void *second) {
+	const QueryWord *a = first, *b = second;
+
+	return (a->numPostings > b->numPostings) - (a->numPostings < b->numPostings);
+}
+
+static int compareInts(const void *first, const void *second) {
+	int a = *(const int *)first, b = *(const int *)second;
+
+	return (a > b) - (a < b);
+}
+
+static bool isTokenChar(char c) {
+	return isalnum((unsigned char)c) || (unsigned char)c >= 0x80;
+}
+
+// Reads the word of 'text' that starts at or after *pos into 'token', lower-cased and cut down to
+// MAX_TOKEN_LENGTH bytes, and moves *pos to just after it. Escaped characters (e.g. "\n" or "\,") split
+// words apart. Returns the length of the word, or 0 if there are no more words.
+static int nextToken(const char *text, size_t *pos, char token[MAX_TOKEN_LENGTH + 1]) {
+	size_t i = *pos;
+	int length = 0;
+
+	while (text[i] != '\0' && !isTokenChar(text[i])) {
+		if (text[i] == '\\' && text[i + 1] != '\0') {
+			i++;
+		}
+		i++;
+	}
+
+	while (isTokenChar(text[i])) {
+		if (length < MAX_TOKEN_LENGTH) {
+			token[length++] = tolower((unsigned char)text[i]);
+		}
+		i++;
+	}
+
+	token[length] = '\0';
+	*pos = i;
+	return length;
+}
+
+// Writes 'value' at the end of 'out' as a varint: 7 bits per byte, lowest first, with the top bit set on
+// every byte but the last
+static void writeVarint(uint8_t *out, size_t *length, uint32_t value) {
+	while (value >= 0x80) {
+		out[(*length)++] = (uint8_t)(value | 0x80);
+		value >>= 7;
+	}
+	out[(*length)++] = (uint8_t)value;
+}
+
+// Reads the varint at 'in' into 'value', and returns a pointer to the byte after it
+static const uint8_t *readVarint(const uint8_t *in, uint32_t *value) {
+	uint32_t result = 0;
+	int shift = 0;
+
+	while (*in & 0x80) {
+		result |= (uint32_t)(*in & 0x7F) << shift;
+		shift += 7;
+		in++;
+	}
+	*value = result | ((uint32_t)*in << shift);
+
+	return in + 1;
+}
+
+// Makes room for 'needed' elements of 'elemSize' bytes in the growing array *array, which has room for *size.
+// Returns false if memory could not be allocated.
+static bool reserve(void **array, size_t *size, size_t needed, size_t elemSize) {
+	if (needed <= *size) {
+		return true;
+	}
+
+	size_t newSize = (*size == 0) ? 256 : *size;
+	while (newSize < needed) {
+		newSize *= 2;
+	}
+
+	void *grown = realloc(*array, newSize * elemSize);
+	if (grown == NULL) {
+		return false;
+	}
+
+	*array = grown;
+	*size = newSize;
+	return true;
+}
+
+static bool isIndexedProp(const Property *prop) {
+	for (size_t i = 0; i < sizeof(indexedProps) / sizeof(indexedProps[0]); i++) {
+		if (strcasecmp(prop->propName, indexedProps[i]) == 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Adds every word of every indexed property of 'ev' to 'entries', with the words themselves appended to 'text'.
+// Returns false if memory could not be allocated.
+static bool collectTokens(const Event *ev, int calendar, int event, TokenEntry **entries, size_t *numEntries, \
+                          size_t *entriesSize, char **text, size_t *textLength, size_t *textSize) {
+	char token[MAX_TOKEN_LENGTH + 1];
+	Property *prop;
+	int length;
+
+	ListIterator iter = createIterator(ev->properties);
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		if (!isIndexedProp(prop)) {
+			continue;
+		}
+
+		size_t pos = 0;
+		while ((length = nextToken(prop->propDescr, &pos, token)) > 0) {
+			if (!reserve((void **)entries, entriesSize, *numEntries + 1, sizeof(TokenEntry)) \
+			    || !reserve((void **)text, textSize, *textLength + length + 1, sizeof(char))) {
+				return false;
+			}
+
+			(*entries)[*numEntries].offset = *textLength;
+			(*entries)[*numEntries].calendar = calendar;
+			(*entries)[*numEntries].event = event;
+			(*numEntries)++;
+
+			memcpy(*text + *textLength, token, length + 1);
+			*textLength += length + 1;
+		}
+	}
+
+	return true;
+}
+
+// Fills in the terms and postings of 'index' from 'entries', which must be sorted. Returns false if memory
+// could not be allocated.
+static bool buildPostings(SearchIndex *index, const TokenEntry *entries, size_t numEntries) {
+	size_t textLength = 0;
+	int numTerms = 0;
+
+	for (size_t i = 0; i < numEntries; i++) {
+		if (i == 0 || strcmp(entries[i].token, entries[i - 1].token) != 0) {
+			numTerms++;
+			textLength += strlen(entries[i].token) + 1;
+		}
+	}
+
+	index->numTerms = numTerms;
+	index->terms = malloc(sizeof(char *) * (numTerms + 1));
+	index->termText = malloc(textLength + 1);
+	index->postingStart = malloc(sizeof(size_t) * (numTerms + 1));
+	index->postingCount = malloc(sizeof(int) * (numTerms + 1));
+	index->postings = malloc(numEntries * MAX_POSTING_BYTES + 1);
+
+	if (index->terms == NULL || index->termText == NULL || index->postingStart == NULL \
+	    || index->postingCount == NULL || index->postings == NULL) {
+		return false;
+	}
+
+	char *text = index->termText;
+	size_t length = 0;
+	int term = -1, prevCalendar = 0, prevEvent = 0;
+
+	for (size_t i = 0; i < numEntries; i++) {
+		if (i == 0 || strcmp(entries[i].token, entries[i - 1].token) != 0) {
+			term++;
+			strcpy(text, entries[i].token);
+			index->terms[term] = text;
+			text += strlen(text) + 1;
+
+			index->postingStart[term] = length;
+			index->postingCount[term] = 0;
+			prevCalendar = prevEvent = 0;
+		} else if (entries[i].calendar == entries[i - 1].calendar && entries[i].event == entries[i - 1].event) {
+			// The same word more than once in an Event is only posted once
+			continue;
+		}
+
+		int calendarDelta = entries[i].calendar - prevCalendar;
+		writeVarint(index->postings, &length, calendarDelta);
+		writeVarint(index->postings, &length, (calendarDelta == 0) ? entries[i].event - prevEvent : entries[i].event);
+
+		prevCalendar = entries[i].calendar;
+		prevEvent = entries[i].event;
+		index->postingCount[term]++;
+	}
+	index->postingStart[numTerms] = length;
+
+	// Give back the room that was kept for the longest possible postings
+	uint8_t *shrunk = realloc(index->postings, length + 1);
+	if (shrunk != NULL) {
+		index->postings = shrunk;
+	}
+
+	return true;
+}
+
+/*
+ * Builds an index over the Events of the 'numCals' Calendars in 'cals'.
+ * Returns NULL if memory could not be allocated.
+ */
+SearchIndex *createSearchIndex(Calendar **cals, int numCals) {
+	debugMsg("-----START createSearchIndex()-----\n");
+	SearchIndex *index = calloc(1, sizeof(SearchIndex));
+	TokenEntry *entries = NULL;
+	char *text = NULL;
+	size_t numEntries, entriesSize, textLength, textSize;
+	numEntries = entriesSize = textLength = textSize = 0;
+
+	if (index == NULL) {
+		return NULL;
+	}
+
+	index->numCalendars = numCals;
+	if ((index->firstEvent = malloc(sizeof(int) * (numCals + 1))) == NULL) {
+		deleteSearchIndex(index);
+		return NULL;
+	}
+
+	int numEvents = 0;
+	for (int c = 0; c < numCals; c++) {
+		index->firstEvent[c] = numEvents;
+		numEvents += getLength(cals[c]->events);
+	}
+	index->firstEvent[numCals] = numEvents;
+
+	if ((index->events = malloc(sizeof(Event *) * (numEvents + 1))) == NULL) {
+		deleteSearchIndex(index);
+		return NULL;
+	}
+
+	for (int c = 0; c < numCals; c++) {
+		Event *ev;
+		ListIterator iter = createIterator(cals[c]->events);
+
+		for (int position = 0; (ev = (Event *)nextElement(&iter)) != NULL; position++) {
+			index->events[index->firstEvent[c] + position] = ev;
+
+			if (!collectTokens(ev, c, position, &entries, &numEntries, &entriesSize, &text, &textLength, &textSize)) {
+				free(entries);
+				free(text);
+				deleteSearchIndex(index);
+				return NULL;
+			}
+		}
+	}
+
+	// The block of words is done growing, so the entries can point right at their words
+	for (size_t i = 0; i < numEntries; i++) {
+		entries[i].token = text + entries[i].offset;
+	}
+	qsort(entries, numEntries, sizeof(TokenEntry), compareTokenEntries);
+
+	bool built = buildPostings(index, entries, numEntries);
+	free(entries);
+	free(text);
+
+	if (!built) {
+		deleteSearchIndex(index);
+		return NULL;
+	}
+
+	notifyMsg("\t-----END createSearchIndex(): %d terms, %zu bytes of postings-----\n", \
+	          index->numTerms, index->postingStart[index->numTerms]);
+	return index;
+}
+
+/*
+ * Frees the index (but not the Calendars it points to).
+ */
+void deleteSearchIndex(SearchIndex *index) {
+	if (index == NULL) {
+		return;
+	}
+
+	free(index->firstEvent);
+	free(index->events);
+	free(index->terms);
+	free(index->termText);
+	free(index->postingStart);
+	free(index->postingCount);
+	free(index->postings);
+	free(index);
+}
+
+// Returns the position of the first term that isn't less than 'token'
+static int lowerBound(const SearchIndex *index, const char *token) {
+	int lo = 0, hi = index->numTerms;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (strcmp(index->terms[mid], token) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+// Decodes the postings of every term that 'word' matches into 'docs', as positions in index->events.
+// Returns the number of Events, which are sorted and each only appear once.
+static int decodePostings(const SearchIndex *index, QueryWord word, int *docs) {
+	int count = 0;
+
+	for (int term = word.lo; term < word.hi; term++) {
+		const uint8_t *in = index->postings + index->postingStart[term];
+		uint32_t calendar = 0, event = 0, calendarDelta, value;
+
+		for (int i = 0; i < index->postingCount[term]; i++) {
+			in = readVarint(in, &calendarDelta);
+			in = readVarint(in, &value);
+
+			calendar += calendarDelta;
+			event = (calendarDelta == 0) ? event + value : value;
+			docs[count++] = index->firstEvent[calendar] + event;
+		}
+	}
+
+	// A prefix that matches several terms gives back several sorted lists, which have to be merged
+	if (word.hi - word.lo > 1) {
+		qsort(docs, count, sizeof(int), compareInts);
+
+		int unique = 0;
+		for (int i = 0; i < count; i++) {
+			if (unique == 0 || docs[i] != docs[unique - 1]) {
+				docs[unique++] = docs[i];
+			}
+		}
+		count = unique;
+	}
+
+	return count;
+}
+
+// Finds the terms that every word of 'query' matches, and stores them in 'words'. Returns the number of words,
+// or -1 if one of them doesn't match any terms (so nothing can match the whole query).
+static int parseQuery(const SearchIndex *index, const char *query, QueryWord *words) {
+	char token[MAX_TOKEN_LENGTH + 1];
+	size_t pos = 0;
+	int numWords = 0, length;
+
+	while ((length = nextToken(query, &pos, token)) > 0) {
+		QueryWord *word = &words[numWords++];
+		word->lo = word->hi = lowerBound(index, token);
+
+		if (query[pos] == '*') {
+			while (word->hi < index->numTerms && strncmp(index->terms[word->hi], token, length) == 0) {
+				word->hi++;
+			}
+		} else if (word->lo < index->numTerms && strcmp(index->terms[word->lo], token) == 0) {
+			word->hi = word->lo + 1;
+		}
+
+		word->numPostings = 0;
+		for (int term = word->lo; term < word->hi; term++) {
+			word->numPostings += index->postingCount[term];
+		}
+
+		if (word->numPostings == 0) {
+			return -1;
+		}
+	}
+
+	return numWords;
+}
+
+/*
+ * Finds every Event that contains all of the words in 'query', and stores them in a newly allocated
+ * array in 'hits', sorted by calendar and then by position. A query without any words finds nothing.
+ * Returns the number of Events found, or -1 if memory could not be allocated.
+ */
+int searchEvents(const SearchIndex *index, const char *query, SearchHit **hits) {
+	// Every word takes up at least two characters of the query, counting the one that ends it
+	QueryWord *words = malloc(sizeof(QueryWord) * (strlen(query) / 2 + 1));
+	int *found = NULL, numFound = 0;
+
+	*hits = NULL;
+	if (words == NULL) {
+		return -1;
+	}
+
+	int numWords = parseQuery(index, query, words);
+
+	// The smallest list is decoded first, and only shrinks as the others are intersected with it
+	if (numWords > 0) {
+		qsort(words, numWords, sizeof(QueryWord), compareQueryWords);
+
+		if ((found = malloc(sizeof(int) * words[0].numPostings)) == NULL) {
+			free(words);
+			return -1;
+		}
+		numFound = decodePostings(index, words[0], found);
+	}
+
+	for (int w = 1; w < numWords && numFound > 0; w++) {
+		int *docs = malloc(sizeof(int) * words[w].numPostings);
+		if (docs == NULL) {
+			free(found);
+			free(words);
+			return -1;
+		}
+
+		int numDocs = decodePostings(index, words[w], docs);
+		int kept = 0;
+		for (int i = 0, j = 0; i < numFound && j < numDocs; ) {
+			if (found[i] < docs[j]) {
+				i++;
+			} else if (found[i] > docs[j]) {
+				j++;
+			} else {
+				found[kept++] = found[i];
+				i++;
+				j++;
+			}
+		}
+		numFound = kept;
+
+		free(docs);
+	}
+	free(words);
+
+	if ((*hits = malloc(sizeof(SearchHit) * (numFound + 1))) == NULL) {
+		free(found);
+		return -1;
+	}
+
+	// The positions are sorted, so the calendar they belong to only moves forwards
+	int calendar = 0;
+	for (int i = 0; i < numFound; i++) {
+		while (found[i] >= index->firstEvent[calendar + 1]) {
+			calendar++;
+		}
+		(*hits)[i].calendar = calendar;
+		(*hits)[i].event = found[i] - index->firstEvent[calendar];
+	}
+	free(found);
+
+	return numFound;
+}
+
+/*
+ * Returns the Event that 'hit' names.
+ */
+const Event *searchHitEvent(const SearchIndex *index, SearchHit hit) {
+	return index->events[index->firstEvent[hit.calendar] + hit.event];
+}
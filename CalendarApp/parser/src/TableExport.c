@@ -0,0 +1,119 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  TableExport.c                   *
+ ************************************/
+
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <strings.h>
+
+#include "TableExport.h"
+
+// Returns the description of the Event's first property whose name matches 'name', or NULL if it doesn't
+// have one. SUMMARY is matched exactly (as calendarToJSON() does), the others ignoring case.
+static const char *propDescr(const Event *ev, const char *name, bool ignoreCase) {
+	ListIterator iter = createIterator(ev->properties);
+	Property *prop;
+
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		if ((ignoreCase ? strcasecmp(prop->propName, name) : strcmp(prop->propName, name)) == 0) {
+			return prop->propDescr;
+		}
+	}
+
+	return NULL;
+}
+
+// Appends 'value' as a field, escaping the characters LOAD DATA INFILE gives a meaning to, followed by
+// 'end' (a tab or a newline). A NULL value is written as \N.
+static ICalErrorCode appendField(IOBatch *batch, const char *value, const char *end) {
+	if (value == NULL) {
+		batchAppendLit(batch, "\\N");
+		return batchAppend(batch, end, 1);
+	}
+
+	while (*value != '\0') {
+		// Everything up to the next special character is appended without being copied
+		size_t run = strcspn(value, "\\\t\n\r");
+		if (run > 0) {
+			batchAppend(batch, value, run);
+			value += run;
+		}
+
+		switch (*value) {
+			case '\\':
+				batchAppendLit(batch, "\\\\");
+				break;
+			case '\t':
+				batchAppendLit(batch, "\\t");
+				break;
+			case '\n':
+				batchAppendLit(batch, "\\n");
+				break;
+			case '\r':
+				batchAppendLit(batch, "\\r");
+				break;
+			default:
+				continue;
+		}
+		value++;
+	}
+
+	return batchAppend(batch, end, 1);
+}
+
+/*
+ * Appends a row to 'events' for every Event of 'cal' (other than the ones whose entry in 'skip' is true,
+ * if 'skip' isn't NULL), and a row to 'alarms' for every Alarm of those Events. The number of rows of
+ * each is stored in 'numEvents' and 'numAlarms'.
+ * Returns OK, INV_CAL if 'cal' is NULL, or WRITE_ERROR if a flush was needed and it failed.
+ */
+ICalErrorCode appendTableRows(const Calendar *cal, const bool *skip, IOBatch *events, IOBatch *alarms, \
+                              int *numEvents, int *numAlarms) {
+	*numEvents = *numAlarms = 0;
+
+	if (cal == NULL) {
+		return INV_CAL;
+	}
+
+	ListIterator eventIter = createIterator(cal->events);
+	Event *ev;
+
+	for (int position = 0; (ev = (Event *)nextElement(&eventIter)) != NULL; position++) {
+		if (skip != NULL && skip[position]) {
+			continue;
+		}
+
+		const char *summary = propDescr(ev, "SUMMARY", false);
+		const DateTime *start = &ev->startDateTime;
+
+		int row = (*numEvents)++;
+
+		batchPrintf(events, "%d\t", row);
+		appendField(events, (summary == NULL || summary[0] == '\0') ? NULL : summary, "\t");
+		// A DATE (with no time) starts at midnight
+		batchPrintf(events, "%.4s-%.2s-%.2s %.2s:%.2s:%.2s\t", start->date, start->date + 4, start->date + 6, \
+		            (start->time[0] == '\0') ? "00" : start->time, (start->time[0] == '\0') ? "00" : start->time + 2, \
+		            (start->time[0] == '\0') ? "00" : start->time + 4);
+		appendField(events, propDescr(ev, "LOCATION", true), "\t");
+		appendField(events, propDescr(ev, "ORGANIZER", true), "\n");
+
+		ListIterator alarmIter = createIterator(ev->alarms);
+		Alarm *alarm;
+
+		while ((alarm = (Alarm *)nextElement(&alarmIter)) != NULL) {
+			batchPrintf(alarms, "%d\t", row);
+			appendField(alarms, alarm->action, "\t");
+			appendField(alarms, alarm->trigger, "\n");
+			(*numAlarms)++;
+		}
+	}
+
+	// A batch remembers the first error it ran into, so the appends above don't each need to be checked
+	return (events->error != OK || alarms->error != OK) ? WRITE_ERROR : OK;
+}
@@ -0,0 +1,287 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  TimeSpan.c                      *
+ ************************************/
+
+#include <ctype.h>
+#include <strings.h>
+
+#include "TimeSpan.h"
+#include "Debug.h"
+
+// Reads exactly 'count' digits starting at 'str' into 'number'. Returns false if any of them isn't a digit.
+static bool readDigits(const char *str, int count, int *number) {
+	*number = 0;
+
+	for (int i = 0; i < count; i++) {
+		if (!isdigit((unsigned char)str[i])) {
+			return false;
+		}
+		*number = (*number * 10) + (str[i] - '0');
+	}
+
+	return true;
+}
+
+/*
+ * Returns the number of days from 19700101 to the given date in the proleptic Gregorian calendar.
+ * Years are counted from March, so that the leap day comes last.
+ */
+int64_t daysFromDate(int year, int month, int day) {
+	year -= (month <= 2);
+	int64_t era = (year >= 0 ? year : year - 399) / 400;
+	int yearOfEra = year - era * 400;
+	int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+
+	return era * 146097 + dayOfEra - 719468;
+}
+
+/*
+ * The inverse of daysFromDate(): stores the date that is 'days' days after 19700101.
+ */
+void dateFromDays(int64_t days, int *year, int *month, int *day) {
+	days += 719468;
+	int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+	int dayOfEra = (int)(days - era * 146097);
+	int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+	int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+	int monthIndex = (5 * dayOfYear + 2) / 153;
+
+	*day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+	*month = monthIndex + (monthIndex < 10 ? 3 : -9);
+	*year = (int)(yearOfEra + era * 400) + (*month <= 2);
+}
+
+/*
+ * Returns the day of the week of the date 'days' days after 19700101, where 0 is Sunday.
+ */
+int weekdayFromDays(int64_t days) {
+	// 19700101 was a Thursday
+	return (int)(((days % 7) + 11) % 7);
+}
+
+/*
+ * Returns the number of days in the given month.
+ */
+int daysInMonth(int year, int month) {
+	static const int lengths[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+	bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+
+	return (month == 2 && leap) ? 29 : lengths[month - 1];
+}
+
+// Converts a "YYYYMMDD" date and, unless it is NULL, an "hhmmss" time into seconds
+static ICalErrorCode toSeconds(const char *date, const char *time, int64_t *seconds) {
+	int year, month, day, hour, minute, second;
+	hour = minute = second = 0;
+
+	if (!readDigits(date, 4, &year) || !readDigits(date + 4, 2, &month) || !readDigits(date + 6, 2, &day)) {
+		errorMsg("\tdate \"%.8s\" is not made of 8 digits\n", date);
+		return INV_DT;
+	}
+	if (time != NULL && (!readDigits(time, 2, &hour) || !readDigits(time + 2, 2, &minute) || !readDigits(time + 4, 2, &second))) {
+		errorMsg("\ttime \"%.6s\" is not made of 6 digits\n", time);
+		return INV_DT;
+	}
+
+	// 60 seconds is allowed for leap seconds
+	if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+		errorMsg("\tdate/time out of range: %.8s %.6s\n", date, (time == NULL) ? "" : time);
+		return INV_DT;
+	}
+
+	*seconds = daysFromDate(year, month, day) * SECONDS_PER_DAY + hour * 3600 + minute * 60 + second;
+	return OK;
+}
+
+/*
+ * Converts a number of seconds back into a DateTime, and stores it in 'dt'.
+ */
+void secondsToDateTime(int64_t seconds, bool UTC, DateTime *dt) {
+	int64_t days = seconds / SECONDS_PER_DAY - (seconds % SECONDS_PER_DAY < 0);
+	int timeOfDay = (int)(seconds - days * SECONDS_PER_DAY);
+	int year, month, day;
+
+	dateFromDays(days, &year, &month, &day);
+	// The modulos only tell the compiler how many digits each number has
+	snprintf(dt->date, sizeof(dt->date), "%04u%02u%02u", (unsigned)year % 10000u, (unsigned)month % 100u, (unsigned)day % 100u);
+	snprintf(dt->time, sizeof(dt->time), "%02u%02u%02u", (unsigned)timeOfDay / 3600u % 100u, (unsigned)timeOfDay / 60u % 60u, \
+	         (unsigned)timeOfDay % 60u);
+	dt->UTC = UTC;
+}
+
+/*
+ * Converts the DateTime 'dt' into seconds, and stores them in 'seconds'.
+ * Returns OK, or INV_DT if the DateTime does not hold a real date and time.
+ */
+ICalErrorCode dateTimeToSeconds(const DateTime *dt, int64_t *seconds) {
+	if (strlen(dt->date) != 8 || strlen(dt->time) != 6) {
+		return INV_DT;
+	}
+
+	return toSeconds(dt->date, dt->time, seconds);
+}
+
+/*
+ * Converts an iCalendar DATE ("YYYYMMDD") or DATE-TIME ("YYYYMMDDThhmmss", optionally followed
+ * by a 'Z') value into seconds, and stores them in 'seconds'. 'isDate' is set to true if the
+ * value was a DATE (it may be NULL).
+ * Returns OK, or INV_DT if the value is malformed.
+ */
+ICalErrorCode parseTimeValue(const char *value, int64_t *seconds, bool *isDate) {
+	if (value == NULL) {
+		return INV_DT;
+	}
+
+	size_t length = strlen(value);
+	bool date = (length == 8);
+
+	if (!date && !((length == 15 || (length == 16 && toupper((unsigned char)value[15]) == 'Z')) \
+	               && toupper((unsigned char)value[8]) == 'T')) {
+		errorMsg("\t\"%s\" is neither a DATE nor a DATE-TIME\n", value);
+		return INV_DT;
+	}
+
+	if (isDate != NULL) {
+		*isDate = date;
+	}
+
+	return toSeconds(value, date ? NULL : value + 9, seconds);
+}
+
+/*
+ * Converts an iCalendar DURATION value (e.g. "PT1H30M", "P1W", "-P2DT12H") into a number of
+ * seconds, which is negative for a negative duration, and stores it in 'seconds'.
+ * Refer to section 3.3.6 of the RFC5545 iCal specification.
+ * Returns OK, or INV_DT if the value is malformed.
+ */
+ICalErrorCode parseDuration(const char *value, int64_t *seconds) {
+	const char *c = value;
+	bool negative, inTime, foundUnit;
+	int64_t total = 0;
+	negative = inTime = foundUnit = false;
+
+	if (value == NULL) {
+		return INV_DT;
+	}
+
+	if (*c == '+' || *c == '-') {
+		negative = (*c == '-');
+		c++;
+	}
+
+	if (toupper((unsigned char)*c) != 'P') {
+		errorMsg("\tduration \"%s\" does not start with 'P'\n", value);
+		return INV_DT;
+	}
+	c++;
+
+	while (*c != '\0') {
+		if (toupper((unsigned char)*c) == 'T' && !inTime) {
+			inTime = true;
+			c++;
+			continue;
+		}
+
+		// Every other part of a duration is a number followed by its unit
+		int64_t number = 0;
+		const char *digits = c;
+		while (isdigit((unsigned char)*c) && c - digits < 9) {
+			number = (number * 10) + (*c - '0');
+			c++;
+		}
+		if (c == digits) {
+			errorMsg("\tduration \"%s\" is missing a number\n", value);
+			return INV_DT;
+		}
+
+		switch (toupper((unsigned char)*c)) {
+			case 'W':
+				total += number * 7 * SECONDS_PER_DAY;
+				break;
+			case 'D':
+				total += number * SECONDS_PER_DAY;
+				break;
+			case 'H':
+				total += number * 3600;
+				break;
+			case 'M':
+				total += number * 60;
+				break;
+			case 'S':
+				total += number;
+				break;
+			default:
+				errorMsg("\tduration \"%s\" has an unknown unit\n", value);
+				return INV_DT;
+		}
+
+		// Weeks and days come before the 'T', and hours, minutes and seconds after it
+		if (inTime != (strchr("HMShms", *c) != NULL)) {
+			errorMsg("\tduration \"%s\" has a unit on the wrong side of the 'T'\n", value);
+			return INV_DT;
+		}
+
+		foundUnit = true;
+		c++;
+	}
+
+	if (!foundUnit) {
+		errorMsg("\tduration \"%s\" is empty\n", value);
+		return INV_DT;
+	}
+
+	*seconds = negative ? -total : total;
+	return OK;
+}
+
+// Returns the value of the Property, without any parameters that come before it (e.g. "VALUE=DATE:")
+static const char *propertyValue(const Property *prop) {
+	const char *colon = strrchr(prop->propDescr, ':');
+
+	return (colon == NULL) ? prop->propDescr : colon + 1;
+}
+
+/*
+ * Finds the span of time taken up by the Event 'ev': it starts at DTSTART, and ends at DTEND if the
+ * Event has one, or DTSTART + DURATION if it has that instead. An Event without either (or with an end
+ * before its start) ends at its DTSTART.
+ * Returns OK, or INV_DT if DTSTART, DTEND or DURATION is malformed.
+ */
+ICalErrorCode getEventSpan(const Event *ev, TimeSpan *span) {
+	ICalErrorCode error;
+	Property *prop;
+	int64_t duration;
+
+	if ((error = dateTimeToSeconds(&(ev->startDateTime), &(span->start))) != OK) {
+		return error;
+	}
+	span->end = span->start;
+
+	ListIterator iter = createIterator(ev->properties);
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		if (strcasecmp(prop->propName, "DTEND") == 0) {
+			if ((error = parseTimeValue(propertyValue(prop), &(span->end), NULL)) != OK) {
+				return error;
+			}
+			break;
+		} else if (strcasecmp(prop->propName, "DURATION") == 0) {
+			if ((error = parseDuration(propertyValue(prop), &duration)) != OK) {
+				return error;
+			}
+			span->end = span->start + duration;
+			break;
+		}
+	}
+
+	if (span->end < span->start) {
+		span->end = span->start;
+	}
+
+	return OK;
+}
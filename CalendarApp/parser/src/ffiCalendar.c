@@ -7,6 +7,8 @@
  *  ffiCalendar.c                   *
  ************************************/
 
+#define _GNU_SOURCE
+
 #include "ffiCalendar.h"
 
 /****************************
@@ -18,30 +20,15 @@
 // only for testing that AJAX calls are functional.
 
 
-// It is VERY IMPORTANT to only seed random number generation once, so through the magic
-// of static variables, this function guarantees to seed the rand() function exactly once.
-void seedrand() {
-    static bool notYetSeeded = true;
-
-    if (notYetSeeded) {
-        srand(time(NULL));
-        notYetSeeded = false;
-    }
-}
-
 void wordgen(char str[], int length) {
-    seedrand();
-
     int i;
     for (i = 0; i < length; i++) {
-        str[i] = (rand() % 26) + 'a';
+        str[i] = (randomNumber() % 26) + 'a';
     }
     str[i] = '\0';
 }
 
 char *fakeText(bool spaces, int numWords) {
-	seedrand();
-
     char *toReturn = malloc(1000);
     char temp[100];
     if (numWords <= 0) {
@@ -52,7 +39,7 @@ char *fakeText(bool spaces, int numWords) {
     strcpy(toReturn, "");
 
     for (int i = 0; i < numWords; i++) {
-        wordgen(temp, (rand() % 8) + 3);
+        wordgen(temp, (randomNumber() % 8) + 3);
         strcat(toReturn, temp);
         if (spaces) {
             strcat(toReturn, " ");
@@ -68,45 +55,37 @@ char *fakeText(bool spaces, int numWords) {
 }
 
 int randdate() {
-    seedrand();
-
     int toReturn = 201900; // year is 2019 always
 
-    toReturn += rand() % 12; // month
+    toReturn += randomNumber() % 12; // month
     toReturn *= 100;
-    toReturn += rand() % 30; // day
+    toReturn += randomNumber() % 30; // day
 
     return toReturn;
 }
 
 int randtime() {
-    seedrand();
-
     int toReturn = 0;
 
-    toReturn += rand() % 24; // hour
+    toReturn += randomNumber() % 24; // hour
     toReturn *= 100;
-    toReturn += rand() % 60; // minute
+    toReturn += randomNumber() % 60; // minute
     toReturn *= 100;
-    toReturn += rand() % 60; // second
+    toReturn += randomNumber() % 60; // second
 
     return toReturn;
 }
 
 char *fakeDT() {
-    seedrand();
-
     char *toReturn = malloc(200);
 
     int written = snprintf(toReturn, 200, "{\"date\":\"%08d\",\"time\":\"%06d\",\"isUTC\":%s}", \
-                           randdate(), randtime(), (rand() % 2) ? "true" : "false");
+                           randdate(), randtime(), (randomNumber() % 2) ? "true" : "false");
 
     return realloc(toReturn, written+1);
 }
 
 char *fakeProperty() {
-	seedrand();
-
 	char *toReturn = malloc(3000);
 
 	char *fakeName = fakeText(false, 1);
@@ -121,8 +100,6 @@ char *fakeProperty() {
 }
 
 char *fakePropertyList(short int numProps) {
-	seedrand();
-
 	char *toReturn = malloc(3);
 	int curLen = 1;
 	char *temp;
@@ -149,13 +126,11 @@ char *fakePropertyList(short int numProps) {
 }
 
 char *fakeAlarm() {
-    seedrand();
-
     char *toReturn = malloc(2000);
 
     char *fakeAct = fakeText(true, 2);
     char *fakeTrig = fakeText(false, 1);
-	int numProps = rand()%4;
+	int numProps = randomNumber()%4;
 	char *fakePropList = fakePropertyList(numProps);
 
     int written = snprintf(toReturn, 2000, "{\"action\":\"%s\",\"trigger\":\"%s\",\"numProps\":%d,\"properties\":%s}",\
@@ -169,8 +144,6 @@ char *fakeAlarm() {
 }
 
 char *fakeAlarmList(short int numAlarms) {
-	seedrand();
-
 	char *toReturn = malloc(3);
 	int curLen = 1;
 	char *temp;
@@ -197,15 +170,13 @@ char *fakeAlarmList(short int numAlarms) {
 }
 
 char *fakeEvent() {
-    seedrand();
-
     char *toReturn = malloc(4000);
 
     char *fakeSummary = fakeText(true, 10);
     char *fakeStart = fakeDT();
-	int numProps = rand()%4;
+	int numProps = randomNumber()%4;
 	char *fakeProps = fakePropertyList(numProps);
-	int numAlarms = rand()%4;
+	int numAlarms = randomNumber()%4;
 	char *fakeAlarms = fakeAlarmList(numAlarms);
 
     int written = snprintf(toReturn, 4000, "{\"startDT\":%s,\"numProps\":%d,\"numAlarms\":%d,\"summary\":\"%s\",\"properties\":%s,\"alarms\":%s}", \
@@ -220,8 +191,6 @@ char *fakeEvent() {
 }
 
 char *fakeEventList(short int numEvents) {
-	seedrand();
-
 	char *toReturn = malloc(3);
 	int curLen = 1;
 	char *temp;
@@ -248,14 +217,12 @@ char *fakeEventList(short int numEvents) {
 }
 
 char *fakeCal() {
-    seedrand();
-
     char *toReturn = malloc(2000);
 
     char *fakeProdid = fakeText(false, 4);
-	int numProps = rand()%4;
+	int numProps = randomNumber()%4;
 	char *fakeProps = fakePropertyList(numProps);
-	int numEvents = (rand()%3)+1;
+	int numEvents = (randomNumber()%3)+1;
 	char *fakeEvents = fakeEventList(numEvents);
 
     int written = snprintf(toReturn, 2000, "{\"version\":2,\"prodID\":\"%s\",\"numProps\":%d,\"numEvents\":%d,\"properties\":%s,\"events\":%s}",\
@@ -273,85 +240,492 @@ char *fakeCal() {
  * Actual AJAX Callback Functions *
  **********************************/
 
+// Frees a string or buffer returned by any of the functions below. Does nothing if 'result' is NULL.
+void freeResult(char *result) {
+	free(result);
+}
+
 // Takes a filename and returns a JSON string of a Calendar object, or an error code on a fail.
 char *createCalendarJSON(const char filepath[]) {
 	ICalErrorCode error;
 	Calendar *cal;
 
 	if (filepath == NULL) {
-		return ferrorCodeToJSON(INV_FILE, "N/A", "File path was not received");
+		return ferrorCodeToJSON(INV_FILE, NULL, "File path was not received");
 	}
 
-	if ((error = createCalendar((char *)filepath, &cal)) != OK) {
-		return ferrorCodeToJSON(error, filepath, "Could not read in calendar from the file");
+	if ((error = createCalendarValidated((char *)filepath, &cal)) != OK) {
+		return ferrorCodeToJSON(error, filepath, "Could not read in a valid calendar from the file");
 	}
 
-	if ((error = validateCalendar(cal)) != OK) {
-		return ferrorCodeToJSON(error, filepath, "File contains data that is invalid or wrong");
+	char *toReturn = calendarToJSON(cal);
+	deleteCalendar(cal);
+
+	return toReturn;
+}
+
+// Takes a filename, and the key to sort its Events by ("start", "stamp" or "uid"). Returns a JSON array of
+// every Event in the Calendar (as eventListToJSON() writes them) sorted by their DTSTART, DTSTAMP or UID,
+// with Events that have equal keys left in the order they are in the file. Returns an error code JSON on a fail.
+char *sortedEventsJSON(const char filepath[], const char *key) {
+	ICalErrorCode error;
+	enum eventSortKey sortKey;
+	Calendar *cal;
+
+	if (filepath == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File path was not received");
 	}
 
-	char *toReturn = calendarToJSON(cal);
+	if (key == NULL || strcmp(key, "start") == 0) {
+		sortKey = SORT_BY_START;
+	} else if (strcmp(key, "stamp") == 0) {
+		sortKey = SORT_BY_STAMP;
+	} else if (strcmp(key, "uid") == 0) {
+		sortKey = SORT_BY_UID;
+	} else {
+		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Events can only be sorted by start, stamp or uid");
+	}
+
+	if ((error = createCalendarValidated((char *)filepath, &cal)) != OK) {
+		return ferrorCodeToJSON(error, filepath, "Could not read in a valid calendar from the file");
+	}
+
+	if ((error = sortEvents(cal->events, sortKey)) != OK) {
+		deleteCalendar(cal);
+		return ferrorCodeToJSON(error, filepath, "Could not sort the events");
+	}
+
+	char *toReturn = eventListToJSON(cal->events);
 	deleteCalendar(cal);
 
 	return toReturn;
 }
 
-// Takes a filename and an Event JSON. Adds the Event to the Calendar created from the filename,
-// then overwrites the file with the new Calendar containing its shiny new event.
-// Returns the JSON of the new calendar.
+// Takes a filename and an Event JSON. Appends the Event to the end of the Calendar in the file,
+// without reading in or re-writing any of the Calendar's other Events.
+// Returns the JSON of the new Event.
 char *addEventJSON(const char filepath[], const char *eventJSON) {
 	ICalErrorCode error;
-	Calendar *cal;
 	Event *toAdd;
+	List *toWrite;
+	FILE *fp;
+	const char *uid;
+	long endOffset;
+	bool taken, generatedUID;
 	char *toReturn;
 
 	if (filepath == NULL) {
-		return ferrorCodeToJSON(INV_FILE, "N/A", "File path was not received");
+		return ferrorCodeToJSON(INV_FILE, NULL, "File path was not received");
 	}
 	if (eventJSON == NULL) {
 		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Event JSON was not received");
 	}
 
-	//printf("filePath: \"%s\"\n", filepath);
-	//printf("event JSON: \"%s\"\n", eventJSON);
+	if ((toAdd = JSONtoEventGenerated(eventJSON, &generatedUID)) == NULL) {
+		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not properly convert Event JSON into Event object");
+	}
 
-	if ((error = createCalendar((char *)filepath, &cal)) != OK) {
-		return ferrorCodeToJSON(error, filepath, "Could not read in calendar from the file in order to modify it");
+	// The rest of the Calendar was already valid when it was written, so only the new Event is checked
+	if ((error = validateEvent(toAdd)) != OK) {
+		deleteEvent(toAdd);
+		return ferrorCodeToJSON(error, filepath, "The Event that was added to the Calendar made it invalid; the added Event was invalid");
 	}
-	//printf("Successfully called createCalendar()\n");
 
-	if ((error = validateCalendar(cal)) != OK) {
-		return ferrorCodeToJSON(error, filepath, "Calendar file contains data that is invalid or wrong");
+	if ((fp = fopen(filepath, "r")) == NULL) {
+		deleteEvent(toAdd);
+		return ferrorCodeToJSON(INV_FILE, filepath, "Could not open the calendar file in order to modify it");
 	}
-	//printf("Successfully called validateCalendar()\n");
 
-	if ((toAdd = JSONtoEvent(eventJSON)) == NULL) {
-		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not properly convert Event JSON into Event object");
+	// Find where the Calendar ends, and make sure none of its Events already use the new UID.
+	// A generated UID is simply replaced if it is taken.
+	uid = toAdd->UID;
+	for (int attempts = 0; ; attempts++) {
+		if ((error = scanCalendarFile(fp, &uid, 1, &taken, &endOffset)) != OK) {
+			fclose(fp);
+			deleteEvent(toAdd);
+			return ferrorCodeToJSON(error, filepath, "Could not read in calendar from the file in order to modify it");
+		}
+
+		if (!taken) {
+			break;
+		}
+
+		if (!generatedUID || attempts == 10) {
+			fclose(fp);
+			deleteEvent(toAdd);
+			return ferrorCodeToJSON(INV_EVENT, filepath, "An Event with the same UID already exists in the Calendar");
+		}
+
+		snprintf(toAdd->UID, 1000, "%u", randomNumber());
+		rewind(fp);
 	}
-	//printf("Successfully called JSONtoEvent()\n");
 
-	addEvent(cal, toAdd);
+	toWrite = initializeList(printEvent, deleteEvent, compareEvents);
+	insertBack(toWrite, toAdd);
 
-	if ((error = validateCalendar(cal)) != OK) {
-		return ferrorCodeToJSON(error, filepath, "The Event that was added to the Calendar made it invalid; the added Event was invalid");
+	error = spliceEvents((char *)filepath, fileno(fp), endOffset, toWrite);
+	fclose(fp);
+
+	if (error != OK) {
+		freeList(toWrite);
+		return ferrorCodeToJSON(error, filepath, "Could not append the new Event to the Calendar file; changes may have only partially gone through, or not at all");
 	}
-	//printf("Successfully called validateCalendar() after adding the new Event\n");
 
-	if ((error = writeCalendar((char *)filepath, cal)) != OK) {
-		return ferrorCodeToJSON(error, filepath, "Could not re-write the new Calendar back to its file; changes may have only partially gone through, or not at all");
+	if ((toReturn = eventToJSON(toAdd)) == NULL) {
+		freeList(toWrite);
+		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not convert the new Event back into a JSON");
 	}
-	//printf("Successfully called writeCalendar()\n");
 
-	if ((toReturn = calendarToJSON(cal)) == NULL) {
-		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not convert the new Calendar back into a JSON");
+	freeList(toWrite);
+
+	return toReturn;
+}
+
+// Splits the JSON array of objects 'json' into its elements, which are stored in 'elements' as a
+// newly allocated array of newly allocated strings. Returns the number of elements, -1 if 'json'
+// isn't an array of objects, or -2 if memory could not be allocated.
+static int splitJSONArray(const char *json, char ***elements) {
+	const char *start = NULL;
+	int depth = 0, count = 0, capacity = 16, failure = -1;
+	bool inString = false;
+
+	while (isspace((unsigned char)*json)) {
+		json++;
+	}
+	if (*json != '[') {
+		return -1;
 	}
 
-	deleteCalendar(cal);
-	//printf("Successfully called deleteCalendar()\n");
+	if ((*elements = malloc(capacity * sizeof(char *))) == NULL) {
+		return -2;
+	}
+
+	for (const char *c = json + 1; *c != '\0'; c++) {
+		if (inString) {
+			// Skip over escaped characters, so that \" doesn't end the string
+			if (*c == '\\' && c[1] != '\0') {
+				c++;
+			} else if (*c == '"') {
+				inString = false;
+			}
+			continue;
+		}
+
+		if (*c == '"' && depth > 0) {
+			inString = true;
+		} else if (*c == '{' || *c == '[') {
+			if (depth++ == 0) {
+				if (*c != '{') {
+					break;
+				}
+				start = c;
+			}
+		} else if (*c == ']' && depth == 0) {
+			// the end of the array
+			return count;
+		} else if (*c == '}' || *c == ']') {
+			if (--depth == 0) {
+				if (count == capacity) {
+					char **grown = realloc(*elements, capacity * 2 * sizeof(char *));
+					if (grown == NULL) {
+						failure = -2;
+						break;
+					}
+					*elements = grown;
+					capacity *= 2;
+				}
+				if (((*elements)[count] = strndup(start, c - start + 1)) == NULL) {
+					failure = -2;
+					break;
+				}
+				count++;
+			}
+		} else if (depth == 0 && *c != ',' && !isspace((unsigned char)*c)) {
+			// something other than an object in the array
+			break;
+		}
+	}
+
+	// The array was malformed, never closed, or memory ran out
+	for (int i = 0; i < count; i++) {
+		free((*elements)[i]);
+	}
+	free(*elements);
+	*elements = NULL;
+	return failure;
+}
+
+// Concatenates 'pieces' into a newly allocated JSON array string "[piece,piece,...]".
+// Returns NULL if memory could not be allocated.
+static char *joinJSONArray(char **pieces, int numPieces) {
+	size_t length = 2, pos = 1;
+
+	for (int i = 0; i < numPieces; i++) {
+		length += strlen(pieces[i]) + 1;
+	}
+
+	char *toReturn = malloc(length + 1);
+	if (toReturn == NULL) {
+		return NULL;
+	}
+	toReturn[0] = '[';
+	for (int i = 0; i < numPieces; i++) {
+		size_t pieceLen = strlen(pieces[i]);
+		memcpy(toReturn + pos, pieces[i], pieceLen);
+		pos += pieceLen;
+		if (i < numPieces - 1) {
+			toReturn[pos++] = ',';
+		}
+	}
+	toReturn[pos++] = ']';
+	toReturn[pos] = '\0';
 
 	return toReturn;
 }
 
+// An Event of a batch, along with its position in the batch and whether its UID was generated,
+// so that the batch can be sorted by UID
+typedef struct batchentry {
+	Event *event;
+	int index;
+	bool generated;
+} BatchEntry;
+
+// Sorts BatchEntries by UID. Of the Events with the same UID, the ones whose UID was given by the
+// client come first, and then they are sorted by their position in the batch.
+static int compareBatchEntries(const void *first, const void *second) {
+	const BatchEntry *a = first, *b = second;
+	int cmp = strcmp(a->event->UID, b->event->UID);
+
+	if (cmp != 0) {
+		return cmp;
+	}
+	if (a->generated != b->generated) {
+		return a->generated ? 1 : -1;
+	}
+	return a->index - b->index;
+}
+
+// Takes a filename and a JSON array of Events. Every Event is converted and validated on its own,
+// and all of the valid ones are appended to the end of the Calendar in the file with a single write.
+// Returns {"filename":...,"added":[Event JSONs],"errors":[{"index":...,"error":...,"message":...}]},
+// where 'index' is the position of a rejected Event in the array. If the file itself can't be
+// appended to, an error code JSON is returned instead and nothing is added.
+char *addEventsJSON(const char filepath[], const char *eventsJSON) {
+	ICalErrorCode error = OK;
+	char **elements;
+	int numEvents;
+
+	if (filepath == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File path was not received");
+	}
+	if (eventsJSON == NULL) {
+		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Events JSON was not received");
+	}
+
+	if ((numEvents = splitJSONArray(eventsJSON, &elements)) < 0) {
+		return ferrorCodeToJSON(OTHER_ERROR, filepath, (numEvents == -2) ? "Could not allocate memory" \
+		                        : "Events JSON was not an array of Event objects");
+	}
+
+	Event **events = calloc(numEvents + 1, sizeof(Event *));
+	bool *generatedUID = calloc(numEvents + 1, sizeof(bool));
+	ICalErrorCode *errors = calloc(numEvents + 1, sizeof(ICalErrorCode));
+	const char **messages = calloc(numEvents + 1, sizeof(char *));
+	BatchEntry *sorted = malloc((numEvents + 1) * sizeof(BatchEntry));
+	const char **uids = malloc((numEvents + 1) * sizeof(char *));
+	bool *taken = malloc((numEvents + 1) * sizeof(bool));
+	char **added = calloc(numEvents + 1, sizeof(char *));
+	char **rejected = calloc(numEvents + 1, sizeof(char *));
+	char *addedJSON = NULL, *rejectedJSON = NULL, *fileName = NULL;
+	int numSorted, numUIDs, numAdded = 0, numRejected = 0;
+	long endOffset;
+	FILE *fp = NULL;
+	List *toWrite = NULL;
+	char *toReturn = NULL;
+
+	if (events == NULL || generatedUID == NULL || errors == NULL || messages == NULL || sorted == NULL || uids == NULL \
+	    || taken == NULL || added == NULL || rejected == NULL) {
+		toReturn = ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not allocate memory");
+		goto CLEANBATCH;
+	}
+
+	// Convert and validate each Event on its own
+	for (int i = 0; i < numEvents; i++) {
+		generatedUID[i] = false;
+
+		if ((events[i] = JSONtoEventGenerated(elements[i], &generatedUID[i])) == NULL) {
+			errors[i] = OTHER_ERROR;
+			messages[i] = "Could not properly convert Event JSON into Event object";
+		} else if ((errors[i] = validateEvent(events[i])) != OK) {
+			messages[i] = "The Event was invalid";
+			deleteEvent(events[i]);
+			events[i] = NULL;
+		}
+	}
+
+	if ((fp = fopen(filepath, "r")) == NULL) {
+		toReturn = ferrorCodeToJSON(INV_FILE, filepath, "Could not open the calendar file in order to modify it");
+		goto CLEANBATCH;
+	}
+
+	// Make sure every UID is unique, both within the batch and within the file. Generated UIDs are
+	// replaced when they are taken, which means everything has to be checked again.
+	for (int attempts = 0; ; attempts++) {
+		bool retry = false;
+
+		numSorted = 0;
+		for (int i = 0; i < numEvents; i++) {
+			if (events[i] != NULL) {
+				sorted[numSorted++] = (BatchEntry){.event = events[i], .index = i, .generated = generatedUID[i]};
+			}
+		}
+		qsort(sorted, numSorted, sizeof(BatchEntry), compareBatchEntries);
+
+		// Within the batch, a UID that the client gave keeps it over a generated one, and otherwise
+		// the first Event with the UID keeps it
+		numUIDs = 0;
+		for (int j = 0; j < numSorted; j++) {
+			int i = sorted[j].index;
+
+			if (numUIDs == 0 || strcmp(uids[numUIDs - 1], events[i]->UID) != 0) {
+				sorted[numUIDs] = sorted[j];
+				uids[numUIDs++] = events[i]->UID;
+			} else if (generatedUID[i] && attempts < 10) {
+				snprintf(events[i]->UID, 1000, "%u", randomNumber());
+				retry = true;
+			} else {
+				errors[i] = INV_EVENT;
+				messages[i] = "Another Event in the batch has the same UID";
+				deleteEvent(events[i]);
+				events[i] = NULL;
+			}
+		}
+
+		if (retry) {
+			continue;
+		}
+
+		// The UIDs of the remaining Events are sorted and unique, so the file can be checked against them
+		rewind(fp);
+		if ((error = scanCalendarFile(fp, uids, numUIDs, taken, &endOffset)) != OK) {
+			toReturn = ferrorCodeToJSON(error, filepath, "Could not read in calendar from the file in order to modify it");
+			goto CLEANBATCH;
+		}
+
+		for (int j = 0; j < numUIDs; j++) {
+			int i = sorted[j].index;
+
+			if (!taken[j]) {
+				continue;
+			} else if (generatedUID[i] && attempts < 10) {
+				snprintf(events[i]->UID, 1000, "%u", randomNumber());
+				retry = true;
+			} else {
+				errors[i] = INV_EVENT;
+				messages[i] = "An Event with the same UID already exists in the Calendar";
+				deleteEvent(events[i]);
+				events[i] = NULL;
+			}
+		}
+
+		if (!retry) {
+			break;
+		}
+	}
+
+	// Everything that's left is appended in its original order
+	if ((toWrite = initializeList(printEvent, deleteEvent, compareEvents)) == NULL) {
+		toReturn = ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not allocate memory");
+		goto CLEANBATCH;
+	}
+	for (int i = 0; i < numEvents; i++) {
+		if (events[i] != NULL) {
+			insertBack(toWrite, events[i]);
+		}
+	}
+
+	if (getLength(toWrite) > 0 && (error = spliceEvents((char *)filepath, fileno(fp), endOffset, toWrite)) != OK) {
+		toReturn = ferrorCodeToJSON(error, filepath, "Could not append the new Events to the Calendar file; changes may have only partially gone through, or not at all");
+		goto CLEANBATCH;
+	}
+
+	// Report what was added, and why everything else wasn't. The Events are already in the file by now,
+	// so running out of memory here only loses the report.
+	for (int i = 0; i < numEvents; i++) {
+		if (events[i] != NULL) {
+			if ((added[numAdded++] = eventToJSON(events[i])) == NULL) {
+				goto CLEANREPORT;
+			}
+		} else {
+			char *errorStr = printError(errors[i]);
+			size_t size = strlen(errorStr) + strlen(messages[i]) + 100;
+
+			rejected[numRejected] = malloc(size);
+			if (rejected[numRejected] != NULL) {
+				snprintf(rejected[numRejected], size, "{\"index\":%d,\"error\":\"%s\",\"message\":\"%s\"}", i, errorStr, messages[i]);
+			}
+			free(errorStr);
+			if (rejected[numRejected++] == NULL) {
+				goto CLEANREPORT;
+			}
+		}
+	}
+
+	const char *justFileName = strrchr(filepath, '/');
+	justFileName = (justFileName == NULL) ? filepath : justFileName + 1;
+
+	if ((addedJSON = joinJSONArray(added, numAdded)) != NULL && (rejectedJSON = joinJSONArray(rejected, numRejected)) != NULL \
+	    && (fileName = escapeJSON(justFileName)) != NULL) {
+		size_t size = strlen(fileName) + strlen(addedJSON) + strlen(rejectedJSON) + 50;
+
+		if ((toReturn = malloc(size)) != NULL) {
+			snprintf(toReturn, size, "{\"filename\":\"%s\",\"added\":%s,\"errors\":%s}", fileName, addedJSON, rejectedJSON);
+		}
+	}
+
+CLEANREPORT:
+	if (toReturn == NULL) {
+		toReturn = ferrorCodeToJSON(OTHER_ERROR, filepath, "The Events were added, but the list of them could not be allocated");
+	}
+
+	// Batch cleanup
+CLEANBATCH:	if (fp != NULL) {
+				fclose(fp);
+			}
+			if (toWrite != NULL) {
+				// the List owns every Event that is left
+				freeList(toWrite);
+			} else if (events != NULL) {
+				for (int i = 0; i < numEvents; i++) {
+					deleteEvent(events[i]);
+				}
+			}
+			for (int i = 0; i < numEvents; i++) {
+				free(elements[i]);
+			}
+			for (int i = 0; i < numAdded; i++) {
+				free(added[i]);
+			}
+			for (int i = 0; i < numRejected; i++) {
+				free(rejected[i]);
+			}
+			free(elements);
+			free(events);
+			free(generatedUID);
+			free(errors);
+			free(messages);
+			free(sorted);
+			free(uids);
+			free(taken);
+			free(added);
+			free(rejected);
+			free(addedJSON);
+			free(rejectedJSON);
+			free(fileName);
+			return toReturn;
+}
+
 // Writes the Calendar JSON to the file path
 char *writeCalFromJSON(const char filepath[], const char *calJSON, const char *evtJSON) {
 	ICalErrorCode error;
@@ -364,25 +738,1557 @@ char *writeCalFromJSON(const char filepath[], const char *calJSON, const char *e
 	}
 
 	if ((event = JSONtoEvent(evtJSON)) == NULL) {
+		deleteCalendar(cal);
 		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not properly convert Event JSON into Event object");
 	}
 
 	addEvent(cal, event);
 
 	if ((error = validateCalendar(cal)) != OK) {
+		deleteCalendar(cal);
 		return ferrorCodeToJSON(error, filepath, "Calendar file contains data that is invalid or wrong");
 	}
 
 	if ((error = writeCalendar((char *)filepath, cal)) != OK) {
+		deleteCalendar(cal);
 		return ferrorCodeToJSON(error, filepath, "Could not write the created Calendar back to the file path; changes may have only partially gone through, or not at all");
 	}
 
-	if ((toReturn = calendarToJSON(cal)) == NULL) {
+	toReturn = calendarToJSON(cal);
+	deleteCalendar(cal);
+
+	if (toReturn == NULL) {
 		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not convert the new Calendar back into a JSON");
 	}
 
+	return toReturn;
+}
+
+// The calls that the *Async() functions queue, with the arguments they were given
+static char *runCreateCalendar(char **args) {
+	return createCalendarJSON(args[0]);
+}
+
+static char *runAddEvent(char **args) {
+	return addEventJSON(args[0], args[1]);
+}
+
+static char *runAddEvents(char **args) {
+	return addEventsJSON(args[0], args[1]);
+}
+
+static char *runWriteCal(char **args) {
+	return writeCalFromJSON(args[0], args[1], args[2]);
+}
+
+static char *runSortedEvents(char **args) {
+	return sortedEventsJSON(args[0], args[1]);
+}
+
+// Returns the size of the file at 'filepath' (0 if it can't be found), for telling large jobs apart
+static size_t fileSize(const char filepath[]) {
+	struct stat info;
+
+	return (stat(filepath, &info) == 0) ? (size_t)info.st_size : 0;
+}
+
+// Returns the total size of the files in 'filepaths', which are separated by newlines
+static size_t filesSize(const char *filepaths) {
+	char *pathsCopy = strdup(filepaths), *path, *savePtr;
+	size_t total = 0;
+
+	if (pathsCopy == NULL) {
+		return 0;
+	}
+
+	for (path = strtok_r(pathsCopy, "\n", &savePtr); path != NULL; path = strtok_r(NULL, "\n", &savePtr)) {
+		total += fileSize(path);
+	}
+	free(pathsCopy);
+
+	return total;
+}
+
+// The same as createCalendarJSON(), but run on the library's worker pool (see JobQueue.h).
+// Returns the id of the job, whose result is taken with calendarJobResult(), or -1 on a fail.
+int createCalendarJSONAsync(const char filepath[]) {
+	if (filepath == NULL) {
+		return -1;
+	}
+
+	return submitJob(runCreateCalendar, &filepath, 1, fileSize(filepath), false);
+}
+
+// The same as addEventJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int addEventJSONAsync(const char filepath[], const char *eventJSON) {
+	const char *args[] = {filepath, eventJSON};
+
+	if (filepath == NULL || eventJSON == NULL) {
+		return -1;
+	}
+
+	return submitJob(runAddEvent, args, 2, fileSize(filepath), true);
+}
+
+// The same as addEventsJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int addEventsJSONAsync(const char filepath[], const char *eventsJSON) {
+	const char *args[] = {filepath, eventsJSON};
+
+	if (filepath == NULL || eventsJSON == NULL) {
+		return -1;
+	}
+
+	return submitJob(runAddEvents, args, 2, fileSize(filepath) + strlen(eventsJSON), true);
+}
+
+// The same as writeCalFromJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int writeCalFromJSONAsync(const char filepath[], const char *calJSON, const char *evtJSON) {
+	const char *args[] = {filepath, calJSON, evtJSON};
+
+	if (filepath == NULL || calJSON == NULL || evtJSON == NULL) {
+		return -1;
+	}
+
+	return submitJob(runWriteCal, args, 3, strlen(calJSON) + strlen(evtJSON), true);
+}
+
+// The same as sortedEventsJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int sortedEventsJSONAsync(const char filepath[], const char *key) {
+	const char *args[] = {filepath, key};
+
+	if (filepath == NULL || key == NULL) {
+		return -1;
+	}
+
+	return submitJob(runSortedEvents, args, 2, fileSize(filepath), false);
+}
+
+// Returns the read end of the pipe that the id of each finished job is written to, or -1 on a fail
+int calendarJobsFd() {
+	return jobQueueFd();
+}
+
+// Returns the result of the finished job 'id' (which can only be taken once), or NULL if it hasn't finished
+char *calendarJobResult(int id) {
+	return takeJobResult(id);
+}
+
+// Takes a filename and returns the Calendar encoded as CBOR (see CalendarCBOR.h), storing the
+// number of bytes in 'length'. On a fail, an error code JSON is returned instead and 'length' is set to -1.
+char *createCalendarCBOR(const char filepath[], int *length) {
+	ICalErrorCode error;
+	Calendar *cal;
+	size_t size;
+
+	*length = -1;
+
+	if (filepath == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File path was not received");
+	}
+
+	if ((error = createCalendarValidated((char *)filepath, &cal)) != OK) {
+		return ferrorCodeToJSON(error, filepath, "Could not read in a valid calendar from the file");
+	}
+
+	unsigned char *toReturn = calendarToCBOR(cal, &size);
 	deleteCalendar(cal);
 
+	if (toReturn == NULL) {
+		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not encode the Calendar as CBOR");
+	}
+
+	*length = (int)size;
+	return (char *)toReturn;
+}
+
+// Encodes the Calendar in args[0] as CBOR, and returns it after a native int holding its number of bytes, since a
+// job's result has no length of its own. If it can't be encoded, the int is -1 and the error code JSON follows it.
+static char *runCreateCalendarCBOR(char **args) {
+	int length;
+	char *encoded = createCalendarCBOR(args[0], &length);
+	size_t size = (length < 0) ? strlen(encoded) + 1 : (size_t)length;
+	char *toReturn = malloc(sizeof(int) + size);
+
+	if (toReturn == NULL) {
+		free(encoded);
+		return NULL;
+	}
+
+	memcpy(toReturn, &length, sizeof(int));
+	memcpy(toReturn + sizeof(int), encoded, size);
+	free(encoded);
+
+	return toReturn;
+}
+
+// The same as createCalendarCBOR(), but run on the library's worker pool. The result of the job is laid out as
+// runCreateCalendarCBOR() describes. Returns the id of the job, or -1 on a fail.
+int createCalendarCBORAsync(const char filepath[]) {
+	if (filepath == NULL) {
+		return -1;
+	}
+
+	return submitJob(runCreateCalendarCBOR, &filepath, 1, fileSize(filepath), false);
+}
+
+
+// The last Calendar that had its Events queried by time, and its EventIndex, so that more queries on
+// the same file don't parse it again. The file is taken to be unchanged while its inode, size and
+// modification time stay the same (calendar files are always replaced with rename(), which gives
+// them a new inode).
+static struct {
+	char *path;
+	struct stat info;
+	Calendar *cal;
+	EventIndex *index;
+} indexCache;
+static pthread_mutex_t indexCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Whether 'first' and 'second' are the status of the same file, unchanged
+static bool sameFileStatus(const struct stat *first, const struct stat *second) {
+	return first->st_dev == second->st_dev && first->st_ino == second->st_ino && first->st_size == second->st_size \
+	       && first->st_mtim.tv_sec == second->st_mtim.tv_sec && first->st_mtim.tv_nsec == second->st_mtim.tv_nsec;
+}
+
+// Makes indexCache hold the Calendar in 'filepath', whose current status is 'info'.
+// Must be called with indexCacheLock held. Returns OK, or the error that reading the Calendar gave.
+static ICalErrorCode loadIndexCache(const char filepath[], const struct stat *info) {
+	ICalErrorCode error;
+
+	if (indexCache.path != NULL && strcmp(indexCache.path, filepath) == 0 && sameFileStatus(&indexCache.info, info)) {
+		return OK;
+	}
+
+	deleteEventIndex(indexCache.index);
+	if (indexCache.cal != NULL) {
+		deleteCalendar(indexCache.cal);
+	}
+	free(indexCache.path);
+	indexCache.path = NULL;
+	indexCache.cal = NULL;
+	indexCache.index = NULL;
+
+	if ((error = createCalendarValidated((char *)filepath, &indexCache.cal)) != OK) {
+		return error;
+	}
+
+	if ((indexCache.index = createEventIndex(indexCache.cal)) == NULL) {
+		deleteCalendar(indexCache.cal);
+		indexCache.cal = NULL;
+		return OTHER_ERROR;
+	}
+
+	indexCache.path = strdup(filepath);
+	indexCache.info = *info;
+
+	return OK;
+}
+
+// Takes a filename and a range of time [from, to), given as iCalendar DATE or DATE-TIME values. If 'to' is
+// empty, the range is the day (or second) that 'from' names. Returns a JSON array of every Event in the
+// Calendar that overlaps the range, sorted by start time, or an error code JSON on a fail.
+char *queryEventsInRangeJSON(const char filepath[], const char *from, const char *to) {
+	ICalErrorCode error;
+	struct stat info;
+	TimeSpan range;
+	bool isDate;
+	char *toReturn;
+
+	if (filepath == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File path was not received");
+	}
+
+	if (from == NULL || parseTimeValue(from, &range.start, &isDate) != OK) {
+		return ferrorCodeToJSON(INV_DT, filepath, "Start of the range is not a DATE or DATE-TIME");
+	}
+
+	if (to == NULL || to[0] == '\0') {
+		range.end = range.start + (isDate ? SECONDS_PER_DAY : 1);
+	} else if (parseTimeValue(to, &range.end, NULL) != OK) {
+		return ferrorCodeToJSON(INV_DT, filepath, "End of the range is not a DATE or DATE-TIME");
+	}
+
+	if (stat(filepath, &info) != 0) {
+		return ferrorCodeToJSON(INV_FILE, filepath, "Could not find the calendar file");
+	}
+
+	pthread_mutex_lock(&indexCacheLock);
+
+	if ((error = loadIndexCache(filepath, &info)) != OK) {
+		pthread_mutex_unlock(&indexCacheLock);
+		return ferrorCodeToJSON(error, filepath, "Could not read in a valid calendar from the file");
+	}
+
+	toReturn = queryEventsInRange(indexCache.index, range);
+
+	pthread_mutex_unlock(&indexCacheLock);
+
+	if (toReturn == NULL) {
+		toReturn = ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not allocate memory for the Events in the range");
+	}
+
+	return toReturn;
+}
+
+static char *runQueryEventsInRange(char **args) {
+	return queryEventsInRangeJSON(args[0], args[1], args[2]);
+}
+
+// The same as queryEventsInRangeJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int queryEventsInRangeJSONAsync(const char filepath[], const char *from, const char *to) {
+	const char *args[] = {filepath, from, to};
+
+	if (filepath == NULL || from == NULL || to == NULL) {
+		return -1;
+	}
+
+	return submitJob(runQueryEventsInRange, args, 3, fileSize(filepath), false);
+}
+
+// Takes a filename, the UID of one of its Events, and a range of time [from, to) given as iCalendar DATE or
+// DATE-TIME values. Returns a JSON array of the times the Event occurs at in that range, following its
+// RRULE, RDATEs and EXDATEs, as [{"startDT":...,"endDT":...},...]. At most MAX_OCCURRENCES_JSON are returned.
+// Returns an error code JSON on a fail.
+char *eventOccurrencesJSON(const char filepath[], const char *uid, const char *from, const char *to) {
+	ICalErrorCode error;
+	struct stat info;
+	TimeSpan range;
+	Recurrence *rec;
+	Event *ev;
+	char *toReturn;
+
+	if (filepath == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File path was not received");
+	}
+	if (uid == NULL) {
+		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Event UID was not received");
+	}
+	if (from == NULL || to == NULL || parseTimeValue(from, &range.start, NULL) != OK || parseTimeValue(to, &range.end, NULL) != OK) {
+		return ferrorCodeToJSON(INV_DT, filepath, "Range is not made of two DATE or DATE-TIME values");
+	}
+	if (stat(filepath, &info) != 0) {
+		return ferrorCodeToJSON(INV_FILE, filepath, "Could not find the calendar file");
+	}
+
+	// The Calendar that range queries use is kept around, so it is shared with them
+	pthread_mutex_lock(&indexCacheLock);
+
+	if ((error = loadIndexCache(filepath, &info)) != OK) {
+		pthread_mutex_unlock(&indexCacheLock);
+		return ferrorCodeToJSON(error, filepath, "Could not read in a valid calendar from the file");
+	}
+
+	ListIterator iter = createIterator(indexCache.cal->events);
+	while ((ev = (Event *)nextElement(&iter)) != NULL && strcmp(ev->UID, uid) != 0);
+
+	if (ev == NULL) {
+		toReturn = ferrorCodeToJSON(OTHER_ERROR, filepath, "The calendar has no Event with that UID");
+	} else if ((error = compileRecurrence(ev, &rec)) != OK) {
+		toReturn = ferrorCodeToJSON(error, filepath, "The Event's recurrence properties are invalid or not supported");
+	} else {
+		toReturn = occurrencesToJSON(rec, range, MAX_OCCURRENCES_JSON);
+		deleteRecurrence(rec);
+	}
+
+	pthread_mutex_unlock(&indexCacheLock);
+
 	return toReturn;
 }
 
+static char *runEventOccurrences(char **args) {
+	return eventOccurrencesJSON(args[0], args[1], args[2], args[3]);
+}
+
+// The same as eventOccurrencesJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int eventOccurrencesJSONAsync(const char filepath[], const char *uid, const char *from, const char *to) {
+	const char *args[] = {filepath, uid, from, to};
+
+	if (filepath == NULL || uid == NULL || from == NULL || to == NULL) {
+		return -1;
+	}
+
+	return submitJob(runEventOccurrences, args, 4, fileSize(filepath), false);
+}
+
+// A pair of overlapping Events, as positions in a sweep (see Conflicts.h)
+typedef struct conflictpair {
+	int first;
+	int second;
+} ConflictPair;
+
+// What findConflictsJSON() has found so far: which sweep entries overlap another one, how many
+// overlapping pairs there are, and the first MAX_CONFLICTS_JSON of those pairs
+typedef struct conflictlist {
+	bool *involved;
+	ConflictPair *pairs;
+	long length;
+	long numConflicts;
+} ConflictList;
+
+static void addConflict(int first, int second, void *data) {
+	ConflictList *list = data;
+
+	list->involved[first] = list->involved[second] = true;
+	list->numConflicts++;
+
+	// A dense calendar can have a number of pairs that is close to the square of its number of Events,
+	// so only the first few are kept
+	if (list->length < MAX_CONFLICTS_JSON) {
+		list->pairs[list->length].first = first;
+		list->pairs[list->length].second = second;
+		list->length++;
+	}
+}
+
+// Returns the description of the Event's first property called 'name', or "" if it doesn't have one
+static const char *findPropDescr(const Event *ev, const char *name) {
+	ListIterator iter = createIterator(ev->properties);
+	Property *prop;
+
+	while ((prop = (Property *)nextElement(&iter)) != NULL) {
+		if (strcasecmp(prop->propName, name) == 0) {
+			return prop->propDescr;
+		}
+	}
+
+	return "";
+}
+
+// Takes the paths of any number of calendar files, separated by newlines, and finds every pair of Events
+// (in the same file or in different ones) whose times overlap. Returns
+// {"events":[{"filename":...,"UID":...,"summary":...,"organizer":...,"startDT":...}],"numConflicts":...,
+//  "truncated":...,"conflicts":[[a,b],...],"errors":[...]},
+// where 'events' holds every Event that overlaps another one (sorted by start time), 'numConflicts' is the
+// number of overlapping pairs, 'conflicts' holds the positions in 'events' of the first MAX_CONFLICTS_JSON
+// of those pairs ('truncated' is true if there were more), and 'errors' holds an error code JSON for
+// each file that could not be read in.
+char *findConflictsJSON(const char *filepaths) {
+	Calendar **cals;
+	EventIndex **indexes;
+	char **names, *pathsCopy, *path, *savePtr;
+	SweepEntry *entries;
+	ConflictList conflicts = {NULL, NULL, 0, 0};
+	int numCals, maxCals, numEntries;
+	char *toReturn;
+	size_t length;
+
+	if (filepaths == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File paths were not received");
+	}
+
+	// Each path gets its own line, so there can't be more calendars than newlines + 1
+	maxCals = 1;
+	for (const char *c = filepaths; *c != '\0'; c++) {
+		maxCals += (*c == '\n');
+	}
+
+	cals = malloc(sizeof(Calendar *) * maxCals);
+	indexes = malloc(sizeof(EventIndex *) * maxCals);
+	names = malloc(sizeof(char *) * maxCals);
+	pathsCopy = strdup(filepaths);
+	numCals = 0;
+
+	FILE *json = open_memstream(&toReturn, &length);
+	fputs("{\"errors\":[", json);
+
+	bool firstError = true;
+	for (path = strtok_r(pathsCopy, "\n", &savePtr); path != NULL; path = strtok_r(NULL, "\n", &savePtr)) {
+		ICalErrorCode error = createCalendarValidated(path, &cals[numCals]);
+
+		if (error == OK && (indexes[numCals] = createEventIndex(cals[numCals])) == NULL) {
+			deleteCalendar(cals[numCals]);
+			error = OTHER_ERROR;
+		}
+
+		if (error != OK) {
+			char *errorJSON = ferrorCodeToJSON(error, path, "Could not read in a valid calendar from the file");
+			fprintf(json, "%s%s", firstError ? "" : ",", errorJSON);
+			free(errorJSON);
+			firstError = false;
+			continue;
+		}
+
+		names[numCals] = strrchr(path, '/') == NULL ? path : strrchr(path, '/') + 1;
+		numCals++;
+	}
+
+	if ((numEntries = createSweep(indexes, numCals, &entries)) >= 0) {
+		conflicts.involved = calloc(numEntries + 1, sizeof(bool));
+		conflicts.pairs = malloc(sizeof(ConflictPair) * MAX_CONFLICTS_JSON);
+		if (conflicts.involved != NULL && conflicts.pairs != NULL) {
+			findConflicts(entries, numEntries, addConflict, &conflicts);
+		}
+	}
+
+	// Only the Events that overlap another one are sent, so each is given its position among those
+	int *positions = malloc(sizeof(int) * (numEntries + 1));
+	int numInvolved = 0;
+
+	fputs("],\"events\":[", json);
+	for (int i = 0; i < numEntries; i++) {
+		if (conflicts.involved == NULL || !conflicts.involved[i]) {
+			continue;
+		}
+		positions[i] = numInvolved++;
+
+		const Event *ev = entries[i].event;
+		char *startDT = dtToJSON(ev->startDateTime);
+		fprintf(json, "%s{\"filename\":\"%s\",\"UID\":\"%s\",\"summary\":\"%s\",\"organizer\":\"%s\",\"startDT\":%s}", \
+		        (positions[i] == 0) ? "" : ",", names[entries[i].calendar], ev->UID, \
+		        findPropDescr(ev, "SUMMARY"), findPropDescr(ev, "ORGANIZER"), startDT);
+		free(startDT);
+	}
+
+	fprintf(json, "],\"numConflicts\":%ld,\"truncated\":%s,\"conflicts\":[", conflicts.numConflicts, \
+	        (conflicts.numConflicts > conflicts.length) ? "true" : "false");
+	for (long i = 0; i < conflicts.length; i++) {
+		fprintf(json, "%s[%d,%d]", (i == 0) ? "" : ",", positions[conflicts.pairs[i].first], positions[conflicts.pairs[i].second]);
+	}
+	fputs("]}", json);
+	fclose(json);
+
+	for (int i = 0; i < numCals; i++) {
+		deleteEventIndex(indexes[i]);
+		deleteCalendar(cals[i]);
+	}
+	if (numEntries >= 0) {
+		free(entries);
+	}
+	free(positions);
+	free(conflicts.involved);
+	free(conflicts.pairs);
+	free(cals);
+	free(indexes);
+	free(names);
+	free(pathsCopy);
+
+	return toReturn;
+}
+
+static char *runFindConflicts(char **args) {
+	return findConflictsJSON(args[0]);
+}
+
+// The same as findConflictsJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int findConflictsJSONAsync(const char *filepaths) {
+	if (filepaths == NULL) {
+		return -1;
+	}
+
+	return submitJob(runFindConflicts, &filepaths, 1, filesSize(filepaths), false);
+}
+
+
+// A set of Calendars kept between queries on the same files, so that they aren't read in again. Like indexCache,
+// it is rebuilt as soon as the list of files, or any one of the files, changes, but the Calendars of files that
+// are still in the list and haven't changed are kept. The SearchIndex, EventSets and AlarmSchedule over them
+// are only built once a query needs them.
+typedef struct calendarset {
+	char *paths;
+	int numPaths;
+	struct stat *infos;
+	int numCals;
+	Calendar **cals;
+	char **names;
+	// The full path of every Calendar, and the status its file had when it was read in
+	char **calPaths;
+	struct stat *calInfos;
+	// The error code JSON of every file that could not be read in, separated by commas
+	char *errors;
+	SearchIndex *searchIndex;
+	// Indexed by whether the Events are compared by content
+	EventSet *eventSets[2];
+	AlarmSchedule *alarmSchedule;
+} CalendarSet;
+
+// The Calendars behind the last search, free/busy or duplicate query
+static CalendarSet calendarSet;
+static pthread_mutex_t calendarSetLock = PTHREAD_MUTEX_INITIALIZER;
+
+// The Calendars behind the last alarm query. An AlarmSchedule is meant to be polled over and over with the
+// same files, so it gets a set of its own, which the other queries (each on their own list of files) can't
+// throw away.
+static CalendarSet alarmSet;
+static pthread_mutex_t alarmSetLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Frees everything in 'set', except for the Calendars that have been taken out of it (set to NULL).
+// Must be called with the set's lock held.
+static void clearCalendarSet(CalendarSet *set) {
+	deleteSearchIndex(set->searchIndex);
+	deleteEventSet(set->eventSets[0]);
+	deleteEventSet(set->eventSets[1]);
+	deleteAlarmSchedule(set->alarmSchedule);
+	for (int i = 0; i < set->numCals; i++) {
+		if (set->cals[i] != NULL) {
+			deleteCalendar(set->cals[i]);
+		}
+		free(set->names[i]);
+		free(set->calPaths[i]);
+	}
+	free(set->paths);
+	free(set->infos);
+	free(set->cals);
+	free(set->names);
+	free(set->calPaths);
+	free(set->calInfos);
+	free(set->errors);
+
+	memset(set, 0, sizeof(CalendarSet));
+}
+
+// Makes 'set' hold the Calendars in 'filepaths' (separated by newlines). A file that can't be read in
+// gets an error code JSON in set->errors instead. Must be called with the set's lock held.
+static void loadCalendarSet(CalendarSet *set, const char *filepaths) {
+	char *pathsCopy, *path, *savePtr;
+	struct stat *infos;
+	int maxPaths, numPaths;
+
+	// Each path gets its own line, so there can't be more paths than newlines + 1
+	maxPaths = 1;
+	for (const char *c = filepaths; *c != '\0'; c++) {
+		maxPaths += (*c == '\n');
+	}
+
+	infos = malloc(sizeof(struct stat) * maxPaths);
+	pathsCopy = strdup(filepaths);
+	numPaths = 0;
+
+	// A file that can't be found is given an empty status, which stays the same until it shows up
+	for (path = strtok_r(pathsCopy, "\n", &savePtr); path != NULL; path = strtok_r(NULL, "\n", &savePtr)) {
+		if (stat(path, &infos[numPaths]) != 0) {
+			memset(&infos[numPaths], 0, sizeof(struct stat));
+		}
+		numPaths++;
+	}
+	free(pathsCopy);
+
+	bool unchanged = set->paths != NULL && strcmp(set->paths, filepaths) == 0 && set->numPaths == numPaths;
+	for (int i = 0; unchanged && i < numPaths; i++) {
+		unchanged = sameFileStatus(&set->infos[i], &infos[i]);
+	}
+	if (unchanged) {
+		free(infos);
+		return;
+	}
+
+	CalendarSet old = *set;
+	memset(set, 0, sizeof(CalendarSet));
+	set->paths = strdup(filepaths);
+	set->numPaths = numPaths;
+	set->infos = infos;
+	set->cals = malloc(sizeof(Calendar *) * maxPaths);
+	set->names = malloc(sizeof(char *) * maxPaths);
+	set->calPaths = malloc(sizeof(char *) * maxPaths);
+	set->calInfos = malloc(sizeof(struct stat) * maxPaths);
+
+	size_t length;
+	FILE *errors = open_memstream(&set->errors, &length);
+	bool firstError = true;
+
+	pathsCopy = strdup(filepaths);
+	numPaths = 0;
+	for (path = strtok_r(pathsCopy, "\n", &savePtr); path != NULL; path = strtok_r(NULL, "\n", &savePtr), numPaths++) {
+		Calendar *cal = NULL;
+
+		// A file that was in the old set and hasn't changed since keeps its Calendar
+		for (int j = 0; j < old.numCals; j++) {
+			if (old.cals[j] != NULL && strcmp(old.calPaths[j], path) == 0 && sameFileStatus(&old.calInfos[j], &infos[numPaths])) {
+				cal = old.cals[j];
+				old.cals[j] = NULL;
+				break;
+			}
+		}
+
+		if (cal == NULL) {
+			ICalErrorCode error = createCalendarValidated(path, &cal);
+
+			if (error != OK) {
+				char *errorJSON = ferrorCodeToJSON(error, path, "Could not read in a valid calendar from the file");
+				fprintf(errors, "%s%s", firstError ? "" : ",", errorJSON);
+				free(errorJSON);
+				firstError = false;
+				continue;
+			}
+		}
+
+		set->cals[set->numCals] = cal;
+		set->names[set->numCals] = strdup(strrchr(path, '/') == NULL ? path : strrchr(path, '/') + 1);
+		set->calPaths[set->numCals] = strdup(path);
+		set->calInfos[set->numCals] = infos[numPaths];
+		set->numCals++;
+	}
+	free(pathsCopy);
+	fclose(errors);
+
+	clearCalendarSet(&old);
+}
+
+// Takes the paths of any number of calendar files, separated by newlines, and a query made of words, and
+// finds every Event whose SUMMARY, DESCRIPTION and LOCATION contain all of the words between them (a word
+// ending in '*' matches any word that starts with it). Returns
+// {"errors":[...],"total":...,"events":[{"filename":...,"UID":...,"summary":...,"location":...,"startDT":...}]},
+// where 'total' is the number of Events found, 'events' holds the first MAX_SEARCH_RESULTS of them (in
+// order of file and then position in the file), and 'errors' holds an error code JSON for each file that
+// could not be read in.
+char *searchEventsJSON(const char *filepaths, const char *query) {
+	SearchHit *hits;
+	char *toReturn;
+	size_t length;
+	int numHits;
+
+	if (filepaths == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File paths were not received");
+	}
+	if (query == NULL) {
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "Search query was not received");
+	}
+
+	pthread_mutex_lock(&calendarSetLock);
+
+	loadCalendarSet(&calendarSet, filepaths);
+	if (calendarSet.searchIndex == NULL \
+	    && (calendarSet.searchIndex = createSearchIndex(calendarSet.cals, calendarSet.numCals)) == NULL) {
+		pthread_mutex_unlock(&calendarSetLock);
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "Could not build the search index");
+	}
+
+	if ((numHits = searchEvents(calendarSet.searchIndex, query, &hits)) < 0) {
+		pthread_mutex_unlock(&calendarSetLock);
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "Could not search the calendars");
+	}
+
+	FILE *json = open_memstream(&toReturn, &length);
+	fprintf(json, "{\"errors\":[%s],\"total\":%d,\"events\":[", calendarSet.errors, numHits);
+
+	for (int i = 0; i < numHits && i < MAX_SEARCH_RESULTS; i++) {
+		const Event *ev = searchHitEvent(calendarSet.searchIndex, hits[i]);
+		char *startDT = dtToJSON(ev->startDateTime);
+
+		fprintf(json, "%s{\"filename\":\"%s\",\"UID\":\"%s\",\"summary\":\"%s\",\"location\":\"%s\",\"startDT\":%s}", \
+		        (i == 0) ? "" : ",", calendarSet.names[hits[i].calendar], ev->UID, \
+		        findPropDescr(ev, "SUMMARY"), findPropDescr(ev, "LOCATION"), startDT);
+		free(startDT);
+	}
+
+	fputs("]}", json);
+	fclose(json);
+	free(hits);
+
+	pthread_mutex_unlock(&calendarSetLock);
+
+	return toReturn;
+}
+
+static char *runSearchEvents(char **args) {
+	return searchEventsJSON(args[0], args[1]);
+}
+
+// The same as searchEventsJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int searchEventsJSONAsync(const char *filepaths, const char *query) {
+	const char *args[] = {filepaths, query};
+
+	if (filepaths == NULL || query == NULL) {
+		return -1;
+	}
+
+	return submitJob(runSearchEvents, args, 2, filesSize(filepaths), false);
+}
+
+
+// Takes the paths of any number of calendar files, separated by newlines, a range of time [from, to) given as
+// iCalendar DATE or DATE-TIME values, the length of a time slot in minutes, and one of these modes:
+//   "free":    the time every calendar is free
+//   "busy":    the time at least one calendar is busy
+//   "allbusy": the time every calendar is busy
+// Every Event (and occurrence of a recurring one) takes up each slot it overlaps, even partly (see FreeBusy.h).
+// Returns {"errors":[...],"numCalendars":...,"periods":[{"startDT":...,"endDT":...},...],"freebusy":"..."},
+// where 'periods' and 'freebusy' (as a FREEBUSY property value) both hold the runs of slots that match the
+// mode, and 'errors' holds an error code JSON for each file that could not be read in.
+char *freeBusyJSON(const char *filepaths, const char *from, const char *to, int slotMinutes, const char *mode) {
+	BusyBitmap *result, *bitmap;
+	TimeSpan range;
+	char *toReturn, *periods, *freebusy;
+	size_t length;
+
+	if (filepaths == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File paths were not received");
+	}
+	if (from == NULL || to == NULL || parseTimeValue(from, &range.start, NULL) != OK || parseTimeValue(to, &range.end, NULL) != OK \
+	    || range.end <= range.start) {
+		return ferrorCodeToJSON(INV_DT, NULL, "Range is not made of two DATE or DATE-TIME values in order");
+	}
+	if (mode == NULL || (strcmp(mode, "free") != 0 && strcmp(mode, "busy") != 0 && strcmp(mode, "allbusy") != 0)) {
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "Mode must be free, busy or allbusy");
+	}
+
+	// The last slot may run past the end of the range
+	int64_t slotSeconds = (int64_t)slotMinutes * 60;
+	int64_t numSlots = (slotSeconds <= 0) ? 0 : (range.end - range.start + slotSeconds - 1) / slotSeconds;
+	bool everyone = (strcmp(mode, "allbusy") == 0);
+
+	if (numSlots <= 0 || numSlots > MAX_BUSY_SLOTS) {
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "The range holds too many (or too few) slots");
+	}
+
+	pthread_mutex_lock(&calendarSetLock);
+
+	loadCalendarSet(&calendarSet, filepaths);
+	result = createBusyBitmap(range.start, slotSeconds, numSlots);
+	bitmap = createBusyBitmap(range.start, slotSeconds, numSlots);
+
+	if (result == NULL || bitmap == NULL) {
+		pthread_mutex_unlock(&calendarSetLock);
+		deleteBusyBitmap(result);
+		deleteBusyBitmap(bitmap);
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "Could not allocate the free/busy bitmaps");
+	}
+
+	// Each Calendar gets its own bitmap, which is combined with the others 64 slots at a time
+	for (int i = 0; i < calendarSet.numCals; i++) {
+		memset(bitmap->words, 0, sizeof(uint64_t) * bitmap->numWords);
+		markCalendarBusy(bitmap, calendarSet.cals[i]);
+
+		if (everyone && i > 0) {
+			intersectBusy(result, bitmap);
+		} else {
+			unionBusy(result, bitmap);
+		}
+	}
+
+	// Everyone is free whenever nobody is busy
+	bool busy = (strcmp(mode, "free") != 0);
+	periods = periodsToJSON(result, busy);
+	freebusy = periodsToFreeBusy(result, busy);
+
+	FILE *json = open_memstream(&toReturn, &length);
+	fprintf(json, "{\"errors\":[%s],\"numCalendars\":%d,\"periods\":%s,\"freebusy\":\"%s\"}", \
+	        calendarSet.errors, calendarSet.numCals, periods, freebusy);
+	fclose(json);
+
+	pthread_mutex_unlock(&calendarSetLock);
+
+	free(periods);
+	free(freebusy);
+	deleteBusyBitmap(result);
+	deleteBusyBitmap(bitmap);
+
+	return toReturn;
+}
+
+static char *runFreeBusy(char **args) {
+	return freeBusyJSON(args[0], args[1], args[2], atoi(args[3]), args[4]);
+}
+
+// The same as freeBusyJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int freeBusyJSONAsync(const char *filepaths, const char *from, const char *to, int slotMinutes, const char *mode) {
+	char minutes[16];
+	const char *args[] = {filepaths, from, to, minutes, mode};
+
+	if (filepaths == NULL || from == NULL || to == NULL || mode == NULL) {
+		return -1;
+	}
+
+	snprintf(minutes, sizeof(minutes), "%d", slotMinutes);
+	return submitJob(runFreeBusy, args, 5, filesSize(filepaths), false);
+}
+
+// Returns the EventSet of calendarSet's Events, compared by UID or also by content, building it if it hasn't
+// been yet. Returns NULL if memory could not be allocated. Must be called with calendarSetLock held.
+static EventSet *calendarSetEvents(bool byContent) {
+	if (calendarSet.eventSets[byContent] == NULL) {
+		calendarSet.eventSets[byContent] = createEventSet(calendarSet.cals, calendarSet.numCals, byContent);
+	}
+
+	return calendarSet.eventSets[byContent];
+}
+
+// A growing array of the copies of an Event, for findCopies()
+typedef struct copylist {
+	const FingerprintEntry **entries;
+	int length;
+	int size;
+} CopyList;
+
+static void addCopy(const FingerprintEntry *entry, void *data) {
+	CopyList *copies = data;
+
+	if (copies->length == copies->size) {
+		copies->size = (copies->size == 0) ? 8 : copies->size * 2;
+		copies->entries = realloc(copies->entries, sizeof(FingerprintEntry *) * copies->size);
+	}
+	copies->entries[copies->length++] = entry;
+}
+
+// Orders copies by the file they're in, and then by their position in it
+static int compareCopies(const void *first, const void *second) {
+	const FingerprintEntry *a = *(const FingerprintEntry **)first, *b = *(const FingerprintEntry **)second;
+
+	return (a->calendar != b->calendar) ? a->calendar - b->calendar : a->position - b->position;
+}
+
+// Takes the paths of any number of calendar files, separated by newlines, and finds every Event that is in
+// them more than once, comparing Events by their UID alone or, if 'byContent' is true, also by their DTSTART,
+// properties and alarms (see Dedup.h). Returns
+// {"errors":[...],"numEvents":...,"numUnique":...,"numDuplicated":...,"duplicates":[{"UID":...,"summary":...,
+// "copies":[{"filename":...,"position":...}]}]}, where 'numUnique' is the number of Events left once every
+// copy is dropped, 'numDuplicated' is the number of Events that have copies, 'duplicates' holds the first
+// MAX_DUPLICATES_JSON of them along with where every copy is (position is the Event's index in its file), and
+// 'errors' holds an error code JSON for each file that could not be read in.
+char *duplicateEventsJSON(const char *filepaths, bool byContent) {
+	CopyList copies = {NULL, 0, 0};
+	EventSet *set;
+	char *toReturn;
+	size_t length;
+	int numDuplicated = 0, numCopies = 0;
+
+	if (filepaths == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File paths were not received");
+	}
+
+	pthread_mutex_lock(&calendarSetLock);
+
+	loadCalendarSet(&calendarSet, filepaths);
+	if ((set = calendarSetEvents(byContent)) == NULL) {
+		pthread_mutex_unlock(&calendarSetLock);
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "Could not fingerprint the events");
+	}
+
+	FILE *json = open_memstream(&toReturn, &length);
+	fprintf(json, "{\"errors\":[%s],\"duplicates\":[", calendarSet.errors);
+
+	for (int c = 0; c < calendarSet.numCals; c++) {
+		ListIterator iter = createIterator(calendarSet.cals[c]->events);
+		Event *ev;
+
+		for (int position = 0; (ev = (Event *)nextElement(&iter)) != NULL; position++) {
+			copies.length = 0;
+			if (findCopies(set, ev, addCopy, &copies) == 0) {
+				continue;
+			}
+
+			// Each group of copies is only reported by its first Event
+			bool first = true;
+			for (int i = 0; first && i < copies.length; i++) {
+				const FingerprintEntry *copy = copies.entries[i];
+				first = copy->calendar > c || (copy->calendar == c && copy->position > position);
+			}
+			if (!first) {
+				continue;
+			}
+
+			if (numDuplicated < MAX_DUPLICATES_JSON) {
+				qsort(copies.entries, copies.length, sizeof(FingerprintEntry *), compareCopies);
+
+				fprintf(json, "%s{\"UID\":\"%s\",\"summary\":\"%s\",\"copies\":[{\"filename\":\"%s\",\"position\":%d}", \
+				        (numDuplicated == 0) ? "" : ",", ev->UID, findPropDescr(ev, "SUMMARY"), calendarSet.names[c], position);
+				for (int i = 0; i < copies.length; i++) {
+					fprintf(json, ",{\"filename\":\"%s\",\"position\":%d}", \
+					        calendarSet.names[copies.entries[i]->calendar], copies.entries[i]->position);
+				}
+				fputs("]}", json);
+			}
+			numDuplicated++;
+			numCopies += copies.length;
+		}
+	}
+
+	fprintf(json, "],\"numEvents\":%zu,\"numUnique\":%zu,\"numDuplicated\":%d}", \
+	        set->numEvents, set->numEvents - numCopies, numDuplicated);
+	fclose(json);
+
+	pthread_mutex_unlock(&calendarSetLock);
+
+	free(copies.entries);
+
+	return toReturn;
+}
+
+static char *runDuplicateEvents(char **args) {
+	return duplicateEventsJSON(args[0], args[1][0] == '1');
+}
+
+// The same as duplicateEventsJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int duplicateEventsJSONAsync(const char *filepaths, bool byContent) {
+	const char *args[] = {filepaths, byContent ? "1" : "0"};
+
+	if (filepaths == NULL) {
+		return -1;
+	}
+
+	return submitJob(runDuplicateEvents, args, 2, filesSize(filepaths), false);
+}
+
+// Takes the paths of any number of calendar files, separated by newlines, and the path of another calendar
+// file (e.g. one that was just uploaded), and finds every Event of the other file that is already in one of
+// the files, compared the same way as in duplicateEventsJSON(). The other file itself is skipped if it is in
+// the list. Returns {"errors":[...],"numEvents":...,"duplicates":[{"UID":...,"summary":...,"position":...,
+// "filenames":[...]}]}, where 'numEvents' is the number of Events in the other file, 'position' is the
+// index of the Event in it, 'filenames' are the files that already have a copy of it, and 'errors' holds
+// an error code JSON for each file in the list that could not be read in.
+char *checkDuplicatesJSON(const char *filepaths, const char filepath[], bool byContent) {
+	CopyList copies = {NULL, 0, 0};
+	Calendar *cal;
+	EventSet *set;
+	ICalErrorCode error;
+	char *toReturn;
+	size_t length;
+	int numDuplicates = 0;
+
+	if (filepaths == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File paths were not received");
+	}
+	if (filepath == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File path was not received");
+	}
+	if ((error = createCalendarValidated((char *)filepath, &cal)) != OK) {
+		return ferrorCodeToJSON(error, filepath, "Could not read in a valid calendar from the file");
+	}
+
+	pthread_mutex_lock(&calendarSetLock);
+
+	loadCalendarSet(&calendarSet, filepaths);
+	if ((set = calendarSetEvents(byContent)) == NULL) {
+		pthread_mutex_unlock(&calendarSetLock);
+		deleteCalendar(cal);
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "Could not fingerprint the events");
+	}
+
+	FILE *json = open_memstream(&toReturn, &length);
+	fprintf(json, "{\"errors\":[%s],\"numEvents\":%d,\"duplicates\":[", calendarSet.errors, getLength(cal->events));
+
+	ListIterator iter = createIterator(cal->events);
+	Event *ev;
+	for (int position = 0; (ev = (Event *)nextElement(&iter)) != NULL; position++) {
+		copies.length = 0;
+		if (findCopies(set, ev, addCopy, &copies) == 0) {
+			continue;
+		}
+
+		qsort(copies.entries, copies.length, sizeof(FingerprintEntry *), compareCopies);
+
+		// Every file with a copy is listed once, and the file being checked isn't listed at all
+		bool found = false;
+		for (int i = 0; i < copies.length; i++) {
+			int c = copies.entries[i]->calendar;
+
+			if (strcmp(calendarSet.calPaths[c], filepath) == 0 || (i > 0 && copies.entries[i - 1]->calendar == c)) {
+				continue;
+			}
+
+			if (!found) {
+				fprintf(json, "%s{\"UID\":\"%s\",\"summary\":\"%s\",\"position\":%d,\"filenames\":[", \
+				        (numDuplicates == 0) ? "" : ",", ev->UID, findPropDescr(ev, "SUMMARY"), position);
+			}
+			fprintf(json, "%s\"%s\"", found ? "," : "", calendarSet.names[c]);
+			found = true;
+		}
+
+		if (found) {
+			fputs("]}", json);
+			numDuplicates++;
+		}
+	}
+
+	fputs("]}", json);
+	fclose(json);
+
+	pthread_mutex_unlock(&calendarSetLock);
+
+	free(copies.entries);
+	deleteCalendar(cal);
+
+	return toReturn;
+}
+
+static char *runCheckDuplicates(char **args) {
+	return checkDuplicatesJSON(args[0], args[1], args[2][0] == '1');
+}
+
+// The same as checkDuplicatesJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int checkDuplicatesJSONAsync(const char *filepaths, const char filepath[], bool byContent) {
+	const char *args[] = {filepaths, filepath, byContent ? "1" : "0"};
+
+	if (filepaths == NULL || filepath == NULL) {
+		return -1;
+	}
+
+	return submitJob(runCheckDuplicates, args, 3, filesSize(filepaths) + fileSize(filepath), false);
+}
+
+// Takes the paths of any number of calendar files, separated by newlines, a time given as an iCalendar DATE or
+// DATE-TIME value, and a number of alarms 'k', and finds the next (up to) k times an Alarm of one of the files
+// goes off at or after that time (see AlarmSchedule.h). Returns
+// {"errors":[...],"numAlarms":...,"numSkipped":...,"alarms":[{"time":...,"filename":...,"UID":...,"summary":...,
+// "action":...,"trigger":...,"occurrence":...,"repeat":...}]}, where 'numAlarms' is the number of Alarms in the
+// files, 'numSkipped' the number of them whose TRIGGER, REPEAT or DURATION is malformed, 'occurrence' is the start
+// of the occurrence of the Event the Alarm goes off for, and 'repeat' is 0 the first time it goes off for that
+// occurrence. The schedule is kept between calls, so polling it with a time that moves forward is cheap.
+char *nextAlarmsJSON(const char *filepaths, const char *now, int k) {
+	AlarmFiring *firings;
+	int64_t nowSeconds;
+	char *toReturn;
+	size_t length;
+	int numFirings;
+
+	if (filepaths == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "File paths were not received");
+	}
+	if (now == NULL || parseTimeValue(now, &nowSeconds, NULL) != OK) {
+		return ferrorCodeToJSON(INV_DT, NULL, "Time is not a DATE or DATE-TIME value");
+	}
+	if (k <= 0 || k > MAX_ALARMS_JSON) {
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "The number of alarms is out of range");
+	}
+	if ((firings = malloc(sizeof(AlarmFiring) * k)) == NULL) {
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "Could not allocate the alarms");
+	}
+
+	pthread_mutex_lock(&alarmSetLock);
+
+	loadCalendarSet(&alarmSet, filepaths);
+	if (alarmSet.alarmSchedule == NULL \
+	    && (alarmSet.alarmSchedule = createAlarmSchedule(alarmSet.cals, alarmSet.numCals)) == NULL) {
+		pthread_mutex_unlock(&alarmSetLock);
+		free(firings);
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "Could not build the alarm schedule");
+	}
+
+	AlarmSchedule *schedule = alarmSet.alarmSchedule;
+	if ((numFirings = nextAlarms(schedule, nowSeconds, k, firings)) < 0) {
+		pthread_mutex_unlock(&alarmSetLock);
+		free(firings);
+		return ferrorCodeToJSON(OTHER_ERROR, NULL, "Could not find the next alarms");
+	}
+
+	FILE *json = open_memstream(&toReturn, &length);
+	fprintf(json, "{\"errors\":[%s],\"numAlarms\":%d,\"numSkipped\":%d,\"alarms\":[", \
+	        alarmSet.errors, schedule->numSources, schedule->numSkipped);
+
+	for (int i = 0; i < numFirings; i++) {
+		const AlarmSource *source = &(schedule->sources[firings[i].source]);
+		DateTime time, occurrence;
+
+		secondsToDateTime(firings[i].time, source->trigger.absolute ? source->trigger.UTC : source->rec->UTC, &time);
+		secondsToDateTime(firings[i].occurrence, source->rec->UTC, &occurrence);
+		char *timeJSON = dtToJSON(time);
+		char *occurrenceJSON = dtToJSON(occurrence);
+
+		fprintf(json, "%s{\"time\":%s,\"filename\":\"%s\",\"UID\":\"%s\",\"summary\":\"%s\",\"action\":\"%s\",\"trigger\":\"%s\"," \
+		        "\"occurrence\":%s,\"repeat\":%d}", (i == 0) ? "" : ",", timeJSON, alarmSet.names[source->calendar], \
+		        source->event->UID, findPropDescr(source->event, "SUMMARY"), source->alarm->action, source->alarm->trigger, \
+		        occurrenceJSON, firings[i].repeat);
+		free(timeJSON);
+		free(occurrenceJSON);
+	}
+
+	fputs("]}", json);
+	fclose(json);
+
+	pthread_mutex_unlock(&alarmSetLock);
+
+	free(firings);
+
+	return toReturn;
+}
+
+static char *runNextAlarms(char **args) {
+	return nextAlarmsJSON(args[0], args[1], atoi(args[2]));
+}
+
+// The same as nextAlarmsJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int nextAlarmsJSONAsync(const char *filepaths, const char *now, int k) {
+	char count[16];
+	const char *args[] = {filepaths, now, count};
+
+	if (filepaths == NULL || now == NULL) {
+		return -1;
+	}
+
+	snprintf(count, sizeof(count), "%d", k);
+	return submitJob(runNextAlarms, args, 3, filesSize(filepaths), false);
+}
+
+// The Catalog of the last directory that was listed, so that it is only read from its catalog file once
+static struct {
+	char *dirPath;
+	Catalog *catalog;
+} catalogCache;
+static pthread_mutex_t catalogCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Takes the path of a directory of calendar files, and brings its catalog (see Catalog.h) up to date, only
+// parsing the files that are new or have changed since the last call. Returns a JSON array with the
+// catalog entry of every file, sorted by name, or an error code JSON on a fail.
+char *catalogJSON(const char dirPath[]) {
+	ICalErrorCode error;
+	bool changed;
+	char *toReturn;
+
+	if (dirPath == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "Directory path was not received");
+	}
+
+	pthread_mutex_lock(&catalogCacheLock);
+
+	if (catalogCache.dirPath == NULL || strcmp(catalogCache.dirPath, dirPath) != 0) {
+		deleteCatalog(catalogCache.catalog);
+		free(catalogCache.dirPath);
+		catalogCache.dirPath = NULL;
+
+		if ((error = loadCatalog(dirPath, &catalogCache.catalog)) != OK) {
+			catalogCache.catalog = NULL;
+			pthread_mutex_unlock(&catalogCacheLock);
+			return ferrorCodeToJSON(error, dirPath, "Could not load the catalog");
+		}
+		catalogCache.dirPath = strdup(dirPath);
+	}
+
+	if ((error = updateCatalog(catalogCache.catalog, dirPath, &changed)) != OK) {
+		pthread_mutex_unlock(&catalogCacheLock);
+		return ferrorCodeToJSON(error, dirPath, "Could not read the directory");
+	}
+
+	// The in-memory catalog is still right if it can't be saved, so the listing is sent either way
+	if (changed && saveCatalog(catalogCache.catalog, dirPath) != OK) {
+		errorMsg("Could not save the catalog of \"%s\"\n", dirPath);
+	}
+
+	toReturn = catalogToJSON(catalogCache.catalog);
+
+	pthread_mutex_unlock(&catalogCacheLock);
+
+	return toReturn;
+}
+
+static char *runCatalog(char **args) {
+	return catalogJSON(args[0]);
+}
+
+// The same as catalogJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int catalogJSONAsync(const char dirPath[]) {
+	if (dirPath == NULL) {
+		return -1;
+	}
+
+	// Every file in the directory may need to be parsed, so like loadDirectoryJSONAsync() it is a large job
+	return submitJob(runCatalog, &dirPath, 1, LARGE_JOB_BYTES, false);
+}
+
+// A directory being read in by loadDirectoryJSON(): its files, and the JSON of each one once it has been read in
+typedef struct directoryload {
+	const char *dirPath;
+	char **names;
+	char **results;
+	int numFiles;
+	// The next file for a thread to take, so that a few large files don't leave the other threads idle
+	atomic_int next;
+	atomic_int numErrors;
+} DirectoryLoad;
+
+static int compareNames(const void *first, const void *second) {
+	return strcmp(*(char * const *)first, *(char * const *)second);
+}
+
+// Returns the JSON of the file at 'path', as /getCal sends it: {"filename","obj":Calendar JSON}, or its error code JSON
+static char *loadedFileJSON(const char *path, const char *name, atomic_int *numErrors) {
+	ICalErrorCode error;
+	Calendar *cal;
+
+	if ((error = createCalendarValidated((char *)path, &cal)) != OK) {
+		atomic_fetch_add(numErrors, 1);
+		return ferrorCodeToJSON(error, path, "Could not read in a valid calendar from the file");
+	}
+
+	char *calJSON = calendarToJSON(cal);
+	char *nameJSON = escapeJSON(name);
+	deleteCalendar(cal);
+
+	char *toReturn = NULL;
+	if (calJSON != NULL && nameJSON != NULL) {
+		size_t size = strlen(calJSON) + strlen(nameJSON) + 30;
+		if ((toReturn = malloc(size)) != NULL) {
+			snprintf(toReturn, size, "{\"filename\":\"%s\",\"obj\":%s}", nameJSON, calJSON);
+		}
+	}
+	free(calJSON);
+	free(nameJSON);
+
+	return toReturn;
+}
+
+// Reads in the files of 'load' until none are left. Each file is taken by exactly one thread.
+static void *loadFiles(void *data) {
+	DirectoryLoad *load = data;
+	int i;
+
+	while ((i = atomic_fetch_add(&load->next, 1)) < load->numFiles) {
+		size_t size = strlen(load->dirPath) + strlen(load->names[i]) + 2;
+		char *path = malloc(size);
+
+		if (path != NULL) {
+			snprintf(path, size, "%s/%s", load->dirPath, load->names[i]);
+			load->results[i] = loadedFileJSON(path, load->names[i], &load->numErrors);
+			free(path);
+		}
+	}
+
+	return NULL;
+}
+
+// Stores the names of the .ics files in 'dirPath' that loadDirectoryJSON() reads in, sorted, in 'names'.
+// Returns how many there are, or -1 if the directory can't be read or memory could not be allocated.
+static int listDirectory(const char dirPath[], char ***names) {
+	DIR *dir = opendir(dirPath);
+	struct dirent *file;
+	struct stat info;
+	int numFiles = 0, size = 16;
+
+	*names = malloc(size * sizeof(char *));
+	if (dir == NULL || *names == NULL) {
+		if (dir != NULL) {
+			closedir(dir);
+		}
+		free(*names);
+		return -1;
+	}
+
+	while ((file = readdir(dir)) != NULL) {
+		if (file->d_name[0] == '.' || !endsWith(file->d_name, ".ics")) {
+			continue;
+		}
+
+		size_t pathSize = strlen(dirPath) + strlen(file->d_name) + 2;
+		char *path = malloc(pathSize);
+		if (path == NULL) {
+			break;
+		}
+		snprintf(path, pathSize, "%s/%s", dirPath, file->d_name);
+		bool regular = (stat(path, &info) == 0 && S_ISREG(info.st_mode));
+		free(path);
+
+		if (!regular) {
+			continue;
+		}
+
+		if (numFiles == size) {
+			char **bigger = realloc(*names, (size *= 2) * sizeof(char *));
+			if (bigger == NULL) {
+				break;
+			}
+			*names = bigger;
+		}
+		if (((*names)[numFiles] = strdup(file->d_name)) != NULL) {
+			numFiles++;
+		}
+	}
+	closedir(dir);
+
+	qsort(*names, numFiles, sizeof(char *), compareNames);
+
+	return numFiles;
+}
+
+// Takes the path of a directory, and reads in and validates every .ics file in it (other than ones whose names
+// start with '.') on up to 'maxThreads' threads at once, or one per processor if 'maxThreads' is 0 or less.
+// Returns {"numFiles","numErrors","calendars":[...]}, where each calendar is {"filename","obj":Calendar JSON}
+// or the error code JSON of the file, sorted by filename. Returns an error code JSON if the directory can't be read.
+char *loadDirectoryJSON(const char dirPath[], int maxThreads) {
+	DirectoryLoad load = {.dirPath = dirPath};
+	pthread_t threads[MAX_LOAD_THREADS];
+	bool started[MAX_LOAD_THREADS];
+
+	if (dirPath == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "Directory path was not received");
+	}
+
+	if ((load.numFiles = listDirectory(dirPath, &load.names)) < 0) {
+		return ferrorCodeToJSON(INV_FILE, dirPath, "Could not read the directory");
+	}
+	if ((load.results = calloc(load.numFiles + 1, sizeof(char *))) == NULL) {
+		for (int i = 0; i < load.numFiles; i++) {
+			free(load.names[i]);
+		}
+		free(load.names);
+		return ferrorCodeToJSON(OTHER_ERROR, dirPath, "Could not allocate memory");
+	}
+	atomic_init(&load.next, 0);
+	atomic_init(&load.numErrors, 0);
+
+	int numThreads = (maxThreads > 0) ? maxThreads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+	numThreads = (numThreads > MAX_LOAD_THREADS) ? MAX_LOAD_THREADS : numThreads;
+	numThreads = (numThreads > load.numFiles) ? load.numFiles : numThreads;
+
+	// The calling thread reads in files as well. If a thread can't be started, the others take its share.
+	for (int t = 1; t < numThreads; t++) {
+		started[t] = (pthread_create(&threads[t], NULL, loadFiles, &load) == 0);
+	}
+	loadFiles(&load);
+	for (int t = 1; t < numThreads; t++) {
+		if (started[t]) {
+			pthread_join(threads[t], NULL);
+		}
+	}
+
+	// A file that memory ran out for still gets an entry
+	for (int i = 0; i < load.numFiles; i++) {
+		if (load.results[i] == NULL) {
+			load.results[i] = ferrorCodeToJSON(OTHER_ERROR, load.names[i], "Could not allocate memory");
+			atomic_fetch_add(&load.numErrors, 1);
+		}
+	}
+
+	char *calendars = joinJSONArray(load.results, load.numFiles);
+	char *toReturn = NULL;
+	if (calendars != NULL) {
+		size_t size = strlen(calendars) + 100;
+		if ((toReturn = malloc(size)) != NULL) {
+			snprintf(toReturn, size, "{\"numFiles\":%d,\"numErrors\":%d,\"calendars\":%s}", load.numFiles, \
+			         atomic_load(&load.numErrors), calendars);
+		}
+	}
+	if (toReturn == NULL) {
+		toReturn = ferrorCodeToJSON(OTHER_ERROR, dirPath, "Could not allocate memory");
+	}
+
+	free(calendars);
+	for (int i = 0; i < load.numFiles; i++) {
+		free(load.names[i]);
+		free(load.results[i]);
+	}
+	free(load.names);
+	free(load.results);
+
+	return toReturn;
+}
+
+static char *runLoadDirectory(char **args) {
+	return loadDirectoryJSON(args[0], atoi(args[1]));
+}
+
+// The same as loadDirectoryJSON(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int loadDirectoryJSONAsync(const char dirPath[], int maxThreads) {
+	char threads[16];
+	const char *args[] = {dirPath, threads};
+
+	if (dirPath == NULL) {
+		return -1;
+	}
+
+	// A whole directory is always a large job, so it can't hold up the small ones
+	snprintf(threads, sizeof(threads), "%d", maxThreads);
+	return submitJob(runLoadDirectory, args, 2, LARGE_JOB_BYTES, false);
+}
+
+// Creates the file at 'path' for the rows of a table. Fails if anything is already there (even a dangling link),
+// so the rows can't be written through a link into some other file. Returns its file descriptor, or -1 on a fail.
+static int openTableFile(const char *path) {
+	return open(path, O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+}
+
+// Takes a filename, the paths of the files to write its EVENT and ALARM rows to (which mustn't exist yet), and the
+// positions of the Events to leave out, separated by commas ("" to keep all of them). Writes the rows as tab-separated values
+// (see TableExport.h), and returns {"version":...,"prodID":...,"numEvents":...,"numAlarms":...}, the first two
+// being the Calendar's FILE row. Returns an error code JSON on a fail.
+char *exportTablesTSV(const char filepath[], const char eventsPath[], const char alarmsPath[], const char *skip) {
+	ICalErrorCode error;
+	Calendar *cal;
+
+	if (filepath == NULL || eventsPath == NULL || alarmsPath == NULL || skip == NULL) {
+		return ferrorCodeToJSON(INV_FILE, NULL, "A file path or the Events to leave out were not received");
+	}
+
+	if ((error = createCalendarValidated((char *)filepath, &cal)) != OK) {
+		return ferrorCodeToJSON(error, filepath, "Could not read in a valid calendar from the file");
+	}
+
+	int numEvents = getLength(cal->events);
+	bool *leaveOut = calloc(numEvents + 1, sizeof(bool));
+	if (leaveOut == NULL) {
+		deleteCalendar(cal);
+		return ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not allocate memory");
+	}
+
+	// Positions that aren't in the Calendar are ignored
+	for (char *end; *skip != '\0'; skip = (*end == ',') ? end + 1 : end) {
+		long position = strtol(skip, &end, 10);
+		if (end == skip) {
+			break;
+		}
+		if (position >= 0 && position < numEvents) {
+			leaveOut[position] = true;
+		}
+	}
+
+	int eventsFd = openTableFile(eventsPath);
+	int alarmsFd = openTableFile(alarmsPath);
+	if (eventsFd < 0 || alarmsFd < 0) {
+		if (eventsFd >= 0) {
+			close(eventsFd);
+		}
+		if (alarmsFd >= 0) {
+			close(alarmsFd);
+		}
+		free(leaveOut);
+		deleteCalendar(cal);
+		return ferrorCodeToJSON(WRITE_ERROR, filepath, "Could not create the files to write the rows to");
+	}
+
+	// Each batch is too large to keep on a worker thread's stack
+	IOBatch *events = malloc(sizeof(IOBatch));
+	IOBatch *alarms = malloc(sizeof(IOBatch));
+	int numRows = 0, numAlarmRows = 0;
+
+	if (events == NULL || alarms == NULL) {
+		error = OTHER_ERROR;
+	} else {
+		initializeBatch(events, eventsFd);
+		initializeBatch(alarms, alarmsFd);
+		error = appendTableRows(cal, leaveOut, events, alarms, &numRows, &numAlarmRows);
+		// The rows point into the Calendar, so they are flushed before it is deleted
+		if (error == OK && (flushBatch(events) != OK || flushBatch(alarms) != OK)) {
+			error = WRITE_ERROR;
+		}
+	}
+
+	// Both are closed before either result is looked at, so a failed close can't leak the other file
+	int eventsClosed = close(eventsFd);
+	int alarmsClosed = close(alarmsFd);
+	if (eventsClosed != 0 || alarmsClosed != 0) {
+		error = (error == OK) ? WRITE_ERROR : error;
+	}
+	free(events);
+	free(alarms);
+	free(leaveOut);
+
+	if (error != OK) {
+		deleteCalendar(cal);
+		return ferrorCodeToJSON(error, filepath, "Could not write the calendar's rows");
+	}
+
+	int size = strlen(cal->prodID) + 100;
+	char *toReturn = malloc(size);
+	if (toReturn == NULL) {
+		toReturn = ferrorCodeToJSON(OTHER_ERROR, filepath, "Could not allocate memory");
+	} else {
+		snprintf(toReturn, size, "{\"version\":%d,\"prodID\":\"%s\",\"numEvents\":%d,\"numAlarms\":%d}", \
+		         (int)cal->version, cal->prodID, numRows, numAlarmRows);
+	}
+	deleteCalendar(cal);
+
+	return toReturn;
+}
+
+static char *runExportTables(char **args) {
+	return exportTablesTSV(args[0], args[1], args[2], args[3]);
+}
+
+// The same as exportTablesTSV(), but run on the library's worker pool. Returns the id of the job, or -1 on a fail.
+int exportTablesTSVAsync(const char filepath[], const char eventsPath[], const char alarmsPath[], const char *skip) {
+	const char *args[] = {filepath, eventsPath, alarmsPath, skip};
+
+	if (filepath == NULL || eventsPath == NULL || alarmsPath == NULL || skip == NULL) {
+		return -1;
+	}
+
+	// The calendar file is only read; the files it writes are the caller's own
+	return submitJob(runExportTables, args, 4, fileSize(filepath), false);
+}
@@ -0,0 +1,111 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  ReadFoldTest.c                  *
+ ************************************/
+
+/* Checks the content lines that readFold() reads out of a stream: how folds, comments and whitespace
+ * are handled, that lines longer than its first buffer come through whole, and which errors it returns.
+ *
+ * Leading whitespace is kept and trailing whitespace is trimmed, as the original fixed-size reader did
+ * (its trimWhitespace() call only ever took effect at the end of the line).
+ *
+ * Run with "make test". Exits with 0 if every check passed, or 1 otherwise.
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Parsing.h"
+
+static int failures;
+
+// Reads every content line of 'data', and checks them against the 'numExpected' lines in 'expected'
+// followed by the error 'expectedError' (OK if the data should be read to the end)
+static void check(const char *name, const char *data, const char **expected, int numExpected, ICalErrorCode expectedError) {
+	FILE *fp = fmemopen((void *)data, strlen(data), "r");
+	char *line = NULL;
+	size_t size = 0;
+	ICalErrorCode error = OK;
+	int numLines = 0;
+
+	if (fp == NULL) {
+		perror("fmemopen");
+		exit(1);
+	}
+
+	while ((error = readFold(&line, &size, fp)) == OK && line[0] != '\0') {
+		if (numLines >= numExpected || strcmp(line, expected[numLines]) != 0) {
+			fprintf(stderr, "%s: line %d is \"%.60s\", not \"%.60s\"\n", name, numLines, line, \
+			        (numLines < numExpected) ? expected[numLines] : "(the end)");
+			failures++;
+			break;
+		}
+		numLines++;
+	}
+
+	if (error != expectedError) {
+		fprintf(stderr, "%s: readFold() returned %d, not %d\n", name, error, expectedError);
+		failures++;
+	} else if (error == OK && numLines != numExpected) {
+		fprintf(stderr, "%s: read %d line(s), not %d\n", name, numLines, numExpected);
+		failures++;
+	}
+
+	free(line);
+	fclose(fp);
+}
+
+int main(void) {
+	const char *trailing[] = {"SUMMARY:a", "LOCATION:b"};
+	check("trailing whitespace", "SUMMARY:a  \t\r\nLOCATION:b \r\n", trailing, 2, OK);
+
+	const char *inner[] = {"SUMMARY: \t lead"};
+	check("whitespace in the value", "SUMMARY: \t lead\r\n", inner, 1, OK);
+
+	const char *leading[] = {"  SUMMARY:a", "END:VEVENT"};
+	check("leading whitespace after a comment", ";comment\r\n  SUMMARY:a\r\nEND:VEVENT\r\n", leading, 2, OK);
+
+	const char *folded[] = {"DESCRIPTION:abc", "NEXT:x"};
+	check("folds", "DESCRIPTION:a\r\n b\r\n\tc\r\nNEXT:x\r\n", folded, 2, OK);
+
+	const char *comments[] = {"A:1", "B:2"};
+	check("comments", ";one\r\nA:1\r\n;two\r\nB:2\r\n", comments, 2, OK);
+
+	check("blank line", "A:1\r\n \r\nB:2\r\n", comments, 1, INV_CAL);
+	check("missing CRLF", "A:1\nB:2\r\n", comments, 0, INV_FILE);
+
+	// A line and a fold that are each several times longer than the buffer readFold() starts with
+	size_t longLength = 5 * READ_FOLD_SIZE;
+	char *longLine = malloc(longLength + 1), *data = malloc(2 * longLength + 64);
+	char *expectedLong = malloc(2 * longLength + 64);
+	if (longLine == NULL || data == NULL || expectedLong == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+	for (size_t i = 0; i < longLength; i++) {
+		longLine[i] = 'a' + i % 26;
+	}
+	longLine[longLength] = '\0';
+	sprintf(data, "DESCRIPTION:%s\r\n %s\r\nEND:VEVENT\r\n", longLine, longLine);
+	sprintf(expectedLong, "DESCRIPTION:%s%s", longLine, longLine);
+	const char *longLines[] = {expectedLong, "END:VEVENT"};
+	check("long lines", data, longLines, 2, OK);
+	free(longLine);
+	free(data);
+	free(expectedLong);
+
+	if (failures != 0) {
+		printf("FAILED: %d check(s) failed\n", failures);
+		return 1;
+	}
+
+	printf("passed\n");
+	return 0;
+}
@@ -0,0 +1,286 @@
+/************************************
+ *  Name: Joseph Coffa              *
+ *  Student #: 1007320              *
+ *  Due Date: April 5, 2019         *
+ *                                  *
+ *  Assignment 4, CIS*2750          *
+ *  StressTest.c                    *
+ ************************************/
+
+/* Checks that the library can be used from many threads at once. Every thread repeatedly:
+ *
+ *   - parses and validates a file that every thread is parsing at the same time,
+ *   - parses a file of its own, and writes it back out to a file of its own,
+ *   - writes a Calendar to a file that every thread is writing (and parsing) at the same time, and
+ *   - converts Event JSON without a UID, so the Event is given a random one.
+ *
+ * Every Calendar that is parsed is printed and compared with what printCalendar() gave for the same
+ * file before any thread was started, so a parse that was corrupted by another thread is caught.
+ * The UIDs generated by each thread are compared, to catch threads that share (or repeat) their
+ * random number state.
+ *
+ * Run with "make stress" (or "make stress-tsan" to run it under ThreadSanitizer). The number of threads
+ * and rounds can be given as arguments; by default there are two threads per core. Exits with 0 if
+ * every check passed, or 1 otherwise.
+ */
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "CalendarParser.h"
+
+#define DEFAULT_ROUNDS 50
+#define NUM_UIDS 16
+
+typedef struct {
+	int index;
+	int rounds;
+	char UIDs[NUM_UIDS][1000];
+} Worker;
+
+static char directory[] = "/tmp/calendar-stress-XXXXXX";
+static char sharedPath[256];
+static char sharedOutPath[256];
+static char **ownPaths;
+static char **expected;		// printCalendar() of each thread's own file, and of the shared file last
+static int numThreads;
+static atomic_int failures;
+
+static const char *eventJSON = "{\"startDT\":{\"date\":\"20190102\",\"time\":\"100000\",\"isUTC\":true},"
+                               "\"createDT\":{\"date\":\"20190102\",\"time\":\"100000\",\"isUTC\":true},"
+                               "\"UID\":\"NULL\",\"numProps\":3,\"numAlarms\":0,\"summary\":\"stress\","
+                               "\"properties\":[],\"alarms\":[]}";
+
+// Reports a failed check
+static void fail(const Worker *worker, const char *what, const char *path, const char *detail) {
+	fprintf(stderr, "thread %d: %s %s: %s\n", worker->index, what, path, detail);
+	atomic_fetch_add(&failures, 1);
+}
+
+// Writes a calendar to 'path' whose contents depend on 'seed', so that different files have different
+// numbers of events, alarms, properties and folded lines
+static int writeFixture(const char *path, int seed) {
+	FILE *fp = fopen(path, "w");
+	if (fp == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	fprintf(fp, "BEGIN:VCALENDAR\r\nVERSION:2.0\r\nPRODID:-//stress//test %d//EN\r\n", seed);
+	for (int ev = 0; ev < 20 + seed % 30; ev++) {
+		fprintf(fp, "BEGIN:VEVENT\r\nUID:stress-%d-%d@example.com\r\nDTSTAMP:20190101T%02d0000Z\r\n", seed, ev, ev % 24);
+		fprintf(fp, "DTSTART:201902%02dT%02d%02d00\r\n", 1 + ev % 28, ev % 24, seed % 60);
+		fprintf(fp, "SUMMARY:Event %d of file %d\r\nLOCATION:Room %d\r\n", ev, seed, ev * seed);
+		// A long description, folded onto several lines
+		fprintf(fp, "DESCRIPTION:");
+		for (int i = 0; i <= (ev + seed) % 8; i++) {
+			fprintf(fp, "%s%d the quick brown fox jumps over the lazy dog", (i == 0) ? "" : "\r\n ", i);
+		}
+		fprintf(fp, "\r\n");
+		for (int al = 0; al < (ev + seed) % 3; al++) {
+			fprintf(fp, "BEGIN:VALARM\r\nACTION:AUDIO\r\nTRIGGER:-PT%dM\r\nREPEAT:%d\r\nDURATION:PT5M\r\nEND:VALARM\r\n", \
+			        15 * (al + 1), al + 1);
+		}
+		fprintf(fp, "END:VEVENT\r\n");
+	}
+	fprintf(fp, "END:VCALENDAR\r\n");
+
+	return fclose(fp);
+}
+
+// Parses and validates 'path', and returns the printed Calendar, or NULL (after reporting it) if it
+// couldn't be parsed
+static char *parsePrinted(const Worker *worker, const char *path, Calendar **cal) {
+	ICalErrorCode err = createCalendarValidated((char *)path, cal);
+
+	if (err != OK) {
+		char *msg = printError(err);
+		fail(worker, "parsing", path, msg);
+		free(msg);
+		return NULL;
+	}
+
+	return printCalendar(*cal);
+}
+
+// Parses 'path', and checks that it prints as 'expect'
+static void checkParse(const Worker *worker, const char *path, const char *expect) {
+	Calendar *cal = NULL;
+	char *printed = parsePrinted(worker, path, &cal);
+
+	if (printed != NULL && strcmp(printed, expect) != 0) {
+		fail(worker, "parsing", path, "the Calendar differs from the one parsed by a single thread");
+	}
+	free(printed);
+	deleteCalendar(cal);
+}
+
+// Parses 'from', writes it to 'to', and checks that the written file parses as 'expect'
+static void checkWrite(const Worker *worker, const char *from, const char *to, const char *expect) {
+	Calendar *cal = NULL;
+	ICalErrorCode err = createCalendarValidated((char *)from, &cal);
+
+	if (err == OK) {
+		err = writeCalendar((char *)to, cal);
+	}
+	deleteCalendar(cal);
+
+	if (err != OK) {
+		char *msg = printError(err);
+		fail(worker, "writing", to, msg);
+		free(msg);
+		return;
+	}
+
+	checkParse(worker, to, expect);
+}
+
+static void *work(void *arg) {
+	Worker *worker = (Worker *)arg;
+	char outPath[256];
+
+	snprintf(outPath, sizeof(outPath), "%s/out%d.ics", directory, worker->index);
+
+	for (int round = 0; round < worker->rounds; round++) {
+		// The same file as every other thread
+		checkParse(worker, sharedPath, expected[numThreads]);
+
+		// A different file from every other thread
+		checkWrite(worker, ownPaths[worker->index], outPath, expected[worker->index]);
+
+		// Every thread writes the same Calendar to the same file, which is replaced atomically, so
+		// whichever write a parse sees should give the same Calendar
+		checkWrite(worker, sharedPath, sharedOutPath, expected[numThreads]);
+
+		Event *ev = JSONtoEvent(eventJSON);
+		if (ev == NULL) {
+			fail(worker, "converting", "Event JSON", "JSONtoEvent() returned NULL");
+		} else {
+			if (round < NUM_UIDS) {
+				strcpy(worker->UIDs[round], ev->UID);
+			}
+			deleteEvent(ev);
+		}
+	}
+
+	return NULL;
+}
+
+// Checks that no two threads generated the same sequence of UIDs
+static void checkUIDs(const Worker *workers) {
+	int numUIDs = (workers[0].rounds < NUM_UIDS) ? workers[0].rounds : NUM_UIDS;
+
+	for (int i = 0; i < numThreads; i++) {
+		for (int j = i + 1; j < numThreads; j++) {
+			int same = 0;
+			for (int k = 0; k < numUIDs; k++) {
+				same += (strcmp(workers[i].UIDs[k], workers[j].UIDs[k]) == 0);
+			}
+			if (numUIDs > 0 && same == numUIDs) {
+				fprintf(stderr, "threads %d and %d generated the same UIDs\n", i, j);
+				atomic_fetch_add(&failures, 1);
+			}
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+	numThreads = (argc > 1) ? atoi(argv[1]) : 2 * (int)((cores > 0) ? cores : 1);
+	int rounds = (argc > 2) ? atoi(argv[2]) : DEFAULT_ROUNDS;
+
+	if (numThreads < 2 || rounds < 1) {
+		fprintf(stderr, "usage: %s [threads (at least 2)] [rounds]\n", argv[0]);
+		return 1;
+	}
+
+	if (mkdtemp(directory) == NULL) {
+		perror("mkdtemp");
+		return 1;
+	}
+
+	ownPaths = calloc(numThreads, sizeof(char *));
+	expected = calloc(numThreads + 1, sizeof(char *));
+	Worker *workers = calloc(numThreads, sizeof(Worker));
+	pthread_t *threads = calloc(numThreads, sizeof(pthread_t));
+	if (ownPaths == NULL || expected == NULL || workers == NULL || threads == NULL) {
+		fprintf(stderr, "out of memory\n");
+		return 1;
+	}
+
+	// The files, and what they should parse as, are set up before any thread is started
+	snprintf(sharedPath, sizeof(sharedPath), "%s/shared.ics", directory);
+	snprintf(sharedOutPath, sizeof(sharedOutPath), "%s/sharedOut.ics", directory);
+	for (int i = 0; i <= numThreads; i++) {
+		char path[256];
+		snprintf(path, sizeof(path), "%s/own%d.ics", directory, i);
+		const char *file = (i == numThreads) ? sharedPath : path;
+		Worker setup = { .index = -1 };
+		Calendar *cal = NULL;
+
+		if (writeFixture(file, i + 1) != 0 || (expected[i] = parsePrinted(&setup, file, &cal)) == NULL) {
+			return 1;
+		}
+		deleteCalendar(cal);
+
+		if (i < numThreads) {
+			ownPaths[i] = strdup(path);
+		}
+	}
+
+	printf("%d threads, %d rounds each, in %s\n", numThreads, rounds, directory);
+
+	for (int i = 0; i < numThreads; i++) {
+		workers[i].index = i;
+		workers[i].rounds = rounds;
+		if (pthread_create(&threads[i], NULL, work, &workers[i]) != 0) {
+			fprintf(stderr, "couldn't start thread %d\n", i);
+			return 1;
+		}
+	}
+	for (int i = 0; i < numThreads; i++) {
+		pthread_join(threads[i], NULL);
+	}
+
+	checkUIDs(workers);
+
+	// Clean up the files, so that only a failed run leaves them behind
+	int failed = atomic_load(&failures);
+	for (int i = 0; i <= numThreads; i++) {
+		if (failed == 0) {
+			char path[256];
+			snprintf(path, sizeof(path), "%s/out%d.ics", directory, i);
+			unlink(path);
+			if (i < numThreads) {
+				unlink(ownPaths[i]);
+			}
+		}
+		if (i < numThreads) {
+			free(ownPaths[i]);
+		}
+		free(expected[i]);
+	}
+	if (failed == 0) {
+		unlink(sharedPath);
+		unlink(sharedOutPath);
+		rmdir(directory);
+	}
+	free(ownPaths);
+	free(expected);
+	free(workers);
+	free(threads);
+
+	if (failed != 0) {
+		printf("FAILED: %d check(s) failed, files left in %s\n", failed, directory);
+		return 1;
+	}
+
+	printf("passed\n");
+	return 0;
+}
@@ -189,6 +189,23 @@ function errorMsg(message, error, sql=false) {
     statusMsg('\n' + message + ': ' + error.responseText + ' (' + error.status + ': ' + error.statusText + ')');
 }
 
+// Adds a calendar, as /getCal sends it, to the page, or shows the error it has
+function showLoadedCalendar(cal, duplicates) {
+    // Error code JSON's have the format of {"error":"Error code","filename":"file name"},
+    // for example {"error":"Invalid Alarm","filename":"testCalendar5.ics"}
+    if (cal.error != undefined) {
+        // XXX the assignment description has been updated. Now, invalid files are ignored.
+        statusMsg('Error when trying to create calendar from "' + cal.filename + '": ' + cal.error + ': ' + cal.message);
+    } else {
+        statusMsg('Loaded "' + cal.filename + '" successfully');
+        if (duplicates !== undefined && duplicates.length > 0) {
+            statusMsg(duplicates.length + ' event(s) in "' + cal.filename + '" are already in other uploaded calendars');
+        }
+        addCalendarToTable(cal.filename, cal.obj);
+        addCalendarToFileSelector(cal.filename, cal.obj);
+    }
+}
+
 function loadFile(file) {
     $.ajax({
         type: "GET",
@@ -197,17 +214,7 @@ function loadFile(file) {
         success: function(cal) {
             // In this case, 'success' just means the callback itself didn't encounter
             // an error; the function itself could have still failed.
-            // Error code JSON's have the format of {"error":"Error code","filename":"file name"},
-            // for example {"error":"Invalid Alarm","filename":"testCalendar5.ics"}
-
-            if (cal.error != undefined) {
-                // XXX the assignment description has been updated. Now, invalid files are ignored.
-                statusMsg('Error when trying to create calendar from "' + cal.filename + '": ' + cal.error + ': ' + cal.message);
-            } else {
-                statusMsg('Loaded "' + cal.filename + '" successfully');
-                addCalendarToTable(cal.filename, cal.obj);
-                addCalendarToFileSelector(cal.filename, cal.obj);
-            }
+            showLoadedCalendar(cal, file.duplicates);
         },
         error: function(error) {
             errorMsg('Encountered an error when attempting to load the file "' + file.name + '"', error);
@@ -215,6 +222,27 @@ function loadFile(file) {
     });
 }
 
+// Loads every saved .ics file with a single request, which the server reads in all at once
+function loadAllFiles() {
+    $.ajax({
+        type: "GET",
+        url: "/getAllCals",
+        dataType: "json",
+        success: function(result) {
+            if (result.error !== undefined) {
+                statusMsg('Error when trying to load the saved .ics files: ' + result.error + ': ' + result.message);
+                return;
+            }
+
+            for (var cal of result.calendars) {
+                showLoadedCalendar(cal);
+            }
+        }, error: function(error) {
+            errorMsg('Encountered an error while loading saved .ics files', error);
+        }
+    });
+}
+
 // Returns true if all required input fields have been filled, and false otherwise.
 // Highlights the border of the input field red if it is both required and empty.
 function formHasAllRequired(formID) {
@@ -375,19 +403,7 @@ $(document).ready(function() {
     /******************************
      * Load all files in /uploads *
      ******************************/
-    $.ajax({
-        type: "GET",
-        url: "/uploadsContents",
-        dataType: "json",
-        success: function(files) {
-            for (var file of files) {
-                // Get a JSON of the calendar, and add it to the necessary HTML elements
-                loadFile({"name": file});
-            }
-        }, error: function(error) {
-            errorMsg('Encountered an error while loading saved .ics files', error);
-        }
-    }); 
+    loadAllFiles();
 
 
 
@@ -619,12 +635,18 @@ $(document).ready(function() {
                 "evt": JSON.stringify(eventJSON)
             },
             dataType: "json",
-            success: function(cal) {
-                if (cal.error != undefined) {
-                    statusMsg('Encountered an error when adding an event to the saved calendar "' + filename + '": ' + cal.message);
+            success: function(evt) {
+                if (evt.error != undefined) {
+                    statusMsg('Encountered an error when adding an event to the saved calendar "' + filename + '": ' + evt.message);
                     return;
                 }
                 statusMsg('Added a new Event to "' + filename + '"');
+
+                // Only the new Event is sent back, so it is added to the copy of the Calendar already on the page
+                var cal = $('#fileSelector option[value="' + filename + '"]').data('obj');
+                cal.events.push(evt);
+                cal.numEvents += 1;
+
                 addCalendarToTable(filename, cal, false);
                 addCalendarToFileSelector(filename, cal);
             },
@@ -785,7 +807,7 @@ $(document).ready(function() {
                         url: '/insertIntoDB/' + filename,
                         type: 'GET',
                         success: function(successFilename) {
-                            if (successFilename.alreadyContained !== undefined) {
+                            if (successFilename.message !== undefined) {
                                 statusMsg(successFilename.message);
                             } else {
                                 statusMsg('Successfully added ' + successFilename + ' to the database');
@@ -915,7 +937,7 @@ $(document).ready(function() {
     $('#allConflictsQuery').click(function() {
         $(this).blur();
 
-        $('#queryModalTitle').html('All Events That Occur on The same Day As Another Event');
+        $('#queryModalTitle').html('All Events That Overlap Another Event');
 
         $.ajax({
             url: '/getEventConflicts',